@@ -0,0 +1,151 @@
+#include "AssetRegistry.h"
+
+#include "DDSTextureLoader.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Profiling.h"
+
+#define SAFE_RELEASE(p) { if(p) { p->Release(); p = nullptr; } }
+
+// ===== Constructor / Destructor ===== //
+AssetRegistry::AssetRegistry()
+{
+	m_pDevice = nullptr;
+	m_bCompressTextures = false;
+	m_Compression.format = DDS_FORMAT_UNKNOWN;
+	m_Compression.quality = COMPRESSION_FAST;
+	m_Compression.threadCount = 0;
+}
+
+AssetRegistry::~AssetRegistry()
+{
+	Clear();
+}
+// ==================================== //
+
+// ===== Interface ===== //
+// - CreateTexture
+// --- Straight from the mapping, or from a block compressed copy when compression is on and the texture can take it
+HRESULT AssetRegistry::CreateTexture(const char* _path, const MappedFile& _file, ID3D11ShaderResourceView** _view)
+{
+	DDSTexture texture;
+	if (m_bCompressTextures && ParseDDS(_file.GetData(), _file.GetSize(), &texture) == DDS_OK && CanCompressDDS(texture)) {
+		vector<unsigned char> compressed;
+		CompressionStats stats;
+		if (CompressDDS(texture, m_Compression, &compressed, &stats) == DDS_OK) {
+			LogCompressionStats(_path, stats);
+			return CreateDDSTextureFromMemory(m_pDevice, &compressed[0], compressed.size(), nullptr, _view);
+		}
+	}
+	return CreateDDSTextureFromMemory(m_pDevice, (const uint8_t*)_file.GetData(), _file.GetSize(), nullptr, _view);
+}
+
+HRESULT AssetRegistry::AcquireTexture(const char* _path, ID3D11ShaderResourceView** _view)
+{
+	*_view = nullptr;
+
+	// === Known path, nothing to read
+	unsigned int asset = m_Textures.FindPath(_path);
+	if (asset != INVALID_ASSET) {
+		m_Textures.Reuse(asset);
+		*_view = m_TextureViews[asset];
+	}
+	else {
+		// === Map and hash the file, its content may already be loaded under another name
+		MappedFile file;
+		if (!file.Open(_path)) {
+			LogMessage("AssetRegistry: could not open %s", _path);
+			return E_FAIL;
+		}
+		bool created = false;
+		asset = m_Textures.Request(_path, HashBytes(file.GetData(), file.GetSize()), file.GetSize(), &created);
+		if (created) {
+			ID3D11ShaderResourceView* view = nullptr;
+			HRESULT hr = CreateTexture(_path, file, &view);
+			if (FAILED(hr))
+				LogMessage("AssetRegistry: %s failed to load (0x%08X)", _path, (unsigned int)hr);
+			m_TextureViews.push_back(view);
+		}
+		*_view = m_TextureViews[asset];
+	}
+
+	// === The caller's reference
+	if (*_view == nullptr)
+		return E_FAIL;
+	(*_view)->AddRef();
+	return S_OK;
+}
+
+void AssetRegistry::AcquireMesh(const char* _name, const Vertex* _vertices, unsigned int _vertexCount, const unsigned int* _indexes, unsigned int _indexCount,
+	Object* _object, const std::function<void(Object*)>& _create)
+{
+	// === Generated meshes can change under the same name, so the content is always hashed; the format is part of it
+	unsigned long long vertexBytes = (unsigned long long)_vertexCount * sizeof(Vertex), indexBytes = (unsigned long long)_indexCount * sizeof(unsigned int);
+	unsigned long long hash = HashBytes(&_object->Format, sizeof(_object->Format));
+	hash = HashBytes(_vertices, (size_t)vertexBytes, hash);
+	hash = HashBytes(_indexes, (size_t)indexBytes, hash);
+	bool created = false;
+	unsigned int asset = m_Meshes.Request(_name, hash, vertexBytes + indexBytes, &created);
+
+	// === First time: build it on _object and keep a reference to its buffers
+	if (created) {
+		_create(_object);
+		MeshAsset mesh;
+		mesh.vertexBuffer = _object->pVertexBuffer;
+		mesh.indexBuffer = _object->pIndexBuffer;
+		mesh.indexFormat = _object->IndexFormat;
+		mesh.indexCount = _object->NumIndexes;
+		mesh.vertexSize = _object->VertexSize;
+		mesh.indexRanges = _object->IndexRanges;
+		mesh.positionScale = _object->PositionScale;
+		mesh.positionOffset = _object->PositionOffset;
+		mesh.bounds = _object->GetLocalBounds();
+		if (mesh.vertexBuffer)
+			mesh.vertexBuffer->AddRef();
+		if (mesh.indexBuffer)
+			mesh.indexBuffer->AddRef();
+		m_MeshAssets.push_back(mesh);
+		return;
+	}
+
+	// === Seen before: share the buffers
+	const MeshAsset& mesh = m_MeshAssets[asset];
+	SAFE_RELEASE(_object->pVertexBuffer);
+	SAFE_RELEASE(_object->pIndexBuffer);
+	_object->pVertexBuffer = mesh.vertexBuffer;
+	_object->pIndexBuffer = mesh.indexBuffer;
+	if (_object->pVertexBuffer)
+		_object->pVertexBuffer->AddRef();
+	if (_object->pIndexBuffer)
+		_object->pIndexBuffer->AddRef();
+	_object->IndexFormat = mesh.indexFormat;
+	_object->NumIndexes = mesh.indexCount;
+	_object->VertexSize = mesh.vertexSize;
+	_object->IndexRanges = mesh.indexRanges;
+	_object->PositionScale = mesh.positionScale;
+	_object->PositionOffset = mesh.positionOffset;
+	_object->SetLocalBounds(mesh.bounds);
+}
+
+void AssetRegistry::Clear()
+{
+	for (size_t i = 0; i < m_TextureViews.size(); i++)
+		SAFE_RELEASE(m_TextureViews[i]);
+	for (size_t i = 0; i < m_MeshAssets.size(); i++) {
+		SAFE_RELEASE(m_MeshAssets[i].vertexBuffer);
+		SAFE_RELEASE(m_MeshAssets[i].indexBuffer);
+	}
+	m_TextureViews.clear();
+	m_MeshAssets.clear();
+	m_Textures.Clear();
+	m_Meshes.Clear();
+}
+// ===================== //
+
+// ===== Accessors ===== //
+void AssetRegistry::LogStats() const
+{
+	LogAssetStats("textures", m_Textures.GetStats());
+	LogAssetStats("meshes", m_Meshes.GetStats());
+}
+// ===================== //
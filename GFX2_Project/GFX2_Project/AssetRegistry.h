@@ -0,0 +1,79 @@
+#pragma once
+
+#include <d3d11.h>
+#include <functional>
+#include <vector>
+
+#include "AssetTable.h"
+#include "Object.h"
+#include "TextureCompression.h"
+
+using std::vector;
+
+class MappedFile;
+
+// - AssetRegistry
+// --- Loads every texture and mesh once and shares it: repeated requests, by path or by identical content, hand out
+// --- the same GPU resource with an extra reference, so the Objects using it each release their own as before
+// --- The registry keeps one reference of its own until Clear; not thread safe, use it from the loading thread
+class AssetRegistry
+{
+private:
+	// === Everything CreateMeshBuffers sets up on an Object
+	struct MeshAsset
+	{
+		ID3D11Buffer*		vertexBuffer;
+		ID3D11Buffer*		indexBuffer;
+		DXGI_FORMAT			indexFormat;
+		unsigned int		indexCount;
+		unsigned int		vertexSize;
+		vector<IndexRange>	indexRanges;
+		XMFLOAT4			positionScale;
+		XMFLOAT4			positionOffset;
+		Bounds				bounds;
+	};
+	ID3D11Device*						m_pDevice;
+	AssetTable							m_Textures;
+	vector<ID3D11ShaderResourceView*>	m_TextureViews;
+	AssetTable							m_Meshes;
+	vector<MeshAsset>					m_MeshAssets;
+	bool								m_bCompressTextures;
+	CompressionOptions					m_Compression;
+
+	HRESULT CreateTexture(const char* _path, const MappedFile& _file, ID3D11ShaderResourceView** _view);
+
+	// === Not copyable, it holds references
+	AssetRegistry(const AssetRegistry&);
+	AssetRegistry& operator=(const AssetRegistry&);
+
+public:
+	// ===== Constructor / Destructor
+	AssetRegistry();
+	~AssetRegistry();
+
+	// ===== Interface
+	void SetDevice(ID3D11Device* _device) { m_pDevice = _device; }
+	// - SetTextureCompression
+	// --- Uncompressed RGBA textures loaded from now on are block compressed with _options before they are created;
+	// --- off by default, since it is lossy and nothing keeps the result between runs
+	void SetTextureCompression(const CompressionOptions& _options) { m_Compression = _options; m_bCompressTextures = true; }
+	// - AcquireTexture
+	// --- Shader resource view of the DDS file at _path, with a reference for the caller
+	// --- The file is mapped and hashed only the first time _path is asked for; *_view is null, and the failure logged,
+	// --- if it fails to load
+	HRESULT AcquireTexture(const char* _path, ID3D11ShaderResourceView** _view);
+	// - AcquireMesh
+	// --- Gives _object the buffers of the mesh _name, with a reference each; _create builds them on _object the
+	// --- first time this content is seen in _object's vertex format, a later identical mesh only copies them
+	void AcquireMesh(const char* _name, const Vertex* _vertices, unsigned int _vertexCount, const unsigned int* _indexes, unsigned int _indexCount,
+		Object* _object, const std::function<void(Object*)>& _create);
+	// - Clear
+	// --- Drops the registry's references, the resources live on in the Objects still holding them
+	void Clear();
+
+	// ===== Accessors
+	const AssetStats& GetTextureStats() const { return m_Textures.GetStats(); }
+	const AssetStats& GetMeshStats() const { return m_Meshes.GetStats(); }
+	// - LogStats
+	void LogStats() const;
+};
@@ -0,0 +1,147 @@
+#include "AssetTable.h"
+
+#include <cstring>
+
+#include "Hash.h"
+#include "Profiling.h"
+
+// ===== Constructor ===== //
+AssetTable::AssetTable()
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+// ======================= //
+
+// ===== Interface ===== //
+unsigned int AssetTable::FindPath(const string& _path) const
+{
+	map<string, unsigned int>::const_iterator path = m_Paths.find(_path);
+	return path != m_Paths.end() ? path->second : INVALID_ASSET;
+}
+
+void AssetTable::Reuse(unsigned int _asset)
+{
+	m_Assets[_asset].requests++;
+	m_Stats.requests++;
+	m_Stats.hits++;
+	m_Stats.bytesSaved += m_Assets[_asset].size;
+}
+
+unsigned int AssetTable::Request(const string& _path, unsigned long long _hash, unsigned long long _size, bool* _created)
+{
+	// === Same content under another path, the size guards against a hash collision
+	map<unsigned long long, unsigned int>::const_iterator content = m_Contents.find(_hash);
+	if (content != m_Contents.end() && m_Assets[content->second].size == _size) {
+		if (FindPath(_path) != content->second)
+			m_Stats.contentHits++;
+		m_Paths[_path] = content->second;
+		Reuse(content->second);
+		*_created = false;
+		return content->second;
+	}
+
+	// === New content
+	unsigned int asset = (unsigned int)m_Assets.size();
+	Asset added = { _hash, _size, 1 };
+	m_Assets.push_back(added);
+	m_Paths[_path] = asset;
+	if (content == m_Contents.end())
+		m_Contents[_hash] = asset;
+	m_Stats.requests++;
+	m_Stats.misses++;
+	m_Stats.bytesLoaded += _size;
+	*_created = true;
+	return asset;
+}
+
+void AssetTable::Clear()
+{
+	m_Assets.clear();
+	m_Paths.clear();
+	m_Contents.clear();
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+// ===================== //
+
+void LogAssetStats(const char* _name, const AssetStats& _stats)
+{
+	LogMessage("AssetRegistry: %s, %u requests -> %u loaded (%u KB), %u shared (%u by content under another path), %u KB saved",
+		_name, _stats.requests, _stats.misses, (unsigned int)(_stats.bytesLoaded / 1024), _stats.hits, _stats.contentHits,
+		(unsigned int)(_stats.bytesSaved / 1024));
+}
+
+// ===== Checks ===== //
+bool CheckAssetTable()
+{
+	unsigned int failures = 0;
+	AssetTable table;
+	bool created = false;
+	const char cube[] = "cube vertices and indexes";
+	const char window[] = "windowed box texture";
+	unsigned long long cubeHash = HashBytes(cube, sizeof(cube)), windowHash = HashBytes(window, sizeof(window));
+
+	// === The first request of a path loads it
+	unsigned int first = table.Request("WindowedBox.dds", windowHash, sizeof(window), &created);
+	if (!created || first != 0 || table.GetAssetCount() != 1) {
+		LogMessage("AssetTable: the first request did not add an asset");
+		failures++;
+	}
+
+	// === The same path again is found without its content
+	unsigned int again = table.FindPath("WindowedBox.dds");
+	if (again != first) {
+		LogMessage("AssetTable: a known path was not found");
+		failures++;
+	}
+	else {
+		table.Reuse(again);
+		table.Reuse(again);
+	}
+
+	// === A copy under another name shares the asset, different content does not
+	unsigned int copy = table.Request("Copy of WindowedBox.dds", windowHash, sizeof(window), &created);
+	if (created || copy != first || table.FindPath("Copy of WindowedBox.dds") != first) {
+		LogMessage("AssetTable: the same content under another path was loaded again");
+		failures++;
+	}
+	unsigned int other = table.Request("Cube", cubeHash, sizeof(cube), &created);
+	if (!created || other == first) {
+		LogMessage("AssetTable: different content shared an asset");
+		failures++;
+	}
+	if (table.Request("Cube", cubeHash, sizeof(cube), &created) != other || created) {
+		LogMessage("AssetTable: the same content under the same path was loaded again");
+		failures++;
+	}
+
+	// === Same hash with another size is a collision, not a copy
+	unsigned int collision = table.Request("Collision", windowHash, sizeof(window) + 1, &created);
+	if (!created || collision == first) {
+		LogMessage("AssetTable: a hash collision shared an asset");
+		failures++;
+	}
+	if (table.FindPath("Unknown") != INVALID_ASSET) {
+		LogMessage("AssetTable: an unknown path was found");
+		failures++;
+	}
+
+	// === 7 requests: 3 loads, 3 shares of the texture, one of them by content, and one of the cube
+	const AssetStats& stats = table.GetStats();
+	unsigned long long loaded = sizeof(window) + sizeof(cube) + sizeof(window) + 1;
+	if (stats.requests != 7 || stats.misses != 3 || stats.hits != 4 || stats.contentHits != 1 || table.GetRequests(first) != 4
+		|| stats.bytesLoaded != loaded || stats.bytesSaved != 3 * sizeof(window) + sizeof(cube) || table.GetPathCount() != 4) {
+		LogMessage("AssetTable: %u requests, %u misses, %u hits (%u by content), %llu bytes loaded and %llu saved are wrong",
+			stats.requests, stats.misses, stats.hits, stats.contentHits, stats.bytesLoaded, stats.bytesSaved);
+		failures++;
+	}
+
+	table.Clear();
+	if (table.GetAssetCount() != 0 || table.FindPath("WindowedBox.dds") != INVALID_ASSET || table.GetStats().requests != 0) {
+		LogMessage("AssetTable: Clear left assets behind");
+		failures++;
+	}
+
+	LogMessage("AssetTable: checks %s", failures == 0 ? "passed" : "FAILED");
+	return failures == 0;
+}
+// ================== //
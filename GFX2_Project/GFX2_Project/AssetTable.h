@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+using std::map;
+using std::string;
+using std::vector;
+
+static const unsigned int INVALID_ASSET = 0xFFFFFFFF;
+
+// - AssetStats
+// --- A hit is a request served by an asset loaded before, found by its path or by its content under another path
+struct AssetStats
+{
+	unsigned int		requests;
+	unsigned int		hits;
+	unsigned int		contentHits;
+	unsigned int		misses;
+	unsigned long long	bytesLoaded;
+	unsigned long long	bytesSaved;
+};
+
+// - AssetTable
+// --- Bookkeeping of a cache of shared resources, keyed by path and by content hash: the owner keeps the resources
+// --- in its own array under the asset index the table hands out, and only creates one on a miss
+// --- A path seen before is served without reading it again; a new path is hashed and served by any asset with
+// --- the same hash and size, so copies of a file under several names are loaded once
+class AssetTable
+{
+private:
+	struct Asset
+	{
+		unsigned long long	hash;
+		unsigned long long	size;
+		unsigned int		requests;
+	};
+	vector<Asset>					m_Assets;
+	map<string, unsigned int>		m_Paths;
+	map<unsigned long long, unsigned int>	m_Contents;
+	AssetStats						m_Stats;
+
+public:
+	// ===== Constructor
+	AssetTable();
+
+	// ===== Interface
+	// - FindPath
+	// --- Asset _path was requested as before, INVALID_ASSET for a new path; a found asset still needs Reuse
+	unsigned int FindPath(const string& _path) const;
+	// - Reuse
+	// --- Counts a request served by an asset found with FindPath
+	void Reuse(unsigned int _asset);
+	// - Request
+	// --- _path whose content is _size bytes hashing to _hash: returns the asset with the same content and
+	// --- remembers _path for it, or adds a new asset and sets *_created, the caller then creates its resource
+	// --- A known path may come through here too when its content can change, as generated meshes do
+	unsigned int Request(const string& _path, unsigned long long _hash, unsigned long long _size, bool* _created);
+	void Clear();
+
+	// ===== Accessors
+	size_t GetAssetCount() const { return m_Assets.size(); }
+	size_t GetPathCount() const { return m_Paths.size(); }
+	unsigned int GetRequests(unsigned int _asset) const { return m_Assets[_asset].requests; }
+	const AssetStats& GetStats() const { return m_Stats; }
+};
+
+// - LogAssetStats
+// --- One line of hits, misses and bytes saved, _name says which resources they are
+void LogAssetStats(const char* _name, const AssetStats& _stats);
+
+// ===== Checks ===== //
+// - CheckAssetTable
+// --- Requests the same, renamed and different contents and checks which of them share an asset and the counts
+// --- Logs every check that fails, returns false if any did
+bool CheckAssetTable();
+// ================== //
@@ -0,0 +1,107 @@
+#include "Bounds.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define BOUNDS_SSE
+#include <emmintrin.h>
+#endif
+
+// ===== Bounding Volumes ===== //
+Bounds ComputeBounds(const void* _positions, size_t _count, size_t _stride)
+{
+	Bounds bounds;
+	memset(&bounds, 0, sizeof(bounds));
+	if (_count == 0)
+		return bounds;
+
+	const char* bytes = (const char*)_positions;
+	float radiusSquared = 0;
+#ifdef BOUNDS_SSE
+	// === Box, one vertex per step, the 4th lane is ignored
+	__m128 low = _mm_loadu_ps((const float*)bytes);
+	__m128 high = low;
+	for (size_t i = 1; i < _count; i++) {
+		__m128 position = _mm_loadu_ps((const float*)(bytes + i * _stride));
+		low = _mm_min_ps(low, position);
+		high = _mm_max_ps(high, position);
+	}
+	float lowValues[4], highValues[4];
+	_mm_storeu_ps(lowValues, low);
+	_mm_storeu_ps(highValues, high);
+	for (int axis = 0; axis < 3; axis++) {
+		bounds.min[axis] = lowValues[axis];
+		bounds.max[axis] = highValues[axis];
+		bounds.center[axis] = (lowValues[axis] + highValues[axis]) * 0.5f;
+	}
+
+	// === Sphere, the farthest vertex from the box centre
+	__m128 center = _mm_setr_ps(bounds.center[0], bounds.center[1], bounds.center[2], 0);
+	__m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	__m128 farthest = _mm_setzero_ps();
+	for (size_t i = 0; i < _count; i++) {
+		__m128 offset = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps((const float*)(bytes + i * _stride)), center), mask);
+		__m128 squared = _mm_mul_ps(offset, offset);
+		// == x + y + z in every lane
+		__m128 sum = _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		farthest = _mm_max_ps(farthest, sum);
+	}
+	_mm_store_ss(&radiusSquared, farthest);
+#else
+	// === Box
+	const float* first = (const float*)bytes;
+	for (int axis = 0; axis < 3; axis++)
+		bounds.min[axis] = bounds.max[axis] = first[axis];
+	for (size_t i = 1; i < _count; i++) {
+		const float* position = (const float*)(bytes + i * _stride);
+		for (int axis = 0; axis < 3; axis++) {
+			if (position[axis] < bounds.min[axis]) bounds.min[axis] = position[axis];
+			if (position[axis] > bounds.max[axis]) bounds.max[axis] = position[axis];
+		}
+	}
+	for (int axis = 0; axis < 3; axis++)
+		bounds.center[axis] = (bounds.min[axis] + bounds.max[axis]) * 0.5f;
+
+	// === Sphere
+	for (size_t i = 0; i < _count; i++) {
+		const float* position = (const float*)(bytes + i * _stride);
+		float dx = position[0] - bounds.center[0], dy = position[1] - bounds.center[1], dz = position[2] - bounds.center[2];
+		float distanceSquared = dx * dx + dy * dy + dz * dz;
+		if (distanceSquared > radiusSquared)
+			radiusSquared = distanceSquared;
+	}
+#endif
+	bounds.radius = std::sqrt(radiusSquared);
+	return bounds;
+}
+
+Bounds TransformBounds(const Bounds& _bounds, const float _matrix[16])
+{
+	Bounds transformed;
+	float largestScaleSquared = 0;
+	for (int column = 0; column < 3; column++) {
+		// === Arvo: each output axis starts at the translation and picks the smaller / larger product per input axis
+		float low = _matrix[12 + column], high = _matrix[12 + column];
+		float center = _matrix[12 + column];
+		for (int row = 0; row < 3; row++) {
+			float element = _matrix[row * 4 + column];
+			float a = element * _bounds.min[row], b = element * _bounds.max[row];
+			low += a < b ? a : b;
+			high += a < b ? b : a;
+			center += element * _bounds.center[row];
+		}
+		transformed.min[column] = low;
+		transformed.max[column] = high;
+		transformed.center[column] = center;
+
+		const float* axis = &_matrix[column * 4];
+		float scaleSquared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		if (scaleSquared > largestScaleSquared)
+			largestScaleSquared = scaleSquared;
+	}
+	transformed.radius = _bounds.radius * std::sqrt(largestScaleSquared);
+	return transformed;
+}
+// ============================ //
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+// - Bounds
+// --- Axis aligned box and bounding sphere of a mesh, in whatever space the positions were in
+struct Bounds
+{
+	float min[3];
+	float max[3];
+	float center[3];
+	float radius;
+};
+
+// ===== Bounding Volumes ===== //
+// - ComputeBounds
+// --- Min / max reduction over _count positions, _stride bytes apart, followed by the sphere around the box centre
+// --- Each position is the first 3 floats of a vertex at least 4 floats big (Vertex, Vertex_PositionColor),
+// --- the SSE path loads all 4 at once; an empty array gives all zero bounds
+Bounds ComputeBounds(const void* _positions, size_t _count, size_t _stride);
+
+// - TransformBounds
+// --- Bounds of _bounds after the row-major (row vector) matrix: the box is re-fitted around the
+// --- transformed box, the sphere radius grows with the largest axis scale
+Bounds TransformBounds(const Bounds& _bounds, const float _matrix[16]);
+// ============================ //
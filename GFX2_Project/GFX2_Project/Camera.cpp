@@ -1,15 +1,59 @@
 #include "Camera.h"
 
-#define Float4x4ToXMMAtrix(float4x4) { XMMATRIX(float4x4._11, float4x4._12, float4x4._13, float4x4._14, float4x4._21, float4x4._22, float4x4._23, float4x4._24, float4x4._31, float4x4._32, float4x4._33, float4x4._34, float4x4._41, float4x4._42, float4x4._43, float4x4._44) }
+#include <cmath>
+
+#include "Profiling.h"
+
+// ===== Local Helpers ===== //
+static const float DEGREES_TO_RADIANS = 0.0174532925f;
+
+// === Where the camera starts, and where Space puts it back
+static const XMFLOAT3 HOME_POSITION(0, 1, -2);
+
+// - LegacyCamera
+// --- The camera as it used to be: only the view matrix is stored, every access inverts it
+// --- Kept for BenchmarkCamera only
+struct LegacyCamera
+{
+	XMFLOAT4X4 ViewMatrix;
+
+	void Move(float _right, float _up, float _forward, float _yaw, float _pitch) {
+		XMMATRIX matrix = XMLoadFloat4x4(&ViewMatrix);
+		XMVECTOR determinant = XMMatrixDeterminant(matrix);
+		matrix = XMMatrixInverse(&determinant, matrix);
+		matrix = XMMatrixMultiply(XMMatrixTranslation(_right, 0, _forward), matrix);
+		matrix = XMMatrixMultiply(matrix, XMMatrixTranslation(0, _up, 0));
+		XMVECTOR position = matrix.r[3];
+		matrix = XMMatrixMultiply(matrix, XMMatrixRotationY(_yaw));
+		matrix.r[3] = position;
+		matrix = XMMatrixMultiply(XMMatrixRotationX(_pitch), matrix);
+		determinant = XMMatrixDeterminant(matrix);
+		XMStoreFloat4x4(&ViewMatrix, XMMatrixInverse(&determinant, matrix));
+	}
+	XMFLOAT3 GetPosition() {
+		XMMATRIX matrix = XMLoadFloat4x4(&ViewMatrix);
+		XMVECTOR determinant = XMMatrixDeterminant(matrix);
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, XMMatrixInverse(&determinant, matrix).r[3]);
+		return position;
+	}
+	void SetPosition(XMFLOAT3 _pos) {
+		XMMATRIX matrix = XMLoadFloat4x4(&ViewMatrix);
+		XMVECTOR determinant = XMMatrixDeterminant(matrix);
+		matrix = XMMatrixInverse(&determinant, matrix);
+		matrix.r[3] = XMVectorSet(_pos.x, _pos.y, _pos.z, 1);
+		determinant = XMMatrixDeterminant(matrix);
+		XMStoreFloat4x4(&ViewMatrix, XMMatrixInverse(&determinant, matrix));
+	}
+};
+// ========================= //
 
 // ===== Constructor / Destructor ===== //
 Camera::Camera()
 {
-	ViewMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, -2, 1);
-	XMMATRIX matrix = Float4x4ToXMMAtrix(ViewMatrix);
-	XMVECTOR determinant = XMMatrixDeterminant(matrix);
-	matrix = XMMatrixInverse(&determinant, matrix);
-	XMStoreFloat4x4(&ViewMatrix, matrix);
+	m_Position = HOME_POSITION;
+	XMStoreFloat4(&m_Orientation, XMQuaternionIdentity());
+	m_bViewDirty = true;
 	CursorPosition.x = -1;
 	m_fMovementSpeed = 1;
 	m_fRotationSpeed = 1;
@@ -24,31 +68,29 @@ Camera::~Camera()
 // ===== Interface ===== //
 void Camera::HandleInput(float _deltaTime)
 {
-	XMMATRIX matrix = Float4x4ToXMMAtrix(ViewMatrix);
-	XMVECTOR determinant = XMMatrixDeterminant(matrix);
-	matrix = XMMatrixInverse(&determinant, matrix);
+	float right = 0, up = 0, forward = 0, yaw = 0, pitch = 0;
 	// Forward / Backward Movement (Z-Axis)
 	if (GetAsyncKeyState('W')) {
-		matrix = XMMatrixMultiply(XMMatrixTranslation(0, 0, _deltaTime * m_fMovementSpeed), matrix);
+		forward = _deltaTime * m_fMovementSpeed;
 	}
 	else if (GetAsyncKeyState('S')) {
-		matrix = XMMatrixMultiply(XMMatrixTranslation(0, 0, _deltaTime * -m_fMovementSpeed), matrix);
+		forward = _deltaTime * -m_fMovementSpeed;
 	}
 
 	// Sidewards Movement (X-Axis)
 	if (GetAsyncKeyState('A')) {
-		matrix = XMMatrixMultiply(XMMatrixTranslation(_deltaTime * -m_fMovementSpeed, 0, 0), matrix);
+		right = _deltaTime * -m_fMovementSpeed;
 	}
 	else if (GetAsyncKeyState('D')) {
-		matrix = XMMatrixMultiply(XMMatrixTranslation(_deltaTime * m_fMovementSpeed, 0, 0), matrix);
+		right = _deltaTime * m_fMovementSpeed;
 	}
 
 	// Fly Up / Down (Y-Axis)
 	if (GetAsyncKeyState('E')) {
-		matrix = XMMatrixMultiply(matrix, XMMatrixTranslation(0, _deltaTime * m_fMovementSpeed, 0));
+		up = _deltaTime * m_fMovementSpeed;
 	}
 	else if (GetAsyncKeyState('Q')) {
-		matrix = XMMatrixMultiply(matrix, XMMatrixTranslation(0, _deltaTime * -m_fMovementSpeed, 0));
+		up = _deltaTime * -m_fMovementSpeed;
 	}
 
 	// Camera Rotation
@@ -58,20 +100,10 @@ void Camera::HandleInput(float _deltaTime)
 		// == Get the New Cursor Position
 		POINT newCursorPos;
 		GetCursorPos(&newCursorPos);
-		float distance;
 		// === Left / Right Rotation
-		if (newCursorPos.x != CursorPosition.x) {
-			XMVECTOR position = matrix.r[3];
-			matrix = XMMatrixMultiply(matrix, XMMatrixTranslation(0, 0, 0));
-			distance = CursorPosition.x - newCursorPos.x;
-			matrix = XMMatrixMultiply(matrix, XMMatrixRotationY(-distance * 0.0174532925f));
-			matrix.r[3] = position;
-		}
+		yaw = (newCursorPos.x - CursorPosition.x) * DEGREES_TO_RADIANS;
 		// === Up / Down Rotation
-		if (newCursorPos.y != CursorPosition.y) {
-			distance = CursorPosition.y - newCursorPos.y;
-			matrix = XMMatrixMultiply(XMMatrixRotationX(-distance * 0.0174532925f), matrix);
-		}
+		pitch = (newCursorPos.y - CursorPosition.y) * DEGREES_TO_RADIANS;
 
 		CursorPosition = newCursorPos;
 	}
@@ -79,64 +111,139 @@ void Camera::HandleInput(float _deltaTime)
 		CursorPosition.x = -1;
 	}
 
+	if (right != 0 || up != 0 || forward != 0 || yaw != 0 || pitch != 0)
+		Move(right, up, forward, yaw, pitch);
+
 	// Quick Reset
 	if (GetAsyncKeyState(VK_SPACE)) {
-		matrix = XMMATRIX(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, -2, 1);
+		m_Position = HOME_POSITION;
+		XMStoreFloat4(&m_Orientation, XMQuaternionIdentity());
+		m_bViewDirty = true;
 	}
+}
 
-	// === Update the View Matrix
-	determinant = XMMatrixDeterminant(matrix);
-	matrix = XMMatrixInverse(&determinant, matrix);
-	XMStoreFloat4x4(&ViewMatrix, matrix);
+void Camera::Move(float _right, float _up, float _forward, float _yaw, float _pitch)
+{
+	XMVECTOR orientation = XMLoadFloat4(&m_Orientation);
+	XMVECTOR position = XMLoadFloat3(&m_Position);
+
+	// === Local movement first, then the world up / down, same order the matrices used to be built in
+	position = XMVectorAdd(position, XMVector3Rotate(XMVectorSet(_right, 0, _forward, 0), orientation));
+	position = XMVectorAdd(position, XMVectorSet(0, _up, 0, 0));
+
+	// === Yaw is applied in world space (after), pitch in camera space (before)
+	if (_yaw != 0)
+		orientation = XMQuaternionMultiply(orientation, XMQuaternionRotationRollPitchYaw(0, _yaw, 0));
+	if (_pitch != 0)
+		orientation = XMQuaternionMultiply(XMQuaternionRotationRollPitchYaw(_pitch, 0, 0), orientation);
+
+	// == Renormalize, so rounding does not build up over many frames
+	XMStoreFloat4(&m_Orientation, XMQuaternionNormalize(orientation));
+	XMStoreFloat3(&m_Position, position);
+	m_bViewDirty = true;
 }
 // ===================== //
 
 // ===== Accessors / Mutators ===== //
-void Camera::SetViewMatrix(XMFLOAT4X4 _viewMatrix)
+void Camera::UpdateViewMatrix() const
 {
-	XMMATRIX matrix = Float4x4ToXMMAtrix(_viewMatrix);
-	XMVECTOR determinant = XMMatrixDeterminant(matrix);
-	matrix = XMMatrixInverse(&determinant, matrix);
-	XMStoreFloat4x4(&ViewMatrix, matrix);
+	// === Rigid inverse: the transposed rotation, and the position rotated back and negated
+	XMMATRIX rotation = XMMatrixTranspose(XMMatrixRotationQuaternion(XMLoadFloat4(&m_Orientation)));
+	XMVECTOR translation = XMVector3Transform(XMVectorNegate(XMLoadFloat3(&m_Position)), rotation);
+	rotation.r[3] = XMVectorSetW(translation, 1);
+	XMStoreFloat4x4(&ViewMatrix, rotation);
+	m_bViewDirty = false;
 }
 
-XMFLOAT4X4 Camera::GetViewMatrix()
+void Camera::SetWorldMatrix(const XMFLOAT4X4& _worldMatrix)
 {
+	XMVECTOR scale, orientation, position;
+	XMMatrixDecompose(&scale, &orientation, &position, XMLoadFloat4x4(&_worldMatrix));
+	XMStoreFloat4(&m_Orientation, XMQuaternionNormalize(orientation));
+	XMStoreFloat3(&m_Position, position);
+	m_bViewDirty = true;
+}
+
+const XMFLOAT4X4& Camera::GetViewMatrix() const
+{
+	if (m_bViewDirty)
+		UpdateViewMatrix();
 	return ViewMatrix;
 }
 
-XMMATRIX Camera::GetViewXMMatrix()
+XMMATRIX Camera::GetViewXMMatrix() const
 {
-	return XMMATRIX(ViewMatrix._11, ViewMatrix._12, ViewMatrix._13, ViewMatrix._14,
-		ViewMatrix._21, ViewMatrix._22, ViewMatrix._23, ViewMatrix._24,
-		ViewMatrix._31, ViewMatrix._32, ViewMatrix._33, ViewMatrix._34,
-		ViewMatrix._41, ViewMatrix._42, ViewMatrix._43, ViewMatrix._44);
+	return XMLoadFloat4x4(&GetViewMatrix());
 }
 
-void Camera::SetPosition(XMFLOAT3 _pos)
+void Camera::SetPosition(const XMFLOAT3& _pos)
 {
-	// === Put it in World Space
-	XMMATRIX matrix = Float4x4ToXMMAtrix(ViewMatrix);
-	XMVECTOR determinant = XMMatrixDeterminant(matrix);
-	matrix = XMMatrixInverse(&determinant, matrix);
-	XMStoreFloat4x4(&ViewMatrix, matrix);
-	// === Set the Position
-	ViewMatrix._41 = _pos.x;
-	ViewMatrix._42 = _pos.y;
-	ViewMatrix._43 = _pos.z;
-	// === Bring it back to View Space
-	matrix = Float4x4ToXMMAtrix(ViewMatrix);
-	determinant = XMMatrixDeterminant(matrix);
-	matrix = XMMatrixInverse(&determinant, matrix);
-	XMStoreFloat4x4(&ViewMatrix, matrix);
+	m_Position = _pos;
+	m_bViewDirty = true;
 }
 
-XMFLOAT3 Camera::GetPosition()
+void Camera::SetOrientation(const XMFLOAT4& _orientation)
 {
-	XMMATRIX matrix = Float4x4ToXMMAtrix(ViewMatrix);
-	XMVECTOR determinant = XMMatrixDeterminant(matrix);
-	XMFLOAT3 position;
-	XMStoreFloat3(&position, XMMatrixInverse(&determinant, matrix).r[3]);
-	return position;
+	XMStoreFloat4(&m_Orientation, XMQuaternionNormalize(XMLoadFloat4(&_orientation)));
+	m_bViewDirty = true;
 }
-// ================================ //
\ No newline at end of file
+// ================================ //
+
+// ===== Benchmark ===== //
+bool BenchmarkCamera(unsigned int _frames)
+{
+	// === Per frame, Run() moves the main camera, reads its position, moves the minimap camera onto it,
+	// === then every view reads its camera's position (skybox, transparency sorting) and view matrix twice (culling, constants)
+	const int VIEWS = 3;
+	const int POSITION_READS_PER_VIEW = 4;
+	float checksum = 0;
+
+	LegacyCamera legacy[VIEWS];
+	for (int v = 0; v < VIEWS; v++)
+		XMStoreFloat4x4(&legacy[v].ViewMatrix, XMMatrixTranslation(-HOME_POSITION.x, -HOME_POSITION.y, -HOME_POSITION.z));
+	Stopwatch stopwatch;
+	for (unsigned int frame = 0; frame < _frames; frame++) {
+		legacy[0].Move(0.001f, 0, 0.01f, 0.001f, 0.0005f);
+		XMFLOAT3 position = legacy[0].GetPosition();
+		position.y += 2;
+		legacy[2].SetPosition(position);
+		for (int v = 0; v < VIEWS; v++) {
+			for (int r = 0; r < POSITION_READS_PER_VIEW; r++)
+				checksum += legacy[v].GetPosition().x;
+			checksum += legacy[v].ViewMatrix._41 + legacy[v].ViewMatrix._42;
+		}
+	}
+	double legacyNanoseconds = stopwatch.ElapsedMilliseconds() * 1000000.0 / (_frames > 0 ? _frames : 1);
+
+	Camera cameras[VIEWS];
+	stopwatch.Restart();
+	for (unsigned int frame = 0; frame < _frames; frame++) {
+		cameras[0].Move(0.001f, 0, 0.01f, 0.001f, 0.0005f);
+		XMFLOAT3 position = cameras[0].GetPosition();
+		position.y += 2;
+		cameras[2].SetPosition(position);
+		for (int v = 0; v < VIEWS; v++) {
+			for (int r = 0; r < POSITION_READS_PER_VIEW; r++)
+				checksum += cameras[v].GetPosition().x;
+			checksum += cameras[v].GetViewMatrix()._41 + cameras[v].GetViewMatrix()._42;
+		}
+	}
+	double cameraNanoseconds = stopwatch.ElapsedMilliseconds() * 1000000.0 / (_frames > 0 ? _frames : 1);
+
+	// === Both ran the same moves, so they should end on the same views; the legacy one re-inverts every frame and drifts
+	// === a little each time (about 3e-7 a frame over 100k frames), so the bound grows with the frame count
+	float difference = 0;
+	for (int v = 0; v < VIEWS; v++) {
+		const XMFLOAT4X4& view = cameras[v].GetViewMatrix();
+		for (int row = 0; row < 4; row++)
+			for (int column = 0; column < 4; column++)
+				if (fabsf(view.m[row][column] - legacy[v].ViewMatrix.m[row][column]) > difference)
+					difference = fabsf(view.m[row][column] - legacy[v].ViewMatrix.m[row][column]);
+	}
+	bool agree = difference <= 1e-4f + 1e-6f * _frames;
+
+	LogMessage("Camera: %u frames, matrix inverse per access %.1f ns per frame, cached view %.1f ns per frame, largest view difference %g%s (checksum %.3f)",
+		_frames, legacyNanoseconds, cameraNanoseconds, difference, agree ? "" : " - VIEWS DIFFER", checksum);
+	return agree;
+}
+// ===================== //
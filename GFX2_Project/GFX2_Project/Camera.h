@@ -5,13 +5,21 @@
 
 using namespace DirectX;
 
+// - Camera
+// --- Position and orientation are the source of truth, the view matrix is rebuilt from them
+// --- only when one has changed since it was last read
 class Camera
 {
 private:
-	XMFLOAT4X4	ViewMatrix;
-	POINT		CursorPosition;
-	float		m_fMovementSpeed;
-	float		m_fRotationSpeed;
+	XMFLOAT3			m_Position;
+	XMFLOAT4			m_Orientation;
+	mutable XMFLOAT4X4	ViewMatrix;
+	mutable bool		m_bViewDirty;
+	POINT				CursorPosition;
+	float				m_fMovementSpeed;
+	float				m_fRotationSpeed;
+
+	void UpdateViewMatrix() const;
 
 public:
 	// ===== Constructor / Destructor
@@ -20,12 +28,25 @@ public:
 
 	// ===== Interface
 	void HandleInput(float _deltaTime);
+	// - Move
+	// --- _right / _forward move along the camera's own axes, _up along the world's,
+	// --- _yaw turns around the world up axis and _pitch around the camera's right axis (radians)
+	void Move(float _right, float _up, float _forward, float _yaw, float _pitch);
 
 	// ===== Accessors / Mutators
-	void SetViewMatrix(XMFLOAT4X4 _viewMatrix);
-	XMFLOAT4X4 GetViewMatrix();
-	XMMATRIX GetViewXMMatrix();
-	void SetPosition(XMFLOAT3 _pos);
-	XMFLOAT3 GetPosition();
+	// - SetWorldMatrix
+	// --- Places the camera with a rigid world transform, any scale is dropped
+	void SetWorldMatrix(const XMFLOAT4X4& _worldMatrix);
+	const XMFLOAT4X4& GetViewMatrix() const;
+	XMMATRIX GetViewXMMatrix() const;
+	void SetPosition(const XMFLOAT3& _pos);
+	const XMFLOAT3& GetPosition() const { return m_Position; }
+	void SetOrientation(const XMFLOAT4& _orientation);
+	const XMFLOAT4& GetOrientation() const { return m_Orientation; }
 };
 
+// - BenchmarkCamera
+// --- Runs _frames of the per-frame camera work Run() does, once the way it used to be done
+// --- (matrix inverse per access) and once through Camera, logs both in nanoseconds per frame and the largest difference
+// --- between the views they end on; returns false if that is beyond the drift of the legacy inverses
+bool BenchmarkCamera(unsigned int _frames);
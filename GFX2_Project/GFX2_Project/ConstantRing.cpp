@@ -0,0 +1,318 @@
+#include "ConstantRing.h"
+
+#include <cstring>
+#include <random>
+
+#include "Profiling.h"
+
+// ===== Local Helpers ===== //
+static inline unsigned int AlignUp(unsigned int _size)
+{
+	return (_size + CONSTANT_RING_ALIGNMENT - 1) / CONSTANT_RING_ALIGNMENT * CONSTANT_RING_ALIGNMENT;
+}
+// ========================= //
+
+// ===== Constructor ===== //
+ConstantRing::ConstantRing(unsigned int _capacity)
+{
+	memset(&m_LastFrame, 0, sizeof(m_LastFrame));
+	Initialize(_capacity);
+}
+// ======================= //
+
+// ===== Interface ===== //
+void ConstantRing::Initialize(unsigned int _capacity)
+{
+	m_Memory.assign(AlignUp(_capacity), 0);
+	memset(&m_Frame, 0, sizeof(m_Frame));
+	m_iHead = 0;
+	m_iUploaded = 0;
+	m_bDiscard = true;
+}
+
+void ConstantRing::BeginFrame()
+{
+	m_LastFrame = m_Frame;
+	memset(&m_Frame, 0, sizeof(m_Frame));
+	m_iHead = 0;
+	m_iUploaded = 0;
+	m_bDiscard = true;
+}
+
+bool ConstantRing::Allocate(unsigned int _size, ConstantSlice* _slice)
+{
+	unsigned int size = AlignUp(_size);
+	if (_size == 0 || size > (unsigned int)m_Memory.size() - m_iHead)
+		return false;
+	_slice->offset = m_iHead;
+	_slice->size = _size;
+	_slice->data = &m_Memory[m_iHead];
+	m_iHead += size;
+	m_Frame.allocations++;
+	return true;
+}
+
+bool ConstantRing::Allocate(const void* _data, unsigned int _size, ConstantSlice* _slice)
+{
+	if (!Allocate(_size, _slice))
+		return false;
+	memcpy(_slice->data, _data, _size);
+	return true;
+}
+
+bool ConstantRing::GetPendingUpload(ConstantUpload* _upload) const
+{
+	if (m_iHead == m_iUploaded)
+		return false;
+	_upload->begin = m_iUploaded;
+	_upload->end = m_iHead;
+	_upload->discard = m_bDiscard;
+	return true;
+}
+
+void ConstantRing::Upload(IRenderContext* _context, ID3D11Buffer* _buffer)
+{
+	ConstantUpload upload;
+	if (!GetPendingUpload(&upload))
+		return;
+	_context->WriteBuffer(_buffer, upload.begin, &m_Memory[upload.begin], upload.end - upload.begin, upload.discard);
+	m_iUploaded = m_iHead;
+	m_bDiscard = false;
+	m_Frame.uploads++;
+	m_Frame.discards += upload.discard ? 1 : 0;
+	m_Frame.bytes += upload.end - upload.begin;
+}
+
+bool ConstantRing::Wrap()
+{
+	if (m_iHead != m_iUploaded)
+		return false;
+	// === The discard leaves the old buffer to the draws still reading it
+	m_iHead = 0;
+	m_iUploaded = 0;
+	m_bDiscard = true;
+	m_Frame.wraps++;
+	return true;
+}
+// ===================== //
+
+// ===== Checks ===== //
+bool CheckConstantRing()
+{
+	unsigned int failures = 0;
+	RecordingRenderContext recorder;
+	ID3D11Buffer* buffer = (ID3D11Buffer*)(size_t)0x1000;
+	ConstantSlice slice = { 0, 0, nullptr };
+	ConstantUpload upload = { 0, 0, false };
+
+	// === Capacity rounds up, slices are aligned and their windows cover them
+	ConstantRing ring(1000);
+	if (ring.GetCapacity() != 1024) {
+		LogMessage("ConstantRing: capacity %u instead of 1024", ring.GetCapacity());
+		failures++;
+	}
+	const unsigned int sizes[3] = { 96, 300, 256 };
+	const unsigned int offsets[3] = { 0, 256, 768 };
+	const unsigned int counts[3] = { 16, 32, 16 };
+	for (unsigned int i = 0; i < 3; i++) {
+		if (!ring.Allocate(sizes[i], &slice) || slice.offset != offsets[i] || slice.FirstConstant() != offsets[i] / 16 || slice.ConstantCount() != counts[i]) {
+			LogMessage("ConstantRing: slice %u of %u bytes at %u (%u constants) instead of %u (%u)", i, sizes[i], slice.offset, slice.ConstantCount(), offsets[i], counts[i]);
+			failures++;
+		}
+	}
+
+	// === Every window is one VSSetConstantBuffers1 takes: first and count multiples of 16, at most 4096 constants
+	ConstantRing large(1 << 20);
+	for (unsigned int size = 1; size <= 65536; size += size < 512 ? 1 : 251) {
+		if (!large.Allocate(size, &slice)) {
+			large.Upload(&recorder, buffer);
+			large.Wrap();
+			large.Allocate(size, &slice);
+		}
+		unsigned int first = slice.FirstConstant(), count = slice.ConstantCount();
+		if (first % 16 != 0 || count % 16 != 0 || count > 4096 || count * 16 < size) {
+			LogMessage("ConstantRing: %u bytes got the window [%u, +%u) constants", size, first, count);
+			failures++;
+			break;
+		}
+	}
+	recorder.Reset();
+
+	// === Full, and empty slices are refused
+	if (ring.Allocate(1, &slice) || ring.Allocate(0, &slice) || ring.GetUsed() != 1024) {
+		LogMessage("ConstantRing: a full ring still allocated");
+		failures++;
+	}
+
+	// === The first upload of a frame discards, a wrap waits for the upload
+	if (ring.Wrap() || !ring.GetPendingUpload(&upload) || upload.begin != 0 || upload.end != 1024 || !upload.discard) {
+		LogMessage("ConstantRing: first upload wrong, or wrapped with an upload pending");
+		failures++;
+	}
+	ring.Upload(&recorder, buffer);
+	if (ring.GetPendingUpload(&upload) || recorder.GetBufferWriteCount() != 1 || recorder.GetDiscardCount() != 1 || recorder.GetBytesWritten() != 1024) {
+		LogMessage("ConstantRing: upload did not write the ring once, discarding");
+		failures++;
+	}
+
+	// === After a wrap the next upload discards again, later ones do not overwrite
+	const unsigned char pattern[4] = { 1, 2, 3, 4 };
+	if (!ring.Wrap() || !ring.Allocate(pattern, sizeof(pattern), &slice) || slice.offset != 0 || memcmp(slice.data, pattern, sizeof(pattern)) != 0) {
+		LogMessage("ConstantRing: allocation after a wrap wrong");
+		failures++;
+	}
+	ring.Upload(&recorder, buffer);
+	ring.Allocate(64, &slice);
+	if (!ring.GetPendingUpload(&upload) || upload.begin != 256 || upload.end != 512 || upload.discard) {
+		LogMessage("ConstantRing: second upload of a wrap is [%u, %u) %s instead of [256, 512) without discard",
+			upload.begin, upload.end, upload.discard ? "discarding" : "not discarding");
+		failures++;
+	}
+	ring.Upload(&recorder, buffer);
+
+	// === A new frame starts at the front with a discard and keeps the counters of the old one
+	ring.BeginFrame();
+	const ConstantRingStats& stats = ring.GetFrameStats();
+	if (stats.allocations != 5 || stats.uploads != 3 || stats.discards != 2 || stats.wraps != 1 || stats.bytes != 1024 + 256 + 256) {
+		LogMessage("ConstantRing: frame counters %u allocations, %u uploads, %u discards, %u wraps", stats.allocations, stats.uploads, stats.discards, stats.wraps);
+		failures++;
+	}
+	if (!ring.Allocate(16, &slice) || slice.offset != 0 || !ring.GetPendingUpload(&upload) || !upload.discard) {
+		LogMessage("ConstantRing: a new frame did not start at the front with a discard");
+		failures++;
+	}
+
+	LogMessage("ConstantRing: checks %s", failures == 0 ? "passed" : "FAILED");
+	return failures == 0;
+}
+
+// === The constant buffers of Model_VS
+struct BenchmarkObjectConstants
+{
+	float world[16];
+	float positionScale[4];
+	float positionOffset[4];
+};
+
+struct BenchmarkSceneConstants
+{
+	float view[16];
+	float projection[16];
+};
+
+// - SubmitDiscardPerDraw
+// --- What DrawMesh and UpdateSceneBuffer did: a WRITE_DISCARD of the small buffers for every view and every draw
+static void SubmitDiscardPerDraw(IRenderContext* _context, const vector<BenchmarkSceneConstants>& _views, const vector<BenchmarkObjectConstants>& _objects)
+{
+	ID3D11Buffer* objectBuffer = (ID3D11Buffer*)(size_t)0x1000;
+	ID3D11Buffer* sceneBuffer = (ID3D11Buffer*)(size_t)0x2000;
+	size_t perView = _objects.size() / _views.size();
+	for (size_t view = 0; view < _views.size(); view++) {
+		_context->WriteBuffer(sceneBuffer, 0, &_views[view], sizeof(BenchmarkSceneConstants), true);
+		_context->VSSetConstantBuffers(1, 1, &sceneBuffer);
+		for (size_t i = view * perView; i < (view + 1) * perView; i++) {
+			_context->WriteBuffer(objectBuffer, 0, &_objects[i], sizeof(BenchmarkObjectConstants), true);
+			_context->VSSetConstantBuffers(0, 1, &objectBuffer);
+			_context->DrawIndexed(36, 0, 0);
+		}
+	}
+}
+
+// - SubmitRing
+// --- The same draws through a ConstantRing: per view the constants of as many draws as fit, one upload, then the draws
+static void SubmitRing(IRenderContext* _context, ConstantRing* _ring, const vector<BenchmarkSceneConstants>& _views, const vector<BenchmarkObjectConstants>& _objects, vector<ConstantSlice>* _slices)
+{
+	ID3D11Buffer* ringBuffer = (ID3D11Buffer*)(size_t)0x3000;
+	size_t perView = _objects.size() / _views.size();
+	_ring->BeginFrame();
+	for (size_t view = 0; view < _views.size(); view++) {
+		size_t first = view * perView, end = (view + 1) * perView;
+		ConstantSlice sceneSlice = { 0, 0, nullptr };
+		if (!_ring->Allocate(&_views[view], sizeof(BenchmarkSceneConstants), &sceneSlice)) {
+			_ring->Upload(_context, ringBuffer);
+			_ring->Wrap();
+			_ring->Allocate(&_views[view], sizeof(BenchmarkSceneConstants), &sceneSlice);
+		}
+		unsigned int sceneFirst = sceneSlice.FirstConstant(), sceneCount = sceneSlice.ConstantCount();
+		while (first < end) {
+			size_t last = first;
+			_slices->clear();
+			ConstantSlice slice;
+			while (last < end && _ring->Allocate(&_objects[last], sizeof(BenchmarkObjectConstants), &slice)) {
+				_slices->push_back(slice);
+				last++;
+			}
+			_ring->Upload(_context, ringBuffer);
+			_context->VSSetConstantBuffers1(1, 1, &ringBuffer, &sceneFirst, &sceneCount);
+			for (size_t i = first; i < last; i++) {
+				unsigned int firstConstant = (*_slices)[i - first].FirstConstant(), constantCount = (*_slices)[i - first].ConstantCount();
+				_context->VSSetConstantBuffers1(0, 1, &ringBuffer, &firstConstant, &constantCount);
+				_context->DrawIndexed(36, 0, 0);
+			}
+			// == Full: the scene constants move to the front along with the next batch
+			if (last < end) {
+				_ring->Wrap();
+				_ring->Allocate(&_views[view], sizeof(BenchmarkSceneConstants), &sceneSlice);
+				sceneFirst = sceneSlice.FirstConstant();
+				sceneCount = sceneSlice.ConstantCount();
+			}
+			first = last;
+		}
+	}
+}
+
+bool BenchmarkConstantRing(size_t _drawCount)
+{
+	std::mt19937 random(20);
+	std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+	vector<BenchmarkSceneConstants> views(3);
+	for (size_t i = 0; i < views.size(); i++) {
+		for (int j = 0; j < 16; j++) {
+			views[i].view[j] = value(random);
+			views[i].projection[j] = value(random);
+		}
+	}
+	size_t drawCount = _drawCount / views.size() * views.size();
+	vector<BenchmarkObjectConstants> objects(drawCount);
+	for (size_t i = 0; i < drawCount; i++) {
+		for (int j = 0; j < 16; j++)
+			objects[i].world[j] = value(random);
+		for (int j = 0; j < 4; j++) {
+			objects[i].positionScale[j] = value(random);
+			objects[i].positionOffset[j] = value(random);
+		}
+	}
+
+	// === Both through the state filter, like the renderer; the ring is smaller than a frame so it has to wrap
+	RecordingRenderContext discardRecorder, ringRecorder;
+	StateFilteringContext discardFilter(&discardRecorder), ringFilter(&ringRecorder);
+	ConstantRing ring(1024 * 1024);
+	vector<ConstantSlice> slices;
+	slices.reserve(ring.GetCapacity() / CONSTANT_RING_ALIGNMENT);
+
+	// === Submitted twice, hashing what the object and then the scene constant buffer slot shows at every draw
+	discardRecorder.WatchConstants(0, sizeof(BenchmarkObjectConstants));
+	ringRecorder.WatchConstants(0, sizeof(BenchmarkObjectConstants));
+	SubmitDiscardPerDraw(&discardFilter, views, objects);
+	SubmitRing(&ringFilter, &ring, views, objects, &slices);
+	bool objectsMatch = discardRecorder.GetDrawConstants() == ringRecorder.GetDrawConstants();
+	discardRecorder.Reset();
+	ringRecorder.Reset();
+	discardFilter.Invalidate();
+	ringFilter.Invalidate();
+	discardRecorder.WatchConstants(1, sizeof(BenchmarkSceneConstants));
+	ringRecorder.WatchConstants(1, sizeof(BenchmarkSceneConstants));
+	SubmitDiscardPerDraw(&discardFilter, views, objects);
+	SubmitRing(&ringFilter, &ring, views, objects, &slices);
+	bool scenesMatch = discardRecorder.GetDrawConstants() == ringRecorder.GetDrawConstants();
+	ring.BeginFrame();
+	const ConstantRingStats& ringStats = ring.GetFrameStats();
+
+	LogMessage("ConstantRing: %u draws, discard per draw: %u maps (%u discards, %llu bytes), %u state calls reach the device",
+		(unsigned int)drawCount, discardRecorder.GetBufferWriteCount(), discardRecorder.GetDiscardCount(), discardRecorder.GetBytesWritten(), discardRecorder.GetStateCallCount());
+	LogMessage("ConstantRing: ring: %u maps (%u discards, %u wraps, %llu bytes), %u state calls reach the device, constants at every draw %s",
+		ringRecorder.GetBufferWriteCount(), ringRecorder.GetDiscardCount(), ringStats.wraps, ringRecorder.GetBytesWritten(), ringRecorder.GetStateCallCount(),
+		objectsMatch && scenesMatch ? "match" : "DIFFER");
+	return objectsMatch && scenesMatch;
+}
+// ================== //
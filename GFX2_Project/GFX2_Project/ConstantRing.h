@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "RenderContext.h"
+
+using std::vector;
+
+// === Constant buffer offsets have to be multiples of 16 constants of 16 bytes
+static const unsigned int CONSTANT_RING_ALIGNMENT = 256;
+
+// - ConstantSlice
+// --- Part of a ConstantRing handed to one draw; write the constants to data before the ring is uploaded
+struct ConstantSlice
+{
+	unsigned int	offset;
+	unsigned int	size;
+	void*			data;
+
+	// === The window VSSetConstantBuffers1 takes, in 16 byte constants
+	unsigned int FirstConstant() const { return offset / 16; }
+	unsigned int ConstantCount() const { return (size + CONSTANT_RING_ALIGNMENT - 1) / CONSTANT_RING_ALIGNMENT * (CONSTANT_RING_ALIGNMENT / 16); }
+};
+
+// - ConstantUpload
+// --- Bytes written since the last upload; a discard upload starts at 0 and orphans the rest of the buffer
+struct ConstantUpload
+{
+	unsigned int	begin;
+	unsigned int	end;
+	bool			discard;
+};
+
+// - ConstantRingStats
+struct ConstantRingStats
+{
+	unsigned int		allocations;
+	unsigned int		uploads;
+	unsigned int		discards;
+	unsigned int		wraps;
+	unsigned long long	bytes;
+};
+
+// - ConstantRing
+// --- Per frame linear allocator for constant data: every draw gets its own slice of one large dynamic buffer,
+// --- filled in CPU memory and uploaded a batch at a time instead of a Map / WRITE_DISCARD per draw
+// --- The first upload of a frame, or after a Wrap, discards; the others use NO_OVERWRITE and never touch
+// --- the slices earlier draws still read
+class ConstantRing
+{
+private:
+	vector<unsigned char>	m_Memory;
+	unsigned int			m_iHead;
+	unsigned int			m_iUploaded;
+	bool					m_bDiscard;
+	ConstantRingStats		m_Frame;
+	ConstantRingStats		m_LastFrame;
+
+public:
+	// ===== Constructor
+	ConstantRing(unsigned int _capacity = 0);
+
+	// ===== Interface
+	// - Initialize
+	// --- _capacity is rounded up to CONSTANT_RING_ALIGNMENT, the GPU buffer must be at least that large
+	void Initialize(unsigned int _capacity);
+	// - BeginFrame
+	// --- Starts again at the front, the first upload of the frame discards
+	void BeginFrame();
+	// - Allocate
+	// --- A slice of _size bytes at an aligned offset, false when the ring is full: upload and draw what
+	// --- was allocated so far, then Wrap. A shader sees at most 4096 constants of a window, keep _size to 64 KB
+	bool Allocate(unsigned int _size, ConstantSlice* _slice);
+	bool Allocate(const void* _data, unsigned int _size, ConstantSlice* _slice);
+	// - GetPendingUpload
+	// --- False when nothing was allocated since the last upload
+	bool GetPendingUpload(ConstantUpload* _upload) const;
+	// - Upload
+	// --- Writes the pending bytes to _buffer through _context and marks them uploaded
+	void Upload(IRenderContext* _context, ID3D11Buffer* _buffer);
+	// - Wrap
+	// --- Back to the front in the middle of a frame; false, and nothing changes, while an upload is pending
+	bool Wrap();
+
+	// ===== Accessors
+	unsigned int GetCapacity() const { return (unsigned int)m_Memory.size(); }
+	unsigned int GetUsed() const { return m_iHead; }
+	const unsigned char* GetMemory() const { return m_Memory.empty() ? nullptr : &m_Memory[0]; }
+	// - GetFrameStats
+	// --- Counters of the frame before the last BeginFrame
+	const ConstantRingStats& GetFrameStats() const { return m_LastFrame; }
+};
+
+// ===== Checks ===== //
+// - CheckConstantRing
+// --- Allocator checks: alignment and window of the slices, windows VSSetConstantBuffers1 accepts for every size up
+// --- to 64 KB, a full ring, wrapping and the upload ranges
+// --- Logs every check that fails, returns false if any did
+bool CheckConstantRing();
+
+// - BenchmarkConstantRing
+// --- Submits _drawCount draws over three views to a RecordingRenderContext, once with a Map / WRITE_DISCARD per draw and
+// --- once through a ConstantRing with offset binding, checks every draw sees the same constants and logs both costs;
+// --- returns false if they did not
+bool BenchmarkConstantRing(size_t _drawCount);
+// ================== //
@@ -0,0 +1,163 @@
+#include "D3D11RenderContext.h"
+
+#include <cstddef>
+#include <cstring>
+
+// === RenderViewport is handed to the device as it is
+static_assert(sizeof(RenderViewport) == sizeof(D3D11_VIEWPORT) && offsetof(RenderViewport, maxDepth) == offsetof(D3D11_VIEWPORT, MaxDepth),
+	"RenderViewport must match D3D11_VIEWPORT");
+
+// ===== Constructor / Destructor ===== //
+D3D11RenderContext::D3D11RenderContext(ID3D11DeviceContext* _context)
+{
+	m_pContext = nullptr;
+	m_pContext1 = nullptr;
+	SetDeviceContext(_context);
+}
+
+D3D11RenderContext::~D3D11RenderContext()
+{
+	SetDeviceContext(nullptr);
+}
+// ==================================== //
+
+// ===== Interface ===== //
+void D3D11RenderContext::SetDeviceContext(ID3D11DeviceContext* _context)
+{
+	if (m_pContext1) {
+		m_pContext1->Release();
+		m_pContext1 = nullptr;
+	}
+	m_pContext = _context;
+	// === Only there on the D3D11.1 runtime
+	if (m_pContext)
+		m_pContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&m_pContext1);
+}
+
+bool D3D11RenderContext::SupportsConstantOffsets(ID3D11Device* _device) const
+{
+	if (!m_pContext1)
+		return false;
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	ZeroMemory(&options, sizeof(options));
+	if (FAILED(_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+		return false;
+	return options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+}
+// ===================== //
+
+// ===== Input Assembler ===== //
+void D3D11RenderContext::IASetPrimitiveTopology(unsigned int _topology)
+{
+	m_pContext->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)_topology);
+}
+
+void D3D11RenderContext::IASetInputLayout(ID3D11InputLayout* _layout)
+{
+	m_pContext->IASetInputLayout(_layout);
+}
+
+void D3D11RenderContext::IASetVertexBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _strides, const unsigned int* _offsets)
+{
+	m_pContext->IASetVertexBuffers(_startSlot, _count, _buffers, _strides, _offsets);
+}
+
+void D3D11RenderContext::IASetIndexBuffer(ID3D11Buffer* _buffer, unsigned int _format, unsigned int _offset)
+{
+	m_pContext->IASetIndexBuffer(_buffer, (DXGI_FORMAT)_format, _offset);
+}
+// =========================== //
+
+// ===== Shaders ===== //
+void D3D11RenderContext::VSSetShader(ID3D11VertexShader* _shader)
+{
+	m_pContext->VSSetShader(_shader, NULL, 0);
+}
+
+void D3D11RenderContext::VSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers)
+{
+	m_pContext->VSSetConstantBuffers(_startSlot, _count, _buffers);
+}
+
+void D3D11RenderContext::VSSetConstantBuffers1(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _firstConstants, const unsigned int* _constantCounts)
+{
+	m_pContext1->VSSetConstantBuffers1(_startSlot, _count, _buffers, _firstConstants, _constantCounts);
+}
+
+void D3D11RenderContext::PSSetShader(ID3D11PixelShader* _shader)
+{
+	m_pContext->PSSetShader(_shader, NULL, 0);
+}
+
+void D3D11RenderContext::PSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers)
+{
+	m_pContext->PSSetConstantBuffers(_startSlot, _count, _buffers);
+}
+
+void D3D11RenderContext::PSSetShaderResources(unsigned int _startSlot, unsigned int _count, ID3D11ShaderResourceView* const* _views)
+{
+	m_pContext->PSSetShaderResources(_startSlot, _count, _views);
+}
+
+void D3D11RenderContext::PSSetSamplers(unsigned int _startSlot, unsigned int _count, ID3D11SamplerState* const* _samplers)
+{
+	m_pContext->PSSetSamplers(_startSlot, _count, _samplers);
+}
+// =================== //
+
+// ===== Rasterizer ===== //
+void D3D11RenderContext::RSSetState(ID3D11RasterizerState* _state)
+{
+	m_pContext->RSSetState(_state);
+}
+
+void D3D11RenderContext::RSSetViewports(unsigned int _count, const RenderViewport* _viewports)
+{
+	m_pContext->RSSetViewports(_count, (const D3D11_VIEWPORT*)_viewports);
+}
+// ====================== //
+
+// ===== Output Merger ===== //
+void D3D11RenderContext::OMSetBlendState(ID3D11BlendState* _state, const float* _blendFactor, unsigned int _sampleMask)
+{
+	m_pContext->OMSetBlendState(_state, _blendFactor, _sampleMask);
+}
+
+void D3D11RenderContext::OMSetDepthStencilState(ID3D11DepthStencilState* _state, unsigned int _stencilRef)
+{
+	m_pContext->OMSetDepthStencilState(_state, _stencilRef);
+}
+
+void D3D11RenderContext::OMSetRenderTargets(unsigned int _count, ID3D11RenderTargetView* const* _views, ID3D11DepthStencilView* _depthView)
+{
+	m_pContext->OMSetRenderTargets(_count, _views, _depthView);
+}
+// ========================= //
+
+// ===== Draws ===== //
+void D3D11RenderContext::Draw(unsigned int _vertexCount, unsigned int _startVertex)
+{
+	m_pContext->Draw(_vertexCount, _startVertex);
+}
+
+void D3D11RenderContext::DrawIndexed(unsigned int _indexCount, unsigned int _startIndex, int _baseVertex)
+{
+	m_pContext->DrawIndexed(_indexCount, _startIndex, _baseVertex);
+}
+
+void D3D11RenderContext::DrawIndexedInstanced(unsigned int _indexCount, unsigned int _instanceCount, unsigned int _startIndex, int _baseVertex, unsigned int _startInstance)
+{
+	m_pContext->DrawIndexedInstanced(_indexCount, _instanceCount, _startIndex, _baseVertex, _startInstance);
+}
+// ================= //
+
+// ===== Resources ===== //
+void D3D11RenderContext::WriteBuffer(ID3D11Buffer* _buffer, unsigned int _offset, const void* _data, unsigned int _size, bool _discard)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(m_pContext->Map(_buffer, 0, _discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped)))
+		return;
+	memcpy((unsigned char*)mapped.pData + _offset, _data, _size);
+	m_pContext->Unmap(_buffer, 0);
+}
+// ===================== //
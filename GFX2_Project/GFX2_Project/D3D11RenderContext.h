@@ -0,0 +1,52 @@
+#pragma once
+
+#include <d3d11_1.h>
+
+#include "RenderContext.h"
+
+// - D3D11RenderContext
+// --- IRenderContext on an ID3D11DeviceContext, passes every call straight on
+// --- Does not own the device context; put a StateFilteringContext in front of it to drop redundant calls
+// --- VSSetConstantBuffers1 needs the D3D11.1 runtime, check SupportsConstantOffsets before using it
+class D3D11RenderContext : public IRenderContext
+{
+private:
+	ID3D11DeviceContext*	m_pContext;
+	ID3D11DeviceContext1*	m_pContext1;
+
+public:
+	// ===== Constructor / Destructor
+	D3D11RenderContext(ID3D11DeviceContext* _context = nullptr);
+	~D3D11RenderContext();
+
+	// ===== Interface
+	void SetDeviceContext(ID3D11DeviceContext* _context);
+	// - SupportsConstantOffsets
+	// --- True when constant buffers can be bound by offset and mapped with NO_OVERWRITE on _device
+	bool SupportsConstantOffsets(ID3D11Device* _device) const;
+
+	// ===== IRenderContext
+	void IASetPrimitiveTopology(unsigned int _topology);
+	void IASetInputLayout(ID3D11InputLayout* _layout);
+	void IASetVertexBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _strides, const unsigned int* _offsets);
+	void IASetIndexBuffer(ID3D11Buffer* _buffer, unsigned int _format, unsigned int _offset);
+	void VSSetShader(ID3D11VertexShader* _shader);
+	void VSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers);
+	void VSSetConstantBuffers1(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _firstConstants, const unsigned int* _constantCounts);
+	void PSSetShader(ID3D11PixelShader* _shader);
+	void PSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers);
+	void PSSetShaderResources(unsigned int _startSlot, unsigned int _count, ID3D11ShaderResourceView* const* _views);
+	void PSSetSamplers(unsigned int _startSlot, unsigned int _count, ID3D11SamplerState* const* _samplers);
+	void RSSetState(ID3D11RasterizerState* _state);
+	void RSSetViewports(unsigned int _count, const RenderViewport* _viewports);
+	void OMSetBlendState(ID3D11BlendState* _state, const float* _blendFactor, unsigned int _sampleMask);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* _state, unsigned int _stencilRef);
+	void OMSetRenderTargets(unsigned int _count, ID3D11RenderTargetView* const* _views, ID3D11DepthStencilView* _depthView);
+	void Draw(unsigned int _vertexCount, unsigned int _startVertex);
+	void DrawIndexed(unsigned int _indexCount, unsigned int _startIndex, int _baseVertex);
+	void DrawIndexedInstanced(unsigned int _indexCount, unsigned int _instanceCount, unsigned int _startIndex, int _baseVertex, unsigned int _startInstance);
+	void WriteBuffer(ID3D11Buffer* _buffer, unsigned int _offset, const void* _data, unsigned int _size, bool _discard);
+
+	// ===== Accessors
+	ID3D11DeviceContext* GetDeviceContext() const { return m_pContext; }
+};
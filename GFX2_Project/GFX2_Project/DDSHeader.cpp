@@ -0,0 +1,661 @@
+#include "DDSHeader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Profiling.h"
+
+using std::vector;
+
+// ===== Local Helpers ===== //
+// === D3D11 hardware limits, the file's metadata is not trusted beyond them
+static const unsigned int DDS_MAX_MIP_LEVELS = 15;
+static const unsigned int DDS_MAX_ARRAY_SIZE = 2048;
+static const unsigned int DDS_MAX_TEXTURE1D_SIZE = 16384;
+static const unsigned int DDS_MAX_TEXTURE2D_SIZE = 16384;
+static const unsigned int DDS_MAX_TEXTURECUBE_SIZE = 16384;
+static const unsigned int DDS_MAX_TEXTURE3D_SIZE = 2048;
+
+static inline unsigned int MakeFourCC(char _a, char _b, char _c, char _d)
+{
+	return (unsigned int)(unsigned char)_a | ((unsigned int)(unsigned char)_b << 8) | ((unsigned int)(unsigned char)_c << 16) | ((unsigned int)(unsigned char)_d << 24);
+}
+
+static inline bool IsBitMask(const DDSPixelFormat& _format, unsigned int _r, unsigned int _g, unsigned int _b, unsigned int _a)
+{
+	return _format.RBitMask == _r && _format.GBitMask == _g && _format.BBitMask == _b && _format.ABitMask == _a;
+}
+// ========================= //
+
+// ===== Parsing ===== //
+unsigned int GetDDSBitsPerPixel(unsigned int _format)
+{
+	// === DXGI_FORMAT values, grouped the way the enum is ordered
+	if (_format >= 1 && _format <= 4)		// R32G32B32A32
+		return 128;
+	if (_format >= 5 && _format <= 8)		// R32G32B32
+		return 96;
+	if (_format >= 9 && _format <= 22)		// R16G16B16A16, R32G32, R32G8X24 and its views
+		return 64;
+	if (_format >= 23 && _format <= 47)		// R10G10B10A2, R11G11B10, R8G8B8A8, R16G16, R32, R24G8 and its views
+		return 32;
+	if (_format >= 48 && _format <= 59)		// R8G8, R16
+		return 16;
+	if (_format >= 60 && _format <= 65)		// R8, A8
+		return 8;
+	if (_format == 66)						// R1
+		return 1;
+	if (_format >= 67 && _format <= 69)		// R9G9B9E5, R8G8_B8G8, G8R8_G8B8
+		return 32;
+	if ((_format >= 70 && _format <= 72) || (_format >= 79 && _format <= 81))	// BC1, BC4
+		return 4;
+	if ((_format >= 73 && _format <= 78) || (_format >= 82 && _format <= 84))	// BC2, BC3, BC5
+		return 8;
+	if (_format == 85 || _format == 86)		// B5G6R5, B5G5R5A1
+		return 16;
+	if (_format >= 87 && _format <= 93)		// B8G8R8A8, B8G8R8X8, R10G10B10_XR_BIAS_A2 and their views
+		return 32;
+	if (_format >= 94 && _format <= 99)		// BC6H, BC7
+		return 8;
+	// === Video formats, and B4G4R4A4 which needs DXGI 1.2 (Windows 8)
+	return 0;
+}
+
+void GetDDSSurfaceInfo(size_t _width, size_t _height, unsigned int _format, size_t* _bytes, size_t* _rowBytes, size_t* _rows)
+{
+	size_t rowBytes = 0, rows = 0;
+	unsigned int bitsPerPixel = GetDDSBitsPerPixel(_format);
+	bool blockCompressed = (_format >= 70 && _format <= 84) || (_format >= 94 && _format <= 99);
+	if (blockCompressed) {
+		// == 4x4 blocks of 8 (4 bits per pixel) or 16 bytes
+		size_t blocksWide = _width > 0 ? (_width + 3) / 4 : 0;
+		size_t blocksHigh = _height > 0 ? (_height + 3) / 4 : 0;
+		rowBytes = blocksWide * (bitsPerPixel == 4 ? 8 : 16);
+		rows = blocksHigh;
+	}
+	else if (_format == DDS_FORMAT_R8G8_B8G8_UNORM || _format == DDS_FORMAT_G8R8_G8B8_UNORM) {
+		// == Two pixels share 4 bytes
+		rowBytes = ((_width + 1) >> 1) * 4;
+		rows = _height;
+	}
+	else {
+		rowBytes = (_width * bitsPerPixel + 7) / 8;
+		rows = _height;
+	}
+	if (_bytes)
+		*_bytes = rowBytes * rows;
+	if (_rowBytes)
+		*_rowBytes = rowBytes;
+	if (_rows)
+		*_rows = rows;
+}
+
+unsigned int GetDDSFormat(const DDSPixelFormat& _pixelFormat)
+{
+	if (_pixelFormat.flags & DDS_PF_RGB) {
+		// == sRGB formats are only written with the DX10 header
+		if (_pixelFormat.RGBBitCount == 32) {
+			if (IsBitMask(_pixelFormat, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000))
+				return DDS_FORMAT_R8G8B8A8_UNORM;
+			if (IsBitMask(_pixelFormat, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000))
+				return DDS_FORMAT_B8G8R8A8_UNORM;
+			if (IsBitMask(_pixelFormat, 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000))
+				return DDS_FORMAT_B8G8R8X8_UNORM;
+			// == D3DX writes 10:10:10:2 with red and blue swapped, this is what it means
+			if (IsBitMask(_pixelFormat, 0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000))
+				return DDS_FORMAT_R10G10B10A2_UNORM;
+			if (IsBitMask(_pixelFormat, 0x0000FFFF, 0xFFFF0000, 0x00000000, 0x00000000))
+				return DDS_FORMAT_R16G16_UNORM;
+			if (IsBitMask(_pixelFormat, 0xFFFFFFFF, 0x00000000, 0x00000000, 0x00000000))
+				return DDS_FORMAT_R32_FLOAT;
+		}
+		else if (_pixelFormat.RGBBitCount == 16) {
+			if (IsBitMask(_pixelFormat, 0x7C00, 0x03E0, 0x001F, 0x8000))
+				return DDS_FORMAT_B5G5R5A1_UNORM;
+			if (IsBitMask(_pixelFormat, 0xF800, 0x07E0, 0x001F, 0x0000))
+				return DDS_FORMAT_B5G6R5_UNORM;
+		}
+	}
+	else if (_pixelFormat.flags & DDS_PF_LUMINANCE) {
+		if (_pixelFormat.RGBBitCount == 8 && IsBitMask(_pixelFormat, 0x000000FF, 0, 0, 0))
+			return DDS_FORMAT_R8_UNORM;
+		if (_pixelFormat.RGBBitCount == 16) {
+			if (IsBitMask(_pixelFormat, 0x0000FFFF, 0, 0, 0))
+				return DDS_FORMAT_R16_UNORM;
+			if (IsBitMask(_pixelFormat, 0x000000FF, 0, 0, 0x0000FF00))
+				return DDS_FORMAT_R8G8_UNORM;
+		}
+	}
+	else if (_pixelFormat.flags & DDS_PF_ALPHA) {
+		if (_pixelFormat.RGBBitCount == 8)
+			return DDS_FORMAT_A8_UNORM;
+	}
+	else if (_pixelFormat.flags & DDS_PF_FOURCC) {
+		unsigned int fourCC = _pixelFormat.fourCC;
+		// == Premultiplied DXT2 / DXT4 load as BC2 / BC3
+		if (fourCC == MakeFourCC('D', 'X', 'T', '1'))
+			return DDS_FORMAT_BC1_UNORM;
+		if (fourCC == MakeFourCC('D', 'X', 'T', '3') || fourCC == MakeFourCC('D', 'X', 'T', '2'))
+			return DDS_FORMAT_BC2_UNORM;
+		if (fourCC == MakeFourCC('D', 'X', 'T', '5') || fourCC == MakeFourCC('D', 'X', 'T', '4'))
+			return DDS_FORMAT_BC3_UNORM;
+		if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U'))
+			return DDS_FORMAT_BC4_UNORM;
+		if (fourCC == MakeFourCC('B', 'C', '4', 'S'))
+			return DDS_FORMAT_BC4_SNORM;
+		if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U'))
+			return DDS_FORMAT_BC5_UNORM;
+		if (fourCC == MakeFourCC('B', 'C', '5', 'S'))
+			return DDS_FORMAT_BC5_SNORM;
+		if (fourCC == MakeFourCC('R', 'G', 'B', 'G'))
+			return DDS_FORMAT_R8G8_B8G8_UNORM;
+		if (fourCC == MakeFourCC('G', 'R', 'G', 'B'))
+			return DDS_FORMAT_G8R8_G8B8_UNORM;
+		// == D3DFORMAT values stored as the fourCC
+		switch (fourCC) {
+		case 36: return DDS_FORMAT_R16G16B16A16_UNORM;
+		case 110: return DDS_FORMAT_R16G16B16A16_SNORM;
+		case 111: return DDS_FORMAT_R16_FLOAT;
+		case 112: return DDS_FORMAT_R16G16_FLOAT;
+		case 113: return DDS_FORMAT_R16G16B16A16_FLOAT;
+		case 114: return DDS_FORMAT_R32_FLOAT;
+		case 115: return DDS_FORMAT_R32G32_FLOAT;
+		case 116: return DDS_FORMAT_R32G32B32A32_FLOAT;
+		}
+	}
+	return DDS_FORMAT_UNKNOWN;
+}
+
+DDSResult ParseDDS(const void* _data, size_t _size, DDSTexture* _texture)
+{
+	const unsigned char* bytes = (const unsigned char*)_data;
+	if (bytes == nullptr || _size < sizeof(unsigned int) + sizeof(DDSHeader))
+		return DDS_INVALID_FILE;
+
+	// === Magic and header sizes; the headers are copied out, the mapping may not be aligned for them
+	unsigned int magic;
+	DDSHeader header;
+	memcpy(&magic, bytes, sizeof(magic));
+	memcpy(&header, bytes + sizeof(magic), sizeof(header));
+	if (magic != DDS_MAGIC_NUMBER || header.size != sizeof(DDSHeader) || header.ddspf.size != sizeof(DDSPixelFormat))
+		return DDS_INVALID_FILE;
+	size_t offset = sizeof(magic) + sizeof(header);
+
+	DDSTexture texture;
+	texture.width = header.width;
+	texture.height = header.height;
+	texture.depth = header.depth;
+	texture.mipCount = header.mipMapCount > 0 ? header.mipMapCount : 1;
+	texture.arraySize = 1;
+	texture.format = DDS_FORMAT_UNKNOWN;
+	texture.dimension = DDS_DIMENSION_TEXTURE2D;
+	texture.cubeMap = false;
+
+	if ((header.ddspf.flags & DDS_PF_FOURCC) && header.ddspf.fourCC == MakeFourCC('D', 'X', '1', '0')) {
+		// === DX10 header: any DXGI format, dimension and array size
+		if (_size < offset + sizeof(DDSHeaderDXT10))
+			return DDS_INVALID_FILE;
+		DDSHeaderDXT10 extension;
+		memcpy(&extension, bytes + offset, sizeof(extension));
+		offset += sizeof(extension);
+
+		texture.arraySize = extension.arraySize;
+		if (texture.arraySize == 0)
+			return DDS_INVALID_DATA;
+		if (GetDDSBitsPerPixel(extension.dxgiFormat) == 0)
+			return DDS_NOT_SUPPORTED;
+		texture.format = extension.dxgiFormat;
+
+		switch (extension.resourceDimension) {
+		case DDS_DIMENSION_TEXTURE1D:
+			// == D3DX writes 1D textures with a height of 1
+			if ((header.flags & DDS_HEADER_HEIGHT) && texture.height != 1)
+				return DDS_INVALID_DATA;
+			texture.height = texture.depth = 1;
+			break;
+		case DDS_DIMENSION_TEXTURE2D:
+			if (extension.miscFlag & DDS_MISC_TEXTURECUBE) {
+				if (texture.arraySize > DDS_MAX_ARRAY_SIZE / 6)
+					return DDS_NOT_SUPPORTED;
+				texture.arraySize *= 6;
+				texture.cubeMap = true;
+			}
+			texture.depth = 1;
+			break;
+		case DDS_DIMENSION_TEXTURE3D:
+			if (!(header.flags & DDS_HEADER_VOLUME))
+				return DDS_INVALID_DATA;
+			if (texture.arraySize > 1)
+				return DDS_NOT_SUPPORTED;
+			break;
+		default:
+			return DDS_NOT_SUPPORTED;
+		}
+		texture.dimension = (DDSDimension)extension.resourceDimension;
+	}
+	else {
+		// === Legacy header: the format comes from the pixel format, cube maps need all six faces
+		texture.format = GetDDSFormat(header.ddspf);
+		if (texture.format == DDS_FORMAT_UNKNOWN)
+			return DDS_NOT_SUPPORTED;
+		if (header.flags & DDS_HEADER_VOLUME) {
+			texture.dimension = DDS_DIMENSION_TEXTURE3D;
+		}
+		else {
+			if (header.caps2 & DDS_CAPS2_CUBEMAP) {
+				if ((header.caps2 & DDS_CAPS2_ALLFACES) != DDS_CAPS2_ALLFACES)
+					return DDS_NOT_SUPPORTED;
+				texture.arraySize = 6;
+				texture.cubeMap = true;
+			}
+			texture.depth = 1;
+		}
+	}
+
+	// === D3D11 limits
+	if (texture.mipCount > DDS_MAX_MIP_LEVELS)
+		return DDS_NOT_SUPPORTED;
+	switch (texture.dimension) {
+	case DDS_DIMENSION_TEXTURE1D:
+		if (texture.arraySize > DDS_MAX_ARRAY_SIZE || texture.width > DDS_MAX_TEXTURE1D_SIZE)
+			return DDS_NOT_SUPPORTED;
+		break;
+	case DDS_DIMENSION_TEXTURE2D:
+		if (texture.arraySize > DDS_MAX_ARRAY_SIZE || texture.width > (texture.cubeMap ? DDS_MAX_TEXTURECUBE_SIZE : DDS_MAX_TEXTURE2D_SIZE)
+			|| texture.height > (texture.cubeMap ? DDS_MAX_TEXTURECUBE_SIZE : DDS_MAX_TEXTURE2D_SIZE))
+			return DDS_NOT_SUPPORTED;
+		break;
+	case DDS_DIMENSION_TEXTURE3D:
+		if (texture.arraySize > 1 || texture.width > DDS_MAX_TEXTURE3D_SIZE || texture.height > DDS_MAX_TEXTURE3D_SIZE || texture.depth > DDS_MAX_TEXTURE3D_SIZE)
+			return DDS_NOT_SUPPORTED;
+		break;
+	}
+
+	texture.bits = bytes + offset;
+	texture.bitSize = _size - offset;
+	*_texture = texture;
+	return DDS_OK;
+}
+
+DDSResult LayoutDDS(const DDSTexture& _texture, size_t _maxSize, DDSSubresource* _subresources, DDSLayout* _layout)
+{
+	memset(_layout, 0, sizeof(DDSLayout));
+	unsigned long long remaining = _texture.bitSize;
+	const unsigned char* bits = _texture.bits;
+	unsigned int index = 0;
+	for (unsigned int slice = 0; slice < _texture.arraySize; slice++) {
+		size_t width = _texture.width, height = _texture.height, depth = _texture.depth;
+		for (unsigned int mip = 0; mip < _texture.mipCount; mip++) {
+			size_t bytes = 0, rowBytes = 0;
+			GetDDSSurfaceInfo(width, height, _texture.format, &bytes, &rowBytes, nullptr);
+
+			// == Kept mips point straight into the file data
+			if (_texture.mipCount <= 1 || _maxSize == 0 || (width <= _maxSize && height <= _maxSize && depth <= _maxSize)) {
+				if (_layout->width == 0) {
+					_layout->width = (unsigned int)width;
+					_layout->height = (unsigned int)height;
+					_layout->depth = (unsigned int)depth;
+				}
+				_subresources[index].data = bits;
+				_subresources[index].rowPitch = (unsigned int)rowBytes;
+				_subresources[index].slicePitch = (unsigned int)bytes;
+				index++;
+			}
+			else if (slice == 0) {
+				_layout->skippedMips++;
+			}
+
+			unsigned long long mipBytes = (unsigned long long)bytes * depth;
+			if (mipBytes > remaining)
+				return DDS_TRUNCATED;
+			bits += mipBytes;
+			remaining -= mipBytes;
+
+			width = width > 1 ? width >> 1 : 1;
+			height = height > 1 ? height >> 1 : 1;
+			depth = depth > 1 ? depth >> 1 : 1;
+		}
+	}
+	_layout->subresourceCount = index;
+	return index > 0 ? DDS_OK : DDS_INVALID_DATA;
+}
+// =================== //
+
+// ===== Writing ===== //
+size_t WriteDDSHeaders(const DDSTexture& _texture, unsigned char* _header)
+{
+	size_t bytes = 0, rowBytes = 0;
+	GetDDSSurfaceInfo(_texture.width, _texture.height, _texture.format, &bytes, &rowBytes, nullptr);
+	bool blockCompressed = (_texture.format >= 70 && _texture.format <= 84) || (_texture.format >= 94 && _texture.format <= 99);
+
+	DDSHeader header;
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(DDSHeader);
+	header.flags = DDS_HEADER_TEXTURE | (blockCompressed ? DDS_HEADER_LINEARSIZE : DDS_HEADER_PITCH);
+	header.width = _texture.width;
+	header.height = _texture.height;
+	header.pitchOrLinearSize = (unsigned int)(blockCompressed ? bytes : rowBytes);
+	header.mipMapCount = _texture.mipCount;
+	header.ddspf.size = sizeof(DDSPixelFormat);
+	header.caps = DDS_CAPS_TEXTURE;
+	if (_texture.mipCount > 1) {
+		header.flags |= DDS_HEADER_MIPMAP;
+		header.caps |= DDS_CAPS_MIPMAP | DDS_CAPS_COMPLEX;
+	}
+	if (_texture.dimension == DDS_DIMENSION_TEXTURE3D) {
+		header.flags |= DDS_HEADER_VOLUME;
+		header.depth = _texture.depth;
+		header.caps |= DDS_CAPS_COMPLEX;
+		header.caps2 = DDS_CAPS2_VOLUME;
+	}
+	if (_texture.cubeMap) {
+		header.caps |= DDS_CAPS_COMPLEX;
+		header.caps2 = DDS_CAPS2_CUBEMAP | DDS_CAPS2_ALLFACES;
+	}
+
+	// === DXT1 / DXT5 / DXT3 fourCCs for what legacy readers know, the DX10 header for the rest
+	unsigned int fourCC = 0;
+	bool single = _texture.dimension == DDS_DIMENSION_TEXTURE2D && _texture.arraySize == (_texture.cubeMap ? 6u : 1u);
+	if (single && _texture.format == DDS_FORMAT_BC1_UNORM)
+		fourCC = MakeFourCC('D', 'X', 'T', '1');
+	else if (single && _texture.format == DDS_FORMAT_BC2_UNORM)
+		fourCC = MakeFourCC('D', 'X', 'T', '3');
+	else if (single && _texture.format == DDS_FORMAT_BC3_UNORM)
+		fourCC = MakeFourCC('D', 'X', 'T', '5');
+	header.ddspf.flags = DDS_PF_FOURCC;
+	header.ddspf.fourCC = fourCC != 0 ? fourCC : MakeFourCC('D', 'X', '1', '0');
+
+	size_t offset = 0;
+	memcpy(_header, &DDS_MAGIC_NUMBER, sizeof(DDS_MAGIC_NUMBER));
+	offset += sizeof(DDS_MAGIC_NUMBER);
+	memcpy(_header + offset, &header, sizeof(header));
+	offset += sizeof(header);
+	if (fourCC == 0) {
+		// == A DX10 cube map counts cubes, not faces
+		DDSHeaderDXT10 extension = { _texture.format, (unsigned int)_texture.dimension, _texture.cubeMap ? DDS_MISC_TEXTURECUBE : 0,
+			_texture.cubeMap ? _texture.arraySize / 6 : _texture.arraySize, 0 };
+		memcpy(_header + offset, &extension, sizeof(extension));
+		offset += sizeof(extension);
+	}
+	return offset;
+}
+// =================== //
+
+// ===== Checks ===== //
+// - BuildDDS
+// --- A DDS file with _format and a DX10 header when _extension is given, its pixel bytes counting up
+static void BuildDDS(const DDSHeader& _header, const DDSHeaderDXT10* _extension, size_t _pixelBytes, vector<unsigned char>* _file)
+{
+	size_t headerBytes = sizeof(unsigned int) + sizeof(DDSHeader) + (_extension ? sizeof(DDSHeaderDXT10) : 0);
+	_file->assign(headerBytes + _pixelBytes, 0);
+	memcpy(&(*_file)[0], &DDS_MAGIC_NUMBER, sizeof(unsigned int));
+	memcpy(&(*_file)[sizeof(unsigned int)], &_header, sizeof(DDSHeader));
+	if (_extension)
+		memcpy(&(*_file)[sizeof(unsigned int) + sizeof(DDSHeader)], _extension, sizeof(DDSHeaderDXT10));
+	for (size_t i = 0; i < _pixelBytes; i++)
+		(*_file)[headerBytes + i] = (unsigned char)i;
+}
+
+static DDSHeader MakeHeader(unsigned int _width, unsigned int _height, unsigned int _mips, unsigned int _fourCC)
+{
+	DDSHeader header;
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(DDSHeader);
+	header.flags = DDS_HEADER_TEXTURE;
+	header.width = _width;
+	header.height = _height;
+	header.depth = 1;
+	header.mipMapCount = _mips;
+	header.ddspf.size = sizeof(DDSPixelFormat);
+	header.ddspf.flags = DDS_PF_FOURCC;
+	header.ddspf.fourCC = _fourCC;
+	return header;
+}
+
+bool CheckDDSHeader()
+{
+	unsigned int failures = 0;
+	vector<unsigned char> file;
+	DDSTexture texture;
+	DDSLayout layout;
+	DDSSubresource subresources[6 * 15];
+
+	// === BC1 256x128 with 9 mips: 16384 + 4096 + 1024 + 256 + 64 + 16 (two 8x4 / 4x2 / 2x1 / 1x1 mips of one block each)
+	DDSHeader header = MakeHeader(256, 128, 9, MakeFourCC('D', 'X', 'T', '1'));
+	const size_t bc1Mips[9] = { 16384, 4096, 1024, 256, 64, 16, 8, 8, 8 };
+	size_t bc1Bytes = 0;
+	for (unsigned int i = 0; i < 9; i++)
+		bc1Bytes += bc1Mips[i];
+	BuildDDS(header, nullptr, bc1Bytes, &file);
+	if (ParseDDS(&file[0], file.size(), &texture) != DDS_OK || texture.format != DDS_FORMAT_BC1_UNORM || texture.mipCount != 9 || texture.arraySize != 1
+		|| texture.dimension != DDS_DIMENSION_TEXTURE2D || texture.bits != &file[128] || texture.bitSize != bc1Bytes) {
+		LogMessage("DDSHeader: legacy BC1 header parsed wrong");
+		failures++;
+	}
+	else {
+		// == Every mip right after the previous one, straight in the file
+		bool match = LayoutDDS(texture, 0, subresources, &layout) == DDS_OK && layout.subresourceCount == 9 && layout.skippedMips == 0 && layout.width == 256;
+		size_t offset = 128;
+		for (unsigned int i = 0; i < 9 && match; i++) {
+			match = subresources[i].data == &file[offset] && subresources[i].slicePitch == bc1Mips[i];
+			offset += bc1Mips[i];
+		}
+		match = match && subresources[0].rowPitch == 64 * 8;
+		// == A max size of 64 skips the 256x128 and 128x64 mips
+		match = match && LayoutDDS(texture, 64, subresources, &layout) == DDS_OK && layout.skippedMips == 2 && layout.subresourceCount == 7
+			&& layout.width == 64 && layout.height == 32 && subresources[0].data == &file[128 + 16384 + 4096];
+		if (!match) {
+			LogMessage("DDSHeader: BC1 mips laid out wrong");
+			failures++;
+		}
+		// == One byte short of the last mip
+		if (ParseDDS(&file[0], file.size() - 1, &texture) != DDS_OK || LayoutDDS(texture, 0, subresources, &layout) != DDS_TRUNCATED) {
+			LogMessage("DDSHeader: truncated pixel data was accepted");
+			failures++;
+		}
+	}
+
+	// === Legacy RGBA cube map, 4 faces of 16x16 with 5 mips
+	header = MakeHeader(16, 16, 5, 0);
+	header.ddspf.flags = DDS_PF_RGB | 0x1;
+	header.ddspf.RGBBitCount = 32;
+	header.ddspf.RBitMask = 0x000000FF; header.ddspf.GBitMask = 0x0000FF00; header.ddspf.BBitMask = 0x00FF0000; header.ddspf.ABitMask = 0xFF000000;
+	header.caps2 = DDS_CAPS2_ALLFACES;
+	size_t faceBytes = (256 + 64 + 16 + 4 + 1) * 4;
+	BuildDDS(header, nullptr, faceBytes * 6, &file);
+	if (ParseDDS(&file[0], file.size(), &texture) != DDS_OK || !texture.cubeMap || texture.arraySize != 6 || texture.format != DDS_FORMAT_R8G8B8A8_UNORM
+		|| LayoutDDS(texture, 0, subresources, &layout) != DDS_OK || layout.subresourceCount != 30 || subresources[5].data != &file[128 + faceBytes]
+		|| subresources[29].slicePitch != 4 || (const unsigned char*)subresources[29].data + 4 != &file[0] + file.size()) {
+		LogMessage("DDSHeader: cube map parsed or laid out wrong");
+		failures++;
+	}
+	header.caps2 = DDS_CAPS2_CUBEMAP | 0x400 | 0x800;
+	BuildDDS(header, nullptr, faceBytes * 6, &file);
+	if (ParseDDS(&file[0], file.size(), &texture) != DDS_NOT_SUPPORTED) {
+		LogMessage("DDSHeader: a cube map without all faces was accepted");
+		failures++;
+	}
+
+	// === DX10 BC7 array of 3 slices, 8x8 with 2 mips; then a volume
+	header = MakeHeader(8, 8, 2, MakeFourCC('D', 'X', '1', '0'));
+	DDSHeaderDXT10 extension = { DDS_FORMAT_BC7_UNORM, DDS_DIMENSION_TEXTURE2D, 0, 3, 0 };
+	BuildDDS(header, &extension, (64 + 16) * 3, &file);
+	if (ParseDDS(&file[0], file.size(), &texture) != DDS_OK || texture.arraySize != 3 || texture.format != DDS_FORMAT_BC7_UNORM || texture.bits != &file[148]
+		|| LayoutDDS(texture, 0, subresources, &layout) != DDS_OK || layout.subresourceCount != 6 || subresources[2].data != &file[148 + 80]
+		|| subresources[1].rowPitch != 16 || subresources[0].rowPitch != 32) {
+		LogMessage("DDSHeader: DX10 texture array parsed or laid out wrong");
+		failures++;
+	}
+	header = MakeHeader(4, 4, 3, MakeFourCC('D', 'X', '1', '0'));
+	header.flags |= DDS_HEADER_VOLUME;
+	header.depth = 4;
+	extension.dxgiFormat = DDS_FORMAT_R8G8B8A8_UNORM;
+	extension.resourceDimension = DDS_DIMENSION_TEXTURE3D;
+	extension.arraySize = 1;
+	BuildDDS(header, &extension, (64 + 8 + 1) * 4, &file);
+	if (ParseDDS(&file[0], file.size(), &texture) != DDS_OK || texture.dimension != DDS_DIMENSION_TEXTURE3D || texture.depth != 4
+		|| LayoutDDS(texture, 0, subresources, &layout) != DDS_OK || subresources[1].data != &file[148 + 64 * 4] || subresources[2].data != &file[148 + 64 * 4 + 8 * 4]) {
+		LogMessage("DDSHeader: volume texture parsed or laid out wrong");
+		failures++;
+	}
+
+	// === Written headers parse back: a legacy BC1 texture, a DX10 BC7 cube array of 2 cubes
+	DDSTexture written = { 64, 32, 1, 7, 1, DDS_FORMAT_BC1_UNORM, DDS_DIMENSION_TEXTURE2D, false, nullptr, 0 };
+	for (unsigned int i = 0; i < 2; i++) {
+		if (i == 1) {
+			written.width = written.height = 16;
+			written.mipCount = 3;
+			written.arraySize = 12;
+			written.format = DDS_FORMAT_BC7_UNORM;
+			written.cubeMap = true;
+		}
+		unsigned char headers[DDS_MAX_HEADER_SIZE];
+		size_t headerBytes = WriteDDSHeaders(written, headers);
+		file.assign(headers, headers + headerBytes);
+		file.resize(headerBytes + 4096 * 12, 0);
+		if (headerBytes != (i == 0 ? 128u : 148u) || ParseDDS(&file[0], file.size(), &texture) != DDS_OK || texture.width != written.width
+			|| texture.height != written.height || texture.mipCount != written.mipCount || texture.arraySize != written.arraySize
+			|| texture.format != written.format || texture.cubeMap != written.cubeMap || texture.bits != &file[headerBytes]) {
+			LogMessage("DDSHeader: a written %s header parsed back wrong", i == 0 ? "legacy" : "DX10");
+			failures++;
+		}
+	}
+
+	// === Broken files
+	struct BrokenCase { const char* name; DDSResult expected; };
+	const BrokenCase cases[] = {
+		{ "wrong magic", DDS_INVALID_FILE }, { "header cut short", DDS_INVALID_FILE }, { "wrong header size", DDS_INVALID_FILE },
+		{ "DX10 header cut short", DDS_INVALID_FILE }, { "empty array", DDS_INVALID_DATA }, { "1D texture with a height", DDS_INVALID_DATA },
+		{ "volume without the volume flag", DDS_INVALID_DATA }, { "16 mips", DDS_NOT_SUPPORTED }, { "32768 wide", DDS_NOT_SUPPORTED },
+		{ "unknown fourCC", DDS_NOT_SUPPORTED }, { "video format", DDS_NOT_SUPPORTED },
+	};
+	for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		header = MakeHeader(64, 64, 1, MakeFourCC('D', 'X', '1', '0'));
+		DDSHeaderDXT10 broken = { DDS_FORMAT_R8G8B8A8_UNORM, DDS_DIMENSION_TEXTURE2D, 0, 1, 0 };
+		size_t size = 0;
+		switch (i) {
+		case 2: header.size = 128; break;
+		case 4: broken.arraySize = 0; break;
+		case 5: broken.resourceDimension = DDS_DIMENSION_TEXTURE1D; break;
+		case 6: broken.resourceDimension = DDS_DIMENSION_TEXTURE3D; break;
+		case 7: header.mipMapCount = 16; break;
+		case 8: header.width = 32768; break;
+		case 9: header.ddspf.fourCC = MakeFourCC('A', 'B', 'C', 'D'); break;
+		case 10: broken.dxgiFormat = 103; break;
+		}
+		BuildDDS(header, &broken, 64 * 64 * 4, &file);
+		size = file.size();
+		if (i == 0)
+			file[0] = 'X';
+		if (i == 1)
+			size = 100;
+		if (i == 3)
+			size = 130;
+		DDSResult result = ParseDDS(&file[0], size, &texture);
+		if (result != cases[i].expected) {
+			LogMessage("DDSHeader: %s gave %d instead of %d", cases[i].name, (int)result, (int)cases[i].expected);
+			failures++;
+		}
+	}
+
+	LogMessage("DDSHeader: checks %s", failures == 0 ? "passed" : "FAILED");
+	return failures == 0;
+}
+
+// - LoadAndTouch
+// --- Parses and lays out the DDS file in _data and reads every subresource byte, the checksum keeps the reads
+static bool LoadAndTouch(const void* _data, size_t _size, vector<DDSSubresource>* _subresources, unsigned long long* _checksum)
+{
+	DDSTexture texture;
+	DDSLayout layout;
+	if (ParseDDS(_data, _size, &texture) != DDS_OK)
+		return false;
+	_subresources->resize(texture.mipCount * texture.arraySize);
+	if (LayoutDDS(texture, 0, &(*_subresources)[0], &layout) != DDS_OK)
+		return false;
+	for (unsigned int i = 0; i < layout.subresourceCount; i++) {
+		const unsigned char* bytes = (const unsigned char*)(*_subresources)[i].data;
+		for (unsigned int j = 0; j < (*_subresources)[i].slicePitch; j += 4)
+			*_checksum += bytes[j];
+	}
+	return true;
+}
+
+void BenchmarkDDSLoading(const char* const* _paths, unsigned int _pathCount, unsigned int _repeats)
+{
+	vector<DDSSubresource> subresources;
+	vector<unsigned char*> buffers(_pathCount, nullptr);
+	MappedFile* mappings = new MappedFile[_pathCount];
+	unsigned long long heapChecksum = 0, mappedChecksum = 0, warmChecksum = 0;
+	unsigned int heapLoads = 0, mappedLoads = 0;
+	double heapTime = 0, mappedTime = 0;
+	MemoryUsage heapPeak = { 0, 0 }, mappedPeak = { 0, 0 }, before, now;
+
+	// === Warm the file cache first, so neither path pays for the disk
+	for (unsigned int p = 0; p < _pathCount; p++) {
+		if (mappings[p].Open(_paths[p]))
+			LoadAndTouch(mappings[p].GetData(), mappings[p].GetSize(), &subresources, &warmChecksum);
+		mappings[p].Close();
+	}
+
+	// === Every round loads all the textures and keeps them until the end, as a loader feeding uploads would,
+	// === the peak is the most the process grew by during a round
+	for (unsigned int repeat = 0; repeat < _repeats; repeat++) {
+		// == Old path: a heap buffer of the whole file, read in one call
+		GetMemoryUsage(&before);
+		for (unsigned int p = 0; p < _pathCount; p++) {
+			Stopwatch stopwatch;
+			FILE* file = nullptr;
+#ifdef _WIN32
+			fopen_s(&file, _paths[p], "rb");
+#else
+			file = fopen(_paths[p], "rb");
+#endif
+			if (file == nullptr)
+				continue;
+			fseek(file, 0, SEEK_END);
+			size_t size = (size_t)ftell(file);
+			fseek(file, 0, SEEK_SET);
+			buffers[p] = new unsigned char[size];
+			bool ok = fread(buffers[p], 1, size, file) == size;
+			fclose(file);
+			ok = ok && LoadAndTouch(buffers[p], size, &subresources, &heapChecksum);
+			heapTime += stopwatch.ElapsedMilliseconds();
+			heapLoads += ok ? 1 : 0;
+			GetMemoryUsage(&now);
+			heapPeak.privateBytes = now.privateBytes > before.privateBytes + heapPeak.privateBytes ? now.privateBytes - before.privateBytes : heapPeak.privateBytes;
+			heapPeak.resident = now.resident > before.resident + heapPeak.resident ? now.resident - before.resident : heapPeak.resident;
+		}
+		for (unsigned int p = 0; p < _pathCount; p++) {
+			delete[] buffers[p];
+			buffers[p] = nullptr;
+		}
+
+		// == Mapped path: the subresources point into the mappings
+		GetMemoryUsage(&before);
+		for (unsigned int p = 0; p < _pathCount; p++) {
+			Stopwatch stopwatch;
+			bool ok = mappings[p].Open(_paths[p]) && LoadAndTouch(mappings[p].GetData(), mappings[p].GetSize(), &subresources, &mappedChecksum);
+			mappedTime += stopwatch.ElapsedMilliseconds();
+			mappedLoads += ok ? 1 : 0;
+			GetMemoryUsage(&now);
+			mappedPeak.privateBytes = now.privateBytes > before.privateBytes + mappedPeak.privateBytes ? now.privateBytes - before.privateBytes : mappedPeak.privateBytes;
+			mappedPeak.resident = now.resident > before.resident + mappedPeak.resident ? now.resident - before.resident : mappedPeak.resident;
+		}
+		for (unsigned int p = 0; p < _pathCount; p++)
+			mappings[p].Close();
+	}
+	delete[] mappings;
+
+	if (heapLoads == 0 || mappedLoads == 0) {
+		LogMessage("DDSLoading: none of the %u textures could be loaded", _pathCount);
+		return;
+	}
+	LogMessage("DDSLoading: %u textures x %u, heap copy %.3f ms per texture (peak +%u KB private, +%u KB resident), mapped %.3f ms per texture (peak +%u KB private, +%u KB resident), data %s",
+		mappedLoads / _repeats, _repeats, heapTime / heapLoads, (unsigned int)(heapPeak.privateBytes / 1024), (unsigned int)(heapPeak.resident / 1024),
+		mappedTime / mappedLoads, (unsigned int)(mappedPeak.privateBytes / 1024), (unsigned int)(mappedPeak.resident / 1024),
+		heapChecksum == mappedChecksum && heapLoads == mappedLoads ? "matches" : "DIFFERS");
+}
+// ================== //
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstddef>
+
+// ===== DDS File Layout ===== //
+// --- [magic "DDS "][DDSHeader][DDSHeaderDXT10 when the fourCC is "DX10"][every mip of every array slice, tightly packed]
+static const unsigned int DDS_MAGIC_NUMBER = 0x20534444; // "DDS "
+
+// === DDSPixelFormat flags
+static const unsigned int DDS_PF_FOURCC		= 0x00000004;
+static const unsigned int DDS_PF_RGB		= 0x00000040;
+static const unsigned int DDS_PF_LUMINANCE	= 0x00020000;
+static const unsigned int DDS_PF_ALPHA		= 0x00000002;
+// === DDSHeader flags, caps and caps2
+static const unsigned int DDS_HEADER_TEXTURE	= 0x00001007; // caps, height, width and pixel format, always set
+static const unsigned int DDS_HEADER_HEIGHT	= 0x00000002;
+static const unsigned int DDS_HEADER_PITCH	= 0x00000008;
+static const unsigned int DDS_HEADER_MIPMAP	= 0x00020000;
+static const unsigned int DDS_HEADER_LINEARSIZE	= 0x00080000;
+static const unsigned int DDS_HEADER_VOLUME	= 0x00800000;
+static const unsigned int DDS_CAPS_COMPLEX	= 0x00000008;
+static const unsigned int DDS_CAPS_TEXTURE	= 0x00001000;
+static const unsigned int DDS_CAPS_MIPMAP	= 0x00400000;
+static const unsigned int DDS_CAPS2_CUBEMAP	= 0x00000200;
+static const unsigned int DDS_CAPS2_ALLFACES	= 0x0000FE00;
+static const unsigned int DDS_CAPS2_VOLUME	= 0x00200000;
+// === DDSHeaderDXT10 miscFlag, same as D3D11_RESOURCE_MISC_TEXTURECUBE
+static const unsigned int DDS_MISC_TEXTURECUBE	= 0x4;
+
+struct DDSPixelFormat
+{
+	unsigned int	size;
+	unsigned int	flags;
+	unsigned int	fourCC;
+	unsigned int	RGBBitCount;
+	unsigned int	RBitMask;
+	unsigned int	GBitMask;
+	unsigned int	BBitMask;
+	unsigned int	ABitMask;
+};
+
+struct DDSHeader
+{
+	unsigned int	size;
+	unsigned int	flags;
+	unsigned int	height;
+	unsigned int	width;
+	unsigned int	pitchOrLinearSize;
+	unsigned int	depth;
+	unsigned int	mipMapCount;
+	unsigned int	reserved1[11];
+	DDSPixelFormat	ddspf;
+	unsigned int	caps;
+	unsigned int	caps2;
+	unsigned int	caps3;
+	unsigned int	caps4;
+	unsigned int	reserved2;
+};
+
+struct DDSHeaderDXT10
+{
+	unsigned int	dxgiFormat;
+	unsigned int	resourceDimension;
+	unsigned int	miscFlag;
+	unsigned int	arraySize;
+	unsigned int	reserved;
+};
+
+static_assert(sizeof(DDSPixelFormat) == 32, "DDSPixelFormat must match the file");
+static_assert(sizeof(DDSHeader) == 124, "DDSHeader must match the file");
+static_assert(sizeof(DDSHeaderDXT10) == 20, "DDSHeaderDXT10 must match the file");
+
+// === Magic and both headers
+static const size_t DDS_MAX_HEADER_SIZE = sizeof(unsigned int) + sizeof(DDSHeader) + sizeof(DDSHeaderDXT10);
+// =========================== //
+
+// - DDSDimension
+// --- Same values as D3D11_RESOURCE_DIMENSION
+enum DDSDimension
+{
+	DDS_DIMENSION_TEXTURE1D = 2,
+	DDS_DIMENSION_TEXTURE2D = 3,
+	DDS_DIMENSION_TEXTURE3D = 4,
+};
+
+// - DDSFormat
+// --- The DXGI_FORMAT values this module names, the formats legacy headers map to; a DX10 header can hold any other
+enum DDSFormat
+{
+	DDS_FORMAT_UNKNOWN				= 0,
+	DDS_FORMAT_R32G32B32A32_FLOAT	= 2,
+	DDS_FORMAT_R16G16B16A16_FLOAT	= 10,
+	DDS_FORMAT_R16G16B16A16_UNORM	= 11,
+	DDS_FORMAT_R16G16B16A16_SNORM	= 13,
+	DDS_FORMAT_R32G32_FLOAT			= 16,
+	DDS_FORMAT_R10G10B10A2_UNORM	= 24,
+	DDS_FORMAT_R8G8B8A8_UNORM		= 28,
+	DDS_FORMAT_R16G16_FLOAT			= 34,
+	DDS_FORMAT_R16G16_UNORM			= 35,
+	DDS_FORMAT_R32_FLOAT			= 41,
+	DDS_FORMAT_R8G8_UNORM			= 49,
+	DDS_FORMAT_R16_FLOAT			= 54,
+	DDS_FORMAT_R16_UNORM			= 56,
+	DDS_FORMAT_R8_UNORM				= 61,
+	DDS_FORMAT_A8_UNORM				= 65,
+	DDS_FORMAT_R8G8_B8G8_UNORM		= 68,
+	DDS_FORMAT_G8R8_G8B8_UNORM		= 69,
+	DDS_FORMAT_BC1_UNORM			= 71,
+	DDS_FORMAT_BC2_UNORM			= 74,
+	DDS_FORMAT_BC3_UNORM			= 77,
+	DDS_FORMAT_BC4_UNORM			= 80,
+	DDS_FORMAT_BC4_SNORM			= 81,
+	DDS_FORMAT_BC5_UNORM			= 83,
+	DDS_FORMAT_BC5_SNORM			= 84,
+	DDS_FORMAT_B5G6R5_UNORM			= 85,
+	DDS_FORMAT_B5G5R5A1_UNORM		= 86,
+	DDS_FORMAT_B8G8R8A8_UNORM		= 87,
+	DDS_FORMAT_B8G8R8X8_UNORM		= 88,
+	DDS_FORMAT_BC7_UNORM			= 98,
+};
+
+// - DDSResult
+enum DDSResult
+{
+	DDS_OK = 0,
+	// === Not a DDS file, or its headers are cut short
+	DDS_INVALID_FILE,
+	// === The headers contradict themselves
+	DDS_INVALID_DATA,
+	// === A valid file this loader (or D3D11 hardware) can't use
+	DDS_NOT_SUPPORTED,
+	// === The pixel data ends before the last mip
+	DDS_TRUNCATED,
+};
+
+// - DDSTexture
+// --- What ParseDDS read from a file; bits points into the same memory the file was parsed from
+struct DDSTexture
+{
+	unsigned int			width;
+	unsigned int			height;
+	unsigned int			depth;
+	unsigned int			mipCount;
+	// === Six per cube for cube maps
+	unsigned int			arraySize;
+	unsigned int			format;
+	DDSDimension			dimension;
+	bool					cubeMap;
+	const unsigned char*	bits;
+	size_t					bitSize;
+};
+
+// - DDSSubresource
+// --- One mip of one array slice, laid out like D3D11_SUBRESOURCE_DATA
+struct DDSSubresource
+{
+	const void*		data;
+	unsigned int	rowPitch;
+	unsigned int	slicePitch;
+};
+
+// - DDSLayout
+// --- Size of the largest mip kept and how many larger ones LayoutDDS skipped
+struct DDSLayout
+{
+	unsigned int	width;
+	unsigned int	height;
+	unsigned int	depth;
+	unsigned int	skippedMips;
+	unsigned int	subresourceCount;
+};
+
+// ===== Parsing ===== //
+// - ParseDDS
+// --- Validates the headers of the DDS file in _data against themselves, _size and the D3D11 limits, without copying it
+DDSResult ParseDDS(const void* _data, size_t _size, DDSTexture* _texture);
+// - LayoutDDS
+// --- Points _subresources (mipCount * arraySize of them) straight at the pixel data of _texture, slice by slice
+// --- With _maxSize, mips larger than it are skipped when there is more than one
+DDSResult LayoutDDS(const DDSTexture& _texture, size_t _maxSize, DDSSubresource* _subresources, DDSLayout* _layout);
+// - GetDDSFormat
+// --- DXGI format of a legacy pixel format, DDS_FORMAT_UNKNOWN if there is none
+unsigned int GetDDSFormat(const DDSPixelFormat& _pixelFormat);
+// - GetDDSBitsPerPixel
+// --- 0 for formats the loader does not handle
+unsigned int GetDDSBitsPerPixel(unsigned int _format);
+// - GetDDSSurfaceInfo
+// --- Bytes of one _width x _height surface of _format, its row pitch and rows (block rows for BC formats)
+void GetDDSSurfaceInfo(size_t _width, size_t _height, unsigned int _format, size_t* _bytes, size_t* _rowBytes, size_t* _rows);
+// =================== //
+
+// ===== Writing ===== //
+// - WriteDDSHeaders
+// --- Magic and headers of a DDS file holding _texture, whose pixel data goes right after them: a single BC1 to BC3
+// --- texture or cube map gets the legacy header older tools read, anything else the DX10 one
+// --- Returns the bytes written to _header, at most DDS_MAX_HEADER_SIZE
+size_t WriteDDSHeaders(const DDSTexture& _texture, unsigned char* _header);
+// =================== //
+
+// ===== Checks ===== //
+// - CheckDDSHeader
+// --- Parses and lays out DDS files built in memory: legacy, DX10, cube, volume and array textures, mips skipped
+// --- by a max size, and every kind of broken header; logs every check that fails, returns false if any did
+bool CheckDDSHeader();
+
+// - BenchmarkDDSLoading
+// --- Loads each of _paths _repeats times the old way, the whole file read into a heap buffer, and through a file
+// --- mapping whose pages the subresources point into; both are parsed, laid out and have every subresource byte
+// --- read, as an upload would. Logs the time per texture and the peak private and resident growth of each path
+void BenchmarkDDSLoading(const char* const* _paths, unsigned int _pathCount, unsigned int _repeats);
+// ================== //
@@ -49,3 +49,11 @@ HRESULT CreateDDSTextureFromFile( _In_ ID3D11Device* d3dDevice,
                                   _Out_opt_ ID3D11ShaderResourceView** textureView,
                                   _In_ size_t maxsize = 0
                                 );
+
+// Maps the file instead of reading it into a heap buffer, the subresource data points straight into the mapping
+HRESULT CreateDDSTextureFromMappedFile( _In_ ID3D11Device* d3dDevice,
+                                        _In_z_ const char* fileName,
+                                        _Out_opt_ ID3D11Resource** texture,
+                                        _Out_opt_ ID3D11ShaderResourceView** textureView,
+                                        _In_ size_t maxsize = 0
+                                      );
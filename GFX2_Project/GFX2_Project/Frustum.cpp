@@ -0,0 +1,215 @@
+#include "Frustum.h"
+
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+#include "Profiling.h"
+
+#if defined(__AVX__)
+#define FRUSTUM_AVX
+#include <immintrin.h>
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+// ===== Local Helpers ===== //
+// === Spheres are stored in groups of this many, the widest batch Cull works on
+static const size_t CULL_BATCH = 8;
+
+static void NormalizePlane(float _plane[4])
+{
+	float length = std::sqrt(_plane[0] * _plane[0] + _plane[1] * _plane[1] + _plane[2] * _plane[2]);
+	if (length <= 0)
+		return;
+	for (int i = 0; i < 4; i++)
+		_plane[i] /= length;
+}
+
+// - EmitVisible
+// --- Appends the index of every set bit of _mask, lowest first
+static inline void EmitVisible(unsigned int _mask, unsigned int _first, vector<unsigned int>* _visible)
+{
+	for (unsigned int lane = 0; _mask != 0; lane++, _mask >>= 1)
+		if (_mask & 1)
+			_visible->push_back(_first + lane);
+}
+// ========================= //
+
+// ===== Frustum ===== //
+Frustum ExtractFrustum(const float _viewProjection[16])
+{
+	// === clip = position * M, so each clip coordinate is a dot product with a column of M
+	const float* m = _viewProjection;
+	Frustum frustum;
+	for (int i = 0; i < 4; i++) {
+		float x = m[i * 4 + 0], y = m[i * 4 + 1], z = m[i * 4 + 2], w = m[i * 4 + 3];
+		frustum.planes[0][i] = w + x;
+		frustum.planes[1][i] = w - x;
+		frustum.planes[2][i] = w + y;
+		frustum.planes[3][i] = w - y;
+		frustum.planes[4][i] = z;
+		frustum.planes[5][i] = w - z;
+	}
+	for (int p = 0; p < 6; p++)
+		NormalizePlane(frustum.planes[p]);
+	return frustum;
+}
+
+bool SphereInFrustum(const Frustum& _frustum, const float _center[3], float _radius)
+{
+	for (int p = 0; p < 6; p++) {
+		const float* plane = _frustum.planes[p];
+		if (plane[0] * _center[0] + plane[1] * _center[1] + plane[2] * _center[2] + plane[3] < -_radius)
+			return false;
+	}
+	return true;
+}
+// =================== //
+
+// ===== CullingSet ===== //
+CullingSet::CullingSet()
+{
+	m_iCount = 0;
+}
+
+void CullingSet::Clear()
+{
+	m_CenterX.clear();
+	m_CenterY.clear();
+	m_CenterZ.clear();
+	m_Radius.clear();
+	m_iCount = 0;
+}
+
+unsigned int CullingSet::Add(const float _center[3], float _radius)
+{
+	// === Grow by a whole batch of padding, a radius of -FLT_MAX fails every plane
+	if (m_iCount == m_Radius.size()) {
+		size_t size = m_iCount + CULL_BATCH;
+		m_CenterX.resize(size, 0);
+		m_CenterY.resize(size, 0);
+		m_CenterZ.resize(size, 0);
+		m_Radius.resize(size, -FLT_MAX);
+	}
+	unsigned int index = (unsigned int)m_iCount++;
+	Set(index, _center, _radius);
+	return index;
+}
+
+void CullingSet::Set(unsigned int _index, const float _center[3], float _radius)
+{
+	m_CenterX[_index] = _center[0];
+	m_CenterY[_index] = _center[1];
+	m_CenterZ[_index] = _center[2];
+	m_Radius[_index] = _radius;
+}
+
+void CullingSet::Get(unsigned int _index, float _center[3], float* _radius) const
+{
+	_center[0] = m_CenterX[_index];
+	_center[1] = m_CenterY[_index];
+	_center[2] = m_CenterZ[_index];
+	*_radius = m_Radius[_index];
+}
+
+void CullingSet::RemoveLast()
+{
+	if (m_iCount == 0)
+		return;
+	const float center[3] = { 0, 0, 0 };
+	Set((unsigned int)--m_iCount, center, -FLT_MAX);
+}
+
+void CullingSet::Cull(const Frustum& _frustum, vector<unsigned int>* _visible) const
+{
+	_visible->clear();
+	size_t paddedCount = m_Radius.size();
+	const float* centerX = m_CenterX.data();
+	const float* centerY = m_CenterY.data();
+	const float* centerZ = m_CenterZ.data();
+	const float* radius = m_Radius.data();
+
+#if defined(FRUSTUM_AVX)
+	// === 8 spheres per step, a sphere survives while its distance to every plane is >= -radius
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int i = 0; i < 4; i++)
+			planes[p][i] = _mm256_set1_ps(_frustum.planes[p][i]);
+	for (size_t i = 0; i < paddedCount; i += 8) {
+		__m256 x = _mm256_loadu_ps(centerX + i), y = _mm256_loadu_ps(centerY + i), z = _mm256_loadu_ps(centerZ + i);
+		__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, planes[p][0]), _mm256_mul_ps(y, planes[p][1])),
+											_mm256_add_ps(_mm256_mul_ps(z, planes[p][2]), planes[p][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+		EmitVisible((unsigned int)_mm256_movemask_ps(inside), (unsigned int)i, _visible);
+	}
+#elif defined(FRUSTUM_SSE)
+	// === 4 spheres per step
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int i = 0; i < 4; i++)
+			planes[p][i] = _mm_set1_ps(_frustum.planes[p][i]);
+	for (size_t i = 0; i < paddedCount; i += 4) {
+		__m128 x = _mm_loadu_ps(centerX + i), y = _mm_loadu_ps(centerY + i), z = _mm_loadu_ps(centerZ + i);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planes[p][0]), _mm_mul_ps(y, planes[p][1])),
+										 _mm_add_ps(_mm_mul_ps(z, planes[p][2]), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+		EmitVisible((unsigned int)_mm_movemask_ps(inside), (unsigned int)i, _visible);
+	}
+#else
+	for (size_t i = 0; i < paddedCount; i++) {
+		const float center[3] = { centerX[i], centerY[i], centerZ[i] };
+		if (SphereInFrustum(_frustum, center, radius[i]))
+			_visible->push_back((unsigned int)i);
+	}
+#endif
+}
+// ====================== //
+
+// ===== Benchmark ===== //
+double BenchmarkFrustumCulling(size_t _objectCount, unsigned int _iterations)
+{
+	// === 65 degree, 16:9 perspective looking down +z from the origin, the view is identity
+	const float nearZ = 0.1f, farZ = 1000.0f;
+	float yScale = 1.0f / std::tan(65.0f * 3.14159265f / 360.0f);
+	float xScale = yScale / (16.0f / 9.0f);
+	float range = farZ / (farZ - nearZ);
+	const float projection[16] = {
+		xScale, 0, 0, 0,
+		0, yScale, 0, 0,
+		0, 0, range, 1,
+		0, 0, -nearZ * range, 0
+	};
+	Frustum frustum = ExtractFrustum(projection);
+
+	// === Spheres spread all around the camera, so about a quarter of them are visible
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	CullingSet set;
+	for (size_t i = 0; i < _objectCount; i++) {
+		const float center[3] = { position(random), position(random) * 0.25f, position(random) };
+		set.Add(center, size(random));
+	}
+
+	vector<unsigned int> visible;
+	visible.reserve(_objectCount);
+	set.Cull(frustum, &visible);
+	Stopwatch stopwatch;
+	for (unsigned int i = 0; i < _iterations; i++)
+		set.Cull(frustum, &visible);
+	double nanoseconds = stopwatch.ElapsedMilliseconds() * 1000000.0 / ((double)_objectCount * (_iterations > 0 ? _iterations : 1));
+
+	LogMessage("Frustum culling: %u objects, %u visible, %.3f ns per object", (unsigned int)_objectCount, (unsigned int)visible.size(), nanoseconds);
+	return nanoseconds;
+}
+// ===================== //
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Bounds.h"
+
+using std::vector;
+
+// - Frustum
+// --- Six normalized planes (left, right, bottom, top, near, far), a x + b y + c z + d >= 0 on the inside
+struct Frustum
+{
+	float planes[6][4];
+};
+
+// ===== Frustum ===== //
+// - ExtractFrustum
+// --- Planes of a row-major (row vector) view * projection matrix, with D3D's [0, 1] clip depth
+Frustum ExtractFrustum(const float _viewProjection[16]);
+
+// - SphereInFrustum
+// --- Scalar test of a single sphere, conservative: a sphere just outside a corner still passes
+bool SphereInFrustum(const Frustum& _frustum, const float _center[3], float _radius);
+// =================== //
+
+// - CullingSet
+// --- Bounding spheres kept structure-of-arrays, so they can be culled 8 (AVX) or 4 (SSE) at a time
+// --- The arrays are padded to a multiple of 8 with spheres that never pass
+class CullingSet
+{
+private:
+	vector<float>	m_CenterX;
+	vector<float>	m_CenterY;
+	vector<float>	m_CenterZ;
+	vector<float>	m_Radius;
+	size_t			m_iCount;
+
+public:
+	// ===== Constructor
+	CullingSet();
+
+	// ===== Interface
+	void Clear();
+	// - Add
+	// --- Returns the index the sphere is reported under
+	unsigned int Add(const float _center[3], float _radius);
+	unsigned int Add(const Bounds& _bounds) { return Add(_bounds.center, _bounds.radius); }
+	void Set(unsigned int _index, const float _center[3], float _radius);
+	void Get(unsigned int _index, float _center[3], float* _radius) const;
+	// - RemoveLast
+	// --- Turns the last sphere back into padding
+	void RemoveLast();
+	// - Cull
+	// --- Fills _visible with the indexes of every sphere touching the frustum, in increasing order
+	void Cull(const Frustum& _frustum, vector<unsigned int>* _visible) const;
+
+	// ===== Accessors
+	size_t Size() const { return m_iCount; }
+};
+
+// - BenchmarkFrustumCulling
+// --- Culls _objectCount random spheres against one frustum _iterations times, returns nanoseconds per object
+// --- Needs no device, run through the -benchmark command line switch
+double BenchmarkFrustumCulling(size_t _objectCount, unsigned int _iterations);
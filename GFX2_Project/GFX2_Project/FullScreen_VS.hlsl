@@ -0,0 +1,17 @@
+// == Output to PS
+struct V_OUTPUT
+{
+	float4 posH : SV_POSITION;
+};
+
+// - main
+// --- One triangle covering the whole viewport, drawn with Draw(3, 0) and no vertex buffer
+V_OUTPUT main(uint _vertexID : SV_VertexID)
+{
+	V_OUTPUT output = (V_OUTPUT)0;
+
+	float2 uv = float2((_vertexID << 1) & 2, _vertexID & 2);
+	output.posH = float4(uv * float2(2, -2) + float2(-1, 1), 0, 1);
+
+	return output;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+// - HashBytes
+// --- 64-bit content hash, consumes 8 bytes per step so hashing a mapped file stays cheap
+// --- Not cryptographic, only meant to notice when a source file has changed
+inline unsigned long long HashBytes(const void* _data, size_t _size, unsigned long long _seed = 0xCBF29CE484222325ULL)
+{
+	const unsigned char* bytes = (const unsigned char*)_data;
+	unsigned long long hash = _seed ^ (_size * 0x9E3779B97F4A7C15ULL);
+
+	// === Whole 8 byte words
+	size_t words = _size / 8;
+	for (size_t i = 0; i < words; i++) {
+		unsigned long long word;
+		memcpy(&word, bytes + i * 8, 8);
+		hash = (hash ^ word) * 0x100000001B3ULL;
+		hash ^= hash >> 32;
+	}
+
+	// === Trailing bytes
+	for (size_t i = words * 8; i < _size; i++)
+		hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+
+	// === Final avalanche
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	return hash;
+}
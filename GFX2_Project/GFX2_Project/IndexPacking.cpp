@@ -0,0 +1,56 @@
+#include "IndexPacking.h"
+
+// ===== Index Packing ===== //
+bool BuildIndexRanges16(const unsigned int* _indexes, size_t _indexCount, size_t _vertexCount, vector<IndexRange>* _ranges)
+{
+	_ranges->clear();
+	if (_vertexCount <= 0x10000) {
+		IndexRange range = { 0, (unsigned int)_indexCount, 0 };
+		_ranges->push_back(range);
+		return true;
+	}
+
+	size_t first = 0;
+	unsigned int low = 0xFFFFFFFF, high = 0;
+	for (size_t i = 0; i + 2 < _indexCount; i += 3) {
+		unsigned int triangleLow = _indexes[i], triangleHigh = _indexes[i];
+		for (int corner = 1; corner < 3; corner++) {
+			if (_indexes[i + corner] < triangleLow) triangleLow = _indexes[i + corner];
+			if (_indexes[i + corner] > triangleHigh) triangleHigh = _indexes[i + corner];
+		}
+		if (triangleHigh - triangleLow > 0xFFFF) {
+			_ranges->clear();
+			return false;
+		}
+
+		// === Start a new range once this triangle would stretch the current one too far
+		unsigned int newLow = triangleLow < low ? triangleLow : low;
+		unsigned int newHigh = triangleHigh > high ? triangleHigh : high;
+		if (newHigh - newLow > 0xFFFF) {
+			IndexRange range = { (unsigned int)first, (unsigned int)(i - first), (int)low };
+			_ranges->push_back(range);
+			if (_ranges->size() >= MAX_16BIT_INDEX_RANGES) {
+				_ranges->clear();
+				return false;
+			}
+			first = i;
+			newLow = triangleLow;
+			newHigh = triangleHigh;
+		}
+		low = newLow;
+		high = newHigh;
+	}
+	IndexRange range = { (unsigned int)first, (unsigned int)(_indexCount - first), (int)(low == 0xFFFFFFFF ? 0 : low) };
+	_ranges->push_back(range);
+	return true;
+}
+
+void PackIndexes16(const unsigned int* _indexes, const vector<IndexRange>& _ranges, unsigned short* _packed)
+{
+	for (size_t r = 0; r < _ranges.size(); r++) {
+		const IndexRange& range = _ranges[r];
+		for (unsigned int i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+			_packed[i] = (unsigned short)(_indexes[i] - (unsigned int)range.baseVertex);
+	}
+}
+// ========================= //
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+using std::vector;
+
+// === Largest number of draw ranges a mesh is split into to use 16-bit indexes
+static const unsigned int MAX_16BIT_INDEX_RANGES = 4;
+
+// - IndexRange
+// --- A run of triangles drawn with its own base vertex, so its indexes fit in 16 bits
+struct IndexRange
+{
+	unsigned int	firstIndex;
+	unsigned int	indexCount;
+	int				baseVertex;
+};
+
+// ===== Index Packing ===== //
+// - BuildIndexRanges16
+// --- Meshes below 65536 vertices get a single range, slightly larger ones are cut wherever
+// --- a run of triangles would span more than 65536 vertices (vertex fetch order keeps those runs long)
+// --- Returns false, with _ranges empty, if it would take more than MAX_16BIT_INDEX_RANGES ranges
+bool BuildIndexRanges16(const unsigned int* _indexes, size_t _indexCount, size_t _vertexCount, vector<IndexRange>* _ranges);
+
+// - PackIndexes16
+// --- Writes the indexes relative to their range's base vertex
+void PackIndexes16(const unsigned int* _indexes, const vector<IndexRange>& _ranges, unsigned short* _packed);
+// ========================= //
@@ -0,0 +1,155 @@
+#include "InstanceBatcher.h"
+
+#include <cstring>
+#include <random>
+
+#include "Profiling.h"
+#include "Scene.h"
+
+// ===== Local Helpers ===== //
+// - SameState
+// --- Everything but the depth; within a run the queue order is kept, so the depth order is too
+static bool SameState(const SortKeyFields& _a, const SortKeyFields& _b)
+{
+	return _a.view == _b.view && _a.pass == _b.pass && _a.blend == _b.blend && _a.cull == _b.cull
+		&& _a.shader == _b.shader && _a.material == _b.material && _a.mesh == _b.mesh;
+}
+// ========================= //
+
+// ===== Constructor / Destructor ===== //
+InstanceBatcher::InstanceBatcher()
+{
+	m_iMinInstances = 2;
+}
+// ==================================== //
+
+// ===== Interface ===== //
+void InstanceBatcher::SetInstanced(unsigned int _meshID, bool _instanced)
+{
+	if (_meshID >= m_InstancedMeshes.size())
+		m_InstancedMeshes.resize(_meshID + 1, 0);
+	m_InstancedMeshes[_meshID] = _instanced ? 1 : 0;
+}
+
+void InstanceBatcher::Build(const RenderQueue& _queue, const Scene& _scene)
+{
+	Clear();
+	size_t size = _queue.Size();
+	size_t first = 0;
+	while (first < size) {
+		// === Find the end of the run
+		SortKeyFields fields = DecodeSortKey(_queue[first].key);
+		size_t end = first + 1;
+		while (end < size && SameState(fields, DecodeSortKey(_queue[end].key)))
+			end++;
+
+		InstanceBatch batch;
+		batch.first = (unsigned int)first;
+		batch.count = (unsigned int)(end - first);
+		batch.firstInstance = (unsigned int)m_Instances.size();
+		batch.instanced = batch.count >= m_iMinInstances && IsInstanced(fields.mesh);
+		if (batch.instanced) {
+			for (size_t i = first; i < end; i++) {
+				unsigned int index = _queue[i].payload;
+				InstanceData instance = { _scene.GetWorldMatrixAt(index), _scene.GetTintAt(index) };
+				m_Instances.push_back(instance);
+			}
+		}
+		m_Batches.push_back(batch);
+		first = end;
+	}
+}
+
+void InstanceBatcher::Clear()
+{
+	m_Batches.clear();
+	m_Instances.clear();
+}
+// ===================== //
+
+// ===== Accessors ===== //
+unsigned int InstanceBatcher::GetDrawCount() const
+{
+	unsigned int draws = 0;
+	for (size_t i = 0; i < m_Batches.size(); i++)
+		draws += m_Batches[i].instanced ? 1 : m_Batches[i].count;
+	return draws;
+}
+// ===================== //
+
+// ===== Benchmark ===== //
+bool BenchmarkInstancing(size_t _objectCount)
+{
+	// === 24 props with a material each: the first 16 use the instanced shader, the other 8 are packed meshes
+	// === that are not; a tenth of the objects are transparent and drawn twice, inside faces first
+	const unsigned int propCount = 24, instancedProps = 16;
+	std::mt19937 random(31);
+	std::uniform_int_distribution<unsigned int> prop(0, propCount - 1), percent(0, 99);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f), color(0.5f, 1.0f);
+	Bounds unitBounds = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f }, { 0, 0, 0 }, 0.8660254f };
+
+	Scene scene;
+	scene.Reserve(_objectCount);
+	vector<SortKeyFields> objects(_objectCount);
+	for (size_t i = 0; i < _objectCount; i++) {
+		EntityID entity = scene.CreateEntity(Mat4Translation(position(random), 0, position(random)), unitBounds, nullptr, ENTITY_DRAW);
+		scene.SetTint(entity, MakeVec4(color(random), color(random), color(random), 1));
+		unsigned int mesh = prop(random);
+		bool transparent = percent(random) < 10;
+		const Mat4& world = scene.GetWorldMatrixAt(i);
+		float distance = world.m[3][0] * world.m[3][0] + world.m[3][2] * world.m[3][2];
+		SortKeyFields fields = { 0, transparent ? PASS_TRANSPARENT : PASS_OPAQUE, transparent ? BLEND_ALPHA : BLEND_OPAQUE, CULL_BACK,
+			mesh < instancedProps ? 0u : 1u, mesh, mesh, DepthToKey(distance, transparent) };
+		objects[i] = fields;
+	}
+
+	InstanceBatcher batcher;
+	for (unsigned int mesh = 0; mesh < instancedProps; mesh++)
+		batcher.SetInstanced(mesh, true);
+	RenderQueue queue;
+	queue.Reserve(_objectCount * 2);
+	for (size_t i = 0; i < _objectCount; i++) {
+		SortKeyFields fields = objects[i];
+		if (fields.pass == PASS_TRANSPARENT) {
+			fields.cull = CULL_FRONT;
+			queue.Push(fields, (unsigned int)i);
+			fields.cull = CULL_BACK;
+		}
+		queue.Push(fields, (unsigned int)i);
+	}
+	queue.Sort();
+
+	Stopwatch stopwatch;
+	batcher.Build(queue, scene);
+	double buildTime = stopwatch.ElapsedMilliseconds();
+
+	// === Every queued draw exactly once and in order, instanced ones with their own transform and tint
+	const vector<InstanceBatch>& batches = batcher.GetBatches();
+	const vector<InstanceData>& instances = batcher.GetInstances();
+	bool match = true;
+	unsigned int next = 0, instancedBatches = 0, instanceCount = 0;
+	for (size_t i = 0; i < batches.size() && match; i++) {
+		const InstanceBatch& batch = batches[i];
+		match = batch.first == next && batch.count > 0;
+		next += batch.count;
+		if (!batch.instanced)
+			continue;
+		instancedBatches++;
+		match = match && batch.firstInstance == instanceCount;
+		for (unsigned int j = 0; j < batch.count && match; j++) {
+			unsigned int index = queue[batch.first + j].payload;
+			const InstanceData& instance = instances[batch.firstInstance + j];
+			match = memcmp(&instance.worldMatrix, &scene.GetWorldMatrixAt(index), sizeof(Mat4)) == 0
+				&& memcmp(&instance.tint, &scene.GetTintAt(index), sizeof(Vec4)) == 0;
+		}
+		instanceCount += batch.count;
+	}
+	match = match && next == queue.Size() && instanceCount == instances.size();
+
+	LogMessage("InstanceBatcher: %u objects, %u queued draws -> %u draw calls (%u instanced batches of %u instances, %u KB of instance data), built in %.3f ms",
+		(unsigned int)_objectCount, (unsigned int)queue.Size(), batcher.GetDrawCount(), instancedBatches, instanceCount,
+		(unsigned int)(instances.size() * sizeof(InstanceData) / 1024), buildTime);
+	LogMessage("InstanceBatcher: every draw batched once and in order, instance data %s", match ? "matches" : "DIFFERS");
+	return match;
+}
+// ===================== //
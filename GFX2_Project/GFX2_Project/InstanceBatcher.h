@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Math.h"
+#include "RenderQueue.h"
+
+using std::vector;
+
+class Scene;
+
+// - InstanceData
+// --- One element of the per-instance vertex buffer: the WORLD rows and TINT of ModelInstanced_VS
+struct InstanceData
+{
+	Mat4	worldMatrix;
+	Vec4	tint;
+};
+static_assert(sizeof(InstanceData) == 80, "InstanceData must match the five float4 elements of Layout_Vertex_Instanced");
+
+// - InstanceBatch
+// --- A run of queue items sharing every piece of state; an instanced batch is drawn once with its instances
+// --- from firstInstance on, any other batch one item at a time
+struct InstanceBatch
+{
+	unsigned int	first;
+	unsigned int	count;
+	unsigned int	firstInstance;
+	bool			instanced;
+};
+
+// - InstanceBatcher
+// --- Groups the draws of a sorted Render Queue by state, so repeated meshes with the same material become
+// --- one instanced draw; the queue already keeps equal shader, material and mesh next to each other
+// --- Only meshes marked with SetInstanced have an instanced input layout and shader
+class InstanceBatcher
+{
+private:
+	vector<unsigned char>	m_InstancedMeshes;
+	vector<InstanceBatch>	m_Batches;
+	vector<InstanceData>	m_Instances;
+	unsigned int			m_iMinInstances;
+
+public:
+	// ===== Constructor / Destructor
+	InstanceBatcher();
+
+	// ===== Interface
+	void SetInstanced(unsigned int _meshID, bool _instanced);
+	bool IsInstanced(unsigned int _meshID) const { return _meshID < m_InstancedMeshes.size() && m_InstancedMeshes[_meshID] != 0; }
+	// - SetMinInstances
+	// --- Shorter runs are not worth the instance upload and are drawn one by one, 2 by default
+	void SetMinInstances(unsigned int _count) { m_iMinInstances = _count > 1 ? _count : 1; }
+	// - Build
+	// --- Batches the sorted _queue, whose payloads are dense indexes into _scene, and gathers the instance data
+	// --- of the instanced batches in queue order
+	void Build(const RenderQueue& _queue, const Scene& _scene);
+	void Clear();
+
+	// ===== Accessors
+	const vector<InstanceBatch>& GetBatches() const { return m_Batches; }
+	const vector<InstanceData>& GetInstances() const { return m_Instances; }
+	// - GetDrawCount
+	// --- Draw calls the batches take, one per instanced batch and one per item of the others
+	unsigned int GetDrawCount() const;
+};
+
+// - BenchmarkInstancing
+// --- Fills a Scene with _objectCount copies of a few props, queues and batches them and logs the draw calls
+// --- before and after; checks that every queued draw is drawn exactly once, in order, with its own transform and
+// --- returns false if one was not
+bool BenchmarkInstancing(size_t _objectCount);
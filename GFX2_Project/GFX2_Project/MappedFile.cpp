@@ -0,0 +1,142 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ===== Constructor / Destructor ===== //
+MappedFile::MappedFile()
+{
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = nullptr;
+#else
+	m_iFile = -1;
+#endif
+	m_pData = nullptr;
+	m_iSize = 0;
+	m_bOpen = false;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+// ==================================== //
+
+// ===== Interface ===== //
+bool MappedFile::Open(const char* _path)
+{
+	Close();
+#ifdef _WIN32
+	m_hFile = CreateFileA(_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize)) {
+		Close();
+		return false;
+	}
+	// === A file bigger than the address space would be truncated to a size_t and mapped short
+	if ((unsigned long long)fileSize.QuadPart > (size_t)-1) {
+		Close();
+		return false;
+	}
+	m_iSize = (size_t)fileSize.QuadPart;
+
+	// === Empty files can't be mapped, but they are still valid files
+	if (m_iSize > 0) {
+		m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_hMapping == nullptr) {
+			Close();
+			return false;
+		}
+		m_pData = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (m_pData == nullptr) {
+			Close();
+			return false;
+		}
+	}
+#else
+	m_iFile = open(_path, O_RDONLY);
+	if (m_iFile < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(m_iFile, &fileStat) != 0) {
+		Close();
+		return false;
+	}
+	// === A file bigger than the address space would be truncated to a size_t and mapped short
+	if ((unsigned long long)fileStat.st_size > (size_t)-1) {
+		Close();
+		return false;
+	}
+	m_iSize = (size_t)fileStat.st_size;
+
+	// === Empty files can't be mapped, but they are still valid files
+	if (m_iSize > 0) {
+		void* data = mmap(nullptr, m_iSize, PROT_READ, MAP_PRIVATE, m_iFile, 0);
+		if (data == MAP_FAILED) {
+			Close();
+			return false;
+		}
+		madvise(data, m_iSize, MADV_SEQUENTIAL);
+		m_pData = (const char*)data;
+	}
+#endif
+	m_bOpen = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_pData != nullptr)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping != nullptr)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = nullptr;
+#else
+	if (m_pData != nullptr)
+		munmap((void*)m_pData, m_iSize);
+	if (m_iFile >= 0)
+		close(m_iFile);
+	m_iFile = -1;
+#endif
+	m_pData = nullptr;
+	m_iSize = 0;
+	m_bOpen = false;
+}
+// ===================== //
+
+// ===== File Cache ===== //
+bool DropFileCache(const char* _path)
+{
+#ifdef _WIN32
+	// === An unbuffered handle makes the cache manager purge the file, as long as it holds the only one
+	HANDLE file = CreateFileA(_path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	CloseHandle(file);
+	return true;
+#else
+	// === Dirty pages are never dropped, a freshly written file has to reach the disk first
+	int file = open(_path, O_RDONLY);
+	if (file < 0)
+		return false;
+	bool dropped = fdatasync(file) == 0 && posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(file);
+	return dropped;
+#endif
+}
+// ====================== //
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+// - MappedFile
+// --- Read-only view of a whole file, backed by the OS page cache
+// --- The data stays valid until Close() is called or the MappedFile is destroyed
+class MappedFile
+{
+private:
+#ifdef _WIN32
+	void*		m_hFile;
+	void*		m_hMapping;
+#else
+	int			m_iFile;
+#endif
+	const char*	m_pData;
+	size_t		m_iSize;
+	bool		m_bOpen;
+
+	// === Not copyable, the mapping has a single owner
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	// ===== Constructor / Destructor
+	MappedFile();
+	~MappedFile();
+
+	// ===== Interface
+	bool Open(const char* _path);
+	void Close();
+
+	// ===== Accessors
+	bool IsOpen() const { return m_bOpen; }
+	const char* GetData() const { return m_pData; }
+	const char* GetEnd() const { return m_pData + m_iSize; }
+	size_t GetSize() const { return m_iSize; }
+};
+
+// - DropFileCache
+// --- Asks the OS to forget the cached pages of the file at _path, so the next read comes from the disk, for cold
+// --- start measurements; only works while nothing else has the file open or mapped. False if the OS would not
+bool DropFileCache(const char* _path);
@@ -0,0 +1,569 @@
+#include "Math.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Profiling.h"
+
+// === AVX2 builds keep the SSE kernels for single matrices and leftovers
+#if defined(__AVX2__)
+#define MATH_AVX2
+#define MATH_SSE
+#include <immintrin.h>
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define MATH_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM) || defined(_M_ARM64)
+#define MATH_NEON
+#include <arm_neon.h>
+#endif
+
+using std::vector;
+
+// ===== Scalar Kernels ===== //
+static void MultiplyScalar(const Mat4& _a, const Mat4& _b, Mat4* _out)
+{
+	Mat4 result;
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			result.m[row][column] = _a.m[row][0] * _b.m[0][column] + _a.m[row][1] * _b.m[1][column] + _a.m[row][2] * _b.m[2][column] + _a.m[row][3] * _b.m[3][column];
+	*_out = result;
+}
+
+static void AffineInverseScalar(const Mat4& _m, Mat4* _out)
+{
+	// === The inverse of the 3x3 part has the cross products of its rows as columns, over the determinant
+	const Vec3 r0 = MakeVec3(_m.m[0][0], _m.m[0][1], _m.m[0][2]);
+	const Vec3 r1 = MakeVec3(_m.m[1][0], _m.m[1][1], _m.m[1][2]);
+	const Vec3 r2 = MakeVec3(_m.m[2][0], _m.m[2][1], _m.m[2][2]);
+	const Vec3 t = MakeVec3(_m.m[3][0], _m.m[3][1], _m.m[3][2]);
+	const Vec3 c[3] = { Cross(r1, r2), Cross(r2, r0), Cross(r0, r1) };
+	float determinant = Dot(r0, c[0]);
+
+	Mat4 result;
+	memset(&result, 0, sizeof(result));
+	if (determinant != 0) {
+		float inverse = 1.0f / determinant;
+		for (int row = 0; row < 3; row++) {
+			result.m[row][0] = (&c[0].x)[row] * inverse;
+			result.m[row][1] = (&c[1].x)[row] * inverse;
+			result.m[row][2] = (&c[2].x)[row] * inverse;
+		}
+		for (int column = 0; column < 3; column++)
+			result.m[3][column] = -(t.x * result.m[0][column] + t.y * result.m[1][column] + t.z * result.m[2][column]);
+		result.m[3][3] = 1;
+	}
+	*_out = result;
+}
+// ========================== //
+
+// ===== SIMD Kernels ===== //
+#if defined(MATH_SSE)
+static inline __m128 Broadcast(__m128 _v, int _lane)
+{
+	switch (_lane) {
+	case 0: return _mm_shuffle_ps(_v, _v, _MM_SHUFFLE(0, 0, 0, 0));
+	case 1: return _mm_shuffle_ps(_v, _v, _MM_SHUFFLE(1, 1, 1, 1));
+	case 2: return _mm_shuffle_ps(_v, _v, _MM_SHUFFLE(2, 2, 2, 2));
+	default: return _mm_shuffle_ps(_v, _v, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+}
+
+static inline __m128 CrossSSE(__m128 _a, __m128 _b)
+{
+	__m128 aYZX = _mm_shuffle_ps(_a, _a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 bYZX = _mm_shuffle_ps(_b, _b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 crossZXY = _mm_sub_ps(_mm_mul_ps(_a, bYZX), _mm_mul_ps(aYZX, _b));
+	return _mm_shuffle_ps(crossZXY, crossZXY, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static inline void MultiplySSE(const Mat4& _a, const Mat4& _b, Mat4* _out)
+{
+	// === Every input row is loaded before anything is stored, so _out may alias either input
+	__m128 b[4], a[4];
+	for (int i = 0; i < 4; i++) {
+		b[i] = _mm_loadu_ps(_b.m[i]);
+		a[i] = _mm_loadu_ps(_a.m[i]);
+	}
+	for (int i = 0; i < 4; i++) {
+		__m128 row = _mm_mul_ps(Broadcast(a[i], 0), b[0]);
+		row = _mm_add_ps(row, _mm_mul_ps(Broadcast(a[i], 1), b[1]));
+		row = _mm_add_ps(row, _mm_mul_ps(Broadcast(a[i], 2), b[2]));
+		row = _mm_add_ps(row, _mm_mul_ps(Broadcast(a[i], 3), b[3]));
+		_mm_storeu_ps(_out->m[i], row);
+	}
+}
+
+static inline void AffineInverseSSE(const Mat4& _m, Mat4* _out)
+{
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	__m128 r0 = _mm_and_ps(_mm_loadu_ps(_m.m[0]), xyzMask);
+	__m128 r1 = _mm_and_ps(_mm_loadu_ps(_m.m[1]), xyzMask);
+	__m128 r2 = _mm_and_ps(_mm_loadu_ps(_m.m[2]), xyzMask);
+	__m128 t = _mm_loadu_ps(_m.m[3]);
+
+	__m128 c0 = CrossSSE(r1, r2), c1 = CrossSSE(r2, r0), c2 = CrossSSE(r0, r1), c3 = _mm_setzero_ps();
+	__m128 products = _mm_mul_ps(r0, c0);
+	float determinant = _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(products, Broadcast(products, 1)), Broadcast(products, 2)));
+	if (determinant == 0) {
+		memset(_out, 0, sizeof(*_out));
+		return;
+	}
+
+	// === Cross products are the columns of the inverse, the w lanes stay 0
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	__m128 inverse = _mm_set1_ps(1.0f / determinant);
+	c0 = _mm_mul_ps(c0, inverse);
+	c1 = _mm_mul_ps(c1, inverse);
+	c2 = _mm_mul_ps(c2, inverse);
+	__m128 translation = _mm_mul_ps(Broadcast(t, 0), c0);
+	translation = _mm_add_ps(translation, _mm_mul_ps(Broadcast(t, 1), c1));
+	translation = _mm_add_ps(translation, _mm_mul_ps(Broadcast(t, 2), c2));
+	translation = _mm_sub_ps(_mm_setr_ps(0, 0, 0, 1), translation);
+
+	_mm_storeu_ps(_out->m[0], c0);
+	_mm_storeu_ps(_out->m[1], c1);
+	_mm_storeu_ps(_out->m[2], c2);
+	_mm_storeu_ps(_out->m[3], translation);
+}
+
+// - TransformFourSSE
+// --- 4 packed Vec3 (12 floats in 3 registers) -> x / y / z registers, transformed, and packed back
+static inline void TransformFourSSE(const __m128 _rows[4][3], const float* _in, float* _out)
+{
+	__m128 a = _mm_loadu_ps(_in), b = _mm_loadu_ps(_in + 4), c = _mm_loadu_ps(_in + 8);
+	// == a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+	__m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+	__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+	__m128 result[3];
+	for (int axis = 0; axis < 3; axis++)
+		result[axis] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _rows[0][axis]), _mm_mul_ps(y, _rows[1][axis])), _mm_mul_ps(z, _rows[2][axis])), _rows[3][axis]);
+	x = result[0];
+	y = result[1];
+	z = result[2];
+
+	a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+	c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	_mm_storeu_ps(_out, a);
+	_mm_storeu_ps(_out + 4, b);
+	_mm_storeu_ps(_out + 8, c);
+}
+#endif
+
+#if defined(MATH_AVX2)
+static inline __m256 LoadHalves(const float* _low, const float* _high)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(_low)), _mm_loadu_ps(_high), 1);
+}
+
+static inline void StoreHalves(float* _low, float* _high, __m256 _v)
+{
+	_mm_storeu_ps(_low, _mm256_castps256_ps128(_v));
+	_mm_storeu_ps(_high, _mm256_extractf128_ps(_v, 1));
+}
+
+// - MultiplyTwoRowsAVX
+// --- Rows (i, i + 1) of _a at once, each 128-bit half works on one row against the duplicated rows of _b
+static inline __m256 MultiplyTwoRowsAVX(__m256 _a, const __m256 _b[4])
+{
+	__m256 row = _mm256_mul_ps(_mm256_permute_ps(_a, _MM_SHUFFLE(0, 0, 0, 0)), _b[0]);
+	row = _mm256_add_ps(row, _mm256_mul_ps(_mm256_permute_ps(_a, _MM_SHUFFLE(1, 1, 1, 1)), _b[1]));
+	row = _mm256_add_ps(row, _mm256_mul_ps(_mm256_permute_ps(_a, _MM_SHUFFLE(2, 2, 2, 2)), _b[2]));
+	row = _mm256_add_ps(row, _mm256_mul_ps(_mm256_permute_ps(_a, _MM_SHUFFLE(3, 3, 3, 3)), _b[3]));
+	return row;
+}
+
+// - TransformEightAVX
+// --- Same shuffles as TransformFourSSE, the low half of every register holds points 0 - 3, the high half 4 - 7
+static inline void TransformEightAVX(const __m256 _rows[4][3], const float* _in, float* _out)
+{
+	__m256 a = LoadHalves(_in, _in + 12), b = LoadHalves(_in + 4, _in + 16), c = LoadHalves(_in + 8, _in + 20);
+	__m256 x = _mm256_shuffle_ps(a, _mm256_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+	__m256 y = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m256 z = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+	__m256 result[3];
+	for (int axis = 0; axis < 3; axis++)
+		result[axis] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _rows[0][axis]), _mm256_mul_ps(y, _rows[1][axis])), _mm256_mul_ps(z, _rows[2][axis])), _rows[3][axis]);
+	x = result[0];
+	y = result[1];
+	z = result[2];
+
+	a = _mm256_shuffle_ps(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	b = _mm256_shuffle_ps(_mm256_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+	c = _mm256_shuffle_ps(_mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	StoreHalves(_out, _out + 12, a);
+	StoreHalves(_out + 4, _out + 16, b);
+	StoreHalves(_out + 8, _out + 20, c);
+}
+#endif
+
+#if defined(MATH_NEON)
+static inline void MultiplyNEON(const Mat4& _a, const Mat4& _b, Mat4* _out)
+{
+	float32x4_t b[4], a[4];
+	for (int i = 0; i < 4; i++) {
+		b[i] = vld1q_f32(_b.m[i]);
+		a[i] = vld1q_f32(_a.m[i]);
+	}
+	for (int i = 0; i < 4; i++) {
+		float32x4_t row = vmulq_n_f32(b[0], vgetq_lane_f32(a[i], 0));
+		row = vmlaq_n_f32(row, b[1], vgetq_lane_f32(a[i], 1));
+		row = vmlaq_n_f32(row, b[2], vgetq_lane_f32(a[i], 2));
+		row = vmlaq_n_f32(row, b[3], vgetq_lane_f32(a[i], 3));
+		vst1q_f32(_out->m[i], row);
+	}
+}
+#endif
+// ======================== //
+
+// ===== Quaternions ===== //
+Quat QuatFromAxisAngle(const Vec3& _axis, float _radians)
+{
+	Vec3 axis = Normalize(_axis);
+	float sine = std::sin(_radians * 0.5f);
+	Quat q = { axis.x * sine, axis.y * sine, axis.z * sine, std::cos(_radians * 0.5f) };
+	return q;
+}
+
+Quat QuatFromRollPitchYaw(float _pitch, float _yaw, float _roll)
+{
+	Quat roll = QuatFromAxisAngle(MakeVec3(0, 0, 1), _roll);
+	Quat pitch = QuatFromAxisAngle(MakeVec3(1, 0, 0), _pitch);
+	Quat yaw = QuatFromAxisAngle(MakeVec3(0, 1, 0), _yaw);
+	return QuatMultiply(QuatMultiply(roll, pitch), yaw);
+}
+
+Quat QuatMultiply(const Quat& _a, const Quat& _b)
+{
+	// === Hamilton product _b * _a, so _a is applied first
+	Quat q;
+	q.x = _b.w * _a.x + _b.x * _a.w + _b.y * _a.z - _b.z * _a.y;
+	q.y = _b.w * _a.y - _b.x * _a.z + _b.y * _a.w + _b.z * _a.x;
+	q.z = _b.w * _a.z + _b.x * _a.y - _b.y * _a.x + _b.z * _a.w;
+	q.w = _b.w * _a.w - _b.x * _a.x - _b.y * _a.y - _b.z * _a.z;
+	return q;
+}
+
+Quat QuatNormalize(const Quat& _q)
+{
+	float length = std::sqrt(_q.x * _q.x + _q.y * _q.y + _q.z * _q.z + _q.w * _q.w);
+	if (length <= 0)
+		return QuatIdentity();
+	Quat q = { _q.x / length, _q.y / length, _q.z / length, _q.w / length };
+	return q;
+}
+
+Vec3 QuatRotate(const Vec3& _v, const Quat& _q)
+{
+	// === v + 2 u x (u x v + w v), u being the vector part
+	Vec3 u = MakeVec3(_q.x, _q.y, _q.z);
+	Vec3 t = Add(Cross(u, _v), Scale(_v, _q.w));
+	return Add(_v, Scale(Cross(u, t), 2));
+}
+// ======================= //
+
+// ===== Matrices ===== //
+Mat4 Mat4Identity()
+{
+	return Mat4Scaling(1, 1, 1);
+}
+
+Mat4 Mat4Translation(float _x, float _y, float _z)
+{
+	Mat4 m = Mat4Identity();
+	m.m[3][0] = _x;
+	m.m[3][1] = _y;
+	m.m[3][2] = _z;
+	return m;
+}
+
+Mat4 Mat4Scaling(float _x, float _y, float _z)
+{
+	Mat4 m;
+	memset(&m, 0, sizeof(m));
+	m.m[0][0] = _x;
+	m.m[1][1] = _y;
+	m.m[2][2] = _z;
+	m.m[3][3] = 1;
+	return m;
+}
+
+Mat4 Mat4FromQuat(const Quat& _q)
+{
+	float xx = _q.x * _q.x, yy = _q.y * _q.y, zz = _q.z * _q.z;
+	float xy = _q.x * _q.y, xz = _q.x * _q.z, yz = _q.y * _q.z;
+	float wx = _q.w * _q.x, wy = _q.w * _q.y, wz = _q.w * _q.z;
+	Mat4 m = {{
+		{ 1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0 },
+		{ 2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0 },
+		{ 2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0 },
+		{ 0, 0, 0, 1 }
+	}};
+	return m;
+}
+
+Mat4 Mat4FromTransform(const Vec3& _scale, const Quat& _rotation, const Vec3& _translation)
+{
+	Mat4 m = Mat4FromQuat(_rotation);
+	const float scale[3] = { _scale.x, _scale.y, _scale.z };
+	for (int row = 0; row < 3; row++)
+		for (int column = 0; column < 3; column++)
+			m.m[row][column] *= scale[row];
+	m.m[3][0] = _translation.x;
+	m.m[3][1] = _translation.y;
+	m.m[3][2] = _translation.z;
+	return m;
+}
+
+Mat4 Mat4Transpose(const Mat4& _m)
+{
+	Mat4 m;
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			m.m[row][column] = _m.m[column][row];
+	return m;
+}
+
+Mat4 Mat4Multiply(const Mat4& _a, const Mat4& _b)
+{
+	Mat4 m;
+	MultiplyMatrices(&_a, &_b, &m, 1);
+	return m;
+}
+
+Mat4 Mat4AffineInverse(const Mat4& _m)
+{
+	Mat4 m;
+	AffineInverseMatrices(&_m, &m, 1);
+	return m;
+}
+
+Mat4 Mat4RigidInverse(const Mat4& _m)
+{
+	Mat4 m;
+	memset(&m, 0, sizeof(m));
+	for (int row = 0; row < 3; row++)
+		for (int column = 0; column < 3; column++)
+			m.m[row][column] = _m.m[column][row];
+	for (int column = 0; column < 3; column++)
+		m.m[3][column] = -(_m.m[3][0] * m.m[0][column] + _m.m[3][1] * m.m[1][column] + _m.m[3][2] * m.m[2][column]);
+	m.m[3][3] = 1;
+	return m;
+}
+
+Vec3 TransformPoint(const Vec3& _point, const Mat4& _m)
+{
+	return MakeVec3(_point.x * _m.m[0][0] + _point.y * _m.m[1][0] + _point.z * _m.m[2][0] + _m.m[3][0],
+					_point.x * _m.m[0][1] + _point.y * _m.m[1][1] + _point.z * _m.m[2][1] + _m.m[3][1],
+					_point.x * _m.m[0][2] + _point.y * _m.m[1][2] + _point.z * _m.m[2][2] + _m.m[3][2]);
+}
+
+Vec3 TransformVector(const Vec3& _vector, const Mat4& _m)
+{
+	return MakeVec3(_vector.x * _m.m[0][0] + _vector.y * _m.m[1][0] + _vector.z * _m.m[2][0],
+					_vector.x * _m.m[0][1] + _vector.y * _m.m[1][1] + _vector.z * _m.m[2][1],
+					_vector.x * _m.m[0][2] + _vector.y * _m.m[1][2] + _vector.z * _m.m[2][2]);
+}
+
+Vec4 Transform(const Vec4& _v, const Mat4& _m)
+{
+	Vec4 result;
+	float* out = &result.x;
+	for (int column = 0; column < 4; column++)
+		out[column] = _v.x * _m.m[0][column] + _v.y * _m.m[1][column] + _v.z * _m.m[2][column] + _v.w * _m.m[3][column];
+	return result;
+}
+// ==================== //
+
+// ===== Batch Operations ===== //
+void TransformPoints(const Mat4& _m, const Vec3* _points, Vec3* _out, size_t _count)
+{
+	size_t i = 0;
+#if defined(MATH_SSE) || defined(MATH_NEON)
+	const float* in = &_points[0].x;
+	float* out = &_out[0].x;
+#endif
+#if defined(MATH_AVX2)
+	__m256 wideRows[4][3];
+	for (int row = 0; row < 4; row++)
+		for (int axis = 0; axis < 3; axis++)
+			wideRows[row][axis] = _mm256_set1_ps(_m.m[row][axis]);
+	for (; i + 8 <= _count; i += 8)
+		TransformEightAVX(wideRows, in + i * 3, out + i * 3);
+#endif
+#if defined(MATH_SSE)
+	__m128 rows[4][3];
+	for (int row = 0; row < 4; row++)
+		for (int axis = 0; axis < 3; axis++)
+			rows[row][axis] = _mm_set1_ps(_m.m[row][axis]);
+	for (; i + 4 <= _count; i += 4)
+		TransformFourSSE(rows, in + i * 3, out + i * 3);
+#elif defined(MATH_NEON)
+	// === vld3q / vst3q split and join x / y / z for free
+	for (; i + 4 <= _count; i += 4) {
+		float32x4x3_t points = vld3q_f32(in + i * 3);
+		float32x4x3_t result;
+		for (int axis = 0; axis < 3; axis++) {
+			float32x4_t value = vdupq_n_f32(_m.m[3][axis]);
+			value = vmlaq_n_f32(value, points.val[0], _m.m[0][axis]);
+			value = vmlaq_n_f32(value, points.val[1], _m.m[1][axis]);
+			value = vmlaq_n_f32(value, points.val[2], _m.m[2][axis]);
+			result.val[axis] = value;
+		}
+		vst3q_f32(out + i * 3, result);
+	}
+#endif
+	for (; i < _count; i++)
+		_out[i] = TransformPoint(_points[i], _m);
+}
+
+void TransformPointsScalar(const Mat4& _m, const Vec3* _points, Vec3* _out, size_t _count)
+{
+	for (size_t i = 0; i < _count; i++)
+		_out[i] = TransformPoint(_points[i], _m);
+}
+
+void MultiplyMatrices(const Mat4* _a, const Mat4* _b, Mat4* _out, size_t _count)
+{
+	size_t i = 0;
+#if defined(MATH_AVX2)
+	for (; i < _count; i++) {
+		__m256 b[4];
+		for (int row = 0; row < 4; row++)
+			b[row] = LoadHalves(_b[i].m[row], _b[i].m[row]);
+		__m256 rows01 = _mm256_loadu_ps(_a[i].m[0]), rows23 = _mm256_loadu_ps(_a[i].m[2]);
+		rows01 = MultiplyTwoRowsAVX(rows01, b);
+		rows23 = MultiplyTwoRowsAVX(rows23, b);
+		_mm256_storeu_ps(_out[i].m[0], rows01);
+		_mm256_storeu_ps(_out[i].m[2], rows23);
+	}
+#elif defined(MATH_SSE)
+	for (; i < _count; i++)
+		MultiplySSE(_a[i], _b[i], &_out[i]);
+#elif defined(MATH_NEON)
+	for (; i < _count; i++)
+		MultiplyNEON(_a[i], _b[i], &_out[i]);
+#endif
+	for (; i < _count; i++)
+		MultiplyScalar(_a[i], _b[i], &_out[i]);
+}
+
+void MultiplyMatricesScalar(const Mat4* _a, const Mat4* _b, Mat4* _out, size_t _count)
+{
+	for (size_t i = 0; i < _count; i++)
+		MultiplyScalar(_a[i], _b[i], &_out[i]);
+}
+
+void AffineInverseMatrices(const Mat4* _m, Mat4* _out, size_t _count)
+{
+	// === NEON has no cheap lane rotation for the cross products on ARMv7, it keeps the scalar kernel
+	size_t i = 0;
+#if defined(MATH_SSE)
+	for (; i < _count; i++)
+		AffineInverseSSE(_m[i], &_out[i]);
+#endif
+	for (; i < _count; i++)
+		AffineInverseScalar(_m[i], &_out[i]);
+}
+
+void AffineInverseMatricesScalar(const Mat4* _m, Mat4* _out, size_t _count)
+{
+	for (size_t i = 0; i < _count; i++)
+		AffineInverseScalar(_m[i], &_out[i]);
+}
+
+const char* GetMathKernelName()
+{
+#if defined(MATH_AVX2)
+	return "AVX2";
+#elif defined(MATH_SSE)
+	return "SSE";
+#elif defined(MATH_NEON)
+	return "NEON";
+#else
+	return "Scalar";
+#endif
+}
+// ============================ //
+
+// ===== Benchmark ===== //
+static float LargestDifference(const float* _a, const float* _b, size_t _count)
+{
+	// === Relative to the magnitude, so large translations do not hide small errors
+	float largest = 0;
+	for (size_t i = 0; i < _count; i++) {
+		float magnitude = std::fabs(_a[i]) > 1 ? std::fabs(_a[i]) : 1;
+		float difference = std::fabs(_a[i] - _b[i]) / magnitude;
+		if (!(difference <= largest))
+			largest = difference;
+	}
+	return largest;
+}
+
+bool BenchmarkMath(size_t _count)
+{
+	// === Random scale / rotate / translate matrices, the kind the scene is made of
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> scale(0.25f, 4.0f);
+	vector<Mat4> a(_count), b(_count), simd(_count), scalar(_count);
+	vector<Vec3> points(_count), simdPoints(_count), scalarPoints(_count);
+	for (size_t i = 0; i < _count; i++) {
+		Quat rotation = QuatNormalize(QuatFromAxisAngle(MakeVec3(unit(random), unit(random), unit(random) + 2), unit(random) * 3.14159265f));
+		a[i] = Mat4FromTransform(MakeVec3(scale(random), scale(random), scale(random)), rotation, MakeVec3(unit(random) * 100, unit(random) * 100, unit(random) * 100));
+		b[i] = Mat4FromTransform(MakeVec3(1, 1, 1), QuatConjugate(rotation), MakeVec3(unit(random), unit(random), unit(random)));
+		points[i] = MakeVec3(unit(random) * 50, unit(random) * 50, unit(random) * 50);
+	}
+	const float tolerance = 1e-5f;
+	bool passed = true;
+	double perElement = 1000000.0 / (double)(_count > 0 ? _count : 1);
+
+	// === TransformPoints
+	Stopwatch stopwatch;
+	TransformPoints(a[0], points.data(), simdPoints.data(), _count);
+	double simdTime = stopwatch.ElapsedMilliseconds() * perElement;
+	stopwatch.Restart();
+	TransformPointsScalar(a[0], points.data(), scalarPoints.data(), _count);
+	double scalarTime = stopwatch.ElapsedMilliseconds() * perElement;
+	float difference = LargestDifference(&simdPoints[0].x, &scalarPoints[0].x, _count * 3);
+	passed &= difference <= tolerance;
+	LogMessage("Math (%s): TransformPoints %.2f ns, scalar %.2f ns, largest difference %g", GetMathKernelName(), simdTime, scalarTime, difference);
+
+	// === MultiplyMatrices
+	stopwatch.Restart();
+	MultiplyMatrices(a.data(), b.data(), simd.data(), _count);
+	simdTime = stopwatch.ElapsedMilliseconds() * perElement;
+	stopwatch.Restart();
+	MultiplyMatricesScalar(a.data(), b.data(), scalar.data(), _count);
+	scalarTime = stopwatch.ElapsedMilliseconds() * perElement;
+	difference = LargestDifference(&simd[0].m[0][0], &scalar[0].m[0][0], _count * 16);
+	passed &= difference <= tolerance;
+	LogMessage("Math (%s): MultiplyMatrices %.2f ns, scalar %.2f ns, largest difference %g", GetMathKernelName(), simdTime, scalarTime, difference);
+
+	// === AffineInverseMatrices, also checked against the identity
+	stopwatch.Restart();
+	AffineInverseMatrices(a.data(), simd.data(), _count);
+	simdTime = stopwatch.ElapsedMilliseconds() * perElement;
+	stopwatch.Restart();
+	AffineInverseMatricesScalar(a.data(), scalar.data(), _count);
+	scalarTime = stopwatch.ElapsedMilliseconds() * perElement;
+	difference = LargestDifference(&simd[0].m[0][0], &scalar[0].m[0][0], _count * 16);
+	float identityError = 0;
+	for (size_t i = 0; i < _count; i++) {
+		Mat4 product = Mat4Multiply(a[i], simd[i]);
+		Mat4 identity = Mat4Identity();
+		float error = LargestDifference(&product.m[0][0], &identity.m[0][0], 16);
+		if (error > identityError)
+			identityError = error;
+	}
+	passed &= difference <= tolerance && identityError <= 1e-3f;
+	LogMessage("Math (%s): AffineInverseMatrices %.2f ns, scalar %.2f ns, largest difference %g, M * inverse(M) off identity by %g",
+		GetMathKernelName(), simdTime, scalarTime, difference, identityError);
+	return passed;
+}
+// ===================== //
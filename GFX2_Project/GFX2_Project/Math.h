@@ -1,17 +1,108 @@
 #pragma once
 
-#include <DirectXMath.h>
+#include <cmath>
+#include <cstddef>
 
-using namespace DirectX;
+// - Math
+// --- Portable CPU math, no DirectXMath, so simulation and culling code can run anywhere
+// --- Same conventions as the shaders: row vectors, row-major matrices, point * matrix,
+// --- translation in the last row; Mat4 has the memory layout of an XMFLOAT4X4
+// --- The batch functions pick AVX2, SSE (x86 / x64), NEON or scalar code when compiled,
+// --- the *Scalar versions are the reference they are checked against
 
-#define MatrixToXMMatrix(Matrix) { XMMatrix(Matrix.VectorData[0].x, Matrix.VectorData[0].y, Matrix.VectorData[0].z, Matrix.VectorData[0].w), Matrix.VectorData[1].x, Matrix.VectorData[1].y, Matrix.VectorData[1].z, Matrix.VectorData[1].w, Matrix.VectorData[2].x, Matrix.VectorData[2].y, Matrix.VectorData[2].z, Matrix.VectorData[2].w, Matrix.VectorData[3].x, Matrix.VectorData[3].y, Matrix.VectorData[3].z, Matrix.VectorData[3].w }
+struct Vec3
+{
+	float x, y, z;
+};
+
+struct Vec4
+{
+	float x, y, z, w;
+};
 
-struct Vector
+// - Quat
+// --- Unit quaternion, QuatMultiply(a, b) rotates by a and then by b (like XMQuaternionMultiply)
+struct Quat
 {
 	float x, y, z, w;
 };
 
-struct Matrix
+struct Mat4
 {
-	Vector VectorData[4];
-};
\ No newline at end of file
+	float m[4][4];
+};
+
+// ===== Vectors ===== //
+inline Vec3 MakeVec3(float _x, float _y, float _z) { Vec3 v = { _x, _y, _z }; return v; }
+inline Vec4 MakeVec4(float _x, float _y, float _z, float _w) { Vec4 v = { _x, _y, _z, _w }; return v; }
+inline Vec3 Add(const Vec3& _a, const Vec3& _b) { return MakeVec3(_a.x + _b.x, _a.y + _b.y, _a.z + _b.z); }
+inline Vec3 Subtract(const Vec3& _a, const Vec3& _b) { return MakeVec3(_a.x - _b.x, _a.y - _b.y, _a.z - _b.z); }
+inline Vec3 Scale(const Vec3& _v, float _s) { return MakeVec3(_v.x * _s, _v.y * _s, _v.z * _s); }
+inline float Dot(const Vec3& _a, const Vec3& _b) { return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z; }
+inline float Dot(const Vec4& _a, const Vec4& _b) { return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z + _a.w * _b.w; }
+inline Vec3 Cross(const Vec3& _a, const Vec3& _b) { return MakeVec3(_a.y * _b.z - _a.z * _b.y, _a.z * _b.x - _a.x * _b.z, _a.x * _b.y - _a.y * _b.x); }
+inline float Length(const Vec3& _v) { return std::sqrt(Dot(_v, _v)); }
+// - Normalize
+// --- A zero vector stays zero
+inline Vec3 Normalize(const Vec3& _v) { float length = Length(_v); return length > 0 ? Scale(_v, 1.0f / length) : _v; }
+// =================== //
+
+// ===== Quaternions ===== //
+inline Quat QuatIdentity() { Quat q = { 0, 0, 0, 1 }; return q; }
+Quat QuatFromAxisAngle(const Vec3& _axis, float _radians);
+// - QuatFromRollPitchYaw
+// --- Roll around z, then pitch around x, then yaw around y (like XMQuaternionRotationRollPitchYaw)
+Quat QuatFromRollPitchYaw(float _pitch, float _yaw, float _roll);
+Quat QuatMultiply(const Quat& _a, const Quat& _b);
+Quat QuatNormalize(const Quat& _q);
+inline Quat QuatConjugate(const Quat& _q) { Quat q = { -_q.x, -_q.y, -_q.z, _q.w }; return q; }
+Vec3 QuatRotate(const Vec3& _v, const Quat& _q);
+// ======================= //
+
+// ===== Matrices ===== //
+Mat4 Mat4Identity();
+Mat4 Mat4Translation(float _x, float _y, float _z);
+Mat4 Mat4Scaling(float _x, float _y, float _z);
+Mat4 Mat4FromQuat(const Quat& _q);
+// - Mat4FromTransform
+// --- Scale, then rotate, then translate
+Mat4 Mat4FromTransform(const Vec3& _scale, const Quat& _rotation, const Vec3& _translation);
+Mat4 Mat4Transpose(const Mat4& _m);
+Mat4 Mat4Multiply(const Mat4& _a, const Mat4& _b);
+// - Mat4AffineInverse
+// --- Inverse of a matrix whose last column is (0, 0, 0, 1), through the 3x3 adjugate, far cheaper than a general inverse
+// --- A singular 3x3 part gives a zero matrix
+Mat4 Mat4AffineInverse(const Mat4& _m);
+// - Mat4RigidInverse
+// --- Inverse of rotation + translation only: the transposed rotation, no division at all
+Mat4 Mat4RigidInverse(const Mat4& _m);
+Vec3 TransformPoint(const Vec3& _point, const Mat4& _m);
+Vec3 TransformVector(const Vec3& _vector, const Mat4& _m);
+Vec4 Transform(const Vec4& _v, const Mat4& _m);
+// ==================== //
+
+// ===== Batch Operations ===== //
+// - TransformPoints
+// --- _out[i] = _points[i] * _m with w = 1, _out may be _points
+void TransformPoints(const Mat4& _m, const Vec3* _points, Vec3* _out, size_t _count);
+void TransformPointsScalar(const Mat4& _m, const Vec3* _points, Vec3* _out, size_t _count);
+
+// - MultiplyMatrices
+// --- _out[i] = _a[i] * _b[i], _out may be either input
+void MultiplyMatrices(const Mat4* _a, const Mat4* _b, Mat4* _out, size_t _count);
+void MultiplyMatricesScalar(const Mat4* _a, const Mat4* _b, Mat4* _out, size_t _count);
+
+// - AffineInverseMatrices
+// --- _out[i] = Mat4AffineInverse(_m[i]), _out may be _m
+void AffineInverseMatrices(const Mat4* _m, Mat4* _out, size_t _count);
+void AffineInverseMatricesScalar(const Mat4* _m, Mat4* _out, size_t _count);
+
+// - GetMathKernelName
+// --- "AVX2", "SSE", "NEON" or "Scalar", whichever the batch functions were compiled with
+const char* GetMathKernelName();
+
+// - BenchmarkMath
+// --- Runs every batch operation over _count random elements, logs ns per element for the SIMD and scalar
+// --- kernels and the largest difference between them; returns false if a difference is beyond rounding
+bool BenchmarkMath(size_t _count);
+// ============================ //
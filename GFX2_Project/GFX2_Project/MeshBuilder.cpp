@@ -0,0 +1,92 @@
+#include "MeshBuilder.h"
+
+#include <cstddef>
+
+#include "Bounds.h"
+
+// ===== Weld Table ===== //
+static const unsigned int EMPTY_SLOT = 0xFFFFFFFF;
+
+static inline unsigned int HashCorner(const ObjFaceCorner& _corner)
+{
+	// === Mix all three indexes so neighbouring triples land far apart
+	unsigned long long hash = _corner.position * 0x9E3779B97F4A7C15ULL;
+	hash ^= (_corner.uv + 0x632BE59BD9B4E019ULL) * 0xC2B2AE3D27D4EB4FULL;
+	hash ^= (_corner.normal + 0x85EBCA77C2B2AE63ULL) * 0x165667B19E3779F9ULL;
+	hash ^= hash >> 29;
+	return (unsigned int)(hash ^ (hash >> 32));
+}
+
+static inline bool SameCorner(const ObjFaceCorner& _a, const ObjFaceCorner& _b)
+{
+	return _a.position == _b.position && _a.uv == _b.uv && _a.normal == _b.normal;
+}
+
+WeldTable::WeldTable()
+{
+	m_iMask = 0;
+}
+
+void WeldTable::Reset(size_t _maxEntries)
+{
+	// === Keep the table at most half full
+	size_t capacity = 16;
+	while (capacity < _maxEntries * 2)
+		capacity <<= 1;
+	if (m_Slots.size() != capacity)
+		m_Slots.resize(capacity);
+	for (size_t i = 0; i < capacity; i++)
+		m_Slots[i].vertex = EMPTY_SLOT;
+	m_iMask = capacity - 1;
+}
+
+unsigned int WeldTable::Insert(const ObjFaceCorner& _corner, unsigned int _newVertex, bool* _inserted)
+{
+	// === Linear probe until we find the triple or an empty slot
+	size_t slot = HashCorner(_corner) & m_iMask;
+	while (m_Slots[slot].vertex != EMPTY_SLOT && !SameCorner(m_Slots[slot].key, _corner))
+		slot = (slot + 1) & m_iMask;
+
+	*_inserted = m_Slots[slot].vertex == EMPTY_SLOT;
+	if (*_inserted) {
+		m_Slots[slot].key = _corner;
+		m_Slots[slot].vertex = _newVertex;
+	}
+	return m_Slots[slot].vertex;
+}
+// ====================== //
+
+// ===== Mesh Building ===== //
+void BuildIndexedMesh(const ObjRawData& _rawData, MeshData* _meshData)
+{
+	size_t cornerCount = _rawData.corners.size();
+	_meshData->vertices.clear();
+	_meshData->vertices.reserve(cornerCount);
+	_meshData->indexes.resize(cornerCount);
+
+	// === Every corner could be unique
+	WeldTable table;
+	table.Reset(cornerCount);
+
+	for (size_t i = 0; i < cornerCount; i++) {
+		const ObjFaceCorner& corner = _rawData.corners[i];
+		bool inserted;
+		_meshData->indexes[i] = table.Insert(corner, (unsigned int)_meshData->vertices.size(), &inserted);
+		if (inserted) {
+			const Vector3& position = _rawData.positions[corner.position];
+			const Vector3& uv = _rawData.uvs[corner.uv];
+			const Vector3& normal = _rawData.normals[corner.normal];
+			_meshData->vertices.push_back(Vertex(position.x, position.y, position.z, 1, uv.x, uv.y, uv.z, normal.x, normal.y, normal.z));
+		}
+	}
+}
+
+void ComputeMeshBounds(const MeshData& _meshData, float _min[3], float _max[3])
+{
+	Bounds bounds = ComputeBounds(_meshData.vertices.data(), _meshData.vertices.size(), sizeof(Vertex));
+	for (int axis = 0; axis < 3; axis++) {
+		_min[axis] = bounds.min[axis];
+		_max[axis] = bounds.max[axis];
+	}
+}
+// ========================= //
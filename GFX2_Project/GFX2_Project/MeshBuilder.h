@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "ObjParser.h"
+#include "Vertex_Types.h"
+
+using std::vector;
+
+// - MeshData
+// --- Final vertex and index arrays, ready to be copied into GPU buffers
+struct MeshData
+{
+	vector<Vertex> vertices;
+	vector<unsigned int> indexes;
+};
+
+// - WeldTable
+// --- Open-addressed (linear probing) map from (position, uv, normal) index triples to vertices
+// --- Sized up front by Reset, so inserting never rehashes
+class WeldTable
+{
+private:
+	struct WeldSlot
+	{
+		ObjFaceCorner key;
+		unsigned int vertex;
+	};
+	vector<WeldSlot>	m_Slots;
+	size_t				m_iMask;
+
+public:
+	// ===== Constructor
+	WeldTable();
+
+	// ===== Interface
+	// - Reset
+	// --- Empties the table and makes room for _maxEntries unique triples
+	void Reset(size_t _maxEntries);
+	// - Insert
+	// --- Returns the vertex already welded to _corner, or stores and returns _newVertex
+	unsigned int Insert(const ObjFaceCorner& _corner, unsigned int _newVertex, bool* _inserted);
+
+	// ===== Accessors
+	size_t GetMemoryUsage() const { return m_Slots.capacity() * sizeof(WeldSlot); }
+};
+
+// - BuildIndexedMesh
+// --- Welds every (position, uv, normal) triple of _rawData into one unique Vertex
+// --- and writes an index buffer that references them, in the original triangle order
+// --- The weld table is open-addressed and sized up front, so the weld is linear in the corner count
+void BuildIndexedMesh(const ObjRawData& _rawData, MeshData* _meshData);
+
+// - ComputeMeshBounds
+// --- Axis aligned min / max of every vertex position, zero for an empty mesh
+void ComputeMeshBounds(const MeshData& _meshData, float _min[3], float _max[3]);
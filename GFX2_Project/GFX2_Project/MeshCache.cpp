@@ -0,0 +1,301 @@
+#include "MeshCache.h"
+
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include "Hash.h"
+
+// ===== Local Helpers ===== //
+static const unsigned long long MESHBIN_ALIGNMENT = 16;
+
+static inline unsigned long long AlignOffset(unsigned long long _offset)
+{
+	return (_offset + MESHBIN_ALIGNMENT - 1) & ~(MESHBIN_ALIGNMENT - 1);
+}
+
+static const unsigned int MESHBIN_COPY_INDEXES = 64 * 1024;
+
+static FILE* OpenForWriting(const char* _path, const char* _mode = "wb")
+{
+	FILE* file = nullptr;
+#ifdef _WIN32
+	fopen_s(&file, _path, _mode);
+#else
+	file = fopen(_path, _mode);
+#endif
+	return file;
+}
+
+static void InitializeHeader(MeshCacheHeader* _header, unsigned long long _sourceSize, unsigned long long _sourceHash)
+{
+	memset(_header, 0, sizeof(*_header));
+	_header->magic = MESHBIN_MAGIC;
+	_header->version = MESHBIN_VERSION;
+	_header->vertexStride = sizeof(Vertex);
+	_header->vertexLayoutHash = GetVertexLayoutHash();
+	_header->sourceSize = _sourceSize;
+	_header->sourceHash = _sourceHash;
+	_header->vertexOffset = AlignOffset(sizeof(MeshCacheHeader));
+}
+
+static bool WritePadding(FILE* _file, unsigned long long _from, unsigned long long _to)
+{
+	static const char zeros[MESHBIN_ALIGNMENT] = { 0 };
+	return _to == _from || fwrite(zeros, 1, (size_t)(_to - _from), _file) == _to - _from;
+}
+// ========================= //
+
+// ===== MeshCacheFile ===== //
+MeshCacheFile::MeshCacheFile()
+{
+	m_pHeader = nullptr;
+}
+
+bool MeshCacheFile::Open(const char* _cachePath, unsigned long long _sourceSize, unsigned long long _sourceHash)
+{
+	Close();
+	if (!m_File.Open(_cachePath) || m_File.GetSize() < sizeof(MeshCacheHeader)) {
+		Close();
+		return false;
+	}
+
+	// === Is this cache still describing the source file?
+	const MeshCacheHeader* header = (const MeshCacheHeader*)m_File.GetData();
+	bool valid = header->magic == MESHBIN_MAGIC && header->version == MESHBIN_VERSION &&
+		header->vertexStride == sizeof(Vertex) && header->vertexLayoutHash == GetVertexLayoutHash() &&
+		header->sourceSize == _sourceSize && header->sourceHash == _sourceHash;
+
+	// === Are both arrays actually inside the file?
+	unsigned long long fileSize = m_File.GetSize();
+	valid = valid && header->vertexOffset % MESHBIN_ALIGNMENT == 0 && header->indexOffset % MESHBIN_ALIGNMENT == 0 &&
+		header->vertexOffset <= fileSize && (fileSize - header->vertexOffset) / sizeof(Vertex) >= header->vertexCount &&
+		header->indexOffset <= fileSize && (fileSize - header->indexOffset) / sizeof(unsigned int) >= header->indexCount;
+	if (!valid) {
+		Close();
+		return false;
+	}
+
+	m_pHeader = header;
+	return true;
+}
+
+void MeshCacheFile::Close()
+{
+	m_File.Close();
+	m_pHeader = nullptr;
+}
+
+const Vertex* MeshCacheFile::GetVertices() const
+{
+	return (const Vertex*)(m_File.GetData() + m_pHeader->vertexOffset);
+}
+
+const unsigned int* MeshCacheFile::GetIndexes() const
+{
+	return (const unsigned int*)(m_File.GetData() + m_pHeader->indexOffset);
+}
+// ========================= //
+
+// ===== Interface ===== //
+string GetMeshCachePath(const char* _sourcePath)
+{
+	return string(_sourcePath) + ".meshbin";
+}
+
+unsigned int GetVertexLayoutHash()
+{
+	unsigned long long layout[] = {
+		sizeof(Vertex), offsetof(Vertex, x), offsetof(Vertex, w), offsetof(Vertex, u), offsetof(Vertex, n), offsetof(Vertex, normals)
+	};
+	unsigned long long hash = HashBytes(layout, sizeof(layout));
+	return (unsigned int)(hash ^ (hash >> 32));
+}
+
+bool WriteMeshCache(const char* _cachePath, const MeshData& _meshData, unsigned long long _sourceSize, unsigned long long _sourceHash)
+{
+	MeshCacheHeader header;
+	InitializeHeader(&header, _sourceSize, _sourceHash);
+	header.vertexCount = (unsigned int)_meshData.vertices.size();
+	header.indexCount = (unsigned int)_meshData.indexes.size();
+	header.indexOffset = AlignOffset(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+	ComputeMeshBounds(_meshData, header.boundsMin, header.boundsMax);
+
+	// === Write to a temporary file first, a half written cache must never look valid
+	string tempPath = string(_cachePath) + ".tmp";
+	FILE* file = OpenForWriting(tempPath.c_str());
+	if (file == nullptr)
+		return false;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		WritePadding(file, sizeof(header), header.vertexOffset) &&
+		(header.vertexCount == 0 || fwrite(_meshData.vertices.data(), sizeof(Vertex), header.vertexCount, file) == header.vertexCount) &&
+		WritePadding(file, header.vertexOffset + header.vertexCount * sizeof(Vertex), header.indexOffset) &&
+		(header.indexCount == 0 || fwrite(_meshData.indexes.data(), sizeof(unsigned int), header.indexCount, file) == header.indexCount);
+	written = fclose(file) == 0 && written;
+
+	remove(_cachePath);
+	if (!written || rename(tempPath.c_str(), _cachePath) != 0) {
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+// ===================== //
+
+// ===== MeshCacheWriter ===== //
+MeshCacheWriter::MeshCacheWriter()
+{
+	m_pVertexFile = nullptr;
+	m_pIndexFile = nullptr;
+	InitializeHeader(&m_Header, 0, 0);
+	m_bOptimize = true;
+	m_fRunsBefore = m_fRunsAfter = 0;
+	m_iTriangles = m_iBlockVertices = 0;
+}
+
+MeshCacheWriter::~MeshCacheWriter()
+{
+	Abort();
+}
+
+bool MeshCacheWriter::Begin(const char* _cachePath, unsigned long long _sourceSize, unsigned long long _sourceHash)
+{
+	Abort();
+	m_sCachePath = _cachePath;
+	InitializeHeader(&m_Header, _sourceSize, _sourceHash);
+
+	// === The vertices go straight after a placeholder header, the indexes wait in a scratch file
+	m_pVertexFile = OpenForWriting((m_sCachePath + ".tmp").c_str());
+	m_pIndexFile = OpenForWriting((m_sCachePath + ".idx.tmp").c_str(), "w+b");
+	if (m_pVertexFile == nullptr || m_pIndexFile == nullptr ||
+		fwrite(&m_Header, sizeof(m_Header), 1, m_pVertexFile) != 1 || !WritePadding(m_pVertexFile, sizeof(m_Header), m_Header.vertexOffset)) {
+		Abort();
+		return false;
+	}
+	m_Scratch.resize(MESHBIN_COPY_INDEXES);
+	m_fRunsBefore = m_fRunsAfter = 0;
+	m_iTriangles = m_iBlockVertices = 0;
+	return true;
+}
+
+bool MeshCacheWriter::OnMeshBlock(const MeshBlock& _block)
+{
+	if (!m_bOptimize || _block.indexCount == 0)
+		return WriteBlock(_block);
+
+	m_Block.vertices.assign(_block.vertices, _block.vertices + _block.vertexCount);
+	m_Block.indexes.assign(_block.indexes, _block.indexes + _block.indexCount);
+	VertexCacheStats before, after;
+	OptimizeMesh(&m_Block, MeshOptimizeOptions(), &before, &after);
+
+	// === Both ratios share the vertex shader runs, so they add up over the blocks
+	double triangles = (double)(_block.indexCount / 3);
+	m_fRunsBefore += before.acmr * triangles;
+	m_fRunsAfter += after.acmr * triangles;
+	m_iTriangles += _block.indexCount / 3;
+	m_iBlockVertices += _block.vertexCount;
+
+	MeshBlock optimized = { m_Block.vertices.data(), (unsigned int)m_Block.vertices.size(), m_Block.indexes.data(), (unsigned int)m_Block.indexes.size() };
+	return WriteBlock(optimized);
+}
+
+void MeshCacheWriter::GetCacheStats(VertexCacheStats* _before, VertexCacheStats* _after) const
+{
+	double triangles = m_iTriangles > 0 ? (double)m_iTriangles : 1.0, vertices = m_iBlockVertices > 0 ? (double)m_iBlockVertices : 1.0;
+	_before->acmr = (float)(m_fRunsBefore / triangles);
+	_before->atvr = (float)(m_fRunsBefore / vertices);
+	_after->acmr = (float)(m_fRunsAfter / triangles);
+	_after->atvr = (float)(m_fRunsAfter / vertices);
+}
+
+bool MeshCacheWriter::WriteBlock(const MeshBlock& _block)
+{
+	if (m_pVertexFile == nullptr || _block.vertexCount > UINT_MAX - m_Header.vertexCount || _block.indexCount > UINT_MAX - m_Header.indexCount)
+		return false;
+
+	// === Grow the bounds
+	for (unsigned int i = 0; i < _block.vertexCount; i++) {
+		const float position[3] = { _block.vertices[i].x, _block.vertices[i].y, _block.vertices[i].z };
+		for (int axis = 0; axis < 3; axis++) {
+			if (m_Header.vertexCount == 0 && i == 0) {
+				m_Header.boundsMin[axis] = m_Header.boundsMax[axis] = position[axis];
+			}
+			else {
+				if (position[axis] < m_Header.boundsMin[axis]) m_Header.boundsMin[axis] = position[axis];
+				if (position[axis] > m_Header.boundsMax[axis]) m_Header.boundsMax[axis] = position[axis];
+			}
+		}
+	}
+
+	if (_block.vertexCount > 0 && fwrite(_block.vertices, sizeof(Vertex), _block.vertexCount, m_pVertexFile) != _block.vertexCount)
+		return false;
+
+	// === Rebase the block's indexes onto the vertices written before it
+	for (unsigned int first = 0; first < _block.indexCount; first += MESHBIN_COPY_INDEXES) {
+		unsigned int count = _block.indexCount - first < MESHBIN_COPY_INDEXES ? _block.indexCount - first : MESHBIN_COPY_INDEXES;
+		for (unsigned int i = 0; i < count; i++)
+			m_Scratch[i] = _block.indexes[first + i] + m_Header.vertexCount;
+		if (fwrite(m_Scratch.data(), sizeof(unsigned int), count, m_pIndexFile) != count)
+			return false;
+	}
+
+	m_Header.vertexCount += _block.vertexCount;
+	m_Header.indexCount += _block.indexCount;
+	return true;
+}
+
+bool MeshCacheWriter::Finish()
+{
+	if (m_pVertexFile == nullptr)
+		return false;
+
+	unsigned long long vertexEnd = m_Header.vertexOffset + (unsigned long long)m_Header.vertexCount * sizeof(Vertex);
+	m_Header.indexOffset = AlignOffset(vertexEnd);
+	bool written = WritePadding(m_pVertexFile, vertexEnd, m_Header.indexOffset);
+
+	// === Append the parked indexes
+	rewind(m_pIndexFile);
+	for (unsigned int copied = 0; written && copied < m_Header.indexCount;) {
+		unsigned int count = m_Header.indexCount - copied < MESHBIN_COPY_INDEXES ? m_Header.indexCount - copied : MESHBIN_COPY_INDEXES;
+		written = fread(m_Scratch.data(), sizeof(unsigned int), count, m_pIndexFile) == count &&
+			fwrite(m_Scratch.data(), sizeof(unsigned int), count, m_pVertexFile) == count;
+		copied += count;
+	}
+
+	// === Only now does the header describe the file
+	written = written && fseek(m_pVertexFile, 0, SEEK_SET) == 0 && fwrite(&m_Header, sizeof(m_Header), 1, m_pVertexFile) == 1;
+	written = fclose(m_pVertexFile) == 0 && written;
+	m_pVertexFile = nullptr;
+
+	string tempPath = m_sCachePath + ".tmp";
+	remove(m_sCachePath.c_str());
+	if (!written || rename(tempPath.c_str(), m_sCachePath.c_str()) != 0) {
+		remove(tempPath.c_str());
+		Abort();
+		return false;
+	}
+	Abort();
+	return true;
+}
+
+// - Abort
+// --- Closes and deletes whatever temporary files are still open
+void MeshCacheWriter::Abort()
+{
+	if (m_pVertexFile != nullptr) {
+		fclose(m_pVertexFile);
+		m_pVertexFile = nullptr;
+		remove((m_sCachePath + ".tmp").c_str());
+	}
+	if (m_pIndexFile != nullptr) {
+		fclose(m_pIndexFile);
+		m_pIndexFile = nullptr;
+		remove((m_sCachePath + ".idx.tmp").c_str());
+	}
+	m_Scratch.clear();
+	m_Scratch.shrink_to_fit();
+	vector<Vertex>().swap(m_Block.vertices);
+	vector<unsigned int>().swap(m_Block.indexes);
+}
+// =========================== //
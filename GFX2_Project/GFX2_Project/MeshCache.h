@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "MappedFile.h"
+#include "MeshBuilder.h"
+#include "MeshOptimizer.h"
+#include "ObjStream.h"
+
+using std::string;
+
+// ===== .meshbin Layout ===== //
+// --- [MeshCacheHeader][Vertex * vertexCount][unsigned int * indexCount]
+// --- Both arrays start on 16 byte boundaries so they can be used straight out of the mapping
+static const unsigned int MESHBIN_MAGIC = 0x4E49424D; // "MBIN"
+static const unsigned int MESHBIN_VERSION = 2; // 2: meshes are cache / overdraw optimized
+
+struct MeshCacheHeader
+{
+	unsigned int		magic;
+	unsigned int		version;
+	unsigned int		vertexStride;
+	unsigned int		vertexLayoutHash;
+	unsigned long long	sourceSize;
+	unsigned long long	sourceHash;
+	unsigned int		vertexCount;
+	unsigned int		indexCount;
+	unsigned long long	vertexOffset;
+	unsigned long long	indexOffset;
+	float				boundsMin[3];
+	float				boundsMax[3];
+};
+// =========================== //
+
+// - MeshCacheFile
+// --- A mapped .meshbin file, the vertex and index pointers point straight into the mapping
+class MeshCacheFile
+{
+private:
+	MappedFile				m_File;
+	const MeshCacheHeader*	m_pHeader;
+
+public:
+	// ===== Constructor
+	MeshCacheFile();
+
+	// ===== Interface
+	// - Open
+	// --- Maps _cachePath and checks it against the version, the Vertex layout and the source file
+	// --- Returns false (and stays closed) if the cache is missing, stale or damaged
+	bool Open(const char* _cachePath, unsigned long long _sourceSize, unsigned long long _sourceHash);
+	void Close();
+
+	// ===== Accessors
+	const Vertex* GetVertices() const;
+	const unsigned int* GetIndexes() const;
+	unsigned int GetVertexCount() const { return m_pHeader->vertexCount; }
+	unsigned int GetIndexCount() const { return m_pHeader->indexCount; }
+	const MeshCacheHeader* GetHeader() const { return m_pHeader; }
+};
+
+// - GetMeshCachePath
+// --- The .meshbin file that belongs to a source mesh
+string GetMeshCachePath(const char* _sourcePath);
+
+// - GetVertexLayoutHash
+// --- Changes whenever the size or the member offsets of Vertex change
+unsigned int GetVertexLayoutHash();
+
+// - WriteMeshCache
+// --- Writes _meshData to _cachePath, tagged with the source size and hash
+bool WriteMeshCache(const char* _cachePath, const MeshData& _meshData, unsigned long long _sourceSize, unsigned long long _sourceHash);
+
+// - MeshCacheWriter
+// --- Writes a streamed mesh straight to a .meshbin, one block at a time
+// --- Block indexes are rebased as they arrive and parked in a side file until Finish, so nothing grows with the mesh
+class MeshCacheWriter : public IMeshSink
+{
+private:
+	string				m_sCachePath;
+	FILE*				m_pVertexFile;
+	FILE*				m_pIndexFile;
+	MeshCacheHeader		m_Header;
+	vector<unsigned int>	m_Scratch;
+	// === Each block is optimized on its own copy before it is written, the cache stats add up the vertex shader runs
+	bool				m_bOptimize;
+	MeshData			m_Block;
+	double				m_fRunsBefore;
+	double				m_fRunsAfter;
+	unsigned long long	m_iTriangles;
+	unsigned long long	m_iBlockVertices;
+
+	bool WriteBlock(const MeshBlock& _block);
+	void Abort();
+
+public:
+	// ===== Constructor / Destructor
+	MeshCacheWriter();
+	~MeshCacheWriter();
+
+	// ===== Interface
+	// - Begin
+	// --- Starts a new cache for _cachePath, tagged with the source size and hash
+	bool Begin(const char* _cachePath, unsigned long long _sourceSize, unsigned long long _sourceHash);
+	// - OnMeshBlock
+	// --- Runs OptimizeMesh over the block unless SetOptimize turned it off; blocks are self contained, so the
+	// --- vertex cache and fetch order only lose the reuse across block edges, and overdraw is sorted per block
+	bool OnMeshBlock(const MeshBlock& _block);
+	// - Finish
+	// --- Appends the indexes, writes the final header and moves the cache into place
+	bool Finish();
+	// - SetOptimize
+	// --- On by default, the cache version promises optimized meshes
+	void SetOptimize(bool _optimize) { m_bOptimize = _optimize; }
+
+	// ===== Accessors
+	// - GetCacheStats
+	// --- Of every block written since Begin, before and after optimizing
+	void GetCacheStats(VertexCacheStats* _before, VertexCacheStats* _after) const;
+	const MeshCacheHeader& GetHeader() const { return m_Header; }
+};
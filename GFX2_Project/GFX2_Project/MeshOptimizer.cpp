@@ -0,0 +1,281 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ===== Local Helpers ===== //
+static const unsigned int NO_VERTEX = 0xFFFFFFFF;
+
+// - VertexCache
+// --- FIFO post-transform cache, hits are found through each vertex's insertion time
+class VertexCache
+{
+private:
+	vector<unsigned int>	m_Timestamps;
+	unsigned int			m_iTime;
+	unsigned int			m_iSize;
+
+public:
+	VertexCache(size_t _vertexCount, unsigned int _cacheSize) : m_Timestamps(_vertexCount, 0) {
+		m_iSize = _cacheSize;
+		m_iTime = _cacheSize + 1;
+	}
+	// - Reset
+	// --- Cheap flush, everything already stored is now too old to hit
+	void Reset() { m_iTime += m_iSize + 1; }
+	// - Use
+	// --- Returns true on a miss
+	bool Use(unsigned int _vertex) {
+		if (m_iTime - m_Timestamps[_vertex] <= m_iSize)
+			return false;
+		m_Timestamps[_vertex] = m_iTime++;
+		return true;
+	}
+};
+
+struct OverdrawCluster
+{
+	size_t	firstTriangle;
+	size_t	triangleCount;
+	float	sortKey;
+};
+
+static bool CompareClusters(const OverdrawCluster& _a, const OverdrawCluster& _b)
+{
+	return _a.sortKey > _b.sortKey;
+}
+// ========================= //
+
+// ===== Mesh Optimization ===== //
+VertexCacheStats AnalyzeVertexCache(const unsigned int* _indexes, size_t _indexCount, size_t _vertexCount, unsigned int _cacheSize)
+{
+	VertexCacheStats stats = { 0, 0 };
+	if (_indexCount < 3 || _vertexCount == 0)
+		return stats;
+
+	VertexCache cache(_vertexCount, _cacheSize);
+	size_t misses = 0;
+	for (size_t i = 0; i < _indexCount; i++)
+		misses += cache.Use(_indexes[i]);
+
+	stats.acmr = (float)misses / (float)(_indexCount / 3);
+	stats.atvr = (float)misses / (float)_vertexCount;
+	return stats;
+}
+
+void OptimizeVertexCache(unsigned int* _indexes, size_t _indexCount, size_t _vertexCount, unsigned int _cacheSize, vector<unsigned int>* _clusters)
+{
+	size_t triangleCount = _indexCount / 3;
+	if (_clusters != nullptr)
+		_clusters->clear();
+	if (triangleCount == 0 || _vertexCount == 0)
+		return;
+
+	// === Vertex -> triangle adjacency, as offsets into one array
+	vector<unsigned int> liveTriangles(_vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		++liveTriangles[_indexes[i]];
+	vector<unsigned int> adjacencyOffsets(_vertexCount + 1, 0);
+	for (size_t v = 0; v < _vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	vector<unsigned int> adjacency(triangleCount * 3);
+	vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int corner = 0; corner < 3; corner++)
+			adjacency[fill[_indexes[t * 3 + corner]]++] = (unsigned int)t;
+
+	vector<unsigned int> timestamps(_vertexCount, 0);
+	vector<bool> emitted(triangleCount, false);
+	vector<unsigned int> deadEnds;
+	vector<unsigned int> candidates;
+	vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	deadEnds.reserve(triangleCount * 3);
+
+	unsigned int time = _cacheSize + 1;
+	size_t cursor = 0;
+	unsigned int fan = _indexes[0];
+	if (_clusters != nullptr)
+		_clusters->push_back(0);
+
+	while (fan != NO_VERTEX) {
+		// === Emit every triangle still around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++) {
+			unsigned int triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			for (int corner = 0; corner < 3; corner++) {
+				unsigned int vertex = _indexes[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				--liveTriangles[vertex];
+				if (time - timestamps[vertex] > _cacheSize)
+					timestamps[vertex] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// === Next fan: the candidate that will still be in the cache after its remaining triangles, and is the oldest
+		unsigned int next = NO_VERTEX;
+		int bestPriority = -1;
+		for (size_t c = 0; c < candidates.size(); c++) {
+			unsigned int vertex = candidates[c];
+			if (liveTriangles[vertex] == 0)
+				continue;
+			int priority = 0;
+			if (time - timestamps[vertex] + 2 * liveTriangles[vertex] <= _cacheSize)
+				priority = (int)(time - timestamps[vertex]);
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		// === Dead end, back track through recently used vertices, then fall back to the next unfinished one
+		if (next == NO_VERTEX) {
+			while (!deadEnds.empty() && next == NO_VERTEX) {
+				unsigned int vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[vertex] > 0)
+					next = vertex;
+			}
+			while (next == NO_VERTEX && cursor < _vertexCount) {
+				if (liveTriangles[cursor] > 0) {
+					next = (unsigned int)cursor;
+					// == Nothing from before is left in the cache, this starts a new cluster
+					if (_clusters != nullptr)
+						_clusters->push_back((unsigned int)(output.size() / 3));
+				}
+				++cursor;
+			}
+		}
+		fan = next;
+	}
+
+	if (!output.empty())
+		memcpy(_indexes, output.data(), output.size() * sizeof(unsigned int));
+}
+
+void OptimizeOverdraw(unsigned int* _indexes, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount, const vector<unsigned int>& _clusters, unsigned int _cacheSize, float _threshold)
+{
+	size_t triangleCount = _indexCount / 3;
+	if (triangleCount == 0 || _vertexCount == 0)
+		return;
+
+	// === Split each cold start cluster further, wherever its ACMR so far is already close to the cluster's own
+	vector<OverdrawCluster> clusters;
+	VertexCache cache(_vertexCount, _cacheSize);
+	for (size_t c = 0; c < _clusters.size(); c++) {
+		size_t begin = _clusters[c];
+		size_t end = c + 1 < _clusters.size() ? _clusters[c + 1] : triangleCount;
+		if (begin >= end)
+			continue;
+		size_t misses = 0;
+		cache.Reset();
+		for (size_t i = begin * 3; i < end * 3; i++)
+			misses += cache.Use(_indexes[i]);
+		float target = (float)misses / (float)(end - begin) * _threshold;
+
+		size_t start = begin;
+		misses = 0;
+		cache.Reset();
+		for (size_t t = begin; t < end; t++) {
+			for (int corner = 0; corner < 3; corner++)
+				misses += cache.Use(_indexes[t * 3 + corner]);
+			if (t + 1 == end || (float)misses / (float)(t + 1 - start) <= target) {
+				OverdrawCluster cluster = { start, t + 1 - start, 0 };
+				clusters.push_back(cluster);
+				start = t + 1;
+				misses = 0;
+				cache.Reset();
+			}
+		}
+	}
+
+	// === Mesh centroid, from the area weighted triangle centroids
+	float meshCentroid[3] = { 0, 0, 0 };
+	float meshArea = 0;
+	vector<float> clusterData(clusters.size() * 7, 0);
+	for (size_t c = 0; c < clusters.size(); c++) {
+		float* data = &clusterData[c * 7];
+		for (size_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++) {
+			const Vertex& a = _vertices[_indexes[t * 3 + 0]];
+			const Vertex& b = _vertices[_indexes[t * 3 + 1]];
+			const Vertex& d = _vertices[_indexes[t * 3 + 2]];
+			float e0[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+			float e1[3] = { d.x - a.x, d.y - a.y, d.z - a.z };
+			float normal[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+			float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			float centroid[3] = { (a.x + b.x + d.x) / 3, (a.y + b.y + d.y) / 3, (a.z + b.z + d.z) / 3 };
+			for (int axis = 0; axis < 3; axis++) {
+				data[axis] += centroid[axis] * area;
+				data[3 + axis] += normal[axis];
+			}
+			data[6] += area;
+		}
+		for (int axis = 0; axis < 3; axis++)
+			meshCentroid[axis] += data[axis];
+		meshArea += data[6];
+	}
+	if (meshArea > 0)
+		for (int axis = 0; axis < 3; axis++)
+			meshCentroid[axis] /= meshArea;
+
+	// === Clusters facing away from the centre are the ones most likely to be in front, draw those first
+	for (size_t c = 0; c < clusters.size(); c++) {
+		const float* data = &clusterData[c * 7];
+		float length = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+		if (data[6] <= 0 || length <= 0)
+			continue;
+		float key = 0;
+		for (int axis = 0; axis < 3; axis++)
+			key += (data[axis] / data[6] - meshCentroid[axis]) * (data[3 + axis] / length);
+		clusters[c].sortKey = key;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), CompareClusters);
+
+	vector<unsigned int> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (size_t c = 0; c < clusters.size(); c++)
+		sorted.insert(sorted.end(), _indexes + clusters[c].firstTriangle * 3, _indexes + (clusters[c].firstTriangle + clusters[c].triangleCount) * 3);
+	if (!sorted.empty())
+		memcpy(_indexes, sorted.data(), sorted.size() * sizeof(unsigned int));
+}
+
+void OptimizeVertexFetch(MeshData* _meshData)
+{
+	vector<unsigned int> remap(_meshData->vertices.size(), NO_VERTEX);
+	vector<Vertex> vertices;
+	vertices.reserve(_meshData->vertices.size());
+	for (size_t i = 0; i < _meshData->indexes.size(); i++) {
+		unsigned int& index = _meshData->indexes[i];
+		if (remap[index] == NO_VERTEX) {
+			remap[index] = (unsigned int)vertices.size();
+			vertices.push_back(_meshData->vertices[index]);
+		}
+		index = remap[index];
+	}
+	_meshData->vertices.swap(vertices);
+}
+
+void OptimizeMesh(MeshData* _meshData, const MeshOptimizeOptions& _options, VertexCacheStats* _before, VertexCacheStats* _after)
+{
+	unsigned int* indexes = _meshData->indexes.data();
+	size_t indexCount = _meshData->indexes.size();
+	size_t vertexCount = _meshData->vertices.size();
+	if (_before != nullptr)
+		*_before = AnalyzeVertexCache(indexes, indexCount, vertexCount, _options.cacheSize);
+
+	vector<unsigned int> clusters;
+	OptimizeVertexCache(indexes, indexCount, vertexCount, _options.cacheSize, &clusters);
+	if (_options.reduceOverdraw)
+		OptimizeOverdraw(indexes, indexCount, _meshData->vertices.data(), vertexCount, clusters, _options.cacheSize, _options.overdrawThreshold);
+	OptimizeVertexFetch(_meshData);
+
+	if (_after != nullptr)
+		*_after = AnalyzeVertexCache(_meshData->indexes.data(), _meshData->indexes.size(), _meshData->vertices.size(), _options.cacheSize);
+}
+// ============================= //
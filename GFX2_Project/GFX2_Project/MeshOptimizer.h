@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "MeshBuilder.h"
+
+using std::vector;
+
+// === Post-transform cache size the ordering is tuned for, and measured against
+static const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// - VertexCacheStats
+// --- ACMR: vertex shader runs per triangle (0.5 is ideal, 3 is no reuse at all)
+// --- ATVR: vertex shader runs per unique vertex (1 is ideal)
+struct VertexCacheStats
+{
+	float acmr;
+	float atvr;
+};
+
+// - MeshOptimizeOptions
+struct MeshOptimizeOptions
+{
+	unsigned int	cacheSize;
+	// === Reorders the cache friendly clusters front to back, costing at most overdrawThreshold times the ACMR
+	bool			reduceOverdraw;
+	float			overdrawThreshold;
+
+	MeshOptimizeOptions() {
+		cacheSize = VERTEX_CACHE_SIZE;
+		reduceOverdraw = true;
+		overdrawThreshold = 1.05f;
+	}
+};
+
+// ===== Mesh Optimization ===== //
+// - AnalyzeVertexCache
+// --- Simulates a FIFO post-transform cache of _cacheSize entries over the index buffer
+VertexCacheStats AnalyzeVertexCache(const unsigned int* _indexes, size_t _indexCount, size_t _vertexCount, unsigned int _cacheSize = VERTEX_CACHE_SIZE);
+
+// - OptimizeVertexCache
+// --- Tipsify: reorders the triangles so that vertices are reused while they are still in the cache
+// --- Runs in linear time, _clusters (optional) receives the first triangle of every stretch that starts with a cold cache
+void OptimizeVertexCache(unsigned int* _indexes, size_t _indexCount, size_t _vertexCount, unsigned int _cacheSize = VERTEX_CACHE_SIZE, vector<unsigned int>* _clusters = nullptr);
+
+// - OptimizeOverdraw
+// --- Splits the cache optimized order into small clusters and sorts them so outward facing ones come first,
+// --- which lets early-z reject more of the mesh; _clusters comes from OptimizeVertexCache
+void OptimizeOverdraw(unsigned int* _indexes, size_t _indexCount, const Vertex* _vertices, size_t _vertexCount, const vector<unsigned int>& _clusters, unsigned int _cacheSize = VERTEX_CACHE_SIZE, float _threshold = 1.05f);
+
+// - OptimizeVertexFetch
+// --- Reorders the vertices into the order the index buffer first uses them, and drops unused ones
+void OptimizeVertexFetch(MeshData* _meshData);
+
+// - OptimizeMesh
+// --- Runs all of the above, _before and _after (optional) receive the cache stats
+void OptimizeMesh(MeshData* _meshData, const MeshOptimizeOptions& _options = MeshOptimizeOptions(), VertexCacheStats* _before = nullptr, VertexCacheStats* _after = nullptr);
+// ============================= //
@@ -0,0 +1,58 @@
+#pragma pack_matrix( row_major )
+
+struct V_INPUT
+{
+	float4 posL : POSITION;
+	float3 uvL : TEXTCOORDS;
+	float3 normalsL : NORMALS;
+	// === Per instance, from the second vertex buffer: the rows of the world matrix and the tint
+	float4 world0 : WORLD0;
+	float4 world1 : WORLD1;
+	float4 world2 : WORLD2;
+	float4 world3 : WORLD3;
+	float4 tint : TINT;
+};
+
+struct V_OUTPUT
+{
+	float4 posH : SV_POSITION;
+	float4 surfacePos : SURFACEPOS;
+	float2 UVCoords : TEXCOORD0;
+	float3 normal : NORMAL;
+	float4 tint : TINT;
+};
+
+cbuffer SCENE : register (b1)
+{
+	float4x4 viewMatrix;
+	float4x4 projectionMatrix;
+}
+
+V_OUTPUT main(V_INPUT _input)
+{
+	V_OUTPUT output = (V_OUTPUT)0;
+
+	// === Same as Model_VS, with the world matrix of the instance instead of the OBJECT buffer
+	float4x4 worldMatrix = float4x4(_input.world0, _input.world1, _input.world2, _input.world3);
+
+	// === Position
+	float4 localH = float4(_input.posL);
+	// == Local -> World
+	localH = mul(localH, worldMatrix);
+	// == World -> View
+	localH = mul(localH, viewMatrix);
+	// == View -> Projection
+	localH = mul(localH, projectionMatrix);
+
+	// === Normals
+	float4 normal = float4(_input.normalsL, 0);
+	normal = mul(normal, worldMatrix);
+
+	output.posH = localH;
+	output.surfacePos = mul(_input.posL, worldMatrix);
+	output.UVCoords = float2(_input.uvL[0], _input.uvL[1]);
+	output.normal = normal;
+	output.tint = _input.tint;
+
+	return output;
+}
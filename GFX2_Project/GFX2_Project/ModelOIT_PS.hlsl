@@ -0,0 +1,26 @@
+#include "ModelLighting.hlsli"
+#include "WeightedBlended.hlsli"
+
+// == Output to the two accumulation targets
+struct OIT_OUTPUT
+{
+	float4 accumulation : SV_TARGET0;
+	float4 weight : SV_TARGET1;
+};
+
+OIT_OUTPUT main(P_INPUT _input)
+{
+	OIT_OUTPUT output = (OIT_OUTPUT)0;
+
+	// === Same lighting as Model_PS
+	float4 color = ShadeModel(_input);
+
+	// === SV_POSITION.w is the view space depth
+	float weight = OITWeight(color[3], _input.posH.w);
+
+	// === Target 0: rgb adds up, alpha multiplies down to the revealage; Target 1: red adds up the weights
+	output.accumulation = float4(color.rgb * color[3] * weight, color[3]);
+	output.weight = float4(color[3] * weight, 0, 0, 0);
+
+	return output;
+}
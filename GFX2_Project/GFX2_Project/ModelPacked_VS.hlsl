@@ -0,0 +1,68 @@
+#pragma pack_matrix( row_major )
+
+struct V_INPUT
+{
+	float4 posQ : POSITION;
+	float2 normalOct : NORMALS;
+	float2 uvL : TEXTCOORDS;
+};
+
+struct V_OUTPUT
+{
+	float4 posH : SV_POSITION;
+	float4 surfacePos : SURFACEPOS;
+	float2 UVCoords : TEXCOORD0;
+	float3 normal : NORMAL;
+	float4 tint : TINT;
+};
+
+cbuffer OBJECT : register (b0)
+{
+	float4x4 worldMatrix;
+	float4 tint;
+	float4 positionScale;
+	float4 positionOffset;
+}
+
+cbuffer SCENE : register (b1)
+{
+	float4x4 viewMatrix;
+	float4x4 projectionMatrix;
+}
+
+// - DecodeOctahedral
+// --- Unfolds an octahedral encoded normal back onto the unit sphere
+float3 DecodeOctahedral(float2 _encoded)
+{
+	float3 normal = float3(_encoded, 1 - abs(_encoded.x) - abs(_encoded.y));
+	float fold = saturate(-normal.z);
+	normal.xy += normal.xy >= 0 ? -fold : fold;
+	return normalize(normal);
+}
+
+V_OUTPUT main(V_INPUT _input)
+{
+	V_OUTPUT output = (V_OUTPUT)0;
+
+	// === Position, dequantized against the mesh bounds
+	float4 localPos = float4(_input.posQ.xyz * positionScale.xyz + positionOffset.xyz, 1);
+	float4 localH = localPos;
+	// == Local -> World
+	localH = mul(localH, worldMatrix);
+	// == World -> View
+	localH = mul(localH, viewMatrix);
+	// == View -> Projection
+	localH = mul(localH, projectionMatrix);
+
+	// === Normals
+	float4 normal = float4(DecodeOctahedral(_input.normalOct), 0);
+	normal = mul(normal, worldMatrix);
+
+	output.posH = localH;
+	output.surfacePos = mul(localPos, worldMatrix);
+	output.UVCoords = _input.uvL;
+	output.normal = normal;
+	output.tint = tint;
+
+	return output;
+}
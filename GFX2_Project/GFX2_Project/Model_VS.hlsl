@@ -13,11 +13,13 @@ struct V_OUTPUT
 	float4 surfacePos : SURFACEPOS;
 	float2 UVCoords : TEXCOORD0;
 	float3 normal : NORMAL;
+	float4 tint : TINT;
 };
 
 cbuffer OBJECT : register (b0)
 {
 	float4x4 worldMatrix;
+	float4 tint;
 }
 
 cbuffer SCENE : register (b1)
@@ -47,6 +49,7 @@ V_OUTPUT main(V_INPUT _input)
 	output.surfacePos = mul(_input.posL, worldMatrix);
 	output.UVCoords = float2(_input.uvL[0], _input.uvL[1]);
 	output.normal = normal;
+	output.tint = tint;
 
 	return output;
 }
\ No newline at end of file
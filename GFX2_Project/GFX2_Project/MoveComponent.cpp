@@ -1,105 +1,62 @@
 #include "MoveComponent.h"
 
-#include "Object.h"
-
 // ===== Constructors / Destructors ===== //
-MoveComponent::MoveComponent(Object* _parent)
+MoveComponent::MoveComponent(Scene* _scene, EntityID _entity)
 {
-	m_ParentObject = _parent;
-	m_Wapoints = nullptr;
-	m_CurrentTarget = nullptr;
-	m_iCurrentWaypoint = 0;
-	m_fSpeed = 1.0f;
-	m_bPatrolling = false;
+	m_pScene = _scene;
+	m_Entity = _entity;
+	m_iAgent = m_pScene->GetMovementSystem().AddAgent(this, m_pScene->GetIndex(_entity));
 }
 
 MoveComponent::~MoveComponent()
 {
-	// === Clean up all Memory
-	delete[] m_Wapoints;
-	delete m_CurrentTarget;
+	// === Give the agent, and its reference to its path, back
+	m_pScene->GetMovementSystem().RemoveAgent(m_iAgent);
 }
 // ====================================== //
 
 // ===== Interface ===== //
-void MoveComponent::Update(float _deltaTime)
-{
-	// === Update DeltaTime
-	DeltaTime = _deltaTime;
-
-	// === Do we need to do anything?
-	if (m_CurrentTarget != nullptr) {
-		if (MoveTo(m_CurrentTarget))
-			SetDestination(nullptr);
-	}
-	else if (m_bPatrolling) {
-		Patrol();
-	}
-}
-
 void MoveComponent::Patrol(unsigned int _startIndex)
 {
-	SetDestination(nullptr);
-	m_bPatrolling = true;
-	m_iCurrentWaypoint = _startIndex;
+	m_pScene->GetMovementSystem().Patrol(m_iAgent, _startIndex);
 }
 
 void MoveComponent::StopPatrolling()
 {
-	m_bPatrolling = false;
+	m_pScene->GetMovementSystem().StopPatrolling(m_iAgent);
 }
 // ===================== //
 
-// ===== Private Interface ===== //
-
-// - MoveTo
-// --- Takes in a Float3 representing the position to move to
-// --- Returns true once the positon has been reached, false otherwise
-bool MoveComponent::MoveTo(XMFLOAT3* _position)
+// ===== Accessors ===== //
+void MoveComponent::SetWaypoints(const Vec3* _waypoints, unsigned int _count)
 {
-	// === Get the Direction we need to travel in
-	XMVECTOR direction = XMVectorSubtract(XMLoadFloat3(_position), XMLoadFloat3(&m_ParentObject->GetPosition()));
-	direction = XMVector3Normalize(direction);
-
-	// === Scale it by our Speed
-	direction = XMVectorScale(direction, m_fSpeed * DeltaTime);
-
-	// === Move our Object
-	XMStoreFloat4x4(&m_ParentObject->WorldMatrix, XMMatrixMultiply(XMMatrixTranslationFromVector(direction), XMLoadFloat4x4(&m_ParentObject->WorldMatrix)));
-
-	// === Have we reached our Destination?
-	XMFLOAT3 distance;
-	XMStoreFloat3(&distance, XMVector3Length(XMVectorSubtract(XMLoadFloat3(&m_ParentObject->GetPosition()), XMLoadFloat3(_position))));
-	if (distance.x < 0.05f)
-		return true;
-	return false;
+	MovementSystem& movement = m_pScene->GetMovementSystem();
+	if (_waypoints == nullptr || _count == 0) {
+		movement.SetPath(m_iAgent, INVALID_PATH);
+		return;
+	}
+	PathID path = movement.CreatePath(_waypoints, _count);
+	movement.SetPath(m_iAgent, path);
+	movement.ReleasePath(path);
 }
 
-void MoveComponent::Patrol()
+void MoveComponent::SetPath(PathID _path)
 {
-	// === Move Towards the Current Waypoint
-	if (MoveTo(&m_Wapoints[m_iCurrentWaypoint])) {
-		m_iCurrentWaypoint == m_iNumWaypoints - 1 ? m_iCurrentWaypoint = 0 : m_iCurrentWaypoint++;
-	}
+	m_pScene->GetMovementSystem().SetPath(m_iAgent, _path);
 }
-// ============================= //
 
-// ===== Accessors ===== //
-void MoveComponent::SetWaypoints(XMFLOAT3* _waypoints, unsigned int _count)
+void MoveComponent::SetDestination(const Vec3& _position)
 {
-	delete[] m_Wapoints;
-	m_Wapoints = _waypoints;
-	m_iNumWaypoints = _count;
+	m_pScene->GetMovementSystem().SetDestination(m_iAgent, _position);
 }
 
-void MoveComponent::SetDestination(XMFLOAT3* _position)
+void MoveComponent::ClearDestination()
 {
-	delete m_CurrentTarget;
-	m_CurrentTarget = _position;
+	m_pScene->GetMovementSystem().ClearDestination(m_iAgent);
 }
 
 void MoveComponent::SetSpeed(float _speed)
 {
-	m_fSpeed = _speed;
+	m_pScene->GetMovementSystem().SetSpeed(m_iAgent, _speed);
 }
 // ===================== //
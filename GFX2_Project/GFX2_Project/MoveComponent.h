@@ -1,43 +1,43 @@
 #pragma once
-#include <DirectXMath.h>
 
-using namespace DirectX;
-
-class Object;
+#include "Math.h"
+#include "Scene.h"
 
+// - MoveComponent
+// --- Handle to one agent of the Scene's MovementSystem, which does the actual moving for all of them at once
+// --- Create it for an entity and hand it to Scene::SetMover
 class MoveComponent
 {
 private:
-	Object* m_ParentObject;
-	XMFLOAT3* m_Wapoints;
-	XMFLOAT3* m_CurrentTarget;
-	unsigned int m_iNumWaypoints;
-	unsigned int m_iCurrentWaypoint;
-	float m_fSpeed;
-	bool m_bPatrolling;
-
-	float DeltaTime;
-
-	// ===== Private Interface
-	bool MoveTo(XMFLOAT3* _position);
-	void Patrol();
+	Scene* m_pScene;
+	EntityID m_Entity;
+	unsigned int m_iAgent;
 
 public:
 	// ===== Constuctors / Destructors
-	MoveComponent(Object* _parent);
+	MoveComponent(Scene* _scene, EntityID _entity);
 	~MoveComponent();
 
 	// ===== Interface
-	void Update(float _deltaTime);
 	void Patrol(unsigned int _startIndex);
 	void StopPatrolling();
 
 	// ===== Accessors
-	void SetWaypoints(XMFLOAT3* _waypoints, unsigned int _count);
-	void SetDestination(XMFLOAT3* _position);
+	// - SetWaypoints
+	// --- Copies the waypoints into the MovementSystem's path table
+	void SetWaypoints(const Vec3* _waypoints, unsigned int _count);
+	// - SetPath
+	// --- Follows a path shared with other agents, see MovementSystem::CreatePath
+	void SetPath(PathID _path);
+	void SetDestination(const Vec3& _position);
+	void ClearDestination();
 	void SetSpeed(float _speed);
+	// - SetAgent
+	// --- Called by the MovementSystem when it moves this component's agent
+	void SetAgent(unsigned int _agent) { m_iAgent = _agent; }
 
 	// ===== Mutators
-	float GetSpeed() { return m_fSpeed; }
+	float GetSpeed() const { return m_pScene->GetMovementSystem().GetSpeed(m_iAgent); }
+	unsigned int GetAgent() const { return m_iAgent; }
+	EntityID GetEntity() const { return m_Entity; }
 };
-
@@ -0,0 +1,375 @@
+#include "MovementSystem.h"
+
+#include <thread>
+
+#include "MoveComponent.h"
+#include "Profiling.h"
+#include "Scene.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define MOVEMENT_SSE
+#include <emmintrin.h>
+#endif
+
+using std::thread;
+
+// ===== Local Helpers ===== //
+enum MovementFlags
+{
+	MOVE_DESTINATION	= 1 << 0,
+	MOVE_PATROL			= 1 << 1,
+};
+
+// === Same threshold MoveComponent always used
+static const float ARRIVAL_DISTANCE = 0.05f;
+// === Below this many agents per thread, starting the thread costs more than it saves
+static const size_t MIN_AGENTS_PER_THREAD = 8192;
+static const size_t MAX_THREADS = 32;
+// ========================= //
+
+// ===== Constructor ===== //
+MovementSystem::MovementSystem()
+{
+}
+// ======================= //
+
+// ===== Agents ===== //
+unsigned int MovementSystem::AddAgent(MoveComponent* _owner, unsigned int _index)
+{
+	m_Owners.push_back(_owner);
+	m_Indexes.push_back(_index);
+	m_TargetX.push_back(0);
+	m_TargetY.push_back(0);
+	m_TargetZ.push_back(0);
+	m_Speed.push_back(1.0f);
+	m_Flags.push_back(0);
+	m_AgentPaths.push_back(INVALID_PATH);
+	m_Cursors.push_back(0);
+	return (unsigned int)m_Owners.size() - 1;
+}
+
+void MovementSystem::RemoveAgent(unsigned int _agent)
+{
+	// === Move the last agent into the hole and tell its owner
+	SetPath(_agent, INVALID_PATH);
+	unsigned int last = (unsigned int)m_Owners.size() - 1;
+	if (_agent != last) {
+		m_Owners[_agent] = m_Owners[last];
+		m_Indexes[_agent] = m_Indexes[last];
+		m_TargetX[_agent] = m_TargetX[last];
+		m_TargetY[_agent] = m_TargetY[last];
+		m_TargetZ[_agent] = m_TargetZ[last];
+		m_Speed[_agent] = m_Speed[last];
+		m_Flags[_agent] = m_Flags[last];
+		m_AgentPaths[_agent] = m_AgentPaths[last];
+		m_Cursors[_agent] = m_Cursors[last];
+		m_Owners[_agent]->SetAgent(_agent);
+	}
+	m_Owners.pop_back();
+	m_Indexes.pop_back();
+	m_TargetX.pop_back();
+	m_TargetY.pop_back();
+	m_TargetZ.pop_back();
+	m_Speed.pop_back();
+	m_Flags.pop_back();
+	m_AgentPaths.pop_back();
+	m_Cursors.pop_back();
+}
+// ================== //
+
+// ===== Paths ===== //
+PathID MovementSystem::CreatePath(const Vec3* _waypoints, unsigned int _count)
+{
+	// === Reuse the smallest released range that fits, otherwise grow the table
+	PathID path = INVALID_PATH;
+	size_t freeIndex = 0;
+	for (size_t i = 0; i < m_FreePaths.size(); i++) {
+		const Path& candidate = m_Paths[m_FreePaths[i]];
+		if (candidate.capacity >= _count && (path == INVALID_PATH || candidate.capacity < m_Paths[path].capacity)) {
+			path = m_FreePaths[i];
+			freeIndex = i;
+		}
+	}
+	if (path != INVALID_PATH) {
+		m_FreePaths[freeIndex] = m_FreePaths.back();
+		m_FreePaths.pop_back();
+	}
+	else {
+		Path newPath = { (unsigned int)m_PathPoints.size(), _count, 0, 0 };
+		m_PathPoints.resize(m_PathPoints.size() + _count);
+		path = (PathID)m_Paths.size();
+		m_Paths.push_back(newPath);
+	}
+
+	Path& created = m_Paths[path];
+	for (unsigned int i = 0; i < _count; i++)
+		m_PathPoints[created.first + i] = _waypoints[i];
+	created.count = _count;
+	created.references = 1;
+	return path;
+}
+
+void MovementSystem::AddPathReference(PathID _path)
+{
+	m_Paths[_path].references++;
+}
+
+void MovementSystem::ReleasePath(PathID _path)
+{
+	if (--m_Paths[_path].references == 0)
+		m_FreePaths.push_back(_path);
+}
+
+void MovementSystem::ReservePaths(size_t _pointCount)
+{
+	m_PathPoints.reserve(_pointCount);
+}
+// ================= //
+
+// ===== Agent State ===== //
+void MovementSystem::SetTarget(unsigned int _agent, const Vec3& _target)
+{
+	m_TargetX[_agent] = _target.x;
+	m_TargetY[_agent] = _target.y;
+	m_TargetZ[_agent] = _target.z;
+}
+
+void MovementSystem::SetPath(unsigned int _agent, PathID _path)
+{
+	// === Reference the new path first, it may be the one the agent already follows
+	if (_path != INVALID_PATH)
+		AddPathReference(_path);
+	if (m_AgentPaths[_agent] != INVALID_PATH)
+		ReleasePath(m_AgentPaths[_agent]);
+	m_AgentPaths[_agent] = _path;
+
+	unsigned int count = GetWaypointCount(_agent);
+	if (m_Cursors[_agent] >= count)
+		m_Cursors[_agent] = 0;
+	// === A patrol without waypoints has nowhere to go
+	if (count == 0)
+		m_Flags[_agent] &= ~MOVE_PATROL;
+	else if (!(m_Flags[_agent] & MOVE_DESTINATION))
+		SetTarget(_agent, GetWaypoint(_agent, m_Cursors[_agent]));
+}
+
+void MovementSystem::SetDestination(unsigned int _agent, const Vec3& _position)
+{
+	m_Flags[_agent] |= MOVE_DESTINATION;
+	SetTarget(_agent, _position);
+}
+
+void MovementSystem::ClearDestination(unsigned int _agent)
+{
+	m_Flags[_agent] &= ~MOVE_DESTINATION;
+	if (m_Flags[_agent] & MOVE_PATROL)
+		SetTarget(_agent, GetWaypoint(_agent, m_Cursors[_agent]));
+}
+
+void MovementSystem::Patrol(unsigned int _agent, unsigned int _startIndex)
+{
+	m_Flags[_agent] &= ~MOVE_DESTINATION;
+	if (GetWaypointCount(_agent) == 0)
+		return;
+	m_Flags[_agent] |= MOVE_PATROL;
+	m_Cursors[_agent] = _startIndex < GetWaypointCount(_agent) ? _startIndex : 0;
+	SetTarget(_agent, GetWaypoint(_agent, m_Cursors[_agent]));
+}
+
+void MovementSystem::StopPatrolling(unsigned int _agent)
+{
+	m_Flags[_agent] &= ~MOVE_PATROL;
+}
+
+bool MovementSystem::HasDestination(unsigned int _agent) const
+{
+	return (m_Flags[_agent] & MOVE_DESTINATION) != 0;
+}
+
+bool MovementSystem::IsPatrolling(unsigned int _agent) const
+{
+	return (m_Flags[_agent] & MOVE_PATROL) != 0;
+}
+
+// - Arrive
+// --- A reached destination is dropped, a reached waypoint moves the patrol on to the next one
+void MovementSystem::Arrive(unsigned int _agent)
+{
+	if (m_Flags[_agent] & MOVE_DESTINATION) {
+		// === Like before, the patrol only picks up again on the next update
+		m_Flags[_agent] &= ~MOVE_DESTINATION;
+		if (m_Flags[_agent] & MOVE_PATROL)
+			SetTarget(_agent, GetWaypoint(_agent, m_Cursors[_agent]));
+	}
+	else {
+		unsigned int cursor = m_Cursors[_agent] + 1;
+		m_Cursors[_agent] = cursor == GetWaypointCount(_agent) ? 0 : cursor;
+		SetTarget(_agent, GetWaypoint(_agent, m_Cursors[_agent]));
+	}
+}
+// ======================= //
+
+// ===== Interface ===== //
+// - UpdateRange
+// --- Agents [_begin, _end), each only touches its own agent state, world matrix and dirty flag
+size_t MovementSystem::UpdateRange(float _deltaTime, Mat4* _worldMatrices, unsigned char* _dirty, size_t _begin, size_t _end)
+{
+	size_t moved = 0;
+	size_t i = _begin;
+#if defined(MOVEMENT_SSE)
+	const __m128 deltaTime = _mm_set1_ps(_deltaTime);
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= _end; i += 4) {
+		// === Gather the positions out of the world matrices
+		Mat4* worlds[4] = { &_worldMatrices[m_Indexes[i]], &_worldMatrices[m_Indexes[i + 1]], &_worldMatrices[m_Indexes[i + 2]], &_worldMatrices[m_Indexes[i + 3]] };
+		__m128 x = _mm_setr_ps(worlds[0]->m[3][0], worlds[1]->m[3][0], worlds[2]->m[3][0], worlds[3]->m[3][0]);
+		__m128 y = _mm_setr_ps(worlds[0]->m[3][1], worlds[1]->m[3][1], worlds[2]->m[3][1], worlds[3]->m[3][1]);
+		__m128 z = _mm_setr_ps(worlds[0]->m[3][2], worlds[1]->m[3][2], worlds[2]->m[3][2], worlds[3]->m[3][2]);
+
+		// === Direction and distance to the target, the step never goes past it
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&m_TargetX[i]), x);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&m_TargetY[i]), y);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(&m_TargetZ[i]), z);
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		__m128 step = _mm_min_ps(_mm_mul_ps(_mm_loadu_ps(&m_Speed[i]), deltaTime), distance);
+		__m128 scale = _mm_and_ps(_mm_div_ps(step, distance), _mm_cmpgt_ps(distance, zero));
+
+		// === The distance left is known without measuring it again
+		float newX[4], newY[4], newZ[4], remaining[4];
+		_mm_storeu_ps(newX, _mm_add_ps(x, _mm_mul_ps(dx, scale)));
+		_mm_storeu_ps(newY, _mm_add_ps(y, _mm_mul_ps(dy, scale)));
+		_mm_storeu_ps(newZ, _mm_add_ps(z, _mm_mul_ps(dz, scale)));
+		_mm_storeu_ps(remaining, _mm_sub_ps(distance, step));
+
+		for (unsigned int k = 0; k < 4; k++) {
+			unsigned int agent = (unsigned int)i + k;
+			if (m_Flags[agent] == 0)
+				continue;
+			worlds[k]->m[3][0] = newX[k];
+			worlds[k]->m[3][1] = newY[k];
+			worlds[k]->m[3][2] = newZ[k];
+			_dirty[m_Indexes[agent]] = 1;
+			moved++;
+			if (remaining[k] < ARRIVAL_DISTANCE)
+				Arrive(agent);
+		}
+	}
+#endif
+	for (; i < _end; i++) {
+		if (m_Flags[i] == 0)
+			continue;
+		Mat4& world = _worldMatrices[m_Indexes[i]];
+		float dx = m_TargetX[i] - world.m[3][0], dy = m_TargetY[i] - world.m[3][1], dz = m_TargetZ[i] - world.m[3][2];
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		float step = m_Speed[i] * _deltaTime < distance ? m_Speed[i] * _deltaTime : distance;
+		float scale = distance > 0 ? step / distance : 0;
+		world.m[3][0] += dx * scale;
+		world.m[3][1] += dy * scale;
+		world.m[3][2] += dz * scale;
+		_dirty[m_Indexes[i]] = 1;
+		moved++;
+		if (distance - step < ARRIVAL_DISTANCE)
+			Arrive((unsigned int)i);
+	}
+	return moved;
+}
+
+size_t MovementSystem::Update(float _deltaTime, Mat4* _worldMatrices, unsigned char* _dirty, unsigned int _threadCount)
+{
+	size_t count = m_Owners.size();
+	size_t maxThreads = count / MIN_AGENTS_PER_THREAD;
+	size_t threadCount = _threadCount < maxThreads ? _threadCount : maxThreads;
+	threadCount = threadCount < MAX_THREADS ? threadCount : MAX_THREADS;
+	if (threadCount <= 1)
+		return UpdateRange(_deltaTime, _worldMatrices, _dirty, 0, count);
+
+	// === Split into chunks of whole SIMD groups, the calling thread takes the last one
+	size_t chunk = ((count + threadCount - 1) / threadCount + 3) & ~(size_t)3;
+	size_t moved[MAX_THREADS] = {};
+	thread workers[MAX_THREADS - 1];
+	for (size_t t = 0; t + 1 < threadCount; t++) {
+		size_t begin = t * chunk, end = begin + chunk < count ? begin + chunk : count;
+		size_t* result = &moved[t];
+		workers[t] = thread([=]() { *result = begin < end ? UpdateRange(_deltaTime, _worldMatrices, _dirty, begin, end) : 0; });
+	}
+	size_t begin = (threadCount - 1) * chunk;
+	moved[threadCount - 1] = begin < count ? UpdateRange(_deltaTime, _worldMatrices, _dirty, begin, count) : 0;
+
+	size_t total = 0;
+	for (size_t t = 0; t < threadCount; t++) {
+		if (t + 1 < threadCount)
+			workers[t].join();
+		total += moved[t];
+	}
+	return total;
+}
+// ===================== //
+
+// ===== Benchmark ===== //
+bool BenchmarkMovement(size_t _agentCount, unsigned int _frames)
+{
+	unsigned int hardwareThreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	unsigned int threadCounts[2] = { 1, hardwareThreads };
+	double frameTimes[2];
+	unsigned long long frameAllocations[2];
+	vector<Vec3> finalPositions[2];
+	Bounds unitBounds = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f }, { 0, 0, 0 }, 0.8660254f };
+
+	for (unsigned int run = 0; run < 2; run++) {
+		// === Same agents both times: a square patrol each, a few with a detour first
+		Scene scene;
+		scene.Reserve(_agentCount);
+		scene.GetMovementSystem().ReservePaths(_agentCount * 4);
+		vector<EntityID> entities(_agentCount);
+		vector<MoveComponent*> movers(_agentCount);
+		for (size_t i = 0; i < _agentCount; i++) {
+			float x = (float)(i % 1000) * 2.0f, z = (float)(i / 1000) * 2.0f;
+			entities[i] = scene.CreateEntity(Mat4Translation(x, 0, z), unitBounds, nullptr, ENTITY_DRAW);
+			movers[i] = new MoveComponent(&scene, entities[i]);
+			Vec3 waypoints[4] = { MakeVec3(x + 1, 0, z), MakeVec3(x + 1, 0, z + 1), MakeVec3(x, 0, z + 1), MakeVec3(x, 0, z) };
+			movers[i]->SetWaypoints(waypoints, 4);
+			movers[i]->SetSpeed(1.0f + (float)(i % 7) * 0.25f);
+			movers[i]->Patrol((unsigned int)(i % 4));
+			if (i % 16 == 0)
+				movers[i]->SetDestination(MakeVec3(x + 0.5f, 1, z + 0.5f));
+			scene.SetMover(entities[i], movers[i]);
+		}
+
+		// === Every frame another 1/32 of the agents gets a detour, retargeting must not touch the heap
+		Stopwatch stopwatch;
+		unsigned long long allocations = GetAllocationCount();
+		for (unsigned int frame = 0; frame < _frames; frame++) {
+			for (size_t i = frame % 32; i < _agentCount; i += 32) {
+				float x = (float)(i % 1000) * 2.0f, z = (float)(i / 1000) * 2.0f;
+				movers[i]->SetDestination(MakeVec3(x + 0.25f, 0.5f, z + 0.75f));
+			}
+			scene.UpdateMovers(1.0f / 60.0f, threadCounts[run]);
+		}
+		frameTimes[run] = stopwatch.ElapsedMilliseconds() / (double)(_frames > 0 ? _frames : 1);
+		frameAllocations[run] = GetAllocationCount() - allocations;
+
+		finalPositions[run].resize(_agentCount);
+		for (size_t i = 0; i < _agentCount; i++)
+			finalPositions[run][i] = scene.GetPosition(entities[i]);
+	}
+
+	// === Every agent only depends on itself, so the threads must not change a single bit
+	bool identical = true;
+	for (size_t i = 0; i < _agentCount && identical; i++)
+		identical = finalPositions[0][i].x == finalPositions[1][i].x && finalPositions[0][i].y == finalPositions[1][i].y
+			&& finalPositions[0][i].z == finalPositions[1][i].z;
+
+	double perAgent = 1000000.0 / (double)(_agentCount > 0 ? _agentCount : 1);
+	LogMessage("Movement: %u agents, 1 thread %.3f ms per frame (%.2f ns per agent), %u threads %.3f ms per frame (%.2f ns per agent)%s",
+		(unsigned int)_agentCount, frameTimes[0], frameTimes[0] * perAgent, hardwareThreads, frameTimes[1], frameTimes[1] * perAgent,
+		identical ? "" : ", RESULTS DIFFER");
+	// === Starting each worker thread allocates once, the movement itself never should
+	if (!IsCountingAllocations()) {
+		LogMessage("Movement: heap allocations NOT VERIFIED, build the Profile configuration (PROFILE_ALLOCATIONS) to count them");
+		return false;
+	}
+	LogMessage("Movement: %llu heap allocations in %u frames on 1 thread, %llu on %u threads%s", frameAllocations[0], _frames,
+		frameAllocations[1], hardwareThreads, frameAllocations[0] == 0 ? "" : ", EXPECTED NONE");
+	return identical && frameAllocations[0] == 0;
+}
+// ===================== //
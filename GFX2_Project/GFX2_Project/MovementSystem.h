@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Math.h"
+
+using std::vector;
+
+class MoveComponent;
+
+// - PathID
+// --- A waypoint path in the MovementSystem's path table, any number of agents may follow the same one
+typedef unsigned int PathID;
+static const PathID INVALID_PATH = 0xFFFFFFFF;
+
+// - MovementSystem
+// --- Every moving agent's state kept structure-of-arrays and advanced in one pass: the positions come
+// --- straight from the translation row of the world matrices, the step is computed 4 agents at a time,
+// --- and only the translation row is written back
+// --- MoveComponent is a handle into it, owned by the Scene
+// --- Waypoints live in one pooled table, so neither paths nor retargeting allocate once it has grown
+class MovementSystem
+{
+private:
+	// - Path
+	// --- A range of m_PathPoints, kept with its capacity when released so the range can be reused
+	struct Path
+	{
+		unsigned int first;
+		unsigned int capacity;
+		unsigned int count;
+		unsigned int references;
+	};
+
+	// === Dense, one element per agent
+	vector<MoveComponent*>	m_Owners;
+	vector<unsigned int>	m_Indexes;
+	vector<float>			m_TargetX;
+	vector<float>			m_TargetY;
+	vector<float>			m_TargetZ;
+	vector<float>			m_Speed;
+	vector<unsigned int>	m_Flags;
+	vector<PathID>			m_AgentPaths;
+	vector<unsigned int>	m_Cursors;
+	// === Path table
+	vector<Vec3>			m_PathPoints;
+	vector<Path>			m_Paths;
+	vector<PathID>			m_FreePaths;
+
+	const Vec3& GetWaypoint(unsigned int _agent, unsigned int _cursor) const { return m_PathPoints[m_Paths[m_AgentPaths[_agent]].first + _cursor]; }
+	unsigned int GetWaypointCount(unsigned int _agent) const { return m_AgentPaths[_agent] != INVALID_PATH ? m_Paths[m_AgentPaths[_agent]].count : 0; }
+	void SetTarget(unsigned int _agent, const Vec3& _target);
+	void Arrive(unsigned int _agent);
+	size_t UpdateRange(float _deltaTime, Mat4* _worldMatrices, unsigned char* _dirty, size_t _begin, size_t _end);
+
+public:
+	// ===== Constructor
+	MovementSystem();
+
+	// ===== Agents
+	// - AddAgent
+	// --- _index is the entity's dense Scene index, returns the agent _owner is told about when agents move
+	unsigned int AddAgent(MoveComponent* _owner, unsigned int _index);
+	void RemoveAgent(unsigned int _agent);
+	// - SetEntityIndex
+	// --- The Scene moved the agent's entity to another dense index
+	void SetEntityIndex(unsigned int _agent, unsigned int _index) { m_Indexes[_agent] = _index; }
+
+	// ===== Paths
+	// - CreatePath
+	// --- Copies _count waypoints into the table, the returned path holds one reference for the caller
+	PathID CreatePath(const Vec3* _waypoints, unsigned int _count);
+	void AddPathReference(PathID _path);
+	// - ReleasePath
+	// --- The path's range goes back to the pool once nothing references it
+	void ReleasePath(PathID _path);
+	// - ReservePaths
+	// --- Room for _pointCount waypoints, so creating paths up to that doesn't allocate
+	void ReservePaths(size_t _pointCount);
+	size_t GetPathPointCount() const { return m_PathPoints.size(); }
+
+	// ===== Agent State
+	// - SetPath
+	// --- The agent follows _path (or none) from now on, keeping a reference to it
+	void SetPath(unsigned int _agent, PathID _path);
+	// - SetDestination
+	// --- Goes to _position once, ahead of any patrol; the patrol carries on afterwards
+	// --- Stored by value, retargeting never allocates
+	void SetDestination(unsigned int _agent, const Vec3& _position);
+	void ClearDestination(unsigned int _agent);
+	void Patrol(unsigned int _agent, unsigned int _startIndex);
+	void StopPatrolling(unsigned int _agent);
+	void SetSpeed(unsigned int _agent, float _speed) { m_Speed[_agent] = _speed; }
+	float GetSpeed(unsigned int _agent) const { return m_Speed[_agent]; }
+	bool HasDestination(unsigned int _agent) const;
+	bool IsPatrolling(unsigned int _agent) const;
+
+	// ===== Interface
+	// - Update
+	// --- Moves every agent towards its target by speed * _deltaTime, marks the entities it moved in _dirty
+	// --- With _threadCount > 1 large batches are split across that many threads
+	// --- Returns the number of agents that moved
+	size_t Update(float _deltaTime, Mat4* _worldMatrices, unsigned char* _dirty, unsigned int _threadCount);
+
+	// ===== Accessors
+	size_t Size() const { return m_Owners.size(); }
+};
+
+// - BenchmarkMovement
+// --- Patrols _agentCount agents for _frames 60 Hz frames, on one thread and then on every hardware thread,
+// --- logs the cost per frame and per agent and the heap allocations per frame once the agents are set up; returns false
+// --- if the two runs ended in different places, the single threaded frames allocated, or, outside PROFILE_ALLOCATIONS
+// --- builds (the Profile configuration), the allocations could not be counted
+bool BenchmarkMovement(size_t _agentCount, unsigned int _frames);
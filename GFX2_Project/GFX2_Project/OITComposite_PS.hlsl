@@ -0,0 +1,23 @@
+struct P_INPUT
+{
+	float4 posH : SV_POSITION;
+};
+
+texture2D accumulationTexture : register(t0);
+texture2D weightTexture : register(t1);
+
+// - main
+// --- Weighted average of every transparent fragment, blended (SRC_ALPHA / INV_SRC_ALPHA) by the coverage
+// --- Must match OITComposite in WeightedBlendedOIT.cpp
+float4 main(P_INPUT _input) : SV_TARGET
+{
+	int3 texel = int3(_input.posH.xy, 0);
+	float4 accumulation = accumulationTexture.Load(texel);
+	float weight = weightTexture.Load(texel)[0];
+
+	// === Nothing transparent here
+	if (accumulation[3] == 1)
+		discard;
+
+	return float4(accumulation.rgb / max(weight, 1e-5), 1 - accumulation[3]);
+}
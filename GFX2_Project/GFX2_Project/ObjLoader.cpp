@@ -0,0 +1,214 @@
+#include "ObjLoader.h"
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Bounds.h"
+#include "Hash.h"
+#include "IndexPacking.h"
+#include "MappedFile.h"
+#include "MeshBuilder.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "ObjStream.h"
+#include "Profiling.h"
+#include "VertexPacking.h"
+
+using namespace DirectX;
+using std::vector;
+
+#define SAFE_RELEASE(p) { if(p) { p->Release(); p = nullptr; } }
+
+// === Direct3D 11 refuses any resource over 2048 MB, whatever the adapter
+static const unsigned long long MAX_BUFFER_BYTES = (unsigned long long)D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM * 1024 * 1024;
+
+// ===== Buffers ===== //
+// - CreateInitializedBuffer
+// --- A buffer holding _elementCount elements of _elementSize bytes from _data, sized in 64 bits so a big mesh can't wrap
+// --- Logs and returns false if it is over the resource limit or CreateBuffer fails, _buffer is then left null
+static bool CreateInitializedBuffer(ID3D11Device* _device, UINT _bindFlags, D3D11_USAGE _usage, const void* _data, unsigned int _elementSize, unsigned int _elementCount, ID3D11Buffer** _buffer)
+{
+	const char* kind = _bindFlags == D3D11_BIND_INDEX_BUFFER ? "index" : "vertex";
+	*_buffer = nullptr;
+	unsigned long long byteWidth = (unsigned long long)_elementSize * _elementCount;
+	if (byteWidth == 0 || byteWidth > MAX_BUFFER_BYTES) {
+		LogMessage("ObjLoader: a %s buffer of %llu bytes is outside the 1 byte to %llu MB Direct3D 11 allows", kind, byteWidth, MAX_BUFFER_BYTES >> 20);
+		return false;
+	}
+
+	D3D11_BUFFER_DESC bufferDesc;
+	D3D11_SUBRESOURCE_DATA initData;
+	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+	bufferDesc.BindFlags = _bindFlags;
+	bufferDesc.ByteWidth = (UINT)byteWidth;
+	bufferDesc.CPUAccessFlags = NULL;
+	bufferDesc.MiscFlags = 0;
+	bufferDesc.Usage = _usage;
+
+	initData.pSysMem = _data;
+	initData.SysMemPitch = 0;
+	initData.SysMemSlicePitch = 0;
+
+	HRESULT result = _device->CreateBuffer(&bufferDesc, &initData, _buffer);
+	if (FAILED(result)) {
+		LogMessage("ObjLoader: CreateBuffer of a %llu byte %s buffer failed with 0x%08X", byteWidth, kind, (unsigned int)result);
+		*_buffer = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool CreateIndexBuffer(ID3D11Device* _device, Object* _object, const unsigned int* _indexes, unsigned int _indexCount, unsigned int _vertexCount)
+{
+	vector<IndexRange> ranges;
+	vector<unsigned short> packedIndexes;
+	const void* indexData = _indexes;
+	unsigned int indexSize = sizeof(unsigned int);
+	if (BuildIndexRanges16(_indexes, _indexCount, _vertexCount, &ranges)) {
+		packedIndexes.resize(_indexCount);
+		PackIndexes16(_indexes, ranges, packedIndexes.data());
+		indexData = packedIndexes.data();
+		indexSize = sizeof(unsigned short);
+	}
+
+	// == Without a buffer there is nothing to draw
+	_object->IndexRanges.clear();
+	if (!CreateInitializedBuffer(_device, D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_DEFAULT, indexData, indexSize, _indexCount, &_object->pIndexBuffer)) {
+		_object->NumIndexes = 0;
+		return false;
+	}
+	// == Set the Index Format, a single range starting at vertex 0 needs no extra draws
+	_object->IndexFormat = indexSize == sizeof(unsigned short) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	if (ranges.size() > 1)
+		_object->IndexRanges = ranges;
+	// == Set the Number of Indexes
+	_object->NumIndexes = _indexCount;
+	return true;
+}
+
+bool CreateMeshBuffers(ID3D11Device* _device, Object* _object, const Vertex* _vertices, unsigned int _vertexCount, const unsigned int* _indexes, unsigned int _indexCount, const char* _path)
+{
+	// == Bounds
+	Bounds bounds = ComputeBounds(_vertices, _vertexCount, sizeof(Vertex));
+	_object->SetLocalBounds(bounds);
+	// == Keep the Mesh for Static Batching, before packing
+	if (_object->KeepMeshData) {
+		_object->MeshVertices.assign(_vertices, _vertices + _vertexCount);
+		_object->MeshIndexes.assign(_indexes, _indexes + _indexCount);
+	}
+
+	// == Pack the Vertices
+	const void* vertexData = _vertices;
+	unsigned int vertexSize = sizeof(Vertex);
+	vector<Vertex_Packed> packedVertices;
+	if (_object->Format == VERTEX_FORMAT_PACKED) {
+		VertexQuantization quantization = ComputeVertexQuantization(bounds.min, bounds.max);
+		packedVertices.resize(_vertexCount);
+		PackVertices(_vertices, _vertexCount, quantization, packedVertices.data());
+		_object->PositionScale = XMFLOAT4(quantization.scale[0], quantization.scale[1], quantization.scale[2], 0);
+		_object->PositionOffset = XMFLOAT4(quantization.offset[0], quantization.offset[1], quantization.offset[2], 0);
+		vertexData = packedVertices.data();
+		vertexSize = sizeof(Vertex_Packed);
+
+		VertexPackingError error = GetPackingErrorBounds(quantization);
+		LogMessage("VertexPacking: %s, %u vertices, %llu -> %llu bytes (%llu saved), position error <= %.6f %.6f %.6f", _path, _vertexCount,
+			(unsigned long long)_vertexCount * sizeof(Vertex), (unsigned long long)_vertexCount * vertexSize, (unsigned long long)_vertexCount * (sizeof(Vertex) - sizeof(Vertex_Packed)),
+			error.position[0], error.position[1], error.position[2]);
+	}
+
+	// == Vertex Buffer
+	bool created = CreateInitializedBuffer(_device, D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE, vertexData, vertexSize, _vertexCount, &_object->pVertexBuffer);
+	// == Index Buffer, an Object missing either one draws nothing
+	created = created && CreateIndexBuffer(_device, _object, _indexes, _indexCount, _vertexCount);
+	if (!created) {
+		SAFE_RELEASE(_object->pVertexBuffer);
+		SAFE_RELEASE(_object->pIndexBuffer);
+		_object->IndexRanges.clear();
+		_object->NumIndexes = 0;
+		LogMessage("ObjLoader: could not create the buffers of %s, %u vertices, %u indexes", _path, _vertexCount, _indexCount);
+		return false;
+	}
+	// == Set the VertexSize
+	_object->VertexSize = vertexSize;
+	return true;
+}
+// =================== //
+
+// ===== Loading ===== //
+void LoadObjFile_Thread(ModelData* _modelData)
+{
+	Stopwatch loadTimer;
+	MappedFile source;
+	if (!source.Open(_modelData->path)) {
+		LogMessage("ObjLoader: could not open %s", _modelData->path);
+		return;
+	}
+	unsigned long long sourceHash = HashBytes(source.GetData(), source.GetSize());
+	string cachePath = GetMeshCachePath(_modelData->path);
+
+	// === Warm start, hand the mapped cache straight to the buffers
+	MeshCacheFile cache;
+	_modelData->object->Format = _modelData->format;
+	if (cache.Open(cachePath.c_str(), source.GetSize(), sourceHash)) {
+		if (!CreateMeshBuffers(_modelData->device, _modelData->object, cache.GetVertices(), cache.GetVertexCount(), cache.GetIndexes(), cache.GetIndexCount(), _modelData->path))
+			return;
+		LogMessage("MeshCache: %s warm start, %u vertices, %u indexes in %.2f ms", _modelData->path, cache.GetVertexCount(), cache.GetIndexCount(), loadTimer.ElapsedMilliseconds());
+		return;
+	}
+
+	// === Cold start for a huge file, stream it into the cache and load that
+	if (source.GetSize() >= OBJ_STREAMING_THRESHOLD) {
+		MeshCacheWriter writer;
+		ObjStreamStats stats;
+		if (!writer.Begin(cachePath.c_str(), source.GetSize(), sourceHash) ||
+			!StreamObjData(source.GetData(), source.GetEnd(), &writer, OBJ_STREAM_DEFAULT_BUDGET, &stats) || !writer.Finish()) {
+			LogMessage("ObjStream: could not stream %s into %s", _modelData->path, cachePath.c_str());
+			return;
+		}
+		VertexCacheStats before, after;
+		writer.GetCacheStats(&before, &after);
+		LogMessage("ObjStream: %s, %llu blocks, %llu vertices, %llu indexes, peak working memory %.1f MB", _modelData->path,
+			stats.blockCount, stats.vertexCount, stats.indexCount, stats.peakWorkingMemory / (1024.0 * 1024.0));
+		LogMessage("MeshOptimizer: %s, per block ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", _modelData->path, before.acmr, after.acmr, before.atvr, after.atvr);
+		if (!cache.Open(cachePath.c_str(), source.GetSize(), sourceHash)) {
+			LogMessage("MeshCache: could not open %s after streaming %s", cachePath.c_str(), _modelData->path);
+			return;
+		}
+		if (!CreateMeshBuffers(_modelData->device, _modelData->object, cache.GetVertices(), cache.GetVertexCount(), cache.GetIndexes(), cache.GetIndexCount(), _modelData->path))
+			return;
+		LogMessage("MeshCache: %s streamed cold start in %.2f ms", _modelData->path, loadTimer.ElapsedMilliseconds());
+		return;
+	}
+
+	// === Cold start, load the Data from the file
+	ObjRawData rawData;
+	if (!ParseObjData(source.GetData(), source.GetEnd(), &rawData, 0)) {
+		LogMessage("ObjLoader: could not parse %s", _modelData->path);
+		return;
+	}
+	double parseTime = loadTimer.ElapsedMilliseconds();
+
+	// === Weld the corners into unique vertices, setting up the actual mesh
+	MeshData meshData;
+	Stopwatch weldTimer;
+	BuildIndexedMesh(rawData, &meshData);
+	LogMessage("MeshBuilder: %s, %u corners -> %u vertices, %u indexes, parse %.2f ms, weld %.2f ms", _modelData->path,
+		(unsigned int)rawData.corners.size(), (unsigned int)meshData.vertices.size(), (unsigned int)meshData.indexes.size(), parseTime, weldTimer.ElapsedMilliseconds());
+
+	// === Reorder for the post-transform cache, overdraw and vertex fetch
+	VertexCacheStats before, after;
+	Stopwatch optimizeTimer;
+	OptimizeMesh(&meshData, MeshOptimizeOptions(), &before, &after);
+	LogMessage("MeshOptimizer: %s, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f in %.2f ms", _modelData->path,
+		before.acmr, after.acmr, before.atvr, after.atvr, optimizeTimer.ElapsedMilliseconds());
+
+	// === Setup the Object, the cache is still worth writing if the buffers failed
+	CreateMeshBuffers(_modelData->device, _modelData->object, meshData.vertices.data(), (unsigned int)meshData.vertices.size(), meshData.indexes.data(), (unsigned int)meshData.indexes.size(), _modelData->path);
+
+	// === Cache the result for the next run
+	if (!WriteMeshCache(cachePath.c_str(), meshData, source.GetSize(), sourceHash))
+		LogMessage("MeshCache: could not write %s", cachePath.c_str());
+	LogMessage("MeshCache: %s cold start in %.2f ms", _modelData->path, loadTimer.ElapsedMilliseconds());
+}
+// =================== //
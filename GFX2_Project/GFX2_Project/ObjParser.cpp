@@ -0,0 +1,450 @@
+#include "ObjParser.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "MappedFile.h"
+#include "ObjTokenizer.h"
+#include "Profiling.h"
+
+using std::thread;
+
+// ===== Chunks ===== //
+// - ObjRelativeIndex
+// --- A negative obj index, stored relative to the start of its chunk until the chunks are stitched
+struct ObjRelativeIndex
+{
+	size_t corner;
+	int attribute;
+	long long value;
+};
+
+// - ObjChunk
+// --- Everything parsed from one line-aligned slice of the file
+struct ObjChunk
+{
+	ObjRawData data;
+	vector<ObjRelativeIndex> relativeIndexes;
+	bool valid;
+};
+
+// - ParsedCorner
+// --- One v/vt/vn corner straight out of the file, 0-based and possibly chunk relative
+struct ParsedCorner
+{
+	long long index[3];
+	bool relative[3];
+};
+
+static const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+static inline unsigned int& CornerAttribute(ObjFaceCorner& _corner, int _attribute)
+{
+	return _attribute == 0 ? _corner.position : _attribute == 1 ? _corner.uv : _corner.normal;
+}
+
+// - ReadCorner
+// --- Parses "v/vt/vn" into _corner, returns nullptr on malformed input
+static const char* ReadCorner(const char* _p, const char* _end, const ObjRawData& _data, ParsedCorner* _corner)
+{
+	size_t counts[3] = { _data.positions.size(), _data.uvs.size(), _data.normals.size() };
+	for (int attribute = 0; attribute < 3; attribute++) {
+		if (attribute > 0 && (_p >= _end || *_p++ != '/'))
+			return nullptr;
+		int index;
+		if (!(_p = ParseIndex(_p, _end, &index)) || index == 0)
+			return nullptr;
+		// == Positive indexes are absolute, negative ones count back from the data read so far
+		_corner->relative[attribute] = index < 0;
+		_corner->index[attribute] = index > 0 ? index - 1 : (long long)counts[attribute] + index;
+	}
+	return _p;
+}
+
+static void EmitCorner(const ParsedCorner& _parsed, ObjChunk* _chunk)
+{
+	ObjFaceCorner corner;
+	for (int attribute = 0; attribute < 3; attribute++) {
+		if (_parsed.relative[attribute]) {
+			ObjRelativeIndex relative = { _chunk->data.corners.size(), attribute, _parsed.index[attribute] };
+			_chunk->relativeIndexes.push_back(relative);
+			CornerAttribute(corner, attribute) = 0;
+		}
+		else {
+			CornerAttribute(corner, attribute) = (unsigned int)_parsed.index[attribute];
+		}
+	}
+	_chunk->data.corners.push_back(corner);
+}
+
+// - ParseObjChunk
+// --- Parses the whole lines in [_begin, _end) into _chunk
+static bool ParseObjChunk(const char* _begin, const char* _end, ObjChunk* _chunk)
+{
+	ObjRawData* rawData = &_chunk->data;
+	const char* p = _begin;
+	while (p < _end) {
+		p = SkipSpaces(p, _end);
+		ObjRecordType type = ReadRecordType(p, _end);
+		// === Positions, UVs and Normals
+		if (type == OBJ_RECORD_POSITION || type == OBJ_RECORD_UV || type == OBJ_RECORD_NORMAL) {
+			Vector3 value;
+			if (!(p = ReadAttribute(type, p, _end, &value)))
+				return false;
+			vector<Vector3>& attributes = type == OBJ_RECORD_POSITION ? rawData->positions : type == OBJ_RECORD_UV ? rawData->uvs : rawData->normals;
+			attributes.push_back(value);
+		}
+		// === Faces
+		else if (type == OBJ_RECORD_FACE) {
+			ParsedCorner first, previous, corner;
+			unsigned int cornerCount = 0;
+			while (true) {
+				p = SkipSpaces(p, _end);
+				if (p >= _end || *p == '\n' || *p == '\r' || *p == '#')
+					break;
+				if (!(p = ReadCorner(p, _end, *rawData, &corner)))
+					return false;
+
+				// == Fan the polygon into triangles
+				if (cornerCount == 0) {
+					first = corner;
+				}
+				else if (cornerCount >= 2) {
+					EmitCorner(first, _chunk);
+					EmitCorner(previous, _chunk);
+					EmitCorner(corner, _chunk);
+				}
+				previous = corner;
+				++cornerCount;
+			}
+			if (cornerCount < 3)
+				return false;
+		}
+		p = SkipLine(p, _end);
+	}
+	return true;
+}
+
+// - StitchObjChunks
+// --- Concatenates the chunks in file order, using prefix-summed offsets to place each one
+// --- and to turn chunk relative indexes into absolute ones
+static bool StitchObjChunks(vector<ObjChunk>& _chunks, ObjRawData* _rawData)
+{
+	size_t chunkCount = _chunks.size();
+	vector<size_t> positionOffsets(chunkCount + 1, 0), uvOffsets(chunkCount + 1, 0), normalOffsets(chunkCount + 1, 0), cornerOffsets(chunkCount + 1, 0);
+	for (size_t i = 0; i < chunkCount; i++) {
+		if (!_chunks[i].valid)
+			return false;
+		positionOffsets[i + 1] = positionOffsets[i] + _chunks[i].data.positions.size();
+		uvOffsets[i + 1] = uvOffsets[i] + _chunks[i].data.uvs.size();
+		normalOffsets[i + 1] = normalOffsets[i] + _chunks[i].data.normals.size();
+		cornerOffsets[i + 1] = cornerOffsets[i] + _chunks[i].data.corners.size();
+	}
+
+	// === A single chunk can simply be handed over
+	if (chunkCount == 1) {
+		_rawData->positions.swap(_chunks[0].data.positions);
+		_rawData->uvs.swap(_chunks[0].data.uvs);
+		_rawData->normals.swap(_chunks[0].data.normals);
+		_rawData->corners.swap(_chunks[0].data.corners);
+	}
+	else {
+		_rawData->positions.resize(positionOffsets[chunkCount]);
+		_rawData->uvs.resize(uvOffsets[chunkCount]);
+		_rawData->normals.resize(normalOffsets[chunkCount]);
+		_rawData->corners.resize(cornerOffsets[chunkCount]);
+		vector<thread> workers;
+		for (size_t i = 0; i < chunkCount; i++) {
+			workers.push_back(thread([&, i]() {
+				const ObjRawData& data = _chunks[i].data;
+				if (!data.positions.empty())
+					memcpy(&_rawData->positions[positionOffsets[i]], data.positions.data(), data.positions.size() * sizeof(Vector3));
+				if (!data.uvs.empty())
+					memcpy(&_rawData->uvs[uvOffsets[i]], data.uvs.data(), data.uvs.size() * sizeof(Vector3));
+				if (!data.normals.empty())
+					memcpy(&_rawData->normals[normalOffsets[i]], data.normals.data(), data.normals.size() * sizeof(Vector3));
+				if (!data.corners.empty())
+					memcpy(&_rawData->corners[cornerOffsets[i]], data.corners.data(), data.corners.size() * sizeof(ObjFaceCorner));
+			}));
+		}
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	// === Resolve the negative indexes now that every chunk knows where it starts
+	for (size_t i = 0; i < chunkCount; i++) {
+		size_t bases[3] = { positionOffsets[i], uvOffsets[i], normalOffsets[i] };
+		for (size_t r = 0; r < _chunks[i].relativeIndexes.size(); r++) {
+			const ObjRelativeIndex& relative = _chunks[i].relativeIndexes[r];
+			long long value = relative.value + (long long)bases[relative.attribute];
+			if (value < 0)
+				return false;
+			CornerAttribute(_rawData->corners[cornerOffsets[i] + relative.corner], relative.attribute) = (unsigned int)value;
+		}
+	}
+
+	// === Make sure every corner points at real data
+	for (size_t i = 0; i < _rawData->corners.size(); i++) {
+		const ObjFaceCorner& corner = _rawData->corners[i];
+		if (corner.position >= _rawData->positions.size() || corner.uv >= _rawData->uvs.size() || corner.normal >= _rawData->normals.size())
+			return false;
+	}
+	return true;
+}
+// ================== //
+
+// ===== Parsing ===== //
+bool ParseObjData(const char* _begin, const char* _end, ObjRawData* _rawData, unsigned int _threadCount)
+{
+	// === Small files aren't worth the threads
+	size_t size = _end - _begin;
+	if (_threadCount == 0)
+		_threadCount = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	size_t chunkCount = _threadCount;
+	if (size / MIN_CHUNK_BYTES + 1 < chunkCount)
+		chunkCount = size / MIN_CHUNK_BYTES + 1;
+
+	// === Split the file on line boundaries
+	vector<const char*> boundaries(chunkCount + 1);
+	boundaries[0] = _begin;
+	boundaries[chunkCount] = _end;
+	for (size_t i = 1; i < chunkCount; i++) {
+		const char* split = _begin + size * i / chunkCount;
+		split = split > boundaries[i - 1] ? SkipLine(split, _end) : boundaries[i - 1];
+		boundaries[i] = split;
+	}
+
+	// === Parse every chunk, the calling thread takes the first one
+	vector<ObjChunk> chunks(chunkCount);
+	vector<thread> workers;
+	for (size_t i = 1; i < chunkCount; i++) {
+		workers.push_back(thread([&, i]() {
+			chunks[i].valid = ParseObjChunk(boundaries[i], boundaries[i + 1], &chunks[i]);
+		}));
+	}
+	chunks[0].valid = ParseObjChunk(boundaries[0], boundaries[1], &chunks[0]);
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	return StitchObjChunks(chunks, _rawData);
+}
+
+bool LoadObjRawData(const char* _path, ObjRawData* _rawData, unsigned int _threadCount)
+{
+	Stopwatch timer;
+	MappedFile file;
+	if (!file.Open(_path))
+		return false;
+
+	bool result = ParseObjData(file.GetData(), file.GetEnd(), _rawData, _threadCount);
+
+	double milliseconds = timer.ElapsedMilliseconds();
+	double megabytes = file.GetSize() / (1024.0 * 1024.0);
+	LogMessage("ObjParser: %s, %.2f MB in %.2f ms (%.1f MB/s)", _path, megabytes, milliseconds, milliseconds > 0 ? megabytes / (milliseconds / 1000.0) : 0.0);
+	return result;
+}
+
+bool LoadObjFile(ObjectData* _objectData)
+{
+	ObjRawData rawData;
+	if (!LoadObjRawData(_objectData->path, &rawData))
+		return false;
+
+	// === Cycle through each triangle
+	size_t cornerCount = rawData.corners.size();
+	_objectData->vertices.resize(cornerCount);
+	_objectData->uvs.resize(cornerCount);
+	_objectData->normals.resize(cornerCount);
+	for (size_t i = 0; i < cornerCount; i++) {
+		const ObjFaceCorner& corner = rawData.corners[i];
+		_objectData->vertices[i] = rawData.positions[corner.position];
+		_objectData->uvs[i] = rawData.uvs[corner.uv];
+		_objectData->normals[i] = rawData.normals[corner.normal];
+	}
+	return true;
+}
+// =================== //
+
+// ===== Checks ===== //
+// - AppendLine
+// --- printf style, onto the end of _text
+static void AppendLine(string* _text, const char* _format, ...)
+{
+	char line[128];
+	va_list args;
+	va_start(args, _format);
+#ifdef _WIN32
+	int length = vsnprintf_s(line, sizeof(line), _TRUNCATE, _format, args);
+#else
+	int length = vsnprintf(line, sizeof(line), _format, args);
+#endif
+	va_end(args);
+	if (length > 0)
+		_text->append(line, length < (int)sizeof(line) ? length : sizeof(line) - 1);
+}
+
+void GenerateSyntheticObj(size_t _bytes, unsigned int _farEvery, string* _text)
+{
+	static const int ROW_VERTICES = 256;
+	_text->clear();
+	_text->reserve(_bytes + 64 * 1024);
+	unsigned int cell = 0;
+	for (int row = 0; _text->size() < _bytes || row < 2; row++) {
+		for (int column = 0; column < ROW_VERTICES; column++) {
+			float x = (float)column, z = (float)row, y = std::sin(x * 0.15f) * std::cos(z * 0.1f);
+			AppendLine(_text, "v %.4f %.4f %.4f\nvt %.4f %.4f\nvn %.4f %.4f %.4f\n",
+				x, y, z, x / ROW_VERTICES, std::fmod(z / ROW_VERTICES, 1.0f), -y * 0.3f, 1.0f, y * 0.2f);
+		}
+		if (row == 0)
+			continue;
+
+		// === -ROW_VERTICES is the first vertex of this row, -2 * ROW_VERTICES the first of the one before
+		for (int column = 0; column + 1 < ROW_VERTICES; column++, cell++) {
+			int a = column - 2 * ROW_VERTICES, b = a + 1, c = column - ROW_VERTICES, d = c + 1;
+			AppendLine(_text, "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, b, b, b, b, b, b, c, c, c, d, d, d);
+			// === Written relative too, -(row + 1) * ROW_VERTICES is the first vertex of the text, so copies can be appended
+			if (_farEvery > 0 && cell % _farEvery == 0) {
+				int first = column - (row + 1) * ROW_VERTICES;
+				AppendLine(_text, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", first, first, first, c, c, c, d, d, d);
+			}
+		}
+	}
+}
+
+// - MeasureObjParse
+// --- One parse of the mapped file at _path on a single thread, false if it could not be opened or parsed
+static bool MeasureObjParse(const char* _path, double* _milliseconds, size_t* _size)
+{
+	Stopwatch stopwatch;
+	MappedFile file;
+	ObjRawData rawData;
+	if (!file.Open(_path) || !ParseObjData(file.GetData(), file.GetEnd(), &rawData, 1))
+		return false;
+	*_milliseconds = stopwatch.ElapsedMilliseconds();
+	*_size = file.GetSize();
+	return true;
+}
+
+void BenchmarkObjParser(const char* const* _paths, unsigned int _pathCount, unsigned int _syntheticMegabytes)
+{
+	static const char* SYNTHETIC_PATH = "ObjParserBenchmark.obj";
+	static const unsigned int WARM_RUNS = 5;
+
+	// === The synthetic file goes through the disk like the models do
+	string text;
+	GenerateSyntheticObj((size_t)_syntheticMegabytes * 1024 * 1024, 0, &text);
+	FILE* file = nullptr;
+#ifdef _WIN32
+	fopen_s(&file, SYNTHETIC_PATH, "wb");
+#else
+	file = fopen(SYNTHETIC_PATH, "wb");
+#endif
+	bool written = file != nullptr && fwrite(text.data(), 1, text.size(), file) == text.size();
+	if (file != nullptr)
+		written = fclose(file) == 0 && written;
+	string().swap(text);
+	if (!written)
+		LogMessage("ObjParser: could not write %s", SYNTHETIC_PATH);
+
+	vector<const char*> paths(_paths, _paths + _pathCount);
+	if (written)
+		paths.push_back(SYNTHETIC_PATH);
+	for (size_t p = 0; p < paths.size(); p++) {
+		double cold = 0, warm = 0, milliseconds = 0;
+		size_t size = 0;
+		bool dropped = DropFileCache(paths[p]);
+		if (!MeasureObjParse(paths[p], &cold, &size)) {
+			LogMessage("ObjParser: could not parse %s", paths[p]);
+			continue;
+		}
+		for (unsigned int run = 0; run < WARM_RUNS; run++) {
+			if (MeasureObjParse(paths[p], &milliseconds, &size) && (run == 0 || milliseconds < warm))
+				warm = milliseconds;
+		}
+		double megabytes = size / (1024.0 * 1024.0);
+		LogMessage("ObjParser: %s, %.2f MB, cold %.2f ms (%.1f MB/s)%s, warm %.2f ms (%.1f MB/s)", paths[p], megabytes,
+			cold, cold > 0 ? megabytes / (cold / 1000.0) : 0.0, dropped ? "" : " but still cached",
+			warm, warm > 0 ? megabytes / (warm / 1000.0) : 0.0);
+	}
+	if (written)
+		remove(SYNTHETIC_PATH);
+}
+
+// - SameObjData
+// --- Byte for byte, so a float parsed differently would show even where it compares equal
+static bool SameObjData(const ObjRawData& _a, const ObjRawData& _b)
+{
+	return _a.positions.size() == _b.positions.size() && _a.uvs.size() == _b.uvs.size() && _a.normals.size() == _b.normals.size() &&
+		_a.corners.size() == _b.corners.size() &&
+		(_a.positions.empty() || memcmp(_a.positions.data(), _b.positions.data(), _a.positions.size() * sizeof(Vector3)) == 0) &&
+		(_a.uvs.empty() || memcmp(_a.uvs.data(), _b.uvs.data(), _a.uvs.size() * sizeof(Vector3)) == 0) &&
+		(_a.normals.empty() || memcmp(_a.normals.data(), _b.normals.data(), _a.normals.size() * sizeof(Vector3)) == 0) &&
+		(_a.corners.empty() || memcmp(_a.corners.data(), _b.corners.data(), _a.corners.size() * sizeof(ObjFaceCorner)) == 0);
+}
+
+bool CheckObjParserThreads()
+{
+	static const unsigned int THREAD_COUNTS[] = { 2, 3, 4, 7, 8, 16 };
+	bool passed = true;
+
+	// === 16 chunks of just over the minimum each; a row of faces points up to two rows of vertices back, so every
+	// === chunk starts with faces resolved against the chunk before it
+	string text;
+	GenerateSyntheticObj(17 * MIN_CHUNK_BYTES, 7, &text);
+	ObjRawData serial;
+	if (!ParseObjData(text.data(), text.data() + text.size(), &serial, 1)) {
+		LogMessage("ObjParserThreads: the serial parse of the synthetic obj FAILED");
+		return false;
+	}
+	for (size_t t = 0; t < sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]); t++) {
+		ObjRawData parallel;
+		if (!ParseObjData(text.data(), text.data() + text.size(), &parallel, THREAD_COUNTS[t]) || !SameObjData(serial, parallel)) {
+			LogMessage("ObjParserThreads: %u threads differ from the serial parse", THREAD_COUNTS[t]);
+			passed = false;
+		}
+	}
+
+	// === Reaching one vertex before the first is only caught once the chunks are stitched
+	AppendLine(&text, "f -%u/1/1 1/1/1 1/1/1\n", (unsigned int)serial.positions.size() + 1);
+	for (unsigned int threads = 1; threads <= 16; threads *= 2) {
+		ObjRawData rawData;
+		if (ParseObjData(text.data(), text.data() + text.size(), &rawData, threads)) {
+			LogMessage("ObjParserThreads: an index before the first vertex was accepted on %u threads", threads);
+			passed = false;
+		}
+	}
+
+	LogMessage("ObjParserThreads: %u MB, %u positions, %u corners, %s", (unsigned int)(text.size() >> 20), (unsigned int)serial.positions.size(),
+		(unsigned int)serial.corners.size(), passed ? "checks passed" : "checks FAILED");
+	return passed;
+}
+
+void BenchmarkObjParserThreads(unsigned int _megabytes)
+{
+	static const unsigned int THREAD_COUNTS[] = { 1, 2, 4, 8, 16 };
+	static const unsigned int RUNS = 3;
+
+	string text;
+	GenerateSyntheticObj((size_t)_megabytes * 1024 * 1024, 0, &text);
+	double megabytes = text.size() / (1024.0 * 1024.0), serial = 0;
+	for (size_t t = 0; t < sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]); t++) {
+		double best = 0;
+		for (unsigned int run = 0; run < RUNS; run++) {
+			ObjRawData rawData;
+			Stopwatch stopwatch;
+			ParseObjData(text.data(), text.data() + text.size(), &rawData, THREAD_COUNTS[t]);
+			double milliseconds = stopwatch.ElapsedMilliseconds();
+			if (run == 0 || milliseconds < best)
+				best = milliseconds;
+		}
+		if (t == 0)
+			serial = best;
+		LogMessage("ObjParserThreads: %.1f MB on %2u threads, %.2f ms (%.1f MB/s), %.2fx", megabytes, THREAD_COUNTS[t], best,
+			best > 0 ? megabytes / (best / 1000.0) : 0.0, best > 0 ? serial / best : 0.0);
+	}
+	LogMessage("ObjParserThreads: %u hardware threads", thread::hardware_concurrency());
+}
+// ================== //
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+struct Vector3
+{
+	float x, y, z;
+};
+
+// - ObjFaceCorner
+// --- One corner of a face, as 0-based indexes into the ObjRawData attribute arrays
+struct ObjFaceCorner
+{
+	unsigned int position, uv, normal;
+};
+
+// - ObjRawData
+// --- The attribute arrays exactly as they appear in the file, plus every triangle corner
+struct ObjRawData
+{
+	vector<Vector3> positions;
+	vector<Vector3> uvs;
+	vector<Vector3> normals;
+	vector<ObjFaceCorner> corners;
+};
+
+// - ObjectData
+// --- One expanded position / uv / normal per triangle corner
+struct ObjectData
+{
+	const char * path;
+	vector<Vector3> vertices;
+	vector<Vector3> uvs;
+	vector<Vector3> normals;
+};
+
+// ===== Parsing ===== //
+// - ParseObjData
+// --- Parses the v / vt / vn / f records of an in-memory obj file, everything else is skipped
+// --- Faces must be v/vt/vn, polygons with more than 3 corners are fanned into triangles
+// --- With more than one thread the file is split on line boundaries and the chunks are parsed in
+// --- parallel, the result is identical to the serial parse. A _threadCount of 0 uses every core
+// --- Returns false on a malformed face or an index outside of the attribute arrays
+bool ParseObjData(const char* _begin, const char* _end, ObjRawData* _rawData, unsigned int _threadCount = 0);
+
+// - LoadObjRawData
+// --- Memory maps the file at _path and runs ParseObjData over it, on every core unless told otherwise
+bool LoadObjRawData(const char* _path, ObjRawData* _rawData, unsigned int _threadCount = 0);
+
+// - LoadObjFile
+// --- Loads _objectData->path and expands every triangle corner into _objectData
+bool LoadObjFile(ObjectData* _objectData);
+// =================== //
+
+// ===== Checks ===== //
+// - GenerateSyntheticObj
+// --- About _bytes of obj text: rows of a wavy grid, a v / vt / vn line each per vertex and two triangles per cell
+// --- written with negative indexes back into the last two rows; every _farEvery-th cell (0 for none) adds a triangle
+// --- with one index back into the first row of the text, itself negative so the text can be repeated
+void GenerateSyntheticObj(size_t _bytes, unsigned int _farEvery, string* _text);
+
+// - BenchmarkObjParser
+// --- Parses each of _paths and a _syntheticMegabytes synthetic obj written next to them on one thread, once right
+// --- after dropping the file from the page cache (cold, the disk included) and then the best of a few runs with it
+// --- cached (warm); logs the MB/s of each
+void BenchmarkObjParser(const char* const* _paths, unsigned int _pathCount, unsigned int _syntheticMegabytes);
+
+// - CheckObjParserThreads
+// --- Parses a synthetic obj large enough for 16 chunks on 1 thread and on 2 - 16, whose chunk edges fall between
+// --- faces and the rows their negative indexes point back into; every array has to be byte-identical to the serial
+// --- parse, and a negative index reaching past the first vertex has to fail on any thread count. Logs every
+// --- difference, returns false if there was one
+bool CheckObjParserThreads();
+
+// - BenchmarkObjParserThreads
+// --- Parses a _megabytes synthetic obj from memory on 1, 2, 4, 8 and 16 threads, logs the best of a few runs of each
+// --- and its speedup over one thread
+void BenchmarkObjParserThreads(unsigned int _megabytes);
+// ================== //
@@ -0,0 +1,510 @@
+#include "ObjStream.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshBuilder.h"
+#include "ObjTokenizer.h"
+#include "Profiling.h"
+
+using std::string;
+using std::vector;
+
+// ===== AttributeStore ===== //
+// - AttributeStore
+// --- Answers "what is position / uv / normal N" without keeping every attribute in memory
+// --- Recent records come from a ring buffer, older ones are re-decoded from the mapped file
+// --- using a sparse index of record offsets and a small cache of decoded pages
+class AttributeStore
+{
+private:
+	static const int ATTRIBUTE_COUNT = 3;
+	static const unsigned long long FIRST_STRIDE = 64;
+
+	struct PageTag
+	{
+		unsigned long long	page;
+		int					attribute;
+		unsigned int		count;
+	};
+
+	const char*					m_pBegin;
+	const char*					m_pEnd;
+	unsigned long long			m_iCounts[ATTRIBUTE_COUNT];
+
+	// === File offset of every m_iStride-th record, the stride doubles whenever an index fills up
+	vector<unsigned long long>	m_Checkpoints[ATTRIBUTE_COUNT];
+	size_t						m_iMaxCheckpoints;
+	unsigned long long			m_iStride;
+
+	// === The newest records of each kind, most faces only reference these
+	vector<Vector3>				m_Recent[ATTRIBUTE_COUNT];
+	unsigned long long			m_iRecentMask;
+
+	// === Direct mapped cache of decoded pages, one page is m_iStride records
+	vector<Vector3>				m_PageData;
+	vector<PageTag>				m_PageTags;
+	size_t						m_iPageSlots;
+	unsigned long long			m_iPageDecodes;
+
+	void Coarsen();
+	void InvalidatePages();
+	const Vector3* DecodePage(int _attribute, unsigned long long _page, size_t _slot);
+
+public:
+	// ===== Constructor
+	AttributeStore(const char* _begin, const char* _end, size_t _memoryBudget);
+
+	// ===== Interface
+	// - Add
+	// --- Records the attribute read from the line starting at _line
+	void Add(int _attribute, const Vector3& _value, const char* _line);
+	// - Fetch
+	// --- Looks up a 0-based attribute index, returns false if it has not been read yet
+	bool Fetch(int _attribute, unsigned long long _index, Vector3* _value);
+
+	// ===== Accessors
+	unsigned long long GetCount(int _attribute) const { return m_iCounts[_attribute]; }
+	unsigned long long GetPageDecodes() const { return m_iPageDecodes; }
+	size_t GetMemoryUsage() const;
+};
+
+AttributeStore::AttributeStore(const char* _begin, const char* _end, size_t _memoryBudget)
+{
+	m_pBegin = _begin;
+	m_pEnd = _end;
+	m_iStride = FIRST_STRIDE;
+	m_iPageDecodes = 0;
+
+	// === A quarter for the offset index, a quarter for the ring buffers, half for the page cache
+	m_iMaxCheckpoints = _memoryBudget / 4 / ATTRIBUTE_COUNT / sizeof(unsigned long long);
+	if (m_iMaxCheckpoints < 2)
+		m_iMaxCheckpoints = 2;
+
+	size_t recentCount = 1;
+	while (recentCount * 2 * sizeof(Vector3) * ATTRIBUTE_COUNT <= _memoryBudget / 4)
+		recentCount *= 2;
+	m_iRecentMask = recentCount - 1;
+
+	size_t pageRecords = _memoryBudget / 2 / (sizeof(Vector3) + sizeof(PageTag) / FIRST_STRIDE + 1);
+	if (pageRecords < FIRST_STRIDE)
+		pageRecords = (size_t)FIRST_STRIDE;
+	m_iPageSlots = pageRecords / (size_t)m_iStride;
+	m_PageData.resize(pageRecords);
+	m_PageTags.resize(m_iPageSlots);
+	InvalidatePages();
+
+	for (int attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++) {
+		m_iCounts[attribute] = 0;
+		m_Checkpoints[attribute].reserve(m_iMaxCheckpoints);
+		m_Recent[attribute].resize(recentCount);
+	}
+}
+
+void AttributeStore::Add(int _attribute, const Vector3& _value, const char* _line)
+{
+	unsigned long long index = m_iCounts[_attribute];
+	if (index % m_iStride == 0) {
+		if (m_Checkpoints[_attribute].size() == m_iMaxCheckpoints)
+			Coarsen();
+		if (index % m_iStride == 0)
+			m_Checkpoints[_attribute].push_back((unsigned long long)(_line - m_pBegin));
+	}
+	m_Recent[_attribute][index & m_iRecentMask] = _value;
+	++m_iCounts[_attribute];
+}
+
+bool AttributeStore::Fetch(int _attribute, unsigned long long _index, Vector3* _value)
+{
+	unsigned long long count = m_iCounts[_attribute];
+	if (_index >= count)
+		return false;
+	if (count - _index <= m_iRecentMask + 1) {
+		*_value = m_Recent[_attribute][_index & m_iRecentMask];
+		return true;
+	}
+
+	unsigned long long page = _index / m_iStride;
+	size_t slot = (size_t)((page * 0x9E3779B97F4A7C15ULL + _attribute) % m_iPageSlots);
+	const PageTag& tag = m_PageTags[slot];
+	unsigned long long offset = _index - page * m_iStride;
+	const Vector3* records;
+	if (tag.attribute == _attribute && tag.page == page && offset < tag.count)
+		records = &m_PageData[slot * (size_t)m_iStride];
+	else
+		records = DecodePage(_attribute, page, slot);
+	if (offset >= m_PageTags[slot].count)
+		return false;
+	*_value = records[offset];
+	return true;
+}
+
+size_t AttributeStore::GetMemoryUsage() const
+{
+	size_t usage = m_PageData.capacity() * sizeof(Vector3) + m_PageTags.capacity() * sizeof(PageTag);
+	for (int attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++)
+		usage += m_Checkpoints[attribute].capacity() * sizeof(unsigned long long) + m_Recent[attribute].capacity() * sizeof(Vector3);
+	return usage;
+}
+
+// - Coarsen
+// --- Doubles the stride and keeps every other checkpoint, so the index never grows past its budget
+void AttributeStore::Coarsen()
+{
+	m_iStride *= 2;
+	for (int attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++) {
+		vector<unsigned long long>& checkpoints = m_Checkpoints[attribute];
+		size_t kept = (checkpoints.size() + 1) / 2;
+		for (size_t i = 0; i < kept; i++)
+			checkpoints[i] = checkpoints[i * 2];
+		checkpoints.resize(kept);
+	}
+
+	// === Pages grow with the stride, the cache keeps its size by holding fewer of them
+	m_iPageSlots = m_PageData.size() / (size_t)m_iStride;
+	if (m_iPageSlots == 0) {
+		m_iPageSlots = 1;
+		m_PageData.resize((size_t)m_iStride);
+	}
+	InvalidatePages();
+}
+
+void AttributeStore::InvalidatePages()
+{
+	for (size_t i = 0; i < m_PageTags.size(); i++) {
+		m_PageTags[i].page = 0;
+		m_PageTags[i].attribute = -1;
+		m_PageTags[i].count = 0;
+	}
+}
+
+// - DecodePage
+// --- Re-reads one page of records from the file, starting at its checkpoint
+const Vector3* AttributeStore::DecodePage(int _attribute, unsigned long long _page, size_t _slot)
+{
+	++m_iPageDecodes;
+	Vector3* records = &m_PageData[_slot * (size_t)m_iStride];
+	unsigned long long wanted = m_iCounts[_attribute] - _page * m_iStride;
+	if (wanted > m_iStride)
+		wanted = m_iStride;
+
+	unsigned int count = 0;
+	const char* p = m_pBegin + m_Checkpoints[_attribute][(size_t)_page];
+	while (count < wanted && p < m_pEnd) {
+		p = SkipSpaces(p, m_pEnd);
+		ObjRecordType type = ReadRecordType(p, m_pEnd);
+		if (type == _attribute) {
+			if (!ReadAttribute(type, p, m_pEnd, &records[count]))
+				break;
+			++count;
+		}
+		p = SkipLine(p, m_pEnd);
+	}
+
+	PageTag& tag = m_PageTags[_slot];
+	tag.page = _page;
+	tag.attribute = _attribute;
+	tag.count = count;
+	return records;
+}
+// ========================== //
+
+// ===== BlockBuilder ===== //
+// - BlockBuilder
+// --- Welds corners into a fixed size vertex / index block and hands it to the sink when full
+class BlockBuilder
+{
+private:
+	vector<Vertex>			m_Vertices;
+	vector<unsigned int>	m_Indexes;
+	WeldTable				m_WeldTable;
+	size_t					m_iMaxVertices;
+	size_t					m_iMaxIndexes;
+
+public:
+	// ===== Constructor
+	BlockBuilder(size_t _memoryBudget);
+
+	// ===== Interface
+	// - AddCorner
+	// --- Returns false if one of the corner's attributes can not be found
+	bool AddCorner(const ObjFaceCorner& _corner, AttributeStore& _attributes);
+	// - Flush
+	// --- Hands the current block to _sink and starts an empty one
+	bool Flush(IMeshSink* _sink, ObjStreamStats* _stats);
+
+	// ===== Accessors
+	bool HasRoomForTriangle() const { return m_Vertices.size() + 3 <= m_iMaxVertices && m_Indexes.size() + 3 <= m_iMaxIndexes; }
+	size_t GetMemoryUsage() const;
+};
+
+BlockBuilder::BlockBuilder(size_t _memoryBudget)
+{
+	// === The weld table gets up to a quarter (it is a power of two, kept half full),
+	// === the rest holds the vertices and about 6 indexes per vertex
+	size_t slotSize = sizeof(ObjFaceCorner) + sizeof(unsigned int);
+	size_t slotCount = 16;
+	while (slotCount * 2 * slotSize <= _memoryBudget / 4)
+		slotCount *= 2;
+	size_t remaining = _memoryBudget > slotCount * slotSize ? _memoryBudget - slotCount * slotSize : 0;
+	m_iMaxVertices = remaining / (sizeof(Vertex) + 6 * sizeof(unsigned int));
+	if (m_iMaxVertices > slotCount / 2)
+		m_iMaxVertices = slotCount / 2;
+	if (m_iMaxVertices < 3)
+		m_iMaxVertices = 3;
+	if (m_iMaxVertices > UINT_MAX / 6)
+		m_iMaxVertices = UINT_MAX / 6;
+	m_iMaxIndexes = m_iMaxVertices * 6;
+
+	m_Vertices.reserve(m_iMaxVertices);
+	m_Indexes.reserve(m_iMaxIndexes);
+	m_WeldTable.Reset(m_iMaxVertices);
+}
+
+bool BlockBuilder::AddCorner(const ObjFaceCorner& _corner, AttributeStore& _attributes)
+{
+	bool inserted;
+	unsigned int vertex = m_WeldTable.Insert(_corner, (unsigned int)m_Vertices.size(), &inserted);
+	if (inserted) {
+		Vector3 position, uv, normal;
+		if (!_attributes.Fetch(0, _corner.position, &position) || !_attributes.Fetch(1, _corner.uv, &uv) || !_attributes.Fetch(2, _corner.normal, &normal))
+			return false;
+		m_Vertices.push_back(Vertex(position.x, position.y, position.z, 1, uv.x, uv.y, uv.z, normal.x, normal.y, normal.z));
+	}
+	m_Indexes.push_back(vertex);
+	return true;
+}
+
+bool BlockBuilder::Flush(IMeshSink* _sink, ObjStreamStats* _stats)
+{
+	if (m_Indexes.empty())
+		return true;
+
+	MeshBlock block = { m_Vertices.data(), (unsigned int)m_Vertices.size(), m_Indexes.data(), (unsigned int)m_Indexes.size() };
+	if (!_sink->OnMeshBlock(block))
+		return false;
+	++_stats->blockCount;
+	_stats->vertexCount += block.vertexCount;
+	_stats->indexCount += block.indexCount;
+
+	m_Vertices.clear();
+	m_Indexes.clear();
+	m_WeldTable.Reset(m_iMaxVertices);
+	return true;
+}
+
+size_t BlockBuilder::GetMemoryUsage() const
+{
+	return m_Vertices.capacity() * sizeof(Vertex) + m_Indexes.capacity() * sizeof(unsigned int) + m_WeldTable.GetMemoryUsage();
+}
+// ======================== //
+
+// ===== Streaming ===== //
+// - ReadStreamCorner
+// --- Parses "v/vt/vn" into an absolute, 0-based corner, returns nullptr on malformed input or forward references
+static const char* ReadStreamCorner(const char* _p, const char* _end, const AttributeStore& _attributes, ObjFaceCorner* _corner)
+{
+	unsigned int* indexes[3] = { &_corner->position, &_corner->uv, &_corner->normal };
+	for (int attribute = 0; attribute < 3; attribute++) {
+		if (attribute > 0 && (_p >= _end || *_p++ != '/'))
+			return nullptr;
+		int index;
+		if (!(_p = ParseIndex(_p, _end, &index)) || index == 0)
+			return nullptr;
+		long long count = (long long)_attributes.GetCount(attribute);
+		long long absolute = index > 0 ? index - 1 : count + index;
+		if (absolute < 0 || absolute >= count || absolute > UINT_MAX)
+			return nullptr;
+		*indexes[attribute] = (unsigned int)absolute;
+	}
+	return _p;
+}
+
+bool StreamObjData(const char* _begin, const char* _end, IMeshSink* _sink, size_t _memoryBudget, ObjStreamStats* _stats)
+{
+	// === Half the budget finds attributes, the other half builds blocks
+	AttributeStore attributes(_begin, _end, _memoryBudget / 2);
+	BlockBuilder block(_memoryBudget / 2);
+	ObjStreamStats stats = { 0, 0, 0, 0, 0 };
+
+	const char* p = _begin;
+	bool valid = true;
+	while (valid && p < _end) {
+		const char* line = p = SkipSpaces(p, _end);
+		ObjRecordType type = ReadRecordType(p, _end);
+		// === Positions, UVs and Normals
+		if (type == OBJ_RECORD_POSITION || type == OBJ_RECORD_UV || type == OBJ_RECORD_NORMAL) {
+			Vector3 value;
+			if (!(p = ReadAttribute(type, p, _end, &value)))
+				valid = false;
+			else
+				attributes.Add(type, value, line);
+		}
+		// === Faces, fanned into triangles
+		else if (type == OBJ_RECORD_FACE) {
+			ObjFaceCorner first, previous, corner;
+			unsigned int cornerCount = 0;
+			while (valid) {
+				p = SkipSpaces(p, _end);
+				if (p >= _end || *p == '\n' || *p == '\r' || *p == '#')
+					break;
+				if (!(p = ReadStreamCorner(p, _end, attributes, &corner))) {
+					valid = false;
+					break;
+				}
+				if (cornerCount == 0) {
+					first = corner;
+				}
+				else if (cornerCount >= 2) {
+					if (!block.HasRoomForTriangle() && !block.Flush(_sink, &stats))
+						valid = false;
+					else
+						valid = block.AddCorner(first, attributes) && block.AddCorner(previous, attributes) && block.AddCorner(corner, attributes);
+				}
+				previous = corner;
+				++cornerCount;
+			}
+			valid = valid && cornerCount >= 3;
+		}
+		if (valid)
+			p = SkipLine(p, _end);
+	}
+	valid = valid && block.Flush(_sink, &stats);
+
+	// === Nothing is released before the end, so the final capacities are the peak
+	stats.peakWorkingMemory = attributes.GetMemoryUsage() + block.GetMemoryUsage();
+	stats.pageDecodes = attributes.GetPageDecodes();
+	if (_stats != nullptr)
+		*_stats = stats;
+	return valid;
+}
+
+bool StreamObjFile(const char* _path, IMeshSink* _sink, size_t _memoryBudget, ObjStreamStats* _stats)
+{
+	MappedFile file;
+	if (!file.Open(_path))
+		return false;
+	return StreamObjData(file.GetData(), file.GetEnd(), _sink, _memoryBudget, _stats);
+}
+// ===================== //
+
+// ===== Checks ===== //
+// - ObjStreamComparer
+// --- Expands every streamed triangle and compares it, corner by corner, with the whole file parse
+// --- _repeats is how many copies of the parsed text the streamed file holds back to back
+class ObjStreamComparer : public IMeshSink
+{
+private:
+	const ObjRawData&	m_Reference;
+	unsigned long long	m_iRepeats;
+	unsigned long long	m_iCorner;
+	bool				m_bSame;
+
+public:
+	ObjStreamComparer(const ObjRawData& _reference, unsigned long long _repeats = 1) : m_Reference(_reference), m_iRepeats(_repeats), m_iCorner(0), m_bSame(true) {}
+
+	bool OnMeshBlock(const MeshBlock& _block)
+	{
+		for (unsigned int i = 0; i < _block.indexCount && m_bSame; i++, m_iCorner++) {
+			if (m_iCorner >= m_Reference.corners.size() * m_iRepeats || _block.indexes[i] >= _block.vertexCount) {
+				m_bSame = false;
+				break;
+			}
+			const ObjFaceCorner& corner = m_Reference.corners[(size_t)(m_iCorner % m_Reference.corners.size())];
+			const Vector3& position = m_Reference.positions[corner.position];
+			const Vector3& uv = m_Reference.uvs[corner.uv];
+			const Vector3& normal = m_Reference.normals[corner.normal];
+			Vertex expected(position.x, position.y, position.z, 1, uv.x, uv.y, uv.z, normal.x, normal.y, normal.z);
+			m_bSame = memcmp(&expected, &_block.vertices[_block.indexes[i]], sizeof(Vertex)) == 0;
+		}
+		return true;
+	}
+
+	bool IsSame() const { return m_bSame && m_iCorner == m_Reference.corners.size() * m_iRepeats; }
+};
+
+// - CheckStreamRun
+// --- Streams _megabytes of synthetic obj under _budget, logs the outcome
+static bool CheckStreamRun(size_t _megabytes, size_t _budget)
+{
+	string text;
+	GenerateSyntheticObj(_megabytes * 1024 * 1024, 16, &text);
+	ObjRawData reference;
+	if (!ParseObjData(text.data(), text.data() + text.size(), &reference)) {
+		LogMessage("ObjStream: the reference parse of %u MB FAILED", (unsigned int)_megabytes);
+		return false;
+	}
+
+	ObjStreamComparer comparer(reference);
+	ObjStreamStats stats;
+	bool streamed = StreamObjData(text.data(), text.data() + text.size(), &comparer, _budget, &stats);
+	bool passed = streamed && comparer.IsSame() && stats.peakWorkingMemory <= _budget && stats.pageDecodes > 0;
+	LogMessage("ObjStream: %u MB under a %u KB budget, %llu blocks, peak working memory %u KB, %llu pages re-decoded%s%s", (unsigned int)_megabytes,
+		(unsigned int)(_budget >> 10), stats.blockCount, (unsigned int)(stats.peakWorkingMemory >> 10), stats.pageDecodes,
+		streamed && comparer.IsSame() ? "" : ", TRIANGLES DIFFER", passed ? "" : ", FAILED");
+	return passed;
+}
+
+bool CheckObjStream()
+{
+	bool passed = CheckStreamRun(OBJ_STREAM_DEFAULT_BUDGET / (1024 * 1024) + 16, OBJ_STREAM_DEFAULT_BUDGET);
+	passed = CheckStreamRun(8, 96 * 1024) && passed;
+	LogMessage("ObjStream: %s", passed ? "checks passed" : "checks FAILED");
+	return passed;
+}
+
+bool CheckLargeObjStream(unsigned int _gigabytes)
+{
+	static const char* LARGE_PATH = "ObjStreamCheck.obj";
+	static const unsigned long long GIGABYTE = 1024ull * 1024 * 1024;
+	if (sizeof(size_t) < 8) {
+		LogMessage("ObjStream: %u GB NOT VERIFIED, a 32-bit build cannot map the file", _gigabytes);
+		return false;
+	}
+
+	// === One default budget worth of text, repeated; its far faces point back to the first row of their own copy,
+	// === so past 4 GB they are re-decoded through 64-bit checkpoint offsets
+	string text;
+	GenerateSyntheticObj(OBJ_STREAM_DEFAULT_BUDGET, 16, &text);
+	ObjRawData reference;
+	if (!ParseObjData(text.data(), text.data() + text.size(), &reference)) {
+		LogMessage("ObjStream: the reference parse of the %u GB file FAILED", _gigabytes);
+		return false;
+	}
+	unsigned long long repeats = (_gigabytes * GIGABYTE + text.size() - 1) / text.size();
+
+	FILE* file = nullptr;
+#ifdef _WIN32
+	fopen_s(&file, LARGE_PATH, "wb");
+#else
+	file = fopen(LARGE_PATH, "wb");
+#endif
+	bool written = file != nullptr;
+	for (unsigned long long r = 0; r < repeats && written; r++)
+		written = fwrite(text.data(), 1, text.size(), file) == text.size();
+	if (file != nullptr)
+		written = fclose(file) == 0 && written;
+	unsigned long long size = repeats * text.size();
+	string().swap(text);
+	if (!written) {
+		LogMessage("ObjStream: could not write %u GB to %s", _gigabytes, LARGE_PATH);
+		remove(LARGE_PATH);
+		return false;
+	}
+
+	ObjStreamComparer comparer(reference, repeats);
+	ObjStreamStats stats;
+	bool streamed = StreamObjFile(LARGE_PATH, &comparer, OBJ_STREAM_DEFAULT_BUDGET, &stats);
+	remove(LARGE_PATH);
+	bool passed = streamed && comparer.IsSame() && stats.peakWorkingMemory <= OBJ_STREAM_DEFAULT_BUDGET && stats.pageDecodes > 0;
+	LogMessage("ObjStream: %.2f GB file under a %u KB budget, %llu blocks, peak working memory %u KB, %llu pages re-decoded%s%s",
+		size / (double)GIGABYTE, (unsigned int)(OBJ_STREAM_DEFAULT_BUDGET >> 10), stats.blockCount,
+		(unsigned int)(stats.peakWorkingMemory >> 10), stats.pageDecodes, streamed && comparer.IsSame() ? "" : ", TRIANGLES DIFFER",
+		passed ? "" : ", FAILED");
+	return passed;
+}
+// ================== //
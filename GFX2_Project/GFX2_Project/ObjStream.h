@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Vertex_Types.h"
+
+// - MeshBlock
+// --- One finished, self contained piece of a streamed mesh
+// --- The indexes are local to this block's vertices, the pointers are only valid during OnMeshBlock
+struct MeshBlock
+{
+	const Vertex*		vertices;
+	unsigned int		vertexCount;
+	const unsigned int*	indexes;
+	unsigned int		indexCount;
+};
+
+// - IMeshSink
+// --- Receives the blocks of a streamed mesh in file order
+class IMeshSink
+{
+public:
+	virtual ~IMeshSink() {}
+	// - OnMeshBlock
+	// --- Return false to stop the stream
+	virtual bool OnMeshBlock(const MeshBlock& _block) = 0;
+};
+
+// - ObjStreamStats
+// --- What a stream produced, and the most working memory it held at once
+struct ObjStreamStats
+{
+	unsigned long long	blockCount;
+	unsigned long long	vertexCount;
+	unsigned long long	indexCount;
+	size_t				peakWorkingMemory;
+	// === Pages of attributes re-read from the file because a face used one older than the ring buffers hold
+	unsigned long long	pageDecodes;
+};
+
+static const size_t OBJ_STREAM_DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+// ===== Streaming ===== //
+// - StreamObjData
+// --- Reads an in-memory obj file in a single pass and hands finished, welded blocks to _sink
+// --- Working memory (attribute lookup, caches and the block being built) stays under _memoryBudget
+// --- whatever the file size; the file itself is expected to be mapped, so it lives in the page cache
+// --- Vertices are welded within a block, a vertex used on both sides of a block edge is emitted twice
+bool StreamObjData(const char* _begin, const char* _end, IMeshSink* _sink, size_t _memoryBudget = OBJ_STREAM_DEFAULT_BUDGET, ObjStreamStats* _stats = nullptr);
+
+// - StreamObjFile
+// --- Memory maps the file at _path and runs StreamObjData over it
+bool StreamObjFile(const char* _path, IMeshSink* _sink, size_t _memoryBudget = OBJ_STREAM_DEFAULT_BUDGET, ObjStreamStats* _stats = nullptr);
+// ===================== //
+
+// ===== Checks ===== //
+// - CheckObjStream
+// --- Streams a synthetic obj bigger than the default budget under that budget, and a smaller one under 96 KB, which
+// --- keeps coarsening the offset index; both have faces reaching back to the first row of vertices, long gone from
+// --- the ring buffers. Every streamed triangle has to match the whole file parse, the peak
+// --- working memory has to stay within the budget and pages have to have been re-decoded. Logs every failure,
+// --- returns false if there was one
+// --- Both files live in memory and stay far below 4 GB, CheckLargeObjStream covers the 64-bit offsets
+bool CheckObjStream();
+
+// - CheckLargeObjStream
+// --- Opt-in, it writes _gigabytes of synthetic obj to a temporary file in the working directory, streams it through
+// --- StreamObjFile under the default budget and deletes it. Past 4 GB of file, faces reaching back to the first row
+// --- of their copy make the offset index re-decode pages at offsets that need all 64 bits. Returns false on a
+// --- mismatch, on a disk that cannot take the file and on a 32-bit build, which cannot map it
+bool CheckLargeObjStream(unsigned int _gigabytes);
+// ================== //
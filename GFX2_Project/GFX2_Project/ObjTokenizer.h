@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+
+#include "ObjParser.h"
+
+// ===== Tokenizer ===== //
+// --- Shared by ObjParser and ObjStream, nothing here reads past _end
+static const double OBJ_POWERS_OF_TEN[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool IsSpace(char _c)
+{
+	return _c == ' ' || _c == '\t';
+}
+
+inline bool IsDigit(char _c)
+{
+	return (unsigned char)(_c - '0') < 10;
+}
+
+inline const char* SkipSpaces(const char* _p, const char* _end)
+{
+	while (_p < _end && IsSpace(*_p))
+		++_p;
+	return _p;
+}
+
+// - SkipLine
+// --- Returns the first character of the next line
+inline const char* SkipLine(const char* _p, const char* _end)
+{
+	const char* newLine = (const char*)memchr(_p, '\n', _end - _p);
+	return newLine != nullptr ? newLine + 1 : _end;
+}
+
+// - ParseFloat
+// --- Parses [+-]digits[.digits][(e|E)[+-]digits] starting at _p
+// --- Returns the character after the number, or nullptr if there was no number
+inline const char* ParseFloat(const char* _p, const char* _end, float* _out)
+{
+	_p = SkipSpaces(_p, _end);
+	bool negative = false;
+	if (_p < _end && (*_p == '-' || *_p == '+')) {
+		negative = *_p == '-';
+		++_p;
+	}
+
+	// === Up to 18 significant digits go in the mantissa, the rest only move the exponent
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+	for (; _p < _end && IsDigit(*_p); ++_p) {
+		if (mantissa < 100000000000000000ULL)
+			mantissa = mantissa * 10 + (*_p - '0');
+		else
+			++exponent;
+		anyDigits = true;
+	}
+	if (_p < _end && *_p == '.') {
+		for (++_p; _p < _end && IsDigit(*_p); ++_p) {
+			if (mantissa < 100000000000000000ULL) {
+				mantissa = mantissa * 10 + (*_p - '0');
+				--exponent;
+			}
+			anyDigits = true;
+		}
+	}
+	if (!anyDigits)
+		return nullptr;
+
+	if (_p < _end && (*_p == 'e' || *_p == 'E')) {
+		const char* exponentStart = _p++;
+		bool negativeExponent = false;
+		if (_p < _end && (*_p == '-' || *_p == '+')) {
+			negativeExponent = *_p == '-';
+			++_p;
+		}
+		if (_p < _end && IsDigit(*_p)) {
+			int value = 0;
+			for (; _p < _end && IsDigit(*_p); ++_p) {
+				if (value < 10000)
+					value = value * 10 + (*_p - '0');
+			}
+			exponent += negativeExponent ? -value : value;
+		}
+		else {
+			// == Not an exponent after all, leave the 'e' for the caller
+			_p = exponentStart;
+		}
+	}
+
+	// === Powers of ten up to 22 are exact doubles, so one multiply / divide rounds correctly for obj sized numbers
+	double value = (double)mantissa;
+	if (mantissa != 0) {
+		if (exponent < 0)
+			value = -exponent <= 22 ? value / OBJ_POWERS_OF_TEN[-exponent] : value * pow(10.0, exponent);
+		else if (exponent > 0)
+			value = exponent <= 22 ? value * OBJ_POWERS_OF_TEN[exponent] : value * pow(10.0, exponent);
+	}
+	*_out = (float)(negative ? -value : value);
+	return _p;
+}
+
+// - ParseIndex
+// --- Parses a signed integer, returns nullptr if there was none
+inline const char* ParseIndex(const char* _p, const char* _end, int* _out)
+{
+	bool negative = false;
+	if (_p < _end && (*_p == '-' || *_p == '+')) {
+		negative = *_p == '-';
+		++_p;
+	}
+	if (_p >= _end || !IsDigit(*_p))
+		return nullptr;
+	int value = 0;
+	for (; _p < _end && IsDigit(*_p); ++_p)
+		value = value * 10 + (*_p - '0');
+	*_out = negative ? -value : value;
+	return _p;
+}
+// ===================== //
+
+// ===== Records ===== //
+enum ObjRecordType
+{
+	OBJ_RECORD_POSITION,
+	OBJ_RECORD_UV,
+	OBJ_RECORD_NORMAL,
+	OBJ_RECORD_FACE,
+	OBJ_RECORD_OTHER
+};
+
+// - ReadRecordType
+// --- Classifies the line starting at _p and moves _p past the record keyword
+inline ObjRecordType ReadRecordType(const char*& _p, const char* _end)
+{
+	if (_p + 1 >= _end)
+		return OBJ_RECORD_OTHER;
+	if (_p[0] == 'v') {
+		if (IsSpace(_p[1])) {
+			_p += 1;
+			return OBJ_RECORD_POSITION;
+		}
+		if (_p + 2 < _end && IsSpace(_p[2])) {
+			if (_p[1] == 't') {
+				_p += 2;
+				return OBJ_RECORD_UV;
+			}
+			if (_p[1] == 'n') {
+				_p += 2;
+				return OBJ_RECORD_NORMAL;
+			}
+		}
+	}
+	else if (_p[0] == 'f' && IsSpace(_p[1])) {
+		_p += 1;
+		return OBJ_RECORD_FACE;
+	}
+	return OBJ_RECORD_OTHER;
+}
+
+// - ReadAttribute
+// --- Parses the values of a v / vt / vn record, UVs are flipped to D3D's top-left origin
+// --- Returns nullptr on malformed input
+inline const char* ReadAttribute(ObjRecordType _type, const char* _p, const char* _end, Vector3* _value)
+{
+	if (!(_p = ParseFloat(_p, _end, &_value->x)) || !(_p = ParseFloat(_p, _end, &_value->y)))
+		return nullptr;
+	if (_type == OBJ_RECORD_UV) {
+		_value->y = 1 - _value->y;
+		_value->z = 0;
+		return _p;
+	}
+	return ParseFloat(_p, _end, &_value->z);
+}
+// ===================== //
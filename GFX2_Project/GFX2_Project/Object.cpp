@@ -1,23 +1,37 @@
 #include "Object.h"
 
+#include <cstring>
+
 #define SAFE_RELEASE(p) { if(p) { p->Release(); p = nullptr; } }
 
 // ===== Constructor / Destructor ===== //
 Object::Object()
 {
 	// === Initialize Members
-	XMStoreFloat4x4(&WorldMatrix, XMMatrixIdentity());
 	pVertexBuffer = nullptr;
 	pIndexBuffer = nullptr;
 	pInputLayout = nullptr;
 	pVertexShader = nullptr;
+	pInstancedInputLayout = nullptr;
+	pInstancedVertexShader = nullptr;
 	pPixelShader = nullptr;
 	pTexture = nullptr;
+	pShaderResourceView = nullptr;
+	pSamplerState = nullptr;
 	VertexSize = 0;
+	Format = VERTEX_FORMAT_FULL;
+	PositionScale = XMFLOAT4(1, 1, 1, 0);
+	PositionOffset = XMFLOAT4(0, 0, 0, 0);
 	NumIndexes = 0;
+	IndexFormat = DXGI_FORMAT_R32_UINT;
+	ShaderID = 0;
+	MaterialID = 0;
+	MeshID = 0;
+	KeepMeshData = false;
+	pStaticBatch = nullptr;
 
-	// === Initialize Components
-	pMoveComponent = nullptr;
+	// === Initialize Bounds
+	memset(&m_LocalBounds, 0, sizeof(m_LocalBounds));
 }
 
 Object::~Object()
@@ -25,19 +39,13 @@ Object::~Object()
 	SAFE_RELEASE(pVertexBuffer);
 	SAFE_RELEASE(pIndexBuffer);
 	SAFE_RELEASE(pInputLayout);
+	SAFE_RELEASE(pInstancedInputLayout);
 	SAFE_RELEASE(pTexture);
 	SAFE_RELEASE(pShaderResourceView);
 	SAFE_RELEASE(pSamplerState);
 	/* No need to release the shaders, as the main application will handle that */
 	// SAFE_RELEASE(pVertexShader);
+	// SAFE_RELEASE(pInstancedVertexShader);
 	// SAFE_RELEASE(pPixelShader);
 }
 // ==================================== //
-
-// ===== Interface ===== //
-void Object::Update(float _deltaTime)
-{
-	if (pMoveComponent != nullptr)
-		pMoveComponent->Update(_deltaTime);
-}
-// ===================== //
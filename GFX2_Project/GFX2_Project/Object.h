@@ -2,11 +2,20 @@
 
 #include <d3d11.h>
 #include <DirectXMath.h>
+#include <vector>
 
-#include "MoveComponent.h"
+#include "Bounds.h"
+#include "IndexPacking.h"
+#include "Vertex_Types.h"
 
 using namespace DirectX;
+using std::vector;
 
+struct StaticBatch;
+
+// - Object
+// --- Render resources of one model: buffers, shaders, texture and mesh bounds
+// --- Where it is drawn, and how often, is up to the Scene entities using it
 class Object
 {
 public:
@@ -15,24 +24,44 @@ public:
 	~Object();
 
 	// === Variables
-	XMFLOAT4X4 WorldMatrix;
 	ID3D11Buffer* pVertexBuffer;
 	ID3D11Buffer* pIndexBuffer;
 	ID3D11InputLayout* pInputLayout;
 	ID3D11VertexShader* pVertexShader;
+	// === Instanced drawing, null when the model has no instanced shader: world matrix and tint per instance
+	ID3D11InputLayout* pInstancedInputLayout;
+	ID3D11VertexShader* pInstancedVertexShader;
 	ID3D11PixelShader* pPixelShader;
 	ID3D11Resource* pTexture;
 	ID3D11ShaderResourceView* pShaderResourceView;
 	ID3D11SamplerState*	pSamplerState;
 	unsigned int VertexSize;
+	VertexFormat Format;
+	// === Packed vertices only: position = snorm * PositionScale + PositionOffset
+	XMFLOAT4 PositionScale;
+	XMFLOAT4 PositionOffset;
 	unsigned int NumIndexes;
-	float DistanceFromCamera;
+	DXGI_FORMAT IndexFormat;
+	// === Empty: draw all NumIndexes at once, otherwise one draw per range
+	vector<IndexRange> IndexRanges;
+	// === Render Queue ids: equal ids share the same shaders / texture and sampler / buffers and layout
+	unsigned int ShaderID;
+	unsigned int MaterialID;
+	unsigned int MeshID;
+	// === Static batching: with KeepMeshData set before loading the mesh stays in memory to be baked,
+	// === a baked model points at the batch it draws, whose pieces are culled one by one
+	bool KeepMeshData;
+	vector<Vertex> MeshVertices;
+	vector<unsigned int> MeshIndexes;
+	const StaticBatch* pStaticBatch;
 
-	// === Componets
-	MoveComponent* pMoveComponent;
+	// ===== Bounds
+	// - SetLocalBounds
+	// --- Bounds of the mesh in its own space, set by whoever builds the vertex buffer
+	void SetLocalBounds(const Bounds& _bounds) { m_LocalBounds = _bounds; }
+	const Bounds& GetLocalBounds() const { return m_LocalBounds; }
 
-	// ===== Functions
-	void Update(float _deltaTime);
-	XMFLOAT3 GetPosition() { return XMFLOAT3(WorldMatrix._41, WorldMatrix._42, WorldMatrix._43); }
+private:
+	Bounds m_LocalBounds;
 };
 
@@ -0,0 +1,197 @@
+#include "Profiling.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <chrono>
+#include <unistd.h>
+#endif
+
+// ===== Local Helpers ===== //
+static long long ReadTicks()
+{
+#ifdef _WIN32
+	LARGE_INTEGER ticks;
+	QueryPerformanceCounter(&ticks);
+	return ticks.QuadPart;
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static double TicksPerMillisecond()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return frequency.QuadPart / 1000.0;
+#else
+	return 1000000.0;
+#endif
+}
+// ========================= //
+
+// ===== Stopwatch ===== //
+Stopwatch::Stopwatch()
+{
+	Restart();
+}
+
+void Stopwatch::Restart()
+{
+	m_iStart = ReadTicks();
+}
+
+double Stopwatch::ElapsedMilliseconds() const
+{
+	return (ReadTicks() - m_iStart) / TicksPerMillisecond();
+}
+// ===================== //
+
+// ===== Allocations ===== //
+#ifdef PROFILE_ALLOCATIONS
+static std::atomic<unsigned long long> AllocationCount(0);
+
+static void* CountedAllocate(size_t _size)
+{
+	AllocationCount.fetch_add(1, std::memory_order_relaxed);
+	return malloc(_size > 0 ? _size : 1);
+}
+
+// === Only benchmark builds replace the global operator new; every form the runtime may call is defined, so none of
+// === them mixes the CRT heap with this one
+void* operator new(size_t _size)
+{
+	void* memory = CountedAllocate(_size);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t _size)
+{
+	void* memory = CountedAllocate(_size);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(size_t _size, const std::nothrow_t&) throw()
+{
+	return CountedAllocate(_size);
+}
+
+void* operator new[](size_t _size, const std::nothrow_t&) throw()
+{
+	return CountedAllocate(_size);
+}
+
+void operator delete(void* _memory) throw()
+{
+	free(_memory);
+}
+
+void operator delete[](void* _memory) throw()
+{
+	free(_memory);
+}
+
+void operator delete(void* _memory, const std::nothrow_t&) throw()
+{
+	free(_memory);
+}
+
+void operator delete[](void* _memory, const std::nothrow_t&) throw()
+{
+	free(_memory);
+}
+
+#if defined(__cpp_sized_deallocation) || (defined(_MSC_VER) && _MSC_VER >= 1900)
+void operator delete(void* _memory, size_t) throw()
+{
+	free(_memory);
+}
+
+void operator delete[](void* _memory, size_t) throw()
+{
+	free(_memory);
+}
+#endif
+
+bool IsCountingAllocations()
+{
+	return true;
+}
+
+unsigned long long GetAllocationCount()
+{
+	return AllocationCount.load(std::memory_order_relaxed);
+}
+#else
+bool IsCountingAllocations()
+{
+	return false;
+}
+
+unsigned long long GetAllocationCount()
+{
+	return 0;
+}
+#endif
+// ======================= //
+
+// ===== Memory ===== //
+bool GetMemoryUsage(MemoryUsage* _usage)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS_EX counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&counters, sizeof(counters)))
+		return false;
+	_usage->resident = counters.WorkingSetSize;
+	_usage->privateBytes = counters.PrivateUsage;
+#else
+	// === Pages: total, resident, resident and shared with a file
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (file == nullptr)
+		return false;
+	unsigned long total = 0, resident = 0, shared = 0;
+	int read = fscanf(file, "%lu %lu %lu", &total, &resident, &shared);
+	fclose(file);
+	if (read != 3)
+		return false;
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	_usage->resident = resident * pageSize;
+	_usage->privateBytes = (resident - shared) * pageSize;
+#endif
+	return true;
+}
+// ================== //
+
+// ===== Logging ===== //
+void LogMessage(const char* _format, ...)
+{
+	char buffer[1024];
+	va_list args;
+	va_start(args, _format);
+#ifdef _WIN32
+	vsnprintf_s(buffer, sizeof(buffer), _TRUNCATE, _format, args);
+#else
+	vsnprintf(buffer, sizeof(buffer), _format, args);
+#endif
+	va_end(args);
+#ifdef _WIN32
+	OutputDebugStringA(buffer);
+	OutputDebugStringA("\n");
+#else
+	fprintf(stderr, "%s\n", buffer);
+#endif
+}
+// =================== //
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+// - Stopwatch
+// --- High resolution timer for measuring loading and update costs
+// --- Starts running as soon as it is created
+class Stopwatch
+{
+private:
+	long long	m_iStart;
+
+public:
+	// ===== Constructor
+	Stopwatch();
+
+	// ===== Interface
+	void Restart();
+	double ElapsedMilliseconds() const;
+};
+
+// - IsCountingAllocations
+// --- Only builds with PROFILE_ALLOCATIONS defined, the Profile configuration, replace the global operator new to count;
+// --- Debug and Release leave the CRT heap alone
+bool IsCountingAllocations();
+// - GetAllocationCount
+// --- Number of operator new calls so far, from every thread; compare two readings to count the allocations in between.
+// --- Always 0 unless IsCountingAllocations
+unsigned long long GetAllocationCount();
+
+// - MemoryUsage
+// --- Resident is every page of the process in memory; private leaves out the file pages mapped in, which the OS
+// --- shares with its file cache and can drop at any time
+struct MemoryUsage
+{
+	size_t	resident;
+	size_t	privateBytes;
+};
+
+// - GetMemoryUsage
+// --- The process right now, false if the OS would not tell
+bool GetMemoryUsage(MemoryUsage* _usage);
+
+// - LogMessage
+// --- printf style logging, sent to the debugger output on Windows and stderr elsewhere
+void LogMessage(const char* _format, ...);
@@ -0,0 +1,673 @@
+#include "RenderContext.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "Profiling.h"
+
+// ===== Local Helpers ===== //
+// === Groups of m_iKnown that are a single binding
+enum KnownState
+{
+	KNOWN_TOPOLOGY			= 1 << 0,
+	KNOWN_INPUT_LAYOUT		= 1 << 1,
+	KNOWN_INDEX_BUFFER		= 1 << 2,
+	KNOWN_VERTEX_SHADER		= 1 << 3,
+	KNOWN_PIXEL_SHADER		= 1 << 4,
+	KNOWN_RASTERIZER		= 1 << 5,
+	KNOWN_VIEWPORTS			= 1 << 6,
+	KNOWN_BLEND				= 1 << 7,
+	KNOWN_DEPTH_STENCIL		= 1 << 8,
+	KNOWN_RENDER_TARGETS	= 1 << 9,
+};
+
+static const float DEFAULT_BLEND_FACTOR[4] = { 1, 1, 1, 1 };
+// === Window of a constant buffer bound without one: all of it
+static const unsigned int WHOLE_BUFFER[RENDER_CONSTANT_BUFFER_SLOTS] = { 0 };
+// === What a discarded buffer reads as until it is written again
+static const unsigned char DISCARDED_BYTE = 0xCD;
+
+// - SlotsMatch
+// --- True when every slot of the call is known and already holds its value; slots past _slotCount are never known
+template <typename T>
+static bool SlotsMatch(const T* _bound, unsigned int _known, unsigned int _slotCount, unsigned int _startSlot, unsigned int _count, const T* _values)
+{
+	if (_startSlot > _slotCount || _count > _slotCount - _startSlot)
+		return false;
+	for (unsigned int i = 0; i < _count; i++) {
+		unsigned int slot = _startSlot + i;
+		if (!(_known & (1u << slot)) || _bound[slot] != _values[i])
+			return false;
+	}
+	return true;
+}
+
+// - StoreSlots
+// --- Copies the tracked part of a call and marks those slots known
+template <typename T>
+static void StoreSlots(T* _bound, unsigned int* _known, unsigned int _slotCount, unsigned int _startSlot, unsigned int _count, const T* _values)
+{
+	for (unsigned int i = 0; i < _count && _startSlot + i < _slotCount; i++) {
+		_bound[_startSlot + i] = _values[i];
+		*_known |= 1u << (_startSlot + i);
+	}
+}
+
+// - ApplySlots
+// --- Same as StoreSlots for a context that tracks everything
+template <typename T>
+static void ApplySlots(T* _bound, unsigned int _slotCount, unsigned int _startSlot, unsigned int _count, const T* _values)
+{
+	for (unsigned int i = 0; i < _count && _startSlot + i < _slotCount; i++)
+		_bound[_startSlot + i] = _values[i];
+}
+
+static bool SameViewport(const RenderViewport& _a, const RenderViewport& _b)
+{
+	return _a.topLeftX == _b.topLeftX && _a.topLeftY == _b.topLeftY && _a.width == _b.width && _a.height == _b.height
+		&& _a.minDepth == _b.minDepth && _a.maxDepth == _b.maxDepth;
+}
+
+// - HashBytes
+// --- FNV-1a, a field at a time so padding between the fields of a RenderState never counts
+static void HashBytes(unsigned long long* _hash, const void* _data, size_t _size)
+{
+	const unsigned char* bytes = (const unsigned char*)_data;
+	for (size_t i = 0; i < _size; i++) {
+		*_hash ^= bytes[i];
+		*_hash *= 1099511628211ull;
+	}
+}
+
+static unsigned long long HashRenderState(const RenderState& _state)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	HashBytes(&hash, &_state.topology, sizeof(_state.topology));
+	HashBytes(&hash, &_state.inputLayout, sizeof(_state.inputLayout));
+	HashBytes(&hash, _state.vertexBuffers, sizeof(_state.vertexBuffers));
+	HashBytes(&hash, _state.vertexStrides, sizeof(_state.vertexStrides));
+	HashBytes(&hash, _state.vertexOffsets, sizeof(_state.vertexOffsets));
+	HashBytes(&hash, &_state.indexBuffer, sizeof(_state.indexBuffer));
+	HashBytes(&hash, &_state.indexFormat, sizeof(_state.indexFormat));
+	HashBytes(&hash, &_state.indexOffset, sizeof(_state.indexOffset));
+	HashBytes(&hash, &_state.vertexShader, sizeof(_state.vertexShader));
+	HashBytes(&hash, _state.vsConstantBuffers, sizeof(_state.vsConstantBuffers));
+	HashBytes(&hash, _state.vsConstantFirst, sizeof(_state.vsConstantFirst));
+	HashBytes(&hash, _state.vsConstantCounts, sizeof(_state.vsConstantCounts));
+	HashBytes(&hash, &_state.pixelShader, sizeof(_state.pixelShader));
+	HashBytes(&hash, _state.psConstantBuffers, sizeof(_state.psConstantBuffers));
+	HashBytes(&hash, _state.psShaderResources, sizeof(_state.psShaderResources));
+	HashBytes(&hash, _state.psSamplers, sizeof(_state.psSamplers));
+	HashBytes(&hash, &_state.rasterizerState, sizeof(_state.rasterizerState));
+	HashBytes(&hash, &_state.viewportCount, sizeof(_state.viewportCount));
+	HashBytes(&hash, _state.viewports, sizeof(RenderViewport) * _state.viewportCount);
+	HashBytes(&hash, &_state.blendState, sizeof(_state.blendState));
+	HashBytes(&hash, _state.blendFactor, sizeof(_state.blendFactor));
+	HashBytes(&hash, &_state.sampleMask, sizeof(_state.sampleMask));
+	HashBytes(&hash, &_state.depthStencilState, sizeof(_state.depthStencilState));
+	HashBytes(&hash, &_state.stencilRef, sizeof(_state.stencilRef));
+	HashBytes(&hash, &_state.renderTargetCount, sizeof(_state.renderTargetCount));
+	HashBytes(&hash, _state.renderTargets, sizeof(_state.renderTargets));
+	HashBytes(&hash, &_state.depthStencilView, sizeof(_state.depthStencilView));
+	return hash;
+}
+// ========================= //
+
+// ===== Render State ===== //
+void ResetRenderState(RenderState* _state)
+{
+	memset(_state, 0, sizeof(RenderState));
+	memcpy(_state->blendFactor, DEFAULT_BLEND_FACTOR, sizeof(DEFAULT_BLEND_FACTOR));
+	_state->sampleMask = 0xFFFFFFFF;
+}
+// ======================== //
+
+// ===== StateFilteringContext ===== //
+StateFilteringContext::StateFilteringContext(IRenderContext* _target)
+{
+	memset(&m_Frame, 0, sizeof(m_Frame));
+	memset(&m_LastFrame, 0, sizeof(m_LastFrame));
+	SetTarget(_target);
+}
+
+void StateFilteringContext::SetTarget(IRenderContext* _target)
+{
+	m_pTarget = _target;
+	Invalidate();
+}
+
+void StateFilteringContext::Invalidate()
+{
+	ResetRenderState(&m_Bound);
+	m_iKnown = 0;
+	m_iKnownVertexBuffers = 0;
+	m_iKnownVSConstantBuffers = 0;
+	m_iKnownPSConstantBuffers = 0;
+	m_iKnownPSShaderResources = 0;
+	m_iKnownPSSamplers = 0;
+}
+
+void StateFilteringContext::EndFrame()
+{
+	m_LastFrame = m_Frame;
+	memset(&m_Frame, 0, sizeof(m_Frame));
+}
+
+// - Filter
+// --- Counts the call, true when it has to reach the target
+bool StateFilteringContext::Filter(bool _unchanged)
+{
+	m_Frame.submitted++;
+	if (_unchanged)
+		m_Frame.filtered++;
+	return !_unchanged;
+}
+
+void StateFilteringContext::IASetPrimitiveTopology(unsigned int _topology)
+{
+	if (!Filter((m_iKnown & KNOWN_TOPOLOGY) && m_Bound.topology == _topology))
+		return;
+	m_Bound.topology = _topology;
+	m_iKnown |= KNOWN_TOPOLOGY;
+	m_pTarget->IASetPrimitiveTopology(_topology);
+}
+
+void StateFilteringContext::IASetInputLayout(ID3D11InputLayout* _layout)
+{
+	if (!Filter((m_iKnown & KNOWN_INPUT_LAYOUT) && m_Bound.inputLayout == _layout))
+		return;
+	m_Bound.inputLayout = _layout;
+	m_iKnown |= KNOWN_INPUT_LAYOUT;
+	m_pTarget->IASetInputLayout(_layout);
+}
+
+void StateFilteringContext::IASetVertexBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _strides, const unsigned int* _offsets)
+{
+	bool unchanged = SlotsMatch(m_Bound.vertexBuffers, m_iKnownVertexBuffers, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _buffers)
+		&& SlotsMatch(m_Bound.vertexStrides, m_iKnownVertexBuffers, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _strides)
+		&& SlotsMatch(m_Bound.vertexOffsets, m_iKnownVertexBuffers, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _offsets);
+	if (!Filter(unchanged))
+		return;
+	StoreSlots(m_Bound.vertexBuffers, &m_iKnownVertexBuffers, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _buffers);
+	StoreSlots(m_Bound.vertexStrides, &m_iKnownVertexBuffers, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _strides);
+	StoreSlots(m_Bound.vertexOffsets, &m_iKnownVertexBuffers, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _offsets);
+	m_pTarget->IASetVertexBuffers(_startSlot, _count, _buffers, _strides, _offsets);
+}
+
+void StateFilteringContext::IASetIndexBuffer(ID3D11Buffer* _buffer, unsigned int _format, unsigned int _offset)
+{
+	if (!Filter((m_iKnown & KNOWN_INDEX_BUFFER) && m_Bound.indexBuffer == _buffer && m_Bound.indexFormat == _format && m_Bound.indexOffset == _offset))
+		return;
+	m_Bound.indexBuffer = _buffer;
+	m_Bound.indexFormat = _format;
+	m_Bound.indexOffset = _offset;
+	m_iKnown |= KNOWN_INDEX_BUFFER;
+	m_pTarget->IASetIndexBuffer(_buffer, _format, _offset);
+}
+
+void StateFilteringContext::VSSetShader(ID3D11VertexShader* _shader)
+{
+	if (!Filter((m_iKnown & KNOWN_VERTEX_SHADER) && m_Bound.vertexShader == _shader))
+		return;
+	m_Bound.vertexShader = _shader;
+	m_iKnown |= KNOWN_VERTEX_SHADER;
+	m_pTarget->VSSetShader(_shader);
+}
+
+void StateFilteringContext::VSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers)
+{
+	bool unchanged = SlotsMatch(m_Bound.vsConstantBuffers, m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers)
+		&& SlotsMatch(m_Bound.vsConstantCounts, m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, WHOLE_BUFFER)
+		&& SlotsMatch(m_Bound.vsConstantFirst, m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, WHOLE_BUFFER);
+	if (!Filter(unchanged))
+		return;
+	StoreSlots(m_Bound.vsConstantBuffers, &m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers);
+	StoreSlots(m_Bound.vsConstantFirst, &m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, WHOLE_BUFFER);
+	StoreSlots(m_Bound.vsConstantCounts, &m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, WHOLE_BUFFER);
+	m_pTarget->VSSetConstantBuffers(_startSlot, _count, _buffers);
+}
+
+void StateFilteringContext::VSSetConstantBuffers1(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _firstConstants, const unsigned int* _constantCounts)
+{
+	bool unchanged = SlotsMatch(m_Bound.vsConstantBuffers, m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers)
+		&& SlotsMatch(m_Bound.vsConstantFirst, m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _firstConstants)
+		&& SlotsMatch(m_Bound.vsConstantCounts, m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _constantCounts);
+	if (!Filter(unchanged))
+		return;
+	StoreSlots(m_Bound.vsConstantBuffers, &m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers);
+	StoreSlots(m_Bound.vsConstantFirst, &m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _firstConstants);
+	StoreSlots(m_Bound.vsConstantCounts, &m_iKnownVSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _constantCounts);
+	m_pTarget->VSSetConstantBuffers1(_startSlot, _count, _buffers, _firstConstants, _constantCounts);
+}
+
+void StateFilteringContext::PSSetShader(ID3D11PixelShader* _shader)
+{
+	if (!Filter((m_iKnown & KNOWN_PIXEL_SHADER) && m_Bound.pixelShader == _shader))
+		return;
+	m_Bound.pixelShader = _shader;
+	m_iKnown |= KNOWN_PIXEL_SHADER;
+	m_pTarget->PSSetShader(_shader);
+}
+
+void StateFilteringContext::PSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers)
+{
+	if (!Filter(SlotsMatch(m_Bound.psConstantBuffers, m_iKnownPSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers)))
+		return;
+	StoreSlots(m_Bound.psConstantBuffers, &m_iKnownPSConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers);
+	m_pTarget->PSSetConstantBuffers(_startSlot, _count, _buffers);
+}
+
+void StateFilteringContext::PSSetShaderResources(unsigned int _startSlot, unsigned int _count, ID3D11ShaderResourceView* const* _views)
+{
+	if (!Filter(SlotsMatch(m_Bound.psShaderResources, m_iKnownPSShaderResources, RENDER_SHADER_RESOURCE_SLOTS, _startSlot, _count, _views)))
+		return;
+	StoreSlots(m_Bound.psShaderResources, &m_iKnownPSShaderResources, RENDER_SHADER_RESOURCE_SLOTS, _startSlot, _count, _views);
+	m_pTarget->PSSetShaderResources(_startSlot, _count, _views);
+}
+
+void StateFilteringContext::PSSetSamplers(unsigned int _startSlot, unsigned int _count, ID3D11SamplerState* const* _samplers)
+{
+	if (!Filter(SlotsMatch(m_Bound.psSamplers, m_iKnownPSSamplers, RENDER_SAMPLER_SLOTS, _startSlot, _count, _samplers)))
+		return;
+	StoreSlots(m_Bound.psSamplers, &m_iKnownPSSamplers, RENDER_SAMPLER_SLOTS, _startSlot, _count, _samplers);
+	m_pTarget->PSSetSamplers(_startSlot, _count, _samplers);
+}
+
+void StateFilteringContext::RSSetState(ID3D11RasterizerState* _state)
+{
+	if (!Filter((m_iKnown & KNOWN_RASTERIZER) && m_Bound.rasterizerState == _state))
+		return;
+	m_Bound.rasterizerState = _state;
+	m_iKnown |= KNOWN_RASTERIZER;
+	m_pTarget->RSSetState(_state);
+}
+
+void StateFilteringContext::RSSetViewports(unsigned int _count, const RenderViewport* _viewports)
+{
+	bool unchanged = (m_iKnown & KNOWN_VIEWPORTS) && m_Bound.viewportCount == _count;
+	for (unsigned int i = 0; unchanged && i < _count; i++)
+		unchanged = SameViewport(m_Bound.viewports[i], _viewports[i]);
+	if (!Filter(unchanged))
+		return;
+	// === More viewports than tracked are passed on every time
+	if (_count <= RENDER_VIEWPORT_SLOTS) {
+		m_Bound.viewportCount = _count;
+		memcpy(m_Bound.viewports, _viewports, sizeof(RenderViewport) * _count);
+		m_iKnown |= KNOWN_VIEWPORTS;
+	}
+	else {
+		m_iKnown &= ~KNOWN_VIEWPORTS;
+	}
+	m_pTarget->RSSetViewports(_count, _viewports);
+}
+
+void StateFilteringContext::OMSetBlendState(ID3D11BlendState* _state, const float* _blendFactor, unsigned int _sampleMask)
+{
+	const float* factor = _blendFactor != nullptr ? _blendFactor : DEFAULT_BLEND_FACTOR;
+	if (!Filter((m_iKnown & KNOWN_BLEND) && m_Bound.blendState == _state && m_Bound.sampleMask == _sampleMask
+		&& m_Bound.blendFactor[0] == factor[0] && m_Bound.blendFactor[1] == factor[1] && m_Bound.blendFactor[2] == factor[2] && m_Bound.blendFactor[3] == factor[3]))
+		return;
+	m_Bound.blendState = _state;
+	memcpy(m_Bound.blendFactor, factor, sizeof(m_Bound.blendFactor));
+	m_Bound.sampleMask = _sampleMask;
+	m_iKnown |= KNOWN_BLEND;
+	m_pTarget->OMSetBlendState(_state, _blendFactor, _sampleMask);
+}
+
+void StateFilteringContext::OMSetDepthStencilState(ID3D11DepthStencilState* _state, unsigned int _stencilRef)
+{
+	if (!Filter((m_iKnown & KNOWN_DEPTH_STENCIL) && m_Bound.depthStencilState == _state && m_Bound.stencilRef == _stencilRef))
+		return;
+	m_Bound.depthStencilState = _state;
+	m_Bound.stencilRef = _stencilRef;
+	m_iKnown |= KNOWN_DEPTH_STENCIL;
+	m_pTarget->OMSetDepthStencilState(_state, _stencilRef);
+}
+
+void StateFilteringContext::OMSetRenderTargets(unsigned int _count, ID3D11RenderTargetView* const* _views, ID3D11DepthStencilView* _depthView)
+{
+	bool unchanged = (m_iKnown & KNOWN_RENDER_TARGETS) && _count <= RENDER_TARGET_SLOTS
+		&& m_Bound.renderTargetCount == _count && m_Bound.depthStencilView == _depthView;
+	for (unsigned int i = 0; unchanged && i < _count; i++)
+		unchanged = m_Bound.renderTargets[i] == _views[i];
+	if (!Filter(unchanged))
+		return;
+	if (_count <= RENDER_TARGET_SLOTS) {
+		m_Bound.renderTargetCount = _count;
+		for (unsigned int i = 0; i < _count; i++)
+			m_Bound.renderTargets[i] = _views[i];
+		m_Bound.depthStencilView = _depthView;
+		m_iKnown |= KNOWN_RENDER_TARGETS;
+	}
+	else {
+		m_iKnown &= ~KNOWN_RENDER_TARGETS;
+	}
+	m_iKnownPSShaderResources = 0;
+	m_pTarget->OMSetRenderTargets(_count, _views, _depthView);
+}
+
+void StateFilteringContext::Draw(unsigned int _vertexCount, unsigned int _startVertex)
+{
+	m_Frame.draws++;
+	m_Frame.instances++;
+	m_pTarget->Draw(_vertexCount, _startVertex);
+}
+
+void StateFilteringContext::DrawIndexed(unsigned int _indexCount, unsigned int _startIndex, int _baseVertex)
+{
+	m_Frame.draws++;
+	m_Frame.instances++;
+	m_pTarget->DrawIndexed(_indexCount, _startIndex, _baseVertex);
+}
+
+void StateFilteringContext::DrawIndexedInstanced(unsigned int _indexCount, unsigned int _instanceCount, unsigned int _startIndex, int _baseVertex, unsigned int _startInstance)
+{
+	m_Frame.draws++;
+	m_Frame.instances += _instanceCount;
+	m_pTarget->DrawIndexedInstanced(_indexCount, _instanceCount, _startIndex, _baseVertex, _startInstance);
+}
+
+void StateFilteringContext::WriteBuffer(ID3D11Buffer* _buffer, unsigned int _offset, const void* _data, unsigned int _size, bool _discard)
+{
+	m_Frame.bufferWrites++;
+	m_pTarget->WriteBuffer(_buffer, _offset, _data, _size, _discard);
+}
+// ================================= //
+
+// ===== RecordingRenderContext ===== //
+RecordingRenderContext::RecordingRenderContext()
+{
+	m_iWatchedSlot = 0;
+	m_iWatchedSize = 0;
+	Reset();
+}
+
+void RecordingRenderContext::Reset()
+{
+	ResetRenderState(&m_State);
+	m_DrawStates.clear();
+	m_DrawConstants.clear();
+	m_Buffers.clear();
+	m_iStateCalls = 0;
+	m_iBufferWrites = 0;
+	m_iDiscards = 0;
+	m_iBytesWritten = 0;
+}
+
+void RecordingRenderContext::IASetPrimitiveTopology(unsigned int _topology)
+{
+	m_iStateCalls++;
+	m_State.topology = _topology;
+}
+
+void RecordingRenderContext::IASetInputLayout(ID3D11InputLayout* _layout)
+{
+	m_iStateCalls++;
+	m_State.inputLayout = _layout;
+}
+
+void RecordingRenderContext::IASetVertexBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _strides, const unsigned int* _offsets)
+{
+	m_iStateCalls++;
+	ApplySlots(m_State.vertexBuffers, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _buffers);
+	ApplySlots(m_State.vertexStrides, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _strides);
+	ApplySlots(m_State.vertexOffsets, RENDER_VERTEX_BUFFER_SLOTS, _startSlot, _count, _offsets);
+}
+
+void RecordingRenderContext::IASetIndexBuffer(ID3D11Buffer* _buffer, unsigned int _format, unsigned int _offset)
+{
+	m_iStateCalls++;
+	m_State.indexBuffer = _buffer;
+	m_State.indexFormat = _format;
+	m_State.indexOffset = _offset;
+}
+
+void RecordingRenderContext::VSSetShader(ID3D11VertexShader* _shader)
+{
+	m_iStateCalls++;
+	m_State.vertexShader = _shader;
+}
+
+void RecordingRenderContext::VSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers)
+{
+	m_iStateCalls++;
+	ApplySlots(m_State.vsConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers);
+	ApplySlots(m_State.vsConstantFirst, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, WHOLE_BUFFER);
+	ApplySlots(m_State.vsConstantCounts, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, WHOLE_BUFFER);
+}
+
+void RecordingRenderContext::VSSetConstantBuffers1(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _firstConstants, const unsigned int* _constantCounts)
+{
+	m_iStateCalls++;
+	ApplySlots(m_State.vsConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers);
+	ApplySlots(m_State.vsConstantFirst, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _firstConstants);
+	ApplySlots(m_State.vsConstantCounts, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _constantCounts);
+}
+
+void RecordingRenderContext::PSSetShader(ID3D11PixelShader* _shader)
+{
+	m_iStateCalls++;
+	m_State.pixelShader = _shader;
+}
+
+void RecordingRenderContext::PSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers)
+{
+	m_iStateCalls++;
+	ApplySlots(m_State.psConstantBuffers, RENDER_CONSTANT_BUFFER_SLOTS, _startSlot, _count, _buffers);
+}
+
+void RecordingRenderContext::PSSetShaderResources(unsigned int _startSlot, unsigned int _count, ID3D11ShaderResourceView* const* _views)
+{
+	m_iStateCalls++;
+	ApplySlots(m_State.psShaderResources, RENDER_SHADER_RESOURCE_SLOTS, _startSlot, _count, _views);
+}
+
+void RecordingRenderContext::PSSetSamplers(unsigned int _startSlot, unsigned int _count, ID3D11SamplerState* const* _samplers)
+{
+	m_iStateCalls++;
+	ApplySlots(m_State.psSamplers, RENDER_SAMPLER_SLOTS, _startSlot, _count, _samplers);
+}
+
+void RecordingRenderContext::RSSetState(ID3D11RasterizerState* _state)
+{
+	m_iStateCalls++;
+	m_State.rasterizerState = _state;
+}
+
+void RecordingRenderContext::RSSetViewports(unsigned int _count, const RenderViewport* _viewports)
+{
+	m_iStateCalls++;
+	m_State.viewportCount = _count < RENDER_VIEWPORT_SLOTS ? _count : RENDER_VIEWPORT_SLOTS;
+	memcpy(m_State.viewports, _viewports, sizeof(RenderViewport) * m_State.viewportCount);
+}
+
+void RecordingRenderContext::OMSetBlendState(ID3D11BlendState* _state, const float* _blendFactor, unsigned int _sampleMask)
+{
+	m_iStateCalls++;
+	m_State.blendState = _state;
+	memcpy(m_State.blendFactor, _blendFactor != nullptr ? _blendFactor : DEFAULT_BLEND_FACTOR, sizeof(m_State.blendFactor));
+	m_State.sampleMask = _sampleMask;
+}
+
+void RecordingRenderContext::OMSetDepthStencilState(ID3D11DepthStencilState* _state, unsigned int _stencilRef)
+{
+	m_iStateCalls++;
+	m_State.depthStencilState = _state;
+	m_State.stencilRef = _stencilRef;
+}
+
+void RecordingRenderContext::OMSetRenderTargets(unsigned int _count, ID3D11RenderTargetView* const* _views, ID3D11DepthStencilView* _depthView)
+{
+	m_iStateCalls++;
+	m_State.renderTargetCount = _count < RENDER_TARGET_SLOTS ? _count : RENDER_TARGET_SLOTS;
+	for (unsigned int i = 0; i < RENDER_TARGET_SLOTS; i++)
+		m_State.renderTargets[i] = i < m_State.renderTargetCount ? _views[i] : nullptr;
+	m_State.depthStencilView = _depthView;
+}
+
+void RecordingRenderContext::Draw(unsigned int, unsigned int)
+{
+	RecordDraw();
+}
+
+void RecordingRenderContext::DrawIndexed(unsigned int, unsigned int, int)
+{
+	RecordDraw();
+}
+
+void RecordingRenderContext::DrawIndexedInstanced(unsigned int, unsigned int, unsigned int, int, unsigned int)
+{
+	RecordDraw();
+}
+
+void RecordingRenderContext::WriteBuffer(ID3D11Buffer* _buffer, unsigned int _offset, const void* _data, unsigned int _size, bool _discard)
+{
+	vector<unsigned char>& contents = m_Buffers[_buffer];
+	if (_discard)
+		std::fill(contents.begin(), contents.end(), DISCARDED_BYTE);
+	if (contents.size() < _offset + _size)
+		contents.resize(_offset + _size, DISCARDED_BYTE);
+	memcpy(&contents[_offset], _data, _size);
+	m_iBufferWrites++;
+	m_iDiscards += _discard ? 1 : 0;
+	m_iBytesWritten += _size;
+}
+
+void RecordingRenderContext::RecordDraw()
+{
+	m_DrawStates.push_back(HashRenderState(m_State));
+	if (m_iWatchedSize == 0)
+		return;
+
+	// === The watched window as the shader reads it, bytes past the end of the buffer read as 0
+	unsigned long long hash = 14695981039346656037ull;
+	const unsigned char zero = 0;
+	map<ID3D11Buffer*, vector<unsigned char> >::const_iterator buffer = m_Buffers.find(m_State.vsConstantBuffers[m_iWatchedSlot]);
+	size_t first = (size_t)m_State.vsConstantFirst[m_iWatchedSlot] * 16;
+	for (size_t i = 0; i < m_iWatchedSize; i++) {
+		bool inside = buffer != m_Buffers.end() && first + i < buffer->second.size();
+		HashBytes(&hash, inside ? &buffer->second[first + i] : &zero, 1);
+	}
+	m_DrawConstants.push_back(hash);
+}
+// ================================== //
+
+// ===== Benchmark ===== //
+// - BenchmarkModel
+// --- What DrawObject binds for one model, the objects are fake addresses that are only compared
+struct BenchmarkModel
+{
+	ID3D11VertexShader*			vertexShader;
+	ID3D11PixelShader*			pixelShader;
+	ID3D11InputLayout*			inputLayout;
+	ID3D11ShaderResourceView*	texture;
+	ID3D11SamplerState*			sampler;
+	ID3D11Buffer*				vertexBuffer;
+	ID3D11Buffer*				indexBuffer;
+	unsigned int				vertexSize;
+};
+
+template <typename T>
+static T* FakeObject(size_t _id)
+{
+	return (T*)(size_t)(0x10000 + _id * 64);
+}
+
+// - ReplayFrame
+// --- Same calls as ApplicationWindow::Run and DrawObject make: per view the targets and the blend state,
+// --- then per object everything DrawObject binds, two sided objects switching the rasterizer state around their draws
+static void ReplayFrame(IRenderContext* _context, const vector<BenchmarkModel>& _models, const vector<unsigned int>& _objects, const vector<unsigned char>& _twoSided)
+{
+	ID3D11Buffer* objectBuffer = FakeObject<ID3D11Buffer>(1);
+	ID3D11Buffer* sceneBuffer = FakeObject<ID3D11Buffer>(2);
+	ID3D11Buffer* lightBuffer = FakeObject<ID3D11Buffer>(3);
+	ID3D11BlendState* blendState = FakeObject<ID3D11BlendState>(4);
+	ID3D11RasterizerState* cullBack = FakeObject<ID3D11RasterizerState>(5);
+	ID3D11RasterizerState* cullFront = FakeObject<ID3D11RasterizerState>(6);
+	ID3D11RenderTargetView* targets[2] = { FakeObject<ID3D11RenderTargetView>(7), FakeObject<ID3D11RenderTargetView>(8) };
+	ID3D11DepthStencilView* depthViews[2] = { FakeObject<ID3D11DepthStencilView>(9), FakeObject<ID3D11DepthStencilView>(10) };
+	const RenderViewport viewports[2] = { { 0, 0, 1024, 780, 0, 1 }, { 768, 39, 204.8f, 156, 0, 1 } };
+	const unsigned int views[3][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 } };
+
+	_context->PSSetConstantBuffers(0, 1, &lightBuffer);
+	for (unsigned int view = 0; view < 3; view++) {
+		unsigned int target = views[view][0];
+		_context->RSSetViewports(1, &viewports[views[view][1]]);
+		_context->OMSetRenderTargets(1, &targets[target], depthViews[target]);
+		_context->OMSetBlendState(blendState, nullptr, 0xFFFFFFFF);
+		_context->VSSetConstantBuffers(1, 1, &sceneBuffer);
+		_context->IASetPrimitiveTopology(4);
+		for (size_t i = 0; i < _objects.size(); i++) {
+			const BenchmarkModel& model = _models[_objects[i]];
+			if (_twoSided[i])
+				_context->RSSetState(cullFront);
+			_context->VSSetConstantBuffers(0, 1, &objectBuffer);
+			unsigned int offset = 0;
+			_context->IASetVertexBuffers(0, 1, &model.vertexBuffer, &model.vertexSize, &offset);
+			_context->IASetIndexBuffer(model.indexBuffer, 57, 0);
+			_context->VSSetShader(model.vertexShader);
+			_context->PSSetShader(model.pixelShader);
+			_context->IASetInputLayout(model.inputLayout);
+			_context->PSSetShaderResources(0, 1, &model.texture);
+			_context->PSSetSamplers(0, 1, &model.sampler);
+			_context->DrawIndexed(36, 0, 0);
+			if (_twoSided[i]) {
+				_context->RSSetState(cullBack);
+				_context->DrawIndexed(36, 0, 0);
+			}
+		}
+	}
+}
+
+bool BenchmarkRenderContext(size_t _objectCount)
+{
+	// === 64 models sharing 4 shader pairs, 2 layouts, 2 samplers and 24 textures, like the scene's loaded models
+	std::mt19937 random(19);
+	vector<BenchmarkModel> models(64);
+	for (size_t i = 0; i < models.size(); i++) {
+		size_t shader = i % 4;
+		models[i].vertexShader = FakeObject<ID3D11VertexShader>(100 + shader);
+		models[i].pixelShader = FakeObject<ID3D11PixelShader>(110 + shader);
+		models[i].inputLayout = FakeObject<ID3D11InputLayout>(120 + shader % 2);
+		models[i].texture = FakeObject<ID3D11ShaderResourceView>(200 + random() % 24);
+		models[i].sampler = FakeObject<ID3D11SamplerState>(130 + (i % 8 == 0));
+		models[i].vertexBuffer = FakeObject<ID3D11Buffer>(1000 + i);
+		models[i].indexBuffer = FakeObject<ID3D11Buffer>(2000 + i);
+		models[i].vertexSize = shader == 1 ? 16 : 32;
+	}
+	vector<unsigned int> objects(_objectCount);
+	vector<unsigned char> twoSided(_objectCount);
+	for (size_t i = 0; i < _objectCount; i++) {
+		objects[i] = (unsigned int)(random() % models.size());
+		twoSided[i] = random() % 10 == 0;
+	}
+
+	// === Scattered as culling hands them out, then grouped by model the way the render queue orders them
+	RecordingRenderContext direct, behindFilter;
+	StateFilteringContext filter(&behindFilter);
+	bool allSame = true;
+	for (unsigned int order = 0; order < 2; order++) {
+		if (order == 1) {
+			vector<unsigned int> grouped(objects);
+			std::sort(grouped.begin(), grouped.end());
+			objects.swap(grouped);
+		}
+		direct.Reset();
+		behindFilter.Reset();
+		filter.SetTarget(&behindFilter);
+
+		ReplayFrame(&direct, models, objects, twoSided);
+		ReplayFrame(&filter, models, objects, twoSided);
+		filter.EndFrame();
+
+		const RenderContextStats& stats = filter.GetFrameStats();
+		bool same = direct.GetDrawStates() == behindFilter.GetDrawStates();
+		LogMessage("RenderContext (%s): %u draws, %u state calls, %u filtered (%.1f%%), %u reach the device, state at every draw %s",
+			order == 0 ? "scattered" : "by model", stats.draws, stats.submitted, stats.filtered,
+			100.0 * stats.filtered / (stats.submitted > 0 ? stats.submitted : 1), behindFilter.GetStateCallCount(), same ? "matches" : "DIFFERS");
+		allSame = allSame && same;
+	}
+	return allSame;
+}
+// ===================== //
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+using std::map;
+using std::vector;
+
+// === Only ever handled by pointer here, so the state tracking builds without the D3D11 headers
+struct ID3D11BlendState;
+struct ID3D11Buffer;
+struct ID3D11DepthStencilState;
+struct ID3D11DepthStencilView;
+struct ID3D11InputLayout;
+struct ID3D11PixelShader;
+struct ID3D11RasterizerState;
+struct ID3D11RenderTargetView;
+struct ID3D11SamplerState;
+struct ID3D11ShaderResourceView;
+struct ID3D11VertexShader;
+
+// === Slots whose bindings are tracked, calls reaching past them are always passed on
+static const unsigned int RENDER_VERTEX_BUFFER_SLOTS = 16;
+static const unsigned int RENDER_CONSTANT_BUFFER_SLOTS = 14;
+static const unsigned int RENDER_SHADER_RESOURCE_SLOTS = 16;
+static const unsigned int RENDER_SAMPLER_SLOTS = 16;
+static const unsigned int RENDER_TARGET_SLOTS = 8;
+static const unsigned int RENDER_VIEWPORT_SLOTS = 16;
+
+// - RenderViewport
+// --- Same layout as D3D11_VIEWPORT
+struct RenderViewport
+{
+	float topLeftX;
+	float topLeftY;
+	float width;
+	float height;
+	float minDepth;
+	float maxDepth;
+};
+
+// - RenderState
+// --- Everything the render contexts bind; formats and topologies are the D3D11 / DXGI enum values
+struct RenderState
+{
+	// === Input Assembler
+	unsigned int				topology;
+	ID3D11InputLayout*			inputLayout;
+	ID3D11Buffer*				vertexBuffers[RENDER_VERTEX_BUFFER_SLOTS];
+	unsigned int				vertexStrides[RENDER_VERTEX_BUFFER_SLOTS];
+	unsigned int				vertexOffsets[RENDER_VERTEX_BUFFER_SLOTS];
+	ID3D11Buffer*				indexBuffer;
+	unsigned int				indexFormat;
+	unsigned int				indexOffset;
+	// === Shaders
+	ID3D11VertexShader*			vertexShader;
+	ID3D11Buffer*				vsConstantBuffers[RENDER_CONSTANT_BUFFER_SLOTS];
+	// === Window of each VS constant buffer in 16 byte constants, a count of 0 is the whole buffer
+	unsigned int				vsConstantFirst[RENDER_CONSTANT_BUFFER_SLOTS];
+	unsigned int				vsConstantCounts[RENDER_CONSTANT_BUFFER_SLOTS];
+	ID3D11PixelShader*			pixelShader;
+	ID3D11Buffer*				psConstantBuffers[RENDER_CONSTANT_BUFFER_SLOTS];
+	ID3D11ShaderResourceView*	psShaderResources[RENDER_SHADER_RESOURCE_SLOTS];
+	ID3D11SamplerState*			psSamplers[RENDER_SAMPLER_SLOTS];
+	// === Rasterizer
+	ID3D11RasterizerState*		rasterizerState;
+	unsigned int				viewportCount;
+	RenderViewport				viewports[RENDER_VIEWPORT_SLOTS];
+	// === Output Merger
+	ID3D11BlendState*			blendState;
+	float						blendFactor[4];
+	unsigned int				sampleMask;
+	ID3D11DepthStencilState*	depthStencilState;
+	unsigned int				stencilRef;
+	unsigned int				renderTargetCount;
+	ID3D11RenderTargetView*		renderTargets[RENDER_TARGET_SLOTS];
+	ID3D11DepthStencilView*		depthStencilView;
+};
+
+// - ResetRenderState
+// --- What a new D3D11 device context starts with: nothing bound, blend factor 1 and every sample written
+void ResetRenderState(RenderState* _state);
+
+// - RenderContextStats
+// --- State calls made on a context, the filtered ones never reached the context behind it
+// --- Every draw call counts once in draws, instances counts what it drew: a plain draw is one instance
+struct RenderContextStats
+{
+	unsigned int submitted;
+	unsigned int filtered;
+	unsigned int draws;
+	unsigned int instances;
+	unsigned int bufferWrites;
+
+	unsigned int Forwarded() const { return submitted - filtered; }
+};
+
+// - IRenderContext
+// --- The part of ID3D11DeviceContext the renderer binds state and draws through
+// --- Arrays follow the D3D11 calls; a null blend factor means 1, 1, 1, 1
+// --- VSSetConstantBuffers1 binds a window of each buffer, offsets and sizes in 16 byte constants, multiples of 16 (D3D11.1)
+class IRenderContext
+{
+public:
+	// ===== Destructor
+	virtual ~IRenderContext() {}
+
+	// ===== Input Assembler
+	virtual void IASetPrimitiveTopology(unsigned int _topology) = 0;
+	virtual void IASetInputLayout(ID3D11InputLayout* _layout) = 0;
+	virtual void IASetVertexBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _strides, const unsigned int* _offsets) = 0;
+	virtual void IASetIndexBuffer(ID3D11Buffer* _buffer, unsigned int _format, unsigned int _offset) = 0;
+
+	// ===== Shaders
+	virtual void VSSetShader(ID3D11VertexShader* _shader) = 0;
+	virtual void VSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers) = 0;
+	virtual void VSSetConstantBuffers1(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _firstConstants, const unsigned int* _constantCounts) = 0;
+	virtual void PSSetShader(ID3D11PixelShader* _shader) = 0;
+	virtual void PSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers) = 0;
+	virtual void PSSetShaderResources(unsigned int _startSlot, unsigned int _count, ID3D11ShaderResourceView* const* _views) = 0;
+	virtual void PSSetSamplers(unsigned int _startSlot, unsigned int _count, ID3D11SamplerState* const* _samplers) = 0;
+
+	// ===== Rasterizer
+	virtual void RSSetState(ID3D11RasterizerState* _state) = 0;
+	virtual void RSSetViewports(unsigned int _count, const RenderViewport* _viewports) = 0;
+
+	// ===== Output Merger
+	virtual void OMSetBlendState(ID3D11BlendState* _state, const float* _blendFactor, unsigned int _sampleMask) = 0;
+	virtual void OMSetDepthStencilState(ID3D11DepthStencilState* _state, unsigned int _stencilRef) = 0;
+	virtual void OMSetRenderTargets(unsigned int _count, ID3D11RenderTargetView* const* _views, ID3D11DepthStencilView* _depthView) = 0;
+
+	// ===== Draws
+	virtual void Draw(unsigned int _vertexCount, unsigned int _startVertex) = 0;
+	virtual void DrawIndexed(unsigned int _indexCount, unsigned int _startIndex, int _baseVertex) = 0;
+	virtual void DrawIndexedInstanced(unsigned int _indexCount, unsigned int _instanceCount, unsigned int _startIndex, int _baseVertex, unsigned int _startInstance) = 0;
+
+	// ===== Resources
+	// - WriteBuffer
+	// --- Maps a dynamic buffer, copies _size bytes to _offset and unmaps it again
+	// --- _discard orphans everything the buffer held (WRITE_DISCARD), otherwise the GPU may still read the rest (WRITE_NO_OVERWRITE)
+	virtual void WriteBuffer(ID3D11Buffer* _buffer, unsigned int _offset, const void* _data, unsigned int _size, bool _discard) = 0;
+};
+
+// - StateFilteringContext
+// --- Shadows what is bound on the context behind it and drops every call that would not change it
+// --- Nothing is known at first or after Invalidate, so the first call of each kind always goes through
+// --- Changing the render targets forgets the bound shader resources: the runtime unbinds any of them that became a target
+// --- Binding a resource for reading while it is still a target is refused by the runtime, unbind the target first
+class StateFilteringContext : public IRenderContext
+{
+private:
+	IRenderContext*		m_pTarget;
+	RenderState			m_Bound;
+	// === Which parts of m_Bound are known, one bit per group or per slot
+	unsigned int		m_iKnown;
+	unsigned int		m_iKnownVertexBuffers;
+	unsigned int		m_iKnownVSConstantBuffers;
+	unsigned int		m_iKnownPSConstantBuffers;
+	unsigned int		m_iKnownPSShaderResources;
+	unsigned int		m_iKnownPSSamplers;
+	// === Counters of the frame being drawn and of the last finished one
+	RenderContextStats	m_Frame;
+	RenderContextStats	m_LastFrame;
+
+public:
+	// ===== Constructor
+	StateFilteringContext(IRenderContext* _target = nullptr);
+
+	// ===== Interface
+	// - SetTarget
+	// --- Also forgets everything, the new target may have anything bound
+	void SetTarget(IRenderContext* _target);
+	// - Invalidate
+	// --- Call after binding on the target directly, or when bound objects were released and their addresses may come back
+	void Invalidate();
+	// - EndFrame
+	// --- Keeps this frame's counters for GetFrameStats and starts counting the next frame
+	void EndFrame();
+
+	// ===== IRenderContext
+	void IASetPrimitiveTopology(unsigned int _topology);
+	void IASetInputLayout(ID3D11InputLayout* _layout);
+	void IASetVertexBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _strides, const unsigned int* _offsets);
+	void IASetIndexBuffer(ID3D11Buffer* _buffer, unsigned int _format, unsigned int _offset);
+	void VSSetShader(ID3D11VertexShader* _shader);
+	void VSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers);
+	void VSSetConstantBuffers1(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _firstConstants, const unsigned int* _constantCounts);
+	void PSSetShader(ID3D11PixelShader* _shader);
+	void PSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers);
+	void PSSetShaderResources(unsigned int _startSlot, unsigned int _count, ID3D11ShaderResourceView* const* _views);
+	void PSSetSamplers(unsigned int _startSlot, unsigned int _count, ID3D11SamplerState* const* _samplers);
+	void RSSetState(ID3D11RasterizerState* _state);
+	void RSSetViewports(unsigned int _count, const RenderViewport* _viewports);
+	void OMSetBlendState(ID3D11BlendState* _state, const float* _blendFactor, unsigned int _sampleMask);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* _state, unsigned int _stencilRef);
+	void OMSetRenderTargets(unsigned int _count, ID3D11RenderTargetView* const* _views, ID3D11DepthStencilView* _depthView);
+	void Draw(unsigned int _vertexCount, unsigned int _startVertex);
+	void DrawIndexed(unsigned int _indexCount, unsigned int _startIndex, int _baseVertex);
+	void DrawIndexedInstanced(unsigned int _indexCount, unsigned int _instanceCount, unsigned int _startIndex, int _baseVertex, unsigned int _startInstance);
+	void WriteBuffer(ID3D11Buffer* _buffer, unsigned int _offset, const void* _data, unsigned int _size, bool _discard);
+
+	// ===== Accessors
+	IRenderContext* GetTarget() const { return m_pTarget; }
+	// - GetFrameStats
+	// --- Counters of the last frame passed to EndFrame
+	const RenderContextStats& GetFrameStats() const { return m_LastFrame; }
+	const RenderContextStats& GetCurrentStats() const { return m_Frame; }
+
+private:
+	// ===== Private Interface
+	bool Filter(bool _unchanged);
+};
+
+// - RecordingRenderContext
+// --- Backend without a device: applies every call to a RenderState the way a device context would
+// --- and keeps a hash of the whole state at every draw, so two call streams can be compared draw by draw
+// --- Buffer writes are kept too, so it can also hash the constants a vertex shader slot sees at every draw
+class RecordingRenderContext : public IRenderContext
+{
+private:
+	RenderState								m_State;
+	vector<unsigned long long>				m_DrawStates;
+	unsigned int							m_iStateCalls;
+	// === Contents of every buffer written to, and the writes
+	map<ID3D11Buffer*, vector<unsigned char> >	m_Buffers;
+	unsigned int							m_iBufferWrites;
+	unsigned int							m_iDiscards;
+	unsigned long long						m_iBytesWritten;
+	// === Constants hashed at every draw
+	unsigned int							m_iWatchedSlot;
+	unsigned int							m_iWatchedSize;
+	vector<unsigned long long>				m_DrawConstants;
+
+public:
+	// ===== Constructor
+	RecordingRenderContext();
+
+	// ===== Interface
+	// - Reset
+	// --- Back to the state of a new context, forgetting every call, draw and buffer
+	void Reset();
+	// - WatchConstants
+	// --- At every draw, hash the first _size bytes of the window bound to VS constant buffer _slot; 0 stops
+	void WatchConstants(unsigned int _slot, unsigned int _size) { m_iWatchedSlot = _slot; m_iWatchedSize = _size; }
+
+	// ===== IRenderContext
+	void IASetPrimitiveTopology(unsigned int _topology);
+	void IASetInputLayout(ID3D11InputLayout* _layout);
+	void IASetVertexBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _strides, const unsigned int* _offsets);
+	void IASetIndexBuffer(ID3D11Buffer* _buffer, unsigned int _format, unsigned int _offset);
+	void VSSetShader(ID3D11VertexShader* _shader);
+	void VSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers);
+	void VSSetConstantBuffers1(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers, const unsigned int* _firstConstants, const unsigned int* _constantCounts);
+	void PSSetShader(ID3D11PixelShader* _shader);
+	void PSSetConstantBuffers(unsigned int _startSlot, unsigned int _count, ID3D11Buffer* const* _buffers);
+	void PSSetShaderResources(unsigned int _startSlot, unsigned int _count, ID3D11ShaderResourceView* const* _views);
+	void PSSetSamplers(unsigned int _startSlot, unsigned int _count, ID3D11SamplerState* const* _samplers);
+	void RSSetState(ID3D11RasterizerState* _state);
+	void RSSetViewports(unsigned int _count, const RenderViewport* _viewports);
+	void OMSetBlendState(ID3D11BlendState* _state, const float* _blendFactor, unsigned int _sampleMask);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* _state, unsigned int _stencilRef);
+	void OMSetRenderTargets(unsigned int _count, ID3D11RenderTargetView* const* _views, ID3D11DepthStencilView* _depthView);
+	void Draw(unsigned int _vertexCount, unsigned int _startVertex);
+	void DrawIndexed(unsigned int _indexCount, unsigned int _startIndex, int _baseVertex);
+	void DrawIndexedInstanced(unsigned int _indexCount, unsigned int _instanceCount, unsigned int _startIndex, int _baseVertex, unsigned int _startInstance);
+	void WriteBuffer(ID3D11Buffer* _buffer, unsigned int _offset, const void* _data, unsigned int _size, bool _discard);
+
+	// ===== Accessors
+	const RenderState& GetState() const { return m_State; }
+	const vector<unsigned long long>& GetDrawStates() const { return m_DrawStates; }
+	unsigned int GetStateCallCount() const { return m_iStateCalls; }
+	const vector<unsigned long long>& GetDrawConstants() const { return m_DrawConstants; }
+	unsigned int GetBufferWriteCount() const { return m_iBufferWrites; }
+	unsigned int GetDiscardCount() const { return m_iDiscards; }
+	unsigned long long GetBytesWritten() const { return m_iBytesWritten; }
+
+private:
+	// ===== Private Interface
+	void RecordDraw();
+};
+
+// - BenchmarkRenderContext
+// --- Replays the calls DrawObject makes for _objectCount synthetic draws over three views, once straight into a
+// --- RecordingRenderContext and once through a StateFilteringContext, checks the state at every draw is the same
+// --- and logs how many calls the filter dropped; in scattered and in model order. Returns false if any state differed
+bool BenchmarkRenderContext(size_t _objectCount);
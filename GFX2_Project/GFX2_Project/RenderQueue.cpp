@@ -0,0 +1,196 @@
+#include "RenderQueue.h"
+
+#include <cstring>
+#include <random>
+
+#include "Profiling.h"
+
+// ===== Local Helpers ===== //
+// === Width of every field, shared by both layouts
+static const unsigned int VIEW_BITS = 3;
+static const unsigned int PASS_BITS = 3;
+static const unsigned int BLEND_BITS = 2;
+static const unsigned int CULL_BITS = 2;
+static const unsigned int SHADER_BITS = 8;
+static const unsigned int MATERIAL_BITS = 12;
+static const unsigned int MESH_BITS = 10;
+static const unsigned int DEPTH_BITS = 24;
+
+// === Radix sort digits, 6 passes cover the 64 bits
+static const unsigned int RADIX_BITS = 11;
+static const unsigned int RADIX_SIZE = 1 << RADIX_BITS;
+
+// - PackField / UnpackField
+// --- One field at the bits just below _shift, moving _shift past it
+static inline void PackField(SortKey* _key, unsigned int _value, unsigned int _bits, unsigned int* _shift)
+{
+	*_shift -= _bits;
+	*_key |= (SortKey)(_value & ((1u << _bits) - 1)) << *_shift;
+}
+
+static inline unsigned int UnpackField(SortKey _key, unsigned int _bits, unsigned int* _shift)
+{
+	*_shift -= _bits;
+	return (unsigned int)(_key >> *_shift) & ((1u << _bits) - 1);
+}
+// ========================= //
+
+// ===== Sort Keys ===== //
+SortKey MakeSortKey(const SortKeyFields& _fields)
+{
+	SortKey key = 0;
+	unsigned int shift = 64;
+	PackField(&key, _fields.view, VIEW_BITS, &shift);
+	PackField(&key, _fields.pass, PASS_BITS, &shift);
+	PackField(&key, _fields.blend, BLEND_BITS, &shift);
+	if (_fields.pass == PASS_TRANSPARENT)
+		PackField(&key, _fields.depth, DEPTH_BITS, &shift);
+	PackField(&key, _fields.cull, CULL_BITS, &shift);
+	PackField(&key, _fields.shader, SHADER_BITS, &shift);
+	PackField(&key, _fields.material, MATERIAL_BITS, &shift);
+	PackField(&key, _fields.mesh, MESH_BITS, &shift);
+	if (_fields.pass != PASS_TRANSPARENT)
+		PackField(&key, _fields.depth, DEPTH_BITS, &shift);
+	return key;
+}
+
+SortKeyFields DecodeSortKey(SortKey _key)
+{
+	SortKeyFields fields;
+	unsigned int shift = 64;
+	fields.view = UnpackField(_key, VIEW_BITS, &shift);
+	fields.pass = UnpackField(_key, PASS_BITS, &shift);
+	fields.blend = UnpackField(_key, BLEND_BITS, &shift);
+	if (fields.pass == PASS_TRANSPARENT)
+		fields.depth = UnpackField(_key, DEPTH_BITS, &shift);
+	fields.cull = UnpackField(_key, CULL_BITS, &shift);
+	fields.shader = UnpackField(_key, SHADER_BITS, &shift);
+	fields.material = UnpackField(_key, MATERIAL_BITS, &shift);
+	fields.mesh = UnpackField(_key, MESH_BITS, &shift);
+	if (fields.pass != PASS_TRANSPARENT)
+		fields.depth = UnpackField(_key, DEPTH_BITS, &shift);
+	return fields;
+}
+
+unsigned int DepthToKey(float _depth, bool _farthestFirst)
+{
+	// === Non-negative floats order like their bits, the top 24 of them still do
+	unsigned int bits;
+	float depth = _depth > 0 ? _depth : 0;
+	memcpy(&bits, &depth, sizeof(bits));
+	bits >>= 32 - DEPTH_BITS;
+	return _farthestFirst ? ((1u << DEPTH_BITS) - 1) - bits : bits;
+}
+// ===================== //
+
+// ===== Interface ===== //
+void RenderQueue::Push(SortKey _key, unsigned int _payload)
+{
+	RenderItem item = { _key, _payload };
+	m_Items.push_back(item);
+}
+
+void RenderQueue::Sort()
+{
+	size_t count = m_Items.size();
+	if (count < 2)
+		return;
+	m_Scratch.resize(count);
+
+	RenderItem* items = &m_Items[0];
+	RenderItem* scratch = &m_Scratch[0];
+	unsigned int histogram[RADIX_SIZE];
+	for (unsigned int shift = 0; shift < 64; shift += RADIX_BITS) {
+		memset(histogram, 0, sizeof(histogram));
+		for (size_t i = 0; i < count; i++)
+			histogram[(items[i].key >> shift) & (RADIX_SIZE - 1)]++;
+		if (histogram[(items[0].key >> shift) & (RADIX_SIZE - 1)] == count)
+			continue;
+		unsigned int offset = 0;
+		for (unsigned int digit = 0; digit < RADIX_SIZE; digit++) {
+			unsigned int digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+		for (size_t i = 0; i < count; i++)
+			scratch[histogram[(items[i].key >> shift) & (RADIX_SIZE - 1)]++] = items[i];
+		RenderItem* swap = items;
+		items = scratch;
+		scratch = swap;
+	}
+	if (items != &m_Items[0])
+		m_Items.swap(m_Scratch);
+}
+
+RenderStateChanges RenderQueue::CountStateChanges() const
+{
+	RenderStateChanges changes = { 0, 0, 0, 0 };
+	SortKeyFields bound = { 0, 0, 0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0 };
+	for (size_t i = 0; i < m_Items.size(); i++) {
+		SortKeyFields fields = DecodeSortKey(m_Items[i].key);
+		if (fields.cull != bound.cull) { changes.cull++; bound.cull = fields.cull; }
+		if (fields.shader != bound.shader) { changes.shader++; bound.shader = fields.shader; }
+		if (fields.material != bound.material) { changes.material++; bound.material = fields.material; }
+		if (fields.mesh != bound.mesh) { changes.mesh++; bound.mesh = fields.mesh; }
+	}
+	return changes;
+}
+// ===================== //
+
+// ===== Benchmark ===== //
+void BenchmarkRenderQueue(size_t _objectCount)
+{
+	// === 8 shaders, 200 materials and 500 meshes, a fifth of the objects two-sided and a tenth transparent
+	std::mt19937 random(23);
+	std::uniform_int_distribution<unsigned int> shader(0, 7), material(0, 199), mesh(0, 499), percent(0, 99);
+	std::uniform_real_distribution<float> distance(0.5f, 500.0f);
+	vector<SortKeyFields> objects(_objectCount);
+	for (size_t i = 0; i < _objectCount; i++) {
+		SortKeyFields& object = objects[i];
+		unsigned int kind = percent(random);
+		object.view = 0;
+		object.pass = kind < 10 ? PASS_TRANSPARENT : PASS_OPAQUE;
+		object.blend = kind < 10 ? BLEND_ALPHA : BLEND_OPAQUE;
+		object.cull = kind < 30 ? CULL_FRONT : CULL_BACK;
+		object.shader = shader(random);
+		object.material = material(random);
+		object.mesh = mesh(random);
+		object.depth = DepthToKey(distance(random), object.pass == PASS_TRANSPARENT);
+	}
+
+	// === DrawScene's fixed order: two-sided front faces, then back faces, then transparent front / back pairs
+	RenderQueue queue;
+	queue.Reserve(_objectCount * 2);
+	for (size_t i = 0; i < _objectCount; i++)
+		if (objects[i].pass == PASS_OPAQUE && objects[i].cull == CULL_FRONT)
+			queue.Push(objects[i], (unsigned int)i);
+	for (size_t i = 0; i < _objectCount; i++) {
+		SortKeyFields back = objects[i];
+		back.cull = CULL_BACK;
+		if (objects[i].pass == PASS_OPAQUE)
+			queue.Push(back, (unsigned int)i);
+	}
+	for (size_t i = 0; i < _objectCount; i++) {
+		if (objects[i].pass != PASS_TRANSPARENT)
+			continue;
+		SortKeyFields side = objects[i];
+		side.cull = CULL_FRONT;
+		queue.Push(side, (unsigned int)i);
+		side.cull = CULL_BACK;
+		queue.Push(side, (unsigned int)i);
+	}
+	RenderStateChanges fixedOrder = queue.CountStateChanges();
+	// === Binding everything for every draw: both buffers, layout, both shaders, texture, sampler, cull
+	unsigned int everything = (unsigned int)queue.Size() * 8;
+
+	Stopwatch stopwatch;
+	queue.Sort();
+	double sortTime = stopwatch.ElapsedMilliseconds();
+	RenderStateChanges sorted = queue.CountStateChanges();
+
+	LogMessage("RenderQueue: %u objects, %u draws, sorted in %.3f ms", (unsigned int)_objectCount, (unsigned int)queue.Size(), sortTime);
+	LogMessage("RenderQueue: state changes, bind everything %u, fixed order %u (cull %u shader %u material %u mesh %u), sorted %u (cull %u shader %u material %u mesh %u)",
+		everything, fixedOrder.Total(), fixedOrder.cull, fixedOrder.shader, fixedOrder.material, fixedOrder.mesh,
+		sorted.Total(), sorted.cull, sorted.shader, sorted.material, sorted.mesh);
+}
+// ===================== //
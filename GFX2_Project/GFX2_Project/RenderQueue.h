@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+using std::vector;
+
+// - SortKey
+// --- 64-bit draw key, most significant field first:
+// --- opaque:      view (3) | pass (3) | blend (2) | cull (2) | shader (8) | material (12) | mesh (10) | depth (24)
+// --- transparent: view (3) | pass (3) | blend (2) | depth (24) | cull (2) | shader (8) | material (12) | mesh (10)
+// --- Opaque draws sort by state and then front to back, transparent ones keep their depth order first
+typedef unsigned long long SortKey;
+
+// - RenderPass
+enum RenderPass
+{
+	PASS_OPAQUE			= 0,
+	PASS_TRANSPARENT	= 1,
+};
+
+// - BlendMode
+enum BlendMode
+{
+	BLEND_OPAQUE		= 0,
+	BLEND_ALPHA			= 1,
+};
+
+// - CullMode
+// --- In the order the sides are drawn: two-sided meshes show their inside first
+enum CullMode
+{
+	CULL_FRONT			= 0,
+	CULL_BACK			= 1,
+};
+
+// - SortKeyFields
+// --- Every field of a SortKey; ids are small numbers handed out by whoever builds the queue
+struct SortKeyFields
+{
+	unsigned int view;
+	unsigned int pass;
+	unsigned int blend;
+	unsigned int cull;
+	unsigned int shader;
+	unsigned int material;
+	unsigned int mesh;
+	unsigned int depth;
+};
+
+// ===== Sort Keys ===== //
+// - MakeSortKey
+// --- Fields wider than their bits are masked
+SortKey MakeSortKey(const SortKeyFields& _fields);
+SortKeyFields DecodeSortKey(SortKey _key);
+
+// - DepthToKey
+// --- 24 bits keeping the order of a non-negative depth (or squared distance); _farthestFirst inverts it
+unsigned int DepthToKey(float _depth, bool _farthestFirst);
+// ===================== //
+
+// - RenderItem
+// --- A draw: its key and what to draw, the payload means whatever the queue's owner wants it to
+struct RenderItem
+{
+	SortKey key;
+	unsigned int payload;
+};
+
+// - RenderStateChanges
+// --- How often a submission in queue order has to change each piece of state
+struct RenderStateChanges
+{
+	unsigned int cull;
+	unsigned int shader;
+	unsigned int material;
+	unsigned int mesh;
+
+	unsigned int Total() const { return cull + shader + material + mesh; }
+};
+
+// - RenderQueue
+// --- Draws of one frame, sorted by key so that submitting them in order only changes state
+// --- where a key field changes
+class RenderQueue
+{
+private:
+	vector<RenderItem>	m_Items;
+	vector<RenderItem>	m_Scratch;
+
+public:
+	// ===== Interface
+	void Clear() { m_Items.clear(); }
+	void Reserve(size_t _count) { m_Items.reserve(_count); }
+	void Push(SortKey _key, unsigned int _payload);
+	void Push(const SortKeyFields& _fields, unsigned int _payload) { Push(MakeSortKey(_fields), _payload); }
+	// - Sort
+	// --- Stable LSD radix sort on the 64-bit keys, 11 bits a pass; passes where every key agrees are skipped
+	void Sort();
+	// - CountStateChanges
+	// --- State changes when submitted in the current order, starting from nothing bound
+	RenderStateChanges CountStateChanges() const;
+
+	// ===== Accessors
+	size_t Size() const { return m_Items.size(); }
+	const RenderItem& operator[](size_t _index) const { return m_Items[_index]; }
+};
+
+// - BenchmarkRenderQueue
+// --- Builds a synthetic scene of _objectCount draws and logs the state changes of binding everything for every draw,
+// --- of drawing it in the fixed order DrawScene used and of the sorted queue; also times building and sorting
+void BenchmarkRenderQueue(size_t _objectCount);
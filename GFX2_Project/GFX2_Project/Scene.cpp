@@ -0,0 +1,277 @@
+#include "Scene.h"
+
+#include <random>
+
+#include "MoveComponent.h"
+#include "Profiling.h"
+
+// ===== Local Helpers ===== //
+// === 22 bits of slot (4M entities), the other 10 count how often the slot was reused
+static const unsigned int SLOT_BITS = 22;
+static const unsigned int SLOT_MASK = (1u << SLOT_BITS) - 1;
+static const unsigned int GENERATION_MASK = (1u << (32 - SLOT_BITS)) - 1;
+static const unsigned int NO_INDEX = 0xFFFFFFFF;
+
+static inline EntityID MakeEntityID(unsigned int _slot, unsigned int _generation)
+{
+	return (_generation << SLOT_BITS) | _slot;
+}
+// ========================= //
+
+// ===== Constructor / Destructor ===== //
+Scene::Scene()
+{
+	m_bAnyBoundsDirty = false;
+}
+
+Scene::~Scene()
+{
+	Clear();
+}
+// ==================================== //
+
+// ===== Entities ===== //
+unsigned int Scene::GetIndex(EntityID _entity) const
+{
+	return m_SlotIndexes[_entity & SLOT_MASK];
+}
+
+EntityID Scene::CreateEntity(const Mat4& _worldMatrix, const Bounds& _bounds, Object* _model, unsigned int _flags)
+{
+	// === Reuse a free slot, its generation was already bumped when it was freed
+	unsigned int slot;
+	if (!m_FreeSlots.empty()) {
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else {
+		slot = (unsigned int)m_SlotIndexes.size();
+		m_SlotIndexes.push_back(NO_INDEX);
+		m_SlotGenerations.push_back(0);
+	}
+	unsigned int index = (unsigned int)m_Entities.size();
+	m_SlotIndexes[slot] = index;
+	EntityID entity = MakeEntityID(slot, m_SlotGenerations[slot]);
+
+	m_Entities.push_back(entity);
+	m_WorldMatrices.push_back(_worldMatrix);
+	m_LocalBounds.push_back(_bounds);
+	m_Models.push_back(_model);
+	m_Tints.push_back(MakeVec4(1, 1, 1, 1));
+	m_Flags.push_back(_flags);
+	m_Movers.push_back(nullptr);
+	Bounds world = TransformBounds(_bounds, &_worldMatrix.m[0][0]);
+	m_WorldSpheres.Add(world);
+	m_BoundsDirty.push_back(0);
+	return entity;
+}
+
+void Scene::DestroyEntity(EntityID _entity)
+{
+	if (!IsAlive(_entity))
+		return;
+	unsigned int slot = _entity & SLOT_MASK;
+	unsigned int index = m_SlotIndexes[slot];
+	unsigned int last = (unsigned int)m_Entities.size() - 1;
+	delete m_Movers[index];
+
+	// === Move the last entity into the hole
+	if (index != last) {
+		m_Entities[index] = m_Entities[last];
+		m_WorldMatrices[index] = m_WorldMatrices[last];
+		m_LocalBounds[index] = m_LocalBounds[last];
+		m_Models[index] = m_Models[last];
+		m_Tints[index] = m_Tints[last];
+		m_Flags[index] = m_Flags[last];
+		m_Movers[index] = m_Movers[last];
+		if (m_Movers[index] != nullptr)
+			m_Movement.SetEntityIndex(m_Movers[index]->GetAgent(), index);
+		float center[3], radius;
+		m_WorldSpheres.Get(last, center, &radius);
+		m_WorldSpheres.Set(index, center, radius);
+		m_BoundsDirty[index] = m_BoundsDirty[last];
+		m_SlotIndexes[m_Entities[index] & SLOT_MASK] = index;
+	}
+	m_Entities.pop_back();
+	m_WorldMatrices.pop_back();
+	m_LocalBounds.pop_back();
+	m_Models.pop_back();
+	m_Tints.pop_back();
+	m_Flags.pop_back();
+	m_Movers.pop_back();
+	m_WorldSpheres.RemoveLast();
+	m_BoundsDirty.pop_back();
+
+	m_SlotIndexes[slot] = NO_INDEX;
+	m_SlotGenerations[slot] = (m_SlotGenerations[slot] + 1) & GENERATION_MASK;
+	m_FreeSlots.push_back(slot);
+}
+
+bool Scene::IsAlive(EntityID _entity) const
+{
+	unsigned int slot = _entity & SLOT_MASK;
+	return _entity != INVALID_ENTITY && slot < m_SlotIndexes.size() && m_SlotIndexes[slot] != NO_INDEX
+		&& m_SlotGenerations[slot] == (_entity >> SLOT_BITS);
+}
+
+void Scene::Clear()
+{
+	while (!m_Entities.empty())
+		DestroyEntity(m_Entities.back());
+}
+
+void Scene::Reserve(size_t _count)
+{
+	m_Entities.reserve(_count);
+	m_WorldMatrices.reserve(_count);
+	m_LocalBounds.reserve(_count);
+	m_Models.reserve(_count);
+	m_Tints.reserve(_count);
+	m_Flags.reserve(_count);
+	m_Movers.reserve(_count);
+	m_BoundsDirty.reserve(_count);
+	m_SlotIndexes.reserve(_count);
+	m_SlotGenerations.reserve(_count);
+}
+// ==================== //
+
+// ===== Components ===== //
+void Scene::SetWorldMatrix(EntityID _entity, const Mat4& _worldMatrix)
+{
+	unsigned int index = GetIndex(_entity);
+	m_WorldMatrices[index] = _worldMatrix;
+	m_BoundsDirty[index] = 1;
+	m_bAnyBoundsDirty = true;
+}
+
+Vec3 Scene::GetPosition(EntityID _entity) const
+{
+	const Mat4& world = m_WorldMatrices[GetIndex(_entity)];
+	return MakeVec3(world.m[3][0], world.m[3][1], world.m[3][2]);
+}
+
+void Scene::SetPosition(EntityID _entity, const Vec3& _position)
+{
+	SetPositionAt(GetIndex(_entity), _position);
+}
+
+void Scene::SetPositionAt(size_t _index, const Vec3& _position)
+{
+	Mat4& world = m_WorldMatrices[_index];
+	world.m[3][0] = _position.x;
+	world.m[3][1] = _position.y;
+	world.m[3][2] = _position.z;
+	m_BoundsDirty[_index] = 1;
+	m_bAnyBoundsDirty = true;
+}
+
+void Scene::SetLocalBounds(EntityID _entity, const Bounds& _bounds)
+{
+	unsigned int index = GetIndex(_entity);
+	m_LocalBounds[index] = _bounds;
+	m_BoundsDirty[index] = 1;
+	m_bAnyBoundsDirty = true;
+}
+
+void Scene::SetMover(EntityID _entity, MoveComponent* _mover)
+{
+	MoveComponent*& mover = m_Movers[GetIndex(_entity)];
+	if (mover != _mover)
+		delete mover;
+	mover = _mover;
+}
+// ====================== //
+
+// ===== Systems ===== //
+void Scene::UpdateMovers(float _deltaTime, unsigned int _threadCount)
+{
+	if (m_Entities.empty())
+		return;
+	if (m_Movement.Update(_deltaTime, m_WorldMatrices.data(), m_BoundsDirty.data(), _threadCount) > 0)
+		m_bAnyBoundsDirty = true;
+}
+
+void Scene::UpdateBounds()
+{
+	if (!m_bAnyBoundsDirty)
+		return;
+	for (size_t i = 0; i < m_BoundsDirty.size(); i++) {
+		if (!m_BoundsDirty[i])
+			continue;
+		Bounds world = TransformBounds(m_LocalBounds[i], &m_WorldMatrices[i].m[0][0]);
+		m_WorldSpheres.Set((unsigned int)i, world.center, world.radius);
+		m_BoundsDirty[i] = 0;
+	}
+	m_bAnyBoundsDirty = false;
+}
+
+void Scene::Cull(const Frustum& _frustum, vector<unsigned int>* _visible) const
+{
+	m_WorldSpheres.Cull(_frustum, _visible);
+}
+// =================== //
+
+// ===== Benchmark ===== //
+void BenchmarkScene(size_t _entityCount, unsigned int _frames)
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+	Bounds unitBounds = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f }, { 0, 0, 0 }, 0.8660254f };
+
+	Scene scene;
+	scene.Reserve(_entityCount);
+	Stopwatch stopwatch;
+	for (size_t i = 0; i < _entityCount; i++) {
+		EntityID entity = scene.CreateEntity(Mat4Translation(position(random), position(random) * 0.25f, position(random)), unitBounds, nullptr, ENTITY_DRAW);
+		if (i % 4 == 0) {
+			MoveComponent* mover = new MoveComponent(&scene, entity);
+			Vec3 waypoints[2];
+			waypoints[0] = scene.GetPosition(entity);
+			waypoints[1] = Add(waypoints[0], MakeVec3(10, 0, 0));
+			mover->SetWaypoints(waypoints, 2);
+			mover->Patrol(1);
+			scene.SetMover(entity, mover);
+		}
+	}
+	double createTime = stopwatch.ElapsedMilliseconds();
+
+	// === Same frustum as BenchmarkFrustumCulling: 65 degrees, 16:9, looking down +z from the origin
+	const float nearZ = 0.1f, farZ = 1000.0f;
+	float yScale = 1.0f / std::tan(65.0f * 3.14159265f / 360.0f);
+	float range = farZ / (farZ - nearZ);
+	const float projection[16] = { yScale / (16.0f / 9.0f), 0, 0, 0, 0, yScale, 0, 0, 0, 0, range, 1, 0, 0, -nearZ * range, 0 };
+	Frustum frustum = ExtractFrustum(projection);
+
+	// === Every frame: the movers patrol, every other entity jitters a little, then bounds and culling
+	vector<Vec3> jitter(_entityCount);
+	for (size_t i = 0; i < _entityCount; i++)
+		jitter[i] = MakeVec3(step(random), step(random), step(random));
+	vector<unsigned int> visible;
+	visible.reserve(_entityCount);
+	double moveTime = 0, boundsTime = 0, cullTime = 0;
+	for (unsigned int frame = 0; frame < _frames; frame++) {
+		stopwatch.Restart();
+		scene.UpdateMovers(0.016f);
+		for (size_t i = 0; i < scene.Size(); i++) {
+			if (i % 4 == 0)
+				continue;
+			const Mat4& world = scene.GetWorldMatrixAt(i);
+			scene.SetPositionAt(i, MakeVec3(world.m[3][0] + jitter[i].x, world.m[3][1] + jitter[i].y, world.m[3][2] + jitter[i].z));
+		}
+		moveTime += stopwatch.ElapsedMilliseconds();
+		stopwatch.Restart();
+		scene.UpdateBounds();
+		boundsTime += stopwatch.ElapsedMilliseconds();
+		stopwatch.Restart();
+		scene.Cull(frustum, &visible);
+		cullTime += stopwatch.ElapsedMilliseconds();
+	}
+
+	double frames = _frames > 0 ? _frames : 1;
+	double perEntity = 1000000.0 / (frames * (double)(_entityCount > 0 ? _entityCount : 1));
+	LogMessage("Scene: %u entities created in %.1f ms, %u visible", (unsigned int)_entityCount, createTime, (unsigned int)visible.size());
+	LogMessage("Scene: per frame move %.2f ms, bounds %.2f ms, cull %.2f ms (%.2f / %.2f / %.2f ns per entity)",
+		moveTime / frames, boundsTime / frames, cullTime / frames, moveTime * perEntity, boundsTime * perEntity, cullTime * perEntity);
+}
+// ===================== //
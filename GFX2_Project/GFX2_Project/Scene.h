@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Bounds.h"
+#include "Frustum.h"
+#include "Math.h"
+#include "MovementSystem.h"
+
+using std::vector;
+
+class MoveComponent;
+class Object;
+
+// - EntityID
+// --- Stays valid for the entity's whole life while the entity itself moves around the dense arrays:
+// --- the low bits pick a slot, the high bits are the slot's generation, so a stale ID never finds a newer entity
+typedef unsigned int EntityID;
+static const EntityID INVALID_ENTITY = 0xFFFFFFFF;
+
+// - EntityFlags
+enum EntityFlags
+{
+	// === Drawn by DrawScene, entities without it (skybox, lights) only have a transform
+	ENTITY_DRAW			= 1 << 0,
+	// === Drawn a second time with front face culling, for meshes seen from both sides
+	ENTITY_TWO_SIDED	= 1 << 1,
+	// === Blended, drawn after everything else
+	ENTITY_TRANSPARENT	= 1 << 2,
+	// === Never moves, may be baked into a static batch at load time
+	ENTITY_STATIC		= 1 << 3,
+};
+
+// - Scene
+// --- Entity / component store: every component lives in its own array, all indexed by the same dense index,
+// --- so a system only walks the arrays it needs; destroying an entity moves the last one into its place
+// --- Models (Object) are render resources shared by any number of entities
+class Scene
+{
+private:
+	// === Dense, one element per live entity
+	vector<EntityID>		m_Entities;
+	vector<Mat4>			m_WorldMatrices;
+	vector<Bounds>			m_LocalBounds;
+	vector<Object*>			m_Models;
+	vector<Vec4>			m_Tints;
+	vector<unsigned int>	m_Flags;
+	vector<MoveComponent*>	m_Movers;
+	MovementSystem			m_Movement;
+	// === World bounding spheres, for culling, and which of them are out of date
+	CullingSet				m_WorldSpheres;
+	vector<unsigned char>	m_BoundsDirty;
+	bool					m_bAnyBoundsDirty;
+	// === Sparse, one element per slot
+	vector<unsigned int>	m_SlotIndexes;
+	vector<unsigned int>	m_SlotGenerations;
+	vector<unsigned int>	m_FreeSlots;
+
+public:
+	// ===== Constructor / Destructor
+	Scene();
+	~Scene();
+
+	// ===== Entities
+	// - CreateEntity
+	// --- _model may be null, _bounds are in model space
+	EntityID CreateEntity(const Mat4& _worldMatrix, const Bounds& _bounds, Object* _model, unsigned int _flags);
+	// - DestroyEntity
+	// --- Also deletes its mover
+	void DestroyEntity(EntityID _entity);
+	bool IsAlive(EntityID _entity) const;
+	void Clear();
+	void Reserve(size_t _count);
+
+	// ===== Components
+	const Mat4& GetWorldMatrix(EntityID _entity) const { return m_WorldMatrices[GetIndex(_entity)]; }
+	void SetWorldMatrix(EntityID _entity, const Mat4& _worldMatrix);
+	Vec3 GetPosition(EntityID _entity) const;
+	void SetPosition(EntityID _entity, const Vec3& _position);
+	void SetLocalBounds(EntityID _entity, const Bounds& _bounds);
+	Object* GetModel(EntityID _entity) const { return m_Models[GetIndex(_entity)]; }
+	unsigned int GetFlags(EntityID _entity) const { return m_Flags[GetIndex(_entity)]; }
+	void SetFlags(EntityID _entity, unsigned int _flags) { m_Flags[GetIndex(_entity)] = _flags; }
+	// - SetTint
+	// --- Multiplies the model's texture color, white (the default) leaves it as it is
+	void SetTint(EntityID _entity, const Vec4& _tint) { m_Tints[GetIndex(_entity)] = _tint; }
+	const Vec4& GetTint(EntityID _entity) const { return m_Tints[GetIndex(_entity)]; }
+	// - SetMover
+	// --- The scene owns _mover from now on, a previous mover is deleted
+	void SetMover(EntityID _entity, MoveComponent* _mover);
+	MoveComponent* GetMover(EntityID _entity) const { return m_Movers[GetIndex(_entity)]; }
+	MovementSystem& GetMovementSystem() { return m_Movement; }
+
+	// ===== Systems
+	// - UpdateMovers
+	// --- Advances every mover at once, split across _threadCount threads when there are enough of them
+	void UpdateMovers(float _deltaTime, unsigned int _threadCount = 1);
+	// - UpdateBounds
+	// --- Re-transforms the bounds of every entity that moved since the last call
+	void UpdateBounds();
+	// - Cull
+	// --- Dense indexes of the entities whose world sphere touches _frustum, call UpdateBounds first
+	void Cull(const Frustum& _frustum, vector<unsigned int>* _visible) const;
+
+	// ===== Dense Access
+	// --- Valid until the next CreateEntity / DestroyEntity
+	size_t Size() const { return m_Entities.size(); }
+	unsigned int GetIndex(EntityID _entity) const;
+	EntityID GetEntityAt(size_t _index) const { return m_Entities[_index]; }
+	const Mat4& GetWorldMatrixAt(size_t _index) const { return m_WorldMatrices[_index]; }
+	void SetPositionAt(size_t _index, const Vec3& _position);
+	Object* GetModelAt(size_t _index) const { return m_Models[_index]; }
+	unsigned int GetFlagsAt(size_t _index) const { return m_Flags[_index]; }
+	const Vec4& GetTintAt(size_t _index) const { return m_Tints[_index]; }
+};
+
+// - BenchmarkScene
+// --- Creates _entityCount entities (a quarter of them patrolling), then times moving them all,
+// --- updating their bounds and culling them against one frustum; logs the cost per frame and per entity
+void BenchmarkScene(size_t _entityCount, unsigned int _frames);
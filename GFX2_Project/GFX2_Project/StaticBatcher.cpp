@@ -0,0 +1,276 @@
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "Profiling.h"
+
+// ===== Local Helpers ===== //
+// - TransformStaticVertex
+// --- Position and normal into world space, everything else is copied
+static Vertex TransformStaticVertex(const Vertex& _vertex, const Mat4& _worldMatrix)
+{
+	Vertex vertex = _vertex;
+	Vec3 position = TransformPoint(MakeVec3(_vertex.x, _vertex.y, _vertex.z), _worldMatrix);
+	Vec3 normal = TransformVector(MakeVec3(_vertex.normals[0], _vertex.normals[1], _vertex.normals[2]), _worldMatrix);
+	vertex.x = position.x;
+	vertex.y = position.y;
+	vertex.z = position.z;
+	vertex.normals[0] = normal.x;
+	vertex.normals[1] = normal.y;
+	vertex.normals[2] = normal.z;
+	return vertex;
+}
+
+// - ComputeCell
+// --- Cell of the grid holding the centre of the world bounds
+static void ComputeCell(const Bounds& _localBounds, const Mat4& _worldMatrix, float _cellSize, int _cell[3])
+{
+	Bounds world = TransformBounds(_localBounds, &_worldMatrix.m[0][0]);
+	for (int axis = 0; axis < 3; axis++)
+		_cell[axis] = _cellSize > 0 ? (int)std::floor(world.center[axis] / _cellSize) : 0;
+}
+// ========================= //
+
+// ===== Constructor / Destructor ===== //
+StaticBatcher::StaticBatcher()
+{
+	m_fCellSize = 0;
+	m_iMinPieces = 2;
+}
+// ==================================== //
+
+// ===== Interface ===== //
+unsigned int StaticBatcher::AddMesh(const Vertex* _vertices, unsigned int _vertexCount, const unsigned int* _indexes, unsigned int _indexCount)
+{
+	m_Meshes.push_back(StaticMesh());
+	StaticMesh& mesh = m_Meshes.back();
+	mesh.vertices.assign(_vertices, _vertices + _vertexCount);
+	mesh.indexes.assign(_indexes, _indexes + _indexCount);
+	mesh.bounds = ComputeBounds(_vertices, _vertexCount, sizeof(Vertex));
+	return (unsigned int)m_Meshes.size() - 1;
+}
+
+void StaticBatcher::AddInstance(unsigned int _mesh, unsigned int _material, const Mat4& _worldMatrix, unsigned int _source)
+{
+	StaticInstance instance = { _mesh, _material, _source, _worldMatrix };
+	m_Instances.push_back(instance);
+}
+
+void StaticBatcher::Build(vector<StaticBatch>* _batches) const
+{
+	_batches->clear();
+	size_t count = m_Instances.size();
+
+	// === Cell of every instance, then the instances ordered by material and cell, in the order they were added within a cell
+	vector<int> cells(count * 3);
+	vector<unsigned int> order(count);
+	for (size_t i = 0; i < count; i++) {
+		const StaticInstance& instance = m_Instances[i];
+		ComputeCell(m_Meshes[instance.mesh].bounds, instance.worldMatrix, m_fCellSize, &cells[i * 3]);
+		order[i] = (unsigned int)i;
+	}
+	const vector<StaticInstance>& instances = m_Instances;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int _a, unsigned int _b) {
+		if (instances[_a].material != instances[_b].material)
+			return instances[_a].material < instances[_b].material;
+		return std::lexicographical_compare(&cells[_a * 3], &cells[_a * 3 + 3], &cells[_b * 3], &cells[_b * 3 + 3]);
+	});
+
+	// === Every run of the same material and cell with enough pieces is baked
+	size_t first = 0;
+	while (first < count) {
+		const StaticInstance& head = m_Instances[order[first]];
+		const int* cell = &cells[order[first] * 3];
+		size_t end = first + 1;
+		while (end < count && m_Instances[order[end]].material == head.material && memcmp(&cells[order[end] * 3], cell, sizeof(int) * 3) == 0)
+			end++;
+		if (end - first < m_iMinPieces) {
+			first = end;
+			continue;
+		}
+
+		_batches->push_back(StaticBatch());
+		StaticBatch& batch = _batches->back();
+		batch.material = head.material;
+		memcpy(batch.cell, cell, sizeof(batch.cell));
+		size_t vertexCount = 0, indexCount = 0;
+		for (size_t i = first; i < end; i++) {
+			vertexCount += m_Meshes[m_Instances[order[i]].mesh].vertices.size();
+			indexCount += m_Meshes[m_Instances[order[i]].mesh].indexes.size();
+		}
+		batch.vertices.reserve(vertexCount);
+		batch.indexes.reserve(indexCount);
+		batch.pieces.reserve(end - first);
+
+		for (size_t i = first; i < end; i++) {
+			const StaticInstance& instance = m_Instances[order[i]];
+			const StaticMesh& mesh = m_Meshes[instance.mesh];
+			unsigned int baseVertex = (unsigned int)batch.vertices.size();
+			StaticPiece piece;
+			piece.firstIndex = (unsigned int)batch.indexes.size();
+			piece.indexCount = (unsigned int)mesh.indexes.size();
+			piece.source = instance.source;
+			for (size_t v = 0; v < mesh.vertices.size(); v++)
+				batch.vertices.push_back(TransformStaticVertex(mesh.vertices[v], instance.worldMatrix));
+			for (size_t j = 0; j < mesh.indexes.size(); j++)
+				batch.indexes.push_back(baseVertex + mesh.indexes[j]);
+			piece.bounds = ComputeBounds(mesh.vertices.empty() ? nullptr : &batch.vertices[baseVertex], mesh.vertices.size(), sizeof(Vertex));
+			batch.pieces.push_back(piece);
+		}
+		batch.bounds = ComputeBounds(batch.vertices.empty() ? nullptr : &batch.vertices[0], batch.vertices.size(), sizeof(Vertex));
+		first = end;
+	}
+}
+
+void StaticBatcher::Clear()
+{
+	m_Meshes.clear();
+	m_Instances.clear();
+}
+// ===================== //
+
+// ===== Culling ===== //
+void CullStaticBatch(const StaticBatch& _batch, const Frustum& _frustum, vector<IndexRange>* _ranges)
+{
+	_ranges->clear();
+	for (size_t i = 0; i < _batch.pieces.size(); i++) {
+		const StaticPiece& piece = _batch.pieces[i];
+		if (piece.indexCount == 0 || !SphereInFrustum(_frustum, piece.bounds.center, piece.bounds.radius))
+			continue;
+		if (!_ranges->empty() && _ranges->back().firstIndex + _ranges->back().indexCount == piece.firstIndex) {
+			_ranges->back().indexCount += piece.indexCount;
+			continue;
+		}
+		IndexRange range = { piece.firstIndex, piece.indexCount, 0 };
+		_ranges->push_back(range);
+	}
+}
+// =================== //
+
+// ===== Checks ===== //
+bool CheckStaticBatcher()
+{
+	bool ok = true;
+	std::mt19937 random(37);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f), position(-100.0f, 100.0f), scale(0.25f, 3.0f), angle(-3.14159265f, 3.14159265f);
+
+	// === 6 random meshes, every field of every vertex set
+	const unsigned int meshCount = 6, materialCount = 4, instanceCount = 3000;
+	vector<vector<Vertex> > meshVertices(meshCount);
+	vector<vector<unsigned int> > meshIndexes(meshCount);
+	for (unsigned int m = 0; m < meshCount; m++) {
+		unsigned int vertexCount = 3 + m * 37;
+		std::uniform_int_distribution<unsigned int> corner(0, vertexCount - 1);
+		for (unsigned int v = 0; v < vertexCount; v++)
+			meshVertices[m].push_back(Vertex(unit(random), unit(random), unit(random), 1, unit(random), unit(random), 0, unit(random), unit(random), unit(random)));
+		for (unsigned int t = 0; t < vertexCount * 2; t++)
+			for (int c = 0; c < 3; c++)
+				meshIndexes[m].push_back(corner(random));
+	}
+
+	// === Random instances, scaled, rotated and spread over a few cells
+	vector<unsigned int> instanceMeshes(instanceCount), instanceMaterials(instanceCount);
+	vector<Mat4> worldMatrices(instanceCount);
+	std::uniform_int_distribution<unsigned int> pickMesh(0, meshCount - 1), pickMaterial(0, materialCount - 1);
+	for (unsigned int i = 0; i < instanceCount; i++) {
+		instanceMeshes[i] = pickMesh(random);
+		instanceMaterials[i] = pickMaterial(random);
+		Vec3 axis = Normalize(MakeVec3(unit(random), unit(random), unit(random) + 2));
+		float s = scale(random);
+		worldMatrices[i] = Mat4FromTransform(MakeVec3(s, s, s), QuatFromAxisAngle(axis, angle(random)), MakeVec3(position(random), position(random) * 0.1f, position(random)));
+	}
+
+	// === The camera at the origin looking down +z, like BenchmarkScene
+	const float nearZ = 0.1f, farZ = 150.0f;
+	float yScale = 1.0f / std::tan(65.0f * 3.14159265f / 360.0f);
+	float range = farZ / (farZ - nearZ);
+	const float projection[16] = { yScale / (16.0f / 9.0f), 0, 0, 0, 0, yScale, 0, 0, 0, 0, range, 1, 0, 0, -nearZ * range, 0 };
+	Frustum frustum = ExtractFrustum(projection);
+
+	const float cellSizes[3] = { 50.0f, 0.0f, 200.0f };
+	const unsigned int minPieces[3] = { 1, 1, 2 };
+	for (int pass = 0; pass < 3; pass++) {
+		StaticBatcher batcher;
+		batcher.SetCellSize(cellSizes[pass]);
+		batcher.SetMinPieces(minPieces[pass]);
+		vector<Bounds> meshBounds(meshCount);
+		for (unsigned int m = 0; m < meshCount; m++) {
+			batcher.AddMesh(&meshVertices[m][0], (unsigned int)meshVertices[m].size(), &meshIndexes[m][0], (unsigned int)meshIndexes[m].size());
+			meshBounds[m] = ComputeBounds(&meshVertices[m][0], meshVertices[m].size(), sizeof(Vertex));
+		}
+		for (unsigned int i = 0; i < instanceCount; i++)
+			batcher.AddInstance(instanceMeshes[i], instanceMaterials[i], worldMatrices[i], i);
+		vector<StaticBatch> batches;
+		batcher.Build(&batches);
+
+		// == Merged geometry against every source vertex transformed on its own, triangle by triangle
+		vector<unsigned int> seen(instanceCount, 0);
+		unsigned int pieceCount = 0, visiblePieces = 0, rangeCount = 0;
+		vector<IndexRange> ranges;
+		for (size_t b = 0; b < batches.size(); b++) {
+			const StaticBatch& batch = batches[b];
+			ok = ok && batch.pieces.size() >= minPieces[pass];
+			if (b > 0) {
+				const StaticBatch& previous = batches[b - 1];
+				ok = ok && (previous.material != batch.material || memcmp(previous.cell, batch.cell, sizeof(batch.cell)) != 0);
+			}
+			for (size_t p = 0; p < batch.pieces.size(); p++) {
+				const StaticPiece& piece = batch.pieces[p];
+				unsigned int source = piece.source;
+				unsigned int mesh = instanceMeshes[source];
+				seen[source]++;
+				pieceCount++;
+				int cell[3];
+				ComputeCell(meshBounds[mesh], worldMatrices[source], cellSizes[pass], cell);
+				ok = ok && instanceMaterials[source] == batch.material && memcmp(cell, batch.cell, sizeof(cell)) == 0;
+				ok = ok && piece.indexCount == meshIndexes[mesh].size() && (p == 0 || piece.firstIndex == batch.pieces[p - 1].firstIndex + batch.pieces[p - 1].indexCount);
+				for (unsigned int k = 0; k < piece.indexCount && ok; k++) {
+					const Vertex& merged = batch.vertices[batch.indexes[piece.firstIndex + k]];
+					const Vertex& original = meshVertices[mesh][meshIndexes[mesh][k]];
+					Vertex expected = original;
+					Vec3 expectedPosition = TransformPoint(MakeVec3(original.x, original.y, original.z), worldMatrices[source]);
+					Vec3 expectedNormal = TransformVector(MakeVec3(original.normals[0], original.normals[1], original.normals[2]), worldMatrices[source]);
+					expected.x = expectedPosition.x; expected.y = expectedPosition.y; expected.z = expectedPosition.z;
+					expected.normals[0] = expectedNormal.x; expected.normals[1] = expectedNormal.y; expected.normals[2] = expectedNormal.z;
+					ok = memcmp(&merged, &expected, sizeof(Vertex)) == 0;
+				}
+			}
+
+			// == Culling keeps exactly the pieces in view, with neighbours merged
+			CullStaticBatch(batch, frustum, &ranges);
+			vector<unsigned char> covered(batch.indexes.size(), 0);
+			for (size_t r = 0; r < ranges.size(); r++) {
+				ok = ok && (r == 0 || ranges[r - 1].firstIndex + ranges[r - 1].indexCount < ranges[r].firstIndex);
+				for (unsigned int k = 0; k < ranges[r].indexCount && ok; k++)
+					covered[ranges[r].firstIndex + k] = 1;
+			}
+			rangeCount += (unsigned int)ranges.size();
+			for (size_t p = 0; p < batch.pieces.size(); p++) {
+				const StaticPiece& piece = batch.pieces[p];
+				bool inView = SphereInFrustum(frustum, piece.bounds.center, piece.bounds.radius);
+				visiblePieces += inView ? 1 : 0;
+				for (unsigned int k = 0; k < piece.indexCount && ok; k++)
+					ok = covered[piece.firstIndex + k] == (inView ? 1 : 0);
+			}
+		}
+
+		// == Every instance in exactly one batch, or in none when its cell was too small
+		unsigned int unbatched = 0;
+		for (unsigned int i = 0; i < instanceCount; i++) {
+			ok = ok && seen[i] <= 1 && (seen[i] == 1 || minPieces[pass] > 1);
+			unbatched += seen[i] == 0 ? 1 : 0;
+		}
+		if (cellSizes[pass] <= 0)
+			ok = ok && batches.size() == materialCount;
+
+		LogMessage("StaticBatcher: cell size %.0f, %u instances -> %u batches of %u pieces (%u left unbatched); %u pieces in view, drawn with %u draw calls instead of %u",
+			cellSizes[pass], instanceCount, (unsigned int)batches.size(), pieceCount, unbatched, visiblePieces, rangeCount, visiblePieces);
+	}
+
+	LogMessage("StaticBatcher: checks %s", ok ? "passed" : "FAILED");
+	return ok;
+}
+// ================== //
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Bounds.h"
+#include "Frustum.h"
+#include "IndexPacking.h"
+#include "Math.h"
+#include "Vertex_Types.h"
+
+using std::vector;
+
+// - StaticPiece
+// --- One static object inside a batch: its triangles, where they are in the batch's index buffer and its world bounds
+struct StaticPiece
+{
+	unsigned int	firstIndex;
+	unsigned int	indexCount;
+	unsigned int	source;
+	Bounds			bounds;
+};
+
+// - StaticBatch
+// --- Static objects of one material and one cell merged into one mesh, already in world space
+// --- Pieces are in the order they were added, each one a contiguous run of indexes
+struct StaticBatch
+{
+	unsigned int			material;
+	int						cell[3];
+	vector<Vertex>			vertices;
+	vector<unsigned int>	indexes;
+	vector<StaticPiece>		pieces;
+	Bounds					bounds;
+};
+
+// - StaticBatcher
+// --- Bakes objects that never move at load time: the instances of each material are split into cells of the
+// --- world grid and every cell becomes one StaticBatch, with the vertices transformed into world space
+// --- (normals are transformed like Model_VS does, without normalizing) and the indexes rebased
+// --- Cells keep a batch small enough to be culled; its pieces can still be culled one by one inside it
+class StaticBatcher
+{
+private:
+	struct StaticMesh
+	{
+		vector<Vertex>			vertices;
+		vector<unsigned int>	indexes;
+		Bounds					bounds;
+	};
+	struct StaticInstance
+	{
+		unsigned int	mesh;
+		unsigned int	material;
+		unsigned int	source;
+		Mat4			worldMatrix;
+	};
+	vector<StaticMesh>		m_Meshes;
+	vector<StaticInstance>	m_Instances;
+	float					m_fCellSize;
+	unsigned int			m_iMinPieces;
+
+public:
+	// ===== Constructor / Destructor
+	StaticBatcher();
+
+	// ===== Interface
+	// - SetCellSize
+	// --- Edge of the world grid cells, 0 or less puts every instance of a material into a single batch
+	void SetCellSize(float _cellSize) { m_fCellSize = _cellSize; }
+	// - SetMinPieces
+	// --- Cells with fewer instances are not baked and stay separate objects, 2 by default
+	void SetMinPieces(unsigned int _count) { m_iMinPieces = _count > 1 ? _count : 1; }
+	// - AddMesh
+	// --- Copies the mesh, returns the id AddInstance takes
+	unsigned int AddMesh(const Vertex* _vertices, unsigned int _vertexCount, const unsigned int* _indexes, unsigned int _indexCount);
+	// - AddInstance
+	// --- _material groups instances that may share a batch, _source is reported back in the pieces
+	void AddInstance(unsigned int _mesh, unsigned int _material, const Mat4& _worldMatrix, unsigned int _source);
+	// - Build
+	// --- One batch per material and cell with at least the minimum pieces, ordered by material then cell
+	void Build(vector<StaticBatch>* _batches) const;
+	void Clear();
+
+	// ===== Accessors
+	size_t GetMeshCount() const { return m_Meshes.size(); }
+	size_t GetInstanceCount() const { return m_Instances.size(); }
+};
+
+// - CullStaticBatch
+// --- Index ranges of the pieces of _batch touching _frustum, neighbouring pieces merged into one range
+void CullStaticBatch(const StaticBatch& _batch, const Frustum& _frustum, vector<IndexRange>* _ranges);
+
+// - CheckStaticBatcher
+// --- Bakes random meshes with random transforms and checks every merged vertex is bit-identical to its source
+// --- vertex transformed on its own, that the indexes still draw the same triangles, that each instance ends
+// --- up in exactly one batch of its material and cell and that culling keeps exactly the pieces in view
+// --- Logs the draw calls before and after; returns false if a check failed
+bool CheckStaticBatcher();
@@ -0,0 +1,1328 @@
+#include "TextureCompression.h"
+
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "MappedFile.h"
+#include "Profiling.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define COMPRESSION_SSE
+#include <emmintrin.h>
+#endif
+
+using std::thread;
+
+// ===== Local Helpers ===== //
+static const size_t MAX_THREADS = 32;
+// === Channel masks of an RGBA pixel read as a little endian int
+static const unsigned int CHANNELS_RGB = 0x00FFFFFF;
+static const unsigned int CHANNELS_RGBA = 0xFFFFFFFF;
+static const unsigned int CHANNELS_ALPHA = 0xFF000000;
+
+// === BC7 palette weights of 4 bit indexes, out of 64, and the nearest of them to each step of 0..64
+static const unsigned char BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const unsigned char BC7_STEP_INDEXES[65] = {
+	0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 6, 7, 7, 7, 7,
+	8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 14, 15, 15 };
+// === Palette order of the steps along the line from endpoint 0 to endpoint 1
+static const unsigned char COLOR_STEP_INDEXES[4] = { 0, 2, 3, 1 };
+static const unsigned char ALPHA_STEP_INDEXES[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+// === Position on that line of each palette index
+static const float COLOR_POSITIONS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+static inline float Clamp255(float _value)
+{
+	return _value < 0 ? 0 : _value > 255.0f ? 255.0f : _value;
+}
+
+static inline unsigned int Get16(const unsigned char* _bytes)
+{
+	return _bytes[0] | ((unsigned int)_bytes[1] << 8);
+}
+
+static inline void Put16(unsigned char* _bytes, unsigned int _value)
+{
+	_bytes[0] = (unsigned char)_value;
+	_bytes[1] = (unsigned char)(_value >> 8);
+}
+
+static const char* GetFormatName(unsigned int _format)
+{
+	switch (_format) {
+	case DDS_FORMAT_BC1_UNORM: return "BC1";
+	case DDS_FORMAT_BC3_UNORM: return "BC3";
+	case DDS_FORMAT_BC7_UNORM: return "BC7";
+	}
+	return "auto";
+}
+
+static const char* GetQualityName(CompressionQuality _quality)
+{
+	return _quality == COMPRESSION_FAST ? "fast" : _quality == COMPRESSION_NORMAL ? "normal" : "high";
+}
+// ========================= //
+
+// ===== Kernels ===== //
+// --- Every kernel works on the 16 RGBA pixels of one block; the SSE2 versions give exactly the scalar results
+
+// - ProjectStepsScalar
+// --- Step of each pixel along the line through _axis: (pixel . _axis - _base) * _scale rounded, clamped to [0, _maxStep]
+static void ProjectStepsScalar(const unsigned char* _pixels, const int* _axis, int _base, float _scale, int _maxStep, unsigned char* _steps)
+{
+	for (unsigned int i = 0; i < 16; i++) {
+		const unsigned char* pixel = _pixels + i * 4;
+		int dot = pixel[0] * _axis[0] + pixel[1] * _axis[1] + pixel[2] * _axis[2] + pixel[3] * _axis[3];
+		int step = (int)((float)(dot - _base) * _scale + 0.5f);
+		_steps[i] = (unsigned char)(step < 0 ? 0 : step > _maxStep ? _maxStep : step);
+	}
+}
+
+// - NearestIndexesScalar
+// --- Palette entry of _palette nearest to each pixel over the _channels kept, the first of equally near ones
+// --- Returns the summed squared error of the block over those channels
+static unsigned int NearestIndexesScalar(const unsigned char* _pixels, const unsigned char* _palette, unsigned int _count, unsigned int _channels,
+	unsigned char* _indexes)
+{
+	unsigned char mask[4] = { (unsigned char)_channels, (unsigned char)(_channels >> 8), (unsigned char)(_channels >> 16), (unsigned char)(_channels >> 24) };
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < 16; i++) {
+		const unsigned char* pixel = _pixels + i * 4;
+		unsigned int best = UINT_MAX, index = 0;
+		for (unsigned int e = 0; e < _count; e++) {
+			const unsigned char* entry = _palette + e * 4;
+			unsigned int error = 0;
+			for (unsigned int c = 0; c < 4; c++) {
+				int difference = (pixel[c] & mask[c]) - (entry[c] & mask[c]);
+				error += difference * difference;
+			}
+			if (error < best) {
+				best = error;
+				index = e;
+			}
+		}
+		_indexes[i] = (unsigned char)index;
+		total += best;
+	}
+	return total;
+}
+
+// - BlockErrorScalar
+// --- Summed squared error of every channel of two blocks
+static unsigned int BlockErrorScalar(const unsigned char* _a, const unsigned char* _b)
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < 64; i++) {
+		int difference = _a[i] - _b[i];
+		total += difference * difference;
+	}
+	return total;
+}
+
+#if defined(COMPRESSION_SSE)
+// - SumPairs
+// --- [a0 + a1, a2 + a3, b0 + b1, b2 + b3]: madd leaves each pixel as two sums, RG and BA
+static inline __m128i SumPairs(__m128i _a, __m128i _b)
+{
+	__m128 a = _mm_castsi128_ps(_a), b = _mm_castsi128_ps(_b);
+	__m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i odd = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	return _mm_add_epi32(even, odd);
+}
+
+static inline unsigned int SumLanes(__m128i _value)
+{
+	_value = _mm_add_epi32(_value, _mm_shuffle_epi32(_value, _MM_SHUFFLE(1, 0, 3, 2)));
+	_value = _mm_add_epi32(_value, _mm_shuffle_epi32(_value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (unsigned int)_mm_cvtsi128_si32(_value);
+}
+
+static void ProjectStepsSSE(const unsigned char* _pixels, const int* _axis, int _base, float _scale, int _maxStep, unsigned char* _steps)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i axis = _mm_setr_epi16((short)_axis[0], (short)_axis[1], (short)_axis[2], (short)_axis[3],
+		(short)_axis[0], (short)_axis[1], (short)_axis[2], (short)_axis[3]);
+	const __m128i base = _mm_set1_epi32(_base);
+	const __m128 scale = _mm_set1_ps(_scale), half = _mm_set1_ps(0.5f);
+	__m128i steps[4];
+	for (unsigned int i = 0; i < 4; i++) {
+		// === 4 pixels: bytes widened to 16 bits, dotted with the axis two channels at a time
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(_pixels + i * 16));
+		__m128i dots = SumPairs(_mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), axis), _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), axis));
+		steps[i] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(dots, base)), scale), half));
+	}
+	// === Clamped while packing down to bytes, the saturation can only push further out of range
+	const __m128i maxStep = _mm_set1_epi16((short)_maxStep);
+	__m128i low = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(steps[0], steps[1]), zero), maxStep);
+	__m128i high = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(steps[2], steps[3]), zero), maxStep);
+	_mm_storeu_si128((__m128i*)_steps, _mm_packus_epi16(low, high));
+}
+
+static unsigned int NearestIndexesSSE(const unsigned char* _pixels, const unsigned char* _palette, unsigned int _count, unsigned int _channels,
+	unsigned char* _indexes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask = _mm_set1_epi32((int)_channels);
+	__m128i low[4], high[4], best[4], indexes[4];
+	for (unsigned int i = 0; i < 4; i++) {
+		__m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(_pixels + i * 16)), mask);
+		low[i] = _mm_unpacklo_epi8(pixels, zero);
+		high[i] = _mm_unpackhi_epi8(pixels, zero);
+		best[i] = _mm_set1_epi32(INT_MAX);
+		indexes[i] = zero;
+	}
+	for (unsigned int e = 0; e < _count; e++) {
+		// === The entry against 4 pixels at a time, kept where it is strictly nearer
+		int value;
+		memcpy(&value, _palette + e * 4, sizeof(value));
+		__m128i entry = _mm_unpacklo_epi8(_mm_and_si128(_mm_set1_epi32(value), mask), zero);
+		__m128i index = _mm_set1_epi32((int)e);
+		for (unsigned int i = 0; i < 4; i++) {
+			__m128i lowDifference = _mm_sub_epi16(low[i], entry), highDifference = _mm_sub_epi16(high[i], entry);
+			__m128i error = SumPairs(_mm_madd_epi16(lowDifference, lowDifference), _mm_madd_epi16(highDifference, highDifference));
+			__m128i nearer = _mm_cmplt_epi32(error, best[i]);
+			best[i] = _mm_or_si128(_mm_and_si128(nearer, error), _mm_andnot_si128(nearer, best[i]));
+			indexes[i] = _mm_or_si128(_mm_and_si128(nearer, index), _mm_andnot_si128(nearer, indexes[i]));
+		}
+	}
+	__m128i packed = _mm_packus_epi16(_mm_packs_epi32(indexes[0], indexes[1]), _mm_packs_epi32(indexes[2], indexes[3]));
+	_mm_storeu_si128((__m128i*)_indexes, packed);
+	return SumLanes(_mm_add_epi32(_mm_add_epi32(best[0], best[1]), _mm_add_epi32(best[2], best[3])));
+}
+
+static unsigned int BlockErrorSSE(const unsigned char* _a, const unsigned char* _b)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i total = zero;
+	for (unsigned int i = 0; i < 4; i++) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(_a + i * 16)), b = _mm_loadu_si128((const __m128i*)(_b + i * 16));
+		__m128i lowDifference = _mm_sub_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+		__m128i highDifference = _mm_sub_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+		total = _mm_add_epi32(total, _mm_add_epi32(_mm_madd_epi16(lowDifference, lowDifference), _mm_madd_epi16(highDifference, highDifference)));
+	}
+	return SumLanes(total);
+}
+#endif
+
+static inline void ProjectSteps(const unsigned char* _pixels, const int* _axis, int _base, float _scale, int _maxStep, unsigned char* _steps)
+{
+#if defined(COMPRESSION_SSE)
+	ProjectStepsSSE(_pixels, _axis, _base, _scale, _maxStep, _steps);
+#else
+	ProjectStepsScalar(_pixels, _axis, _base, _scale, _maxStep, _steps);
+#endif
+}
+
+static inline unsigned int NearestIndexes(const unsigned char* _pixels, const unsigned char* _palette, unsigned int _count, unsigned int _channels,
+	unsigned char* _indexes)
+{
+#if defined(COMPRESSION_SSE)
+	return NearestIndexesSSE(_pixels, _palette, _count, _channels, _indexes);
+#else
+	return NearestIndexesScalar(_pixels, _palette, _count, _channels, _indexes);
+#endif
+}
+
+static inline unsigned int BlockError(const unsigned char* _a, const unsigned char* _b)
+{
+#if defined(COMPRESSION_SSE)
+	return BlockErrorSSE(_a, _b);
+#else
+	return BlockErrorScalar(_a, _b);
+#endif
+}
+
+// - ProjectOntoLine
+// --- Steps 0.._maxStep of the pixels along the line from _from to _to over the first _channels channels
+static void ProjectOntoLine(const unsigned char* _pixels, const unsigned char* _from, const unsigned char* _to, unsigned int _channels, int _maxStep,
+	unsigned char* _steps)
+{
+	int axis[4] = { 0, 0, 0, 0 };
+	int base = 0, length = 0;
+	for (unsigned int c = 0; c < _channels; c++) {
+		axis[c] = (int)_to[c] - (int)_from[c];
+		base += _from[c] * axis[c];
+		length += axis[c] * axis[c];
+	}
+	ProjectSteps(_pixels, axis, base, length > 0 ? (float)_maxStep / (float)length : 0.0f, _maxStep, _steps);
+}
+// =================== //
+
+// ===== Endpoints ===== //
+// - GetBoundingBox
+// --- Corners of the box around the first _channels channels of the pixels, on the diagonal the colors run along:
+// --- a channel falling as the widest one rises goes the other way. Inset by a quarter of a step of a _levels palette,
+// --- so the extremes don't use up palette entries on a few pixels
+static void GetBoundingBox(const unsigned char* _pixels, unsigned int _channels, unsigned int _levels, float* _low, float* _high)
+{
+	float minimum[4] = { 255, 255, 255, 255 }, maximum[4] = { 0, 0, 0, 0 }, mean[4] = { 0, 0, 0, 0 };
+	for (unsigned int i = 0; i < 16; i++) {
+		for (unsigned int c = 0; c < _channels; c++) {
+			float value = _pixels[i * 4 + c];
+			minimum[c] = value < minimum[c] ? value : minimum[c];
+			maximum[c] = value > maximum[c] ? value : maximum[c];
+			mean[c] += value / 16.0f;
+		}
+	}
+	unsigned int widest = 0;
+	for (unsigned int c = 1; c < _channels; c++)
+		widest = maximum[c] - minimum[c] > maximum[widest] - minimum[widest] ? c : widest;
+
+	for (unsigned int c = 0; c < _channels; c++) {
+		float covariance = 0;
+		for (unsigned int i = 0; i < 16; i++)
+			covariance += (_pixels[i * 4 + c] - mean[c]) * (_pixels[i * 4 + widest] - mean[widest]);
+		float inset = (maximum[c] - minimum[c]) / (float)(_levels * 4);
+		_low[c] = covariance < 0 ? maximum[c] - inset : minimum[c] + inset;
+		_high[c] = covariance < 0 ? minimum[c] + inset : maximum[c] - inset;
+	}
+}
+
+// - GetPrincipalAxis
+// --- Ends of the pixels' spread along the axis they vary most on, over the first _channels channels
+static void GetPrincipalAxis(const unsigned char* _pixels, unsigned int _channels, float* _low, float* _high)
+{
+	float mean[4] = { 0, 0, 0, 0 };
+	for (unsigned int i = 0; i < 16; i++)
+		for (unsigned int c = 0; c < _channels; c++)
+			mean[c] += _pixels[i * 4 + c] / 16.0f;
+	float covariance[4][4] = {};
+	for (unsigned int i = 0; i < 16; i++) {
+		float offset[4];
+		for (unsigned int c = 0; c < _channels; c++)
+			offset[c] = _pixels[i * 4 + c] - mean[c];
+		for (unsigned int a = 0; a < _channels; a++)
+			for (unsigned int b = a; b < _channels; b++)
+				covariance[a][b] += offset[a] * offset[b];
+	}
+	for (unsigned int a = 0; a < _channels; a++)
+		for (unsigned int b = 0; b < a; b++)
+			covariance[a][b] = covariance[b][a];
+
+	// === Power iteration, from the column of the channel that varies most
+	unsigned int widest = 0;
+	for (unsigned int c = 1; c < _channels; c++)
+		widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+	float axis[4] = { 0, 0, 0, 0 };
+	for (unsigned int c = 0; c < _channels; c++)
+		axis[c] = covariance[c][widest];
+	for (unsigned int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = { 0, 0, 0, 0 }, largest = 0;
+		for (unsigned int a = 0; a < _channels; a++) {
+			for (unsigned int b = 0; b < _channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			largest = std::fabs(next[a]) > largest ? std::fabs(next[a]) : largest;
+		}
+		if (largest < 1e-6f)
+			break;
+		for (unsigned int c = 0; c < _channels; c++)
+			axis[c] = next[c] / largest;
+	}
+
+	float length = 0;
+	for (unsigned int c = 0; c < _channels; c++)
+		length += axis[c] * axis[c];
+	if (length < 1e-6f) {
+		// == Every pixel the same
+		for (unsigned int c = 0; c < _channels; c++)
+			_low[c] = _high[c] = mean[c];
+		return;
+	}
+	float nearest = 0, farthest = 0;
+	for (unsigned int i = 0; i < 16; i++) {
+		float position = 0;
+		for (unsigned int c = 0; c < _channels; c++)
+			position += (_pixels[i * 4 + c] - mean[c]) * axis[c];
+		nearest = position < nearest ? position : nearest;
+		farthest = position > farthest ? position : farthest;
+	}
+	for (unsigned int c = 0; c < _channels; c++) {
+		_low[c] = Clamp255(mean[c] + axis[c] * nearest / length);
+		_high[c] = Clamp255(mean[c] + axis[c] * farthest / length);
+	}
+}
+
+// - FitEndpoints
+// --- Least squares endpoints for pixels at _positions (0 at _low, 1 at _high) on the line between them,
+// --- false when the positions can't tell the two apart
+static bool FitEndpoints(const unsigned char* _pixels, unsigned int _channels, const float* _positions, float* _low, float* _high)
+{
+	float lowLow = 0, lowHigh = 0, highHigh = 0;
+	float lowPixel[4] = { 0, 0, 0, 0 }, highPixel[4] = { 0, 0, 0, 0 };
+	for (unsigned int i = 0; i < 16; i++) {
+		float high = _positions[i], low = 1.0f - high;
+		lowLow += low * low;
+		lowHigh += low * high;
+		highHigh += high * high;
+		for (unsigned int c = 0; c < _channels; c++) {
+			lowPixel[c] += low * _pixels[i * 4 + c];
+			highPixel[c] += high * _pixels[i * 4 + c];
+		}
+	}
+	float determinant = lowLow * highHigh - lowHigh * lowHigh;
+	if (std::fabs(determinant) < 1e-4f)
+		return false;
+	for (unsigned int c = 0; c < _channels; c++) {
+		_low[c] = Clamp255((highHigh * lowPixel[c] - lowHigh * highPixel[c]) / determinant);
+		_high[c] = Clamp255((lowLow * highPixel[c] - lowHigh * lowPixel[c]) / determinant);
+	}
+	return true;
+}
+// ===================== //
+
+// ===== BC1 / BC3 ===== //
+// - ColorBlock
+// --- The color half of a BC1 or BC3 block, error over RGB
+struct ColorBlock
+{
+	unsigned int	color0;
+	unsigned int	color1;
+	unsigned char	indexes[16];
+	unsigned int	error;
+};
+
+// - AlphaBlock
+// --- The alpha half of a BC3 block, error over alpha
+struct AlphaBlock
+{
+	unsigned int	alpha0;
+	unsigned int	alpha1;
+	unsigned char	indexes[16];
+	unsigned int	error;
+};
+
+static inline unsigned int QuantizeColor565(const float* _color)
+{
+	unsigned int red = (unsigned int)(_color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int green = (unsigned int)(_color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int blue = (unsigned int)(_color[2] * 31.0f / 255.0f + 0.5f);
+	return (red << 11) | (green << 5) | blue;
+}
+
+static inline void ExpandColor565(unsigned int _color, unsigned char* _rgba)
+{
+	unsigned int red = (_color >> 11) & 31, green = (_color >> 5) & 63, blue = _color & 31;
+	_rgba[0] = (unsigned char)((red << 3) | (red >> 2));
+	_rgba[1] = (unsigned char)((green << 2) | (green >> 4));
+	_rgba[2] = (unsigned char)((blue << 3) | (blue >> 2));
+	_rgba[3] = 255;
+}
+
+// - GetColorPalette
+// --- The four color palette, the third and fourth entries a third and two thirds of the way to color1
+static void GetColorPalette(unsigned int _color0, unsigned int _color1, unsigned char* _palette)
+{
+	ExpandColor565(_color0, _palette);
+	ExpandColor565(_color1, _palette + 4);
+	for (unsigned int c = 0; c < 3; c++) {
+		_palette[8 + c] = (unsigned char)((2 * _palette[c] + _palette[4 + c] + 1) / 3);
+		_palette[12 + c] = (unsigned char)((_palette[c] + 2 * _palette[4 + c] + 1) / 3);
+	}
+	_palette[11] = _palette[15] = 255;
+}
+
+// - GetAlphaPalette
+// --- Eight levels between alpha0 and alpha1 when alpha0 is larger, otherwise six and then exact 0 and 255
+static void GetAlphaPalette(unsigned int _alpha0, unsigned int _alpha1, unsigned char* _palette)
+{
+	memset(_palette, 0, 8 * 4);
+	_palette[3] = (unsigned char)_alpha0;
+	_palette[7] = (unsigned char)_alpha1;
+	if (_alpha0 > _alpha1) {
+		for (unsigned int i = 2; i < 8; i++)
+			_palette[i * 4 + 3] = (unsigned char)(((8 - i) * _alpha0 + (i - 1) * _alpha1 + 3) / 7);
+	}
+	else {
+		for (unsigned int i = 2; i < 6; i++)
+			_palette[i * 4 + 3] = (unsigned char)(((6 - i) * _alpha0 + (i - 1) * _alpha1 + 2) / 5);
+		_palette[6 * 4 + 3] = 0;
+		_palette[7 * 4 + 3] = 255;
+	}
+}
+
+// - EvaluateColor565
+// --- color0 the larger of the two so BC1 stays in its four color mode, and the index of every pixel:
+// --- the nearest entry, or its step along the line when _nearest is false
+static void EvaluateColor565(const unsigned char* _pixels, unsigned int _color0, unsigned int _color1, bool _nearest, ColorBlock* _block)
+{
+	_block->color0 = _color0 > _color1 ? _color0 : _color1;
+	_block->color1 = _color0 > _color1 ? _color1 : _color0;
+	unsigned char palette[16];
+	GetColorPalette(_block->color0, _block->color1, palette);
+	if (_nearest) {
+		_block->error = NearestIndexes(_pixels, palette, 4, CHANNELS_RGB, _block->indexes);
+		return;
+	}
+	unsigned char steps[16];
+	ProjectOntoLine(_pixels, palette, palette + 4, 3, 3, steps);
+	for (unsigned int i = 0; i < 16; i++)
+		_block->indexes[i] = COLOR_STEP_INDEXES[steps[i]];
+	_block->error = UINT_MAX;
+}
+
+static inline void EvaluateColor(const unsigned char* _pixels, const float* _low, const float* _high, bool _nearest, ColorBlock* _block)
+{
+	EvaluateColor565(_pixels, QuantizeColor565(_high), QuantizeColor565(_low), _nearest, _block);
+}
+
+// - NudgeColor
+// --- Moves each channel of each end one step either way while that lowers the error
+static void NudgeColor(const unsigned char* _pixels, ColorBlock* _block)
+{
+	const unsigned int shifts[3] = { 11, 5, 0 }, maximums[3] = { 31, 63, 31 };
+	bool improved = true;
+	for (unsigned int round = 0; round < 4 && improved && _block->error > 0; round++) {
+		improved = false;
+		for (unsigned int move = 0; move < 12; move++) {
+			unsigned int end = move / 6, channel = (move / 2) % 3;
+			unsigned int colors[2] = { _block->color0, _block->color1 };
+			unsigned int value = (colors[end] >> shifts[channel]) & maximums[channel];
+			if ((move & 1) ? value == maximums[channel] : value == 0)
+				continue;
+			value = (move & 1) ? value + 1 : value - 1;
+			colors[end] = (colors[end] & ~(maximums[channel] << shifts[channel])) | (value << shifts[channel]);
+			ColorBlock candidate;
+			EvaluateColor565(_pixels, colors[0], colors[1], true, &candidate);
+			if (candidate.error < _block->error) {
+				*_block = candidate;
+				improved = true;
+			}
+		}
+	}
+}
+
+static void EncodeColorBlock(const unsigned char* _pixels, CompressionQuality _quality, unsigned char* _block)
+{
+	ColorBlock best;
+	float low[4], high[4];
+	if (_quality == COMPRESSION_FAST) {
+		GetBoundingBox(_pixels, 3, 4, low, high);
+		EvaluateColor(_pixels, low, high, false, &best);
+	}
+	else {
+		// === Each start refit from the indexes it took while that lowers the error
+		best.error = UINT_MAX;
+		unsigned int refits = _quality == COMPRESSION_HIGH ? 3 : 1;
+		for (unsigned int start = 0; start < 2 && best.error > 0; start++) {
+			if (start == 0)
+				GetPrincipalAxis(_pixels, 3, low, high);
+			else
+				GetBoundingBox(_pixels, 3, 4, low, high);
+			ColorBlock candidate;
+			EvaluateColor(_pixels, low, high, true, &candidate);
+			for (unsigned int refit = 0; refit < refits && candidate.error > 0; refit++) {
+				float positions[16];
+				for (unsigned int i = 0; i < 16; i++)
+					positions[i] = COLOR_POSITIONS[candidate.indexes[i]];
+				// == EvaluateColor orders the ends again, which of them is color0 doesn't matter here
+				if (!FitEndpoints(_pixels, 3, positions, low, high))
+					break;
+				ColorBlock refitted;
+				EvaluateColor(_pixels, low, high, true, &refitted);
+				if (refitted.error >= candidate.error)
+					break;
+				candidate = refitted;
+			}
+			if (candidate.error < best.error)
+				best = candidate;
+		}
+		if (_quality == COMPRESSION_HIGH)
+			NudgeColor(_pixels, &best);
+	}
+
+	Put16(_block, best.color0);
+	Put16(_block + 2, best.color1);
+	unsigned int indexes = 0;
+	for (unsigned int i = 0; i < 16; i++)
+		indexes |= (unsigned int)best.indexes[i] << (i * 2);
+	for (unsigned int i = 0; i < 4; i++)
+		_block[4 + i] = (unsigned char)(indexes >> (i * 8));
+}
+
+// - EvaluateAlpha
+static void EvaluateAlpha(const unsigned char* _pixels, unsigned int _alpha0, unsigned int _alpha1, AlphaBlock* _block)
+{
+	unsigned char palette[8 * 4];
+	_block->alpha0 = _alpha0;
+	_block->alpha1 = _alpha1;
+	GetAlphaPalette(_alpha0, _alpha1, palette);
+	_block->error = NearestIndexes(_pixels, palette, 8, CHANNELS_ALPHA, _block->indexes);
+}
+
+static void EncodeAlphaBlock(const unsigned char* _pixels, CompressionQuality _quality, unsigned char* _block)
+{
+	unsigned int minimum = 255, maximum = 0, innerMinimum = 255, innerMaximum = 0;
+	for (unsigned int i = 0; i < 16; i++) {
+		unsigned int alpha = _pixels[i * 4 + 3];
+		minimum = alpha < minimum ? alpha : minimum;
+		maximum = alpha > maximum ? alpha : maximum;
+		if (alpha != 0 && alpha != 255) {
+			innerMinimum = alpha < innerMinimum ? alpha : innerMinimum;
+			innerMaximum = alpha > innerMaximum ? alpha : innerMaximum;
+		}
+	}
+
+	AlphaBlock best;
+	if (_quality == COMPRESSION_FAST || minimum == maximum) {
+		// === Eight levels over the whole range, each pixel's step along it
+		best.alpha0 = maximum;
+		best.alpha1 = minimum;
+		unsigned char steps[16];
+		const int axis[4] = { 0, 0, 0, 1 };
+		ProjectSteps(_pixels, axis, (int)minimum, maximum > minimum ? 7.0f / (float)(maximum - minimum) : 0.0f, 7, steps);
+		// == Counted up from alpha1, the line runs from alpha0
+		for (unsigned int i = 0; i < 16; i++)
+			best.indexes[i] = ALPHA_STEP_INDEXES[7 - steps[i]];
+	}
+	else {
+		// === Eight levels over the whole range, or six over what isn't 0 or 255, which the palette holds exactly
+		EvaluateAlpha(_pixels, maximum, minimum, &best);
+		if (best.error > 0 && (minimum == 0 || maximum == 255)) {
+			AlphaBlock exact;
+			EvaluateAlpha(_pixels, innerMinimum <= innerMaximum ? innerMinimum : 0, innerMinimum <= innerMaximum ? innerMaximum : 0, &exact);
+			if (exact.error < best.error)
+				best = exact;
+		}
+	}
+
+	_block[0] = (unsigned char)best.alpha0;
+	_block[1] = (unsigned char)best.alpha1;
+	unsigned long long indexes = 0;
+	for (unsigned int i = 0; i < 16; i++)
+		indexes |= (unsigned long long)best.indexes[i] << (i * 3);
+	for (unsigned int i = 0; i < 6; i++)
+		_block[2 + i] = (unsigned char)(indexes >> (i * 8));
+}
+
+// - DecodeColorBlock
+// --- BC3 always reads its color half in the four color mode, BC1 only when color0 is larger
+static void DecodeColorBlock(const unsigned char* _block, bool _fourColors, unsigned char* _pixels)
+{
+	unsigned int color0 = Get16(_block), color1 = Get16(_block + 2);
+	unsigned char palette[16];
+	GetColorPalette(color0, color1, palette);
+	if (!_fourColors && color0 <= color1) {
+		for (unsigned int c = 0; c < 3; c++)
+			palette[8 + c] = (unsigned char)((palette[c] + palette[4 + c]) / 2);
+		memset(palette + 12, 0, 4);
+	}
+	unsigned int indexes = _block[4] | ((unsigned int)_block[5] << 8) | ((unsigned int)_block[6] << 16) | ((unsigned int)_block[7] << 24);
+	for (unsigned int i = 0; i < 16; i++)
+		memcpy(_pixels + i * 4, palette + ((indexes >> (i * 2)) & 3) * 4, 4);
+}
+// ===================== //
+
+// ===== BC7 ===== //
+// - BC7Block
+// --- Mode 6: 7 bit endpoints, a p-bit below each, error over RGBA
+struct BC7Block
+{
+	unsigned char	endpoints[2][4];
+	unsigned int	pBits[2];
+	unsigned char	indexes[16];
+	unsigned int	error;
+};
+
+// - QuantizeBC7
+// --- _color to 7 bits that with _pBit below them land nearest it; returns that squared error
+static float QuantizeBC7(const float* _color, unsigned int _pBit, unsigned char* _endpoint)
+{
+	float error = 0;
+	for (unsigned int c = 0; c < 4; c++) {
+		int value = (int)((_color[c] - (float)_pBit) / 2.0f + 0.5f);
+		value = value < 0 ? 0 : value > 127 ? 127 : value;
+		_endpoint[c] = (unsigned char)value;
+		float difference = (float)((value << 1) | _pBit) - _color[c];
+		error += difference * difference;
+	}
+	return error;
+}
+
+static void GetBC7Palette(const BC7Block& _block, unsigned char* _palette)
+{
+	unsigned int endpoints[2][4];
+	for (unsigned int e = 0; e < 2; e++)
+		for (unsigned int c = 0; c < 4; c++)
+			endpoints[e][c] = ((unsigned int)_block.endpoints[e][c] << 1) | _block.pBits[e];
+	for (unsigned int i = 0; i < 16; i++)
+		for (unsigned int c = 0; c < 4; c++)
+			_palette[i * 4 + c] = (unsigned char)(((64 - BC7_WEIGHTS[i]) * endpoints[0][c] + BC7_WEIGHTS[i] * endpoints[1][c] + 32) >> 6);
+}
+
+// - EvaluateBC7Palette
+// --- Indexes and error of the endpoints and p-bits already in _block
+static void EvaluateBC7Palette(const unsigned char* _pixels, bool _nearest, BC7Block* _block)
+{
+	unsigned char palette[16 * 4];
+	GetBC7Palette(*_block, palette);
+	if (_nearest) {
+		_block->error = NearestIndexes(_pixels, palette, 16, CHANNELS_RGBA, _block->indexes);
+		return;
+	}
+	unsigned char steps[16];
+	ProjectOntoLine(_pixels, palette, palette + 15 * 4, 4, 64, steps);
+	for (unsigned int i = 0; i < 16; i++)
+		_block->indexes[i] = BC7_STEP_INDEXES[steps[i]];
+	_block->error = UINT_MAX;
+}
+
+// - EvaluateBC7
+// --- _low and _high quantized with the given p-bits, or with the p-bit that suits each best when _pBits is null
+static void EvaluateBC7(const unsigned char* _pixels, const float* _low, const float* _high, const unsigned int* _pBits, bool _nearest, BC7Block* _block)
+{
+	const float* ends[2] = { _low, _high };
+	for (unsigned int e = 0; e < 2; e++) {
+		if (_pBits) {
+			_block->pBits[e] = _pBits[e];
+			QuantizeBC7(ends[e], _pBits[e], _block->endpoints[e]);
+		}
+		else {
+			unsigned char odd[4];
+			bool even = QuantizeBC7(ends[e], 0, _block->endpoints[e]) <= QuantizeBC7(ends[e], 1, odd);
+			_block->pBits[e] = even ? 0 : 1;
+			if (!even)
+				memcpy(_block->endpoints[e], odd, 4);
+		}
+	}
+	EvaluateBC7Palette(_pixels, _nearest, _block);
+}
+
+// - EvaluateBC7PBits
+// --- Every p-bit pair when _allPBits, the best of them
+static void EvaluateBC7PBits(const unsigned char* _pixels, const float* _low, const float* _high, bool _allPBits, BC7Block* _block)
+{
+	EvaluateBC7(_pixels, _low, _high, nullptr, true, _block);
+	for (unsigned int pair = 0; pair < 4 && _allPBits && _block->error > 0; pair++) {
+		unsigned int pBits[2] = { pair & 1, pair >> 1 };
+		if (pBits[0] == _block->pBits[0] && pBits[1] == _block->pBits[1])
+			continue;
+		BC7Block candidate;
+		EvaluateBC7(_pixels, _low, _high, pBits, true, &candidate);
+		if (candidate.error < _block->error)
+			*_block = candidate;
+	}
+}
+
+// - NudgeBC7
+// --- Moves each channel of each end one 7 bit step either way while that lowers the error
+static void NudgeBC7(const unsigned char* _pixels, BC7Block* _block)
+{
+	bool improved = true;
+	for (unsigned int round = 0; round < 2 && improved && _block->error > 0; round++) {
+		improved = false;
+		for (unsigned int move = 0; move < 16; move++) {
+			unsigned int end = move / 8, channel = (move / 2) % 4;
+			unsigned int value = _block->endpoints[end][channel];
+			if ((move & 1) ? value == 127 : value == 0)
+				continue;
+			BC7Block candidate = *_block;
+			candidate.endpoints[end][channel] = (unsigned char)((move & 1) ? value + 1 : value - 1);
+			EvaluateBC7Palette(_pixels, true, &candidate);
+			if (candidate.error < _block->error) {
+				*_block = candidate;
+				improved = true;
+			}
+		}
+	}
+}
+
+static void WriteBits(unsigned char* _block, unsigned int* _position, unsigned int _value, unsigned int _count)
+{
+	for (unsigned int i = 0; i < _count; i++, (*_position)++)
+		_block[*_position >> 3] |= (unsigned char)(((_value >> i) & 1) << (*_position & 7));
+}
+
+static unsigned int ReadBits(const unsigned char* _block, unsigned int* _position, unsigned int _count)
+{
+	unsigned int value = 0;
+	for (unsigned int i = 0; i < _count; i++, (*_position)++)
+		value |= (unsigned int)((_block[*_position >> 3] >> (*_position & 7)) & 1) << i;
+	return value;
+}
+// =============== //
+
+// ===== Blocks ===== //
+void CompressBC1Block(const unsigned char* _pixels, CompressionQuality _quality, unsigned char* _block)
+{
+	EncodeColorBlock(_pixels, _quality, _block);
+}
+
+void CompressBC3Block(const unsigned char* _pixels, CompressionQuality _quality, unsigned char* _block)
+{
+	EncodeAlphaBlock(_pixels, _quality, _block);
+	EncodeColorBlock(_pixels, _quality, _block + 8);
+}
+
+void CompressBC7Block(const unsigned char* _pixels, CompressionQuality _quality, unsigned char* _block)
+{
+	BC7Block best;
+	float low[4], high[4];
+	if (_quality == COMPRESSION_FAST) {
+		GetBoundingBox(_pixels, 4, 16, low, high);
+		EvaluateBC7(_pixels, low, high, nullptr, false, &best);
+	}
+	else {
+		// === As the color half of BC1, with every p-bit pair tried on high
+		best.error = UINT_MAX;
+		bool allPBits = _quality == COMPRESSION_HIGH;
+		unsigned int refits = _quality == COMPRESSION_HIGH ? 3 : 1;
+		for (unsigned int start = 0; start < 2 && best.error > 0; start++) {
+			if (start == 0)
+				GetPrincipalAxis(_pixels, 4, low, high);
+			else
+				GetBoundingBox(_pixels, 4, 16, low, high);
+			BC7Block candidate;
+			EvaluateBC7PBits(_pixels, low, high, allPBits, &candidate);
+			for (unsigned int refit = 0; refit < refits && candidate.error > 0; refit++) {
+				float positions[16];
+				for (unsigned int i = 0; i < 16; i++)
+					positions[i] = BC7_WEIGHTS[candidate.indexes[i]] / 64.0f;
+				if (!FitEndpoints(_pixels, 4, positions, low, high))
+					break;
+				BC7Block refitted;
+				EvaluateBC7PBits(_pixels, low, high, allPBits, &refitted);
+				if (refitted.error >= candidate.error)
+					break;
+				candidate = refitted;
+			}
+			if (candidate.error < best.error)
+				best = candidate;
+		}
+		if (_quality == COMPRESSION_HIGH)
+			NudgeBC7(_pixels, &best);
+	}
+
+	// === The first index has no top bit, it must be in the lower half of the palette: swap the ends if not
+	if (best.indexes[0] >= 8) {
+		for (unsigned int c = 0; c < 4; c++) {
+			unsigned char endpoint = best.endpoints[0][c];
+			best.endpoints[0][c] = best.endpoints[1][c];
+			best.endpoints[1][c] = endpoint;
+		}
+		unsigned int pBit = best.pBits[0];
+		best.pBits[0] = best.pBits[1];
+		best.pBits[1] = pBit;
+		for (unsigned int i = 0; i < 16; i++)
+			best.indexes[i] = (unsigned char)(15 - best.indexes[i]);
+	}
+
+	// === Mode bit, R0 R1 G0 G1 B0 B1 A0 A1, the p-bits, then the indexes
+	memset(_block, 0, 16);
+	unsigned int position = 0;
+	WriteBits(_block, &position, 1 << 6, 7);
+	for (unsigned int c = 0; c < 4; c++) {
+		WriteBits(_block, &position, best.endpoints[0][c], 7);
+		WriteBits(_block, &position, best.endpoints[1][c], 7);
+	}
+	WriteBits(_block, &position, best.pBits[0], 1);
+	WriteBits(_block, &position, best.pBits[1], 1);
+	WriteBits(_block, &position, best.indexes[0], 3);
+	for (unsigned int i = 1; i < 16; i++)
+		WriteBits(_block, &position, best.indexes[i], 4);
+}
+
+bool DecodeBlock(unsigned int _format, const unsigned char* _block, unsigned char* _pixels)
+{
+	switch (_format) {
+	case DDS_FORMAT_BC1_UNORM:
+		DecodeColorBlock(_block, false, _pixels);
+		return true;
+	case DDS_FORMAT_BC3_UNORM: {
+		DecodeColorBlock(_block + 8, true, _pixels);
+		unsigned char palette[8 * 4];
+		GetAlphaPalette(_block[0], _block[1], palette);
+		unsigned long long indexes = 0;
+		for (unsigned int i = 0; i < 6; i++)
+			indexes |= (unsigned long long)_block[2 + i] << (i * 8);
+		for (unsigned int i = 0; i < 16; i++)
+			_pixels[i * 4 + 3] = palette[((indexes >> (i * 3)) & 7) * 4 + 3];
+		return true;
+	}
+	case DDS_FORMAT_BC7_UNORM: {
+		// == Mode 6 is six 0 bits then a 1
+		if ((_block[0] & 0x7F) != (1 << 6))
+			return false;
+		BC7Block block;
+		unsigned int position = 7;
+		for (unsigned int c = 0; c < 4; c++) {
+			block.endpoints[0][c] = (unsigned char)ReadBits(_block, &position, 7);
+			block.endpoints[1][c] = (unsigned char)ReadBits(_block, &position, 7);
+		}
+		block.pBits[0] = ReadBits(_block, &position, 1);
+		block.pBits[1] = ReadBits(_block, &position, 1);
+		unsigned char palette[16 * 4];
+		GetBC7Palette(block, palette);
+		for (unsigned int i = 0; i < 16; i++)
+			memcpy(_pixels + i * 4, palette + ReadBits(_block, &position, i == 0 ? 3 : 4) * 4, 4);
+		return true;
+	}
+	}
+	return false;
+}
+// ================== //
+
+// ===== Textures ===== //
+// - FetchBlock
+// --- The 4x4 pixels at block (_blockX, _blockY) of a surface as RGBA, its last row and column repeated past the edges
+static void FetchBlock(const DDSSubresource& _surface, unsigned int _format, unsigned int _width, unsigned int _height,
+	unsigned int _blockX, unsigned int _blockY, unsigned char* _pixels)
+{
+	bool bgra = _format != DDS_FORMAT_R8G8B8A8_UNORM, opaque = _format == DDS_FORMAT_B8G8R8X8_UNORM;
+	for (unsigned int y = 0; y < 4; y++) {
+		unsigned int row = _blockY * 4 + y < _height ? _blockY * 4 + y : _height - 1;
+		const unsigned char* source = (const unsigned char*)_surface.data + (size_t)row * _surface.rowPitch;
+		for (unsigned int x = 0; x < 4; x++) {
+			unsigned int column = _blockX * 4 + x < _width ? _blockX * 4 + x : _width - 1;
+			const unsigned char* pixel = source + column * 4;
+			unsigned char* target = _pixels + (y * 4 + x) * 4;
+			target[0] = pixel[bgra ? 2 : 0];
+			target[1] = pixel[1];
+			target[2] = pixel[bgra ? 0 : 2];
+			target[3] = opaque ? 255 : pixel[3];
+		}
+	}
+}
+
+// - HasTransparentPixels
+static bool HasTransparentPixels(const DDSTexture& _texture, const DDSSubresource* _surfaces)
+{
+	if (_texture.format == DDS_FORMAT_B8G8R8X8_UNORM)
+		return false;
+	for (unsigned int slice = 0, s = 0; slice < _texture.arraySize; slice++) {
+		for (unsigned int mip = 0; mip < _texture.mipCount; mip++, s++) {
+			unsigned int width = _texture.width >> mip > 0 ? _texture.width >> mip : 1, height = _texture.height >> mip > 0 ? _texture.height >> mip : 1;
+			for (unsigned int y = 0; y < height; y++) {
+				const unsigned char* row = (const unsigned char*)_surfaces[s].data + (size_t)y * _surfaces[s].rowPitch;
+				for (unsigned int x = 0; x < width; x++)
+					if (row[x * 4 + 3] != 255)
+						return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool CanCompressDDS(const DDSTexture& _texture)
+{
+	bool rgba = _texture.format == DDS_FORMAT_R8G8B8A8_UNORM || _texture.format == DDS_FORMAT_B8G8R8A8_UNORM || _texture.format == DDS_FORMAT_B8G8R8X8_UNORM;
+	// === D3D11 only takes block compressed textures whose top mip is a whole number of blocks
+	return rgba && _texture.dimension == DDS_DIMENSION_TEXTURE2D && _texture.width % 4 == 0 && _texture.height % 4 == 0 && _texture.bits != nullptr;
+}
+
+DDSResult CompressDDS(const DDSTexture& _texture, const CompressionOptions& _options, vector<unsigned char>* _file, CompressionStats* _stats)
+{
+	Stopwatch stopwatch;
+	if (!CanCompressDDS(_texture))
+		return DDS_NOT_SUPPORTED;
+	vector<DDSSubresource> sources(_texture.mipCount * _texture.arraySize);
+	DDSLayout layout;
+	DDSResult result = LayoutDDS(_texture, 0, &sources[0], &layout);
+	if (result != DDS_OK)
+		return result;
+
+	unsigned int format = _options.format;
+	if (format == DDS_FORMAT_UNKNOWN)
+		format = HasTransparentPixels(_texture, &sources[0]) ? DDS_FORMAT_BC3_UNORM : DDS_FORMAT_BC1_UNORM;
+	if (format != DDS_FORMAT_BC1_UNORM && format != DDS_FORMAT_BC3_UNORM && format != DDS_FORMAT_BC7_UNORM)
+		return DDS_NOT_SUPPORTED;
+	unsigned int blockBytes = format == DDS_FORMAT_BC1_UNORM ? 8 : 16;
+
+	// === Headers, then every surface where the compressed file wants it
+	struct Surface
+	{
+		unsigned int	width;
+		unsigned int	height;
+		unsigned int	blocksWide;
+		size_t			offset;
+	};
+	DDSTexture compressed = _texture;
+	compressed.format = format;
+	unsigned char headers[DDS_MAX_HEADER_SIZE];
+	size_t headerBytes = WriteDDSHeaders(compressed, headers);
+	vector<Surface> surfaces(sources.size());
+	// == Each row of blocks is a job: its surface and row
+	vector<unsigned int> jobs;
+	size_t offset = headerBytes, pixelCount = 0;
+	for (unsigned int s = 0; s < surfaces.size(); s++) {
+		unsigned int mip = s % _texture.mipCount;
+		Surface& surface = surfaces[s];
+		surface.width = _texture.width >> mip > 0 ? _texture.width >> mip : 1;
+		surface.height = _texture.height >> mip > 0 ? _texture.height >> mip : 1;
+		surface.blocksWide = (surface.width + 3) / 4;
+		surface.offset = offset;
+		unsigned int blocksHigh = (surface.height + 3) / 4;
+		for (unsigned int row = 0; row < blocksHigh; row++)
+			jobs.push_back((s << 16) | row);
+		offset += (size_t)surface.blocksWide * blocksHigh * blockBytes;
+		pixelCount += (size_t)surface.width * surface.height;
+	}
+	_file->assign(offset, 0);
+	memcpy(&(*_file)[0], headers, headerBytes);
+
+	// === Threads take the next row as they finish one; the error of every block is measured on its decoded pixels
+	unsigned int threadCount = _options.threadCount;
+	if (threadCount == 0)
+		threadCount = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	threadCount = threadCount < MAX_THREADS ? threadCount : (unsigned int)MAX_THREADS;
+	threadCount = threadCount < jobs.size() ? threadCount : (unsigned int)jobs.size();
+	std::atomic<unsigned int> nextJob(0);
+	unsigned long long errors[MAX_THREADS] = {};
+	unsigned int blockCount = 0;
+	auto work = [&](unsigned int _thread) {
+		unsigned char pixels[64], decoded[64];
+		unsigned long long error = 0;
+		for (unsigned int job = nextJob++; job < jobs.size(); job = nextJob++) {
+			unsigned int s = jobs[job] >> 16, row = jobs[job] & 0xFFFF;
+			const Surface& surface = surfaces[s];
+			unsigned char* block = &(*_file)[surface.offset + (size_t)row * surface.blocksWide * blockBytes];
+			for (unsigned int column = 0; column < surface.blocksWide; column++, block += blockBytes) {
+				FetchBlock(sources[s], _texture.format, surface.width, surface.height, column, row, pixels);
+				if (format == DDS_FORMAT_BC1_UNORM)
+					CompressBC1Block(pixels, _options.quality, block);
+				else if (format == DDS_FORMAT_BC3_UNORM)
+					CompressBC3Block(pixels, _options.quality, block);
+				else
+					CompressBC7Block(pixels, _options.quality, block);
+
+				DecodeBlock(format, block, decoded);
+				if (column * 4 + 4 <= surface.width && row * 4 + 4 <= surface.height) {
+					error += BlockError(pixels, decoded);
+				}
+				else {
+					// == Only the pixels inside the surface count
+					for (unsigned int y = 0; y < 4 && row * 4 + y < surface.height; y++)
+						for (unsigned int x = 0; x < 4 && column * 4 + x < surface.width; x++)
+							for (unsigned int c = 0; c < 4; c++) {
+								int difference = pixels[(y * 4 + x) * 4 + c] - decoded[(y * 4 + x) * 4 + c];
+								error += difference * difference;
+							}
+				}
+			}
+		}
+		errors[_thread] = error;
+	};
+	vector<thread> workers;
+	for (unsigned int t = 1; t < threadCount; t++)
+		workers.push_back(thread(work, t));
+	work(0);
+	unsigned long long error = errors[0];
+	for (unsigned int t = 1; t < threadCount; t++) {
+		workers[t - 1].join();
+		error += errors[t];
+	}
+	for (unsigned int s = 0; s < surfaces.size(); s++)
+		blockCount += surfaces[s].blocksWide * ((surfaces[s].height + 3) / 4);
+
+	if (_stats) {
+		double meanError = (double)error / ((double)pixelCount * 4.0);
+		_stats->format = format;
+		_stats->quality = _options.quality;
+		_stats->threadCount = threadCount;
+		_stats->blockCount = blockCount;
+		_stats->pixelCount = pixelCount;
+		_stats->sourceBytes = pixelCount * 4;
+		_stats->compressedBytes = _file->size() - headerBytes;
+		_stats->psnr = error > 0 ? 10.0 * std::log10(255.0 * 255.0 / meanError) : 100.0;
+		_stats->milliseconds = stopwatch.ElapsedMilliseconds();
+	}
+	return DDS_OK;
+}
+
+bool CompressDDSFile(const char* _source, const char* _destination, const CompressionOptions& _options)
+{
+	// === Compressed before the source is closed and the destination opened, they may be the same file
+	vector<unsigned char> compressed;
+	CompressionStats stats;
+	{
+		MappedFile file;
+		DDSTexture texture;
+		if (!file.Open(_source)) {
+			LogMessage("TextureCompression: %s could not be opened", _source);
+			return false;
+		}
+		DDSResult result = ParseDDS(file.GetData(), file.GetSize(), &texture);
+		if (result == DDS_OK)
+			result = CompressDDS(texture, _options, &compressed, &stats);
+		if (result != DDS_OK) {
+			LogMessage("TextureCompression: %s %s", _source, result == DDS_NOT_SUPPORTED
+				? "is not an uncompressed 8 bit RGBA 2D texture whose size is a multiple of 4" : "is not a valid DDS file");
+			return false;
+		}
+	}
+
+	FILE* file = nullptr;
+#ifdef _WIN32
+	fopen_s(&file, _destination, "wb");
+#else
+	file = fopen(_destination, "wb");
+#endif
+	bool written = file != nullptr && fwrite(&compressed[0], 1, compressed.size(), file) == compressed.size();
+	if (file)
+		written = fclose(file) == 0 && written;
+	if (!written) {
+		LogMessage("TextureCompression: %s could not be written", _destination);
+		return false;
+	}
+	LogCompressionStats(_source, stats);
+	return true;
+}
+
+bool ParseCompressionArgument(const char* _argument, CompressionOptions* _options)
+{
+	const char* formats[] = { "auto", "bc1", "bc3", "bc7" };
+	const unsigned int formatValues[] = { DDS_FORMAT_UNKNOWN, DDS_FORMAT_BC1_UNORM, DDS_FORMAT_BC3_UNORM, DDS_FORMAT_BC7_UNORM };
+	for (unsigned int i = 0; i < 4; i++) {
+		if (strcmp(_argument, formats[i]) == 0) {
+			_options->format = formatValues[i];
+			return true;
+		}
+	}
+	for (unsigned int i = COMPRESSION_FAST; i <= COMPRESSION_HIGH; i++) {
+		if (strcmp(_argument, GetQualityName((CompressionQuality)i)) == 0) {
+			_options->quality = (CompressionQuality)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void LogCompressionStats(const char* _name, const CompressionStats& _stats)
+{
+	LogMessage("TextureCompression: %s to %s %s, %u KB -> %u KB, PSNR %.2f dB, %.2f ms (%.1f Mpixels/s on %u thread%s)",
+		_name, GetFormatName(_stats.format), GetQualityName(_stats.quality), (unsigned int)(_stats.sourceBytes / 1024),
+		(unsigned int)(_stats.compressedBytes / 1024), _stats.psnr, _stats.milliseconds,
+		_stats.milliseconds > 0 ? _stats.pixelCount / (_stats.milliseconds * 1000.0) : 0.0, _stats.threadCount, _stats.threadCount == 1 ? "" : "s");
+}
+// ==================== //
+
+// ===== Checks ===== //
+static unsigned int CheckRandom(unsigned int* _state)
+{
+	*_state = *_state * 1664525u + 1013904223u;
+	return *_state >> 8;
+}
+
+// - MakeCheckBlock
+// --- _kind 0 is a solid color, 1 a smooth gradient, 2 a gradient alpha tested to exact 0 or 255, 3 noise
+static void MakeCheckBlock(unsigned int _kind, unsigned int* _random, unsigned char* _pixels)
+{
+	unsigned char base[4], step[4];
+	for (unsigned int c = 0; c < 4; c++) {
+		base[c] = (unsigned char)(CheckRandom(_random) % 192);
+		step[c] = (unsigned char)(CheckRandom(_random) % 10);
+	}
+	for (unsigned int i = 0; i < 16; i++) {
+		for (unsigned int c = 0; c < 4; c++) {
+			unsigned int value = base[c];
+			if (_kind == 1 || _kind == 2)
+				value += step[c] * ((i & 3) + (i >> 2));
+			else if (_kind == 3)
+				value = CheckRandom(_random) & 255;
+			_pixels[i * 4 + c] = (unsigned char)(value > 255 ? 255 : value);
+		}
+		if (_kind == 2)
+			_pixels[i * 4 + 3] = (CheckRandom(_random) & 1) ? 255 : 0;
+		else if (_kind != 3)
+			_pixels[i * 4 + 3] = 255;
+	}
+}
+
+// - MakeCheckTexture
+// --- A DX10 BGRA DDS file of _width x _height with every mip, a smooth pattern, alpha tested when _alpha
+static void MakeCheckTexture(unsigned int _width, unsigned int _height, bool _alpha, vector<unsigned char>* _file)
+{
+	DDSTexture texture = { _width, _height, 1, 1, 1, DDS_FORMAT_B8G8R8A8_UNORM, DDS_DIMENSION_TEXTURE2D, false, nullptr, 0 };
+	while ((_width >> texture.mipCount) > 0 || (_height >> texture.mipCount) > 0)
+		texture.mipCount++;
+	unsigned char headers[DDS_MAX_HEADER_SIZE];
+	size_t headerBytes = WriteDDSHeaders(texture, headers);
+	_file->assign(headers, headers + headerBytes);
+	for (unsigned int mip = 0; mip < texture.mipCount; mip++) {
+		unsigned int width = _width >> mip > 0 ? _width >> mip : 1, height = _height >> mip > 0 ? _height >> mip : 1;
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				unsigned char pixel[4] = { (unsigned char)(x * 8 + mip * 32), (unsigned char)(y * 4 + 64), (unsigned char)(128 + x * 2 - y),
+					(unsigned char)(_alpha && ((x + y) & 2) ? 0 : 255) };
+				_file->insert(_file->end(), pixel, pixel + 4);
+			}
+		}
+	}
+}
+
+bool CheckTextureCompression()
+{
+	unsigned int failures = 0;
+	unsigned int random = 12345;
+	unsigned char pixels[64], decoded[64], block[16];
+
+#if defined(COMPRESSION_SSE)
+	// === The SSE2 kernels against the scalar ones, on random pixels, lines and palettes
+	unsigned int kernelMismatches = 0;
+	for (unsigned int test = 0; test < 1000; test++) {
+		MakeCheckBlock(3, &random, pixels);
+		int axis[4];
+		for (unsigned int c = 0; c < 4; c++)
+			axis[c] = (int)(CheckRandom(&random) % 511) - 255;
+		const int maxSteps[3] = { 3, 7, 64 };
+		int maxStep = maxSteps[test % 3], base = (int)(CheckRandom(&random) % 130000) - 65000;
+		float scale = (float)(CheckRandom(&random) % 1000) / 100000.0f;
+		unsigned char scalarSteps[16], sseSteps[16];
+		ProjectStepsScalar(pixels, axis, base, scale, maxStep, scalarSteps);
+		ProjectStepsSSE(pixels, axis, base, scale, maxStep, sseSteps);
+
+		unsigned char palette[64], scalarIndexes[16], sseIndexes[16];
+		for (unsigned int i = 0; i < 64; i++)
+			palette[i] = (unsigned char)CheckRandom(&random);
+		const unsigned int counts[3] = { 4, 8, 16 }, channels[3] = { CHANNELS_RGB, CHANNELS_ALPHA, CHANNELS_RGBA };
+		unsigned int scalarError = NearestIndexesScalar(pixels, palette, counts[test % 3], channels[(test / 3) % 3], scalarIndexes);
+		unsigned int sseError = NearestIndexesSSE(pixels, palette, counts[test % 3], channels[(test / 3) % 3], sseIndexes);
+
+		if (memcmp(scalarSteps, sseSteps, 16) != 0 || memcmp(scalarIndexes, sseIndexes, 16) != 0 || scalarError != sseError
+			|| BlockErrorScalar(pixels, palette) != BlockErrorSSE(pixels, palette))
+			kernelMismatches++;
+	}
+	if (kernelMismatches > 0) {
+		LogMessage("TextureCompression: the SSE2 kernels differ from the scalar ones in %u of 1000 blocks", kernelMismatches);
+		failures++;
+	}
+#endif
+
+	// === Every format and preset on 64 blocks of each kind; the error per pixel of each
+	const unsigned int formats[3] = { DDS_FORMAT_BC1_UNORM, DDS_FORMAT_BC3_UNORM, DDS_FORMAT_BC7_UNORM };
+	const char* kinds[4] = { "solid", "gradient", "alpha tested", "noise" };
+	// == Most a block may lose per pixel, by format and kind, 0 for none: BC1 drops alpha, and the one line of BC7 mode 6
+	// == can't follow an alpha that is 0 or 255 whatever the color does
+	const double limits[3][4] = { { 20, 40, 0, 0 }, { 20, 40, 40, 0 }, { 3, 4, 0, 0 } };
+	for (unsigned int f = 0; f < 3; f++) {
+		unsigned long long errors[3][4] = {};
+		unsigned int alphaMismatches = 0;
+		for (unsigned int kind = 0; kind < 4; kind++) {
+			for (unsigned int test = 0; test < 64; test++) {
+				MakeCheckBlock(kind, &random, pixels);
+				for (unsigned int quality = COMPRESSION_FAST; quality <= COMPRESSION_HIGH; quality++) {
+					if (formats[f] == DDS_FORMAT_BC1_UNORM)
+						CompressBC1Block(pixels, (CompressionQuality)quality, block);
+					else if (formats[f] == DDS_FORMAT_BC3_UNORM)
+						CompressBC3Block(pixels, (CompressionQuality)quality, block);
+					else
+						CompressBC7Block(pixels, (CompressionQuality)quality, block);
+					if (!DecodeBlock(formats[f], block, decoded)) {
+						alphaMismatches++;
+						continue;
+					}
+					for (unsigned int i = 0; i < 16; i++) {
+						for (unsigned int c = 0; c < (formats[f] == DDS_FORMAT_BC1_UNORM ? 3u : 4u); c++) {
+							int difference = pixels[i * 4 + c] - decoded[i * 4 + c];
+							errors[quality][kind] += difference * difference;
+						}
+						// == BC3 keeps alpha tested edges exact on every preset
+						if (formats[f] == DDS_FORMAT_BC3_UNORM && kind == 2 && decoded[i * 4 + 3] != pixels[i * 4 + 3])
+							alphaMismatches++;
+					}
+				}
+			}
+		}
+		if (alphaMismatches > 0) {
+			LogMessage("TextureCompression: %s lost %u alpha tested pixels or blocks", GetFormatName(formats[f]), alphaMismatches);
+			failures++;
+		}
+		for (unsigned int quality = COMPRESSION_FAST; quality <= COMPRESSION_HIGH; quality++) {
+			for (unsigned int kind = 0; kind < 4; kind++) {
+				double perPixel = errors[quality][kind] / (64.0 * 16.0);
+				if (limits[f][kind] > 0 && perPixel > limits[f][kind]) {
+					LogMessage("TextureCompression: %s %s loses %.2f per %s pixel, more than %.0f", GetFormatName(formats[f]),
+						GetQualityName((CompressionQuality)quality), perPixel, kinds[kind], limits[f][kind]);
+					failures++;
+				}
+			}
+		}
+		// == A better preset never does worse over the blocks that are hard to fit
+		unsigned long long fast = errors[0][1] + errors[0][3], normal = errors[1][1] + errors[1][3], high = errors[2][1] + errors[2][3];
+		if (normal > fast || high > normal) {
+			LogMessage("TextureCompression: %s errors fast %llu, normal %llu, high %llu do not fall", GetFormatName(formats[f]), fast, normal, high);
+			failures++;
+		}
+	}
+
+	// === Whole textures: the automatic format, headers that parse back, every mip, the same bytes on any number of threads
+	vector<unsigned char> source, single, threaded;
+	for (unsigned int test = 0; test < 3; test++) {
+		MakeCheckTexture(12, 8, test == 1, &source);
+		DDSTexture texture, compressed;
+		CompressionOptions options = { test == 2 ? (unsigned int)DDS_FORMAT_BC7_UNORM : (unsigned int)DDS_FORMAT_UNKNOWN, COMPRESSION_NORMAL, 1 };
+		CompressionStats stats, threadedStats;
+		bool compressedOk = ParseDDS(&source[0], source.size(), &texture) == DDS_OK && CompressDDS(texture, options, &single, &stats) == DDS_OK;
+		options.threadCount = 4;
+		compressedOk = compressedOk && CompressDDS(texture, options, &threaded, &threadedStats) == DDS_OK;
+		const unsigned int expected[3] = { DDS_FORMAT_BC1_UNORM, DDS_FORMAT_BC3_UNORM, DDS_FORMAT_BC7_UNORM };
+		// == 12x8, 6x4, 3x2 and 1x1 take 6, 2, 1 and 1 blocks
+		size_t blockBytes = expected[test] == DDS_FORMAT_BC1_UNORM ? 8 : 16, headerBytes = test == 2 ? 148 : 128;
+		DDSSubresource subresources[4];
+		DDSLayout layout;
+		if (!compressedOk || ParseDDS(&single[0], single.size(), &compressed) != DDS_OK || compressed.format != expected[test]
+			|| compressed.mipCount != 4 || compressed.width != 12 || single.size() != headerBytes + 10 * blockBytes
+			|| LayoutDDS(compressed, 0, subresources, &layout) != DDS_OK || stats.blockCount != 10 || stats.pixelCount != 12 * 8 + 6 * 4 + 3 * 2 + 1) {
+			LogMessage("TextureCompression: %s texture compressed wrong", GetFormatName(expected[test]));
+			failures++;
+		}
+		else if (single != threaded || stats.psnr != threadedStats.psnr || threadedStats.threadCount != 4) {
+			LogMessage("TextureCompression: %s texture differs on 4 threads", GetFormatName(expected[test]));
+			failures++;
+		}
+		else if (stats.psnr < 35.0) {
+			LogMessage("TextureCompression: %s texture PSNR %.2f dB is too low", GetFormatName(expected[test]), stats.psnr);
+			failures++;
+		}
+	}
+
+	// === Turned down: a top mip that isn't whole blocks, a texture that is already compressed
+	DDSTexture texture;
+	CompressionOptions options = { DDS_FORMAT_UNKNOWN, COMPRESSION_FAST, 1 };
+	MakeCheckTexture(10, 8, false, &source);
+	bool rejected = ParseDDS(&source[0], source.size(), &texture) == DDS_OK && CompressDDS(texture, options, &single, nullptr) == DDS_NOT_SUPPORTED;
+	rejected = rejected && ParseDDS(&threaded[0], threaded.size(), &texture) == DDS_OK && CompressDDS(texture, options, &single, nullptr) == DDS_NOT_SUPPORTED;
+	if (!rejected) {
+		LogMessage("TextureCompression: a texture it can't compress was accepted");
+		failures++;
+	}
+
+	LogMessage("TextureCompression: checks %s", failures == 0 ? "passed" : "FAILED");
+	return failures == 0;
+}
+
+bool BenchmarkTextureCompression(const char* const* _paths, unsigned int _pathCount)
+{
+	bool same = true;
+	unsigned int hardwareThreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	const unsigned int formats[2] = { DDS_FORMAT_UNKNOWN, DDS_FORMAT_BC7_UNORM };
+	vector<unsigned char> single, threaded;
+	for (unsigned int p = 0; p < _pathCount; p++) {
+		MappedFile file;
+		DDSTexture texture;
+		if (!file.Open(_paths[p]) || ParseDDS(file.GetData(), file.GetSize(), &texture) != DDS_OK || !CanCompressDDS(texture))
+			continue;
+		for (unsigned int f = 0; f < 2; f++) {
+			for (unsigned int quality = COMPRESSION_FAST; quality <= COMPRESSION_HIGH; quality++) {
+				CompressionOptions options = { formats[f], (CompressionQuality)quality, 1 };
+				CompressionStats stats;
+				CompressDDS(texture, options, &single, &stats);
+				LogCompressionStats(_paths[p], stats);
+				if (hardwareThreads == 1)
+					continue;
+				options.threadCount = hardwareThreads;
+				CompressDDS(texture, options, &threaded, &stats);
+				LogCompressionStats(_paths[p], stats);
+				if (single != threaded) {
+					LogMessage("TextureCompression: %s DIFFERS between 1 and %u threads", _paths[p], hardwareThreads);
+					same = false;
+				}
+			}
+		}
+	}
+	return same;
+}
+// ================== //
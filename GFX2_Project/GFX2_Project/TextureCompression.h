@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "DDSHeader.h"
+
+using std::vector;
+
+// - CompressionQuality
+// --- How hard the encoder searches for endpoints; the slower presets try more of them
+enum CompressionQuality
+{
+	// === Bounding box endpoints, every pixel projected onto the line between them
+	COMPRESSION_FAST,
+	// === Bounding box and principal axis starts, nearest palette entries, one least squares refit of the endpoints
+	COMPRESSION_NORMAL,
+	// === Up to three refits, every BC7 p-bit pair, then each endpoint channel nudged a step while that helps
+	COMPRESSION_HIGH,
+};
+
+// - CompressionOptions
+struct CompressionOptions
+{
+	// === DDS_FORMAT_BC1_UNORM, BC3 or BC7; DDS_FORMAT_UNKNOWN picks BC1 when every pixel is opaque, BC3 otherwise
+	unsigned int		format;
+	CompressionQuality	quality;
+	// === 0 uses every core
+	unsigned int		threadCount;
+};
+
+// - CompressionStats
+struct CompressionStats
+{
+	unsigned int		format;
+	CompressionQuality	quality;
+	unsigned int		threadCount;
+	unsigned int		blockCount;
+	size_t				pixelCount;
+	size_t				sourceBytes;
+	size_t				compressedBytes;
+	double				milliseconds;
+	// === Over RGBA of every pixel of every mip, decoded from the blocks as written; 100 when they are exact
+	double				psnr;
+};
+
+// ===== Blocks ===== //
+// --- _pixels are the 16 RGBA pixels of a 4x4 block, row by row
+// - CompressBC1Block
+// --- 8 bytes, always the four color mode: alpha is dropped
+void CompressBC1Block(const unsigned char* _pixels, CompressionQuality _quality, unsigned char* _block);
+// - CompressBC3Block
+// --- 16 bytes, interpolated alpha; the six level alpha mode keeps exact 0 and 255, as alpha tested textures need
+void CompressBC3Block(const unsigned char* _pixels, CompressionQuality _quality, unsigned char* _block);
+// - CompressBC7Block
+// --- 16 bytes, always mode 6: one RGBA line with 16 levels and 7 bit endpoints plus a p-bit each
+void CompressBC7Block(const unsigned char* _pixels, CompressionQuality _quality, unsigned char* _block);
+// - DecodeBlock
+// --- _block of _format back into 16 RGBA pixels the way D3D11 samples it; BC7 only in mode 6, false for anything else
+bool DecodeBlock(unsigned int _format, const unsigned char* _block, unsigned char* _pixels);
+// ================== //
+
+// ===== Textures ===== //
+// - CanCompressDDS
+// --- 8 bit RGBA, BGRA or BGRX 2D textures, arrays and cube maps whose largest mip is a whole number of blocks
+bool CanCompressDDS(const DDSTexture& _texture);
+// - CompressDDS
+// --- A whole DDS file in _file holding every mip and slice of _texture block compressed; rows of blocks are handed out
+// --- to the threads as they finish the last one. DDS_NOT_SUPPORTED for textures CanCompressDDS turns down
+DDSResult CompressDDS(const DDSTexture& _texture, const CompressionOptions& _options, vector<unsigned char>* _file, CompressionStats* _stats);
+// - CompressDDSFile
+// --- Offline conversion of the DDS file at _source into _destination, which may be the same path; logs the stats
+bool CompressDDSFile(const char* _source, const char* _destination, const CompressionOptions& _options);
+// - ParseCompressionArgument
+// --- Sets the format or quality _options a command line word names: bc1, bc3, bc7, auto, fast, normal or high
+bool ParseCompressionArgument(const char* _argument, CompressionOptions* _options);
+// - LogCompressionStats
+void LogCompressionStats(const char* _name, const CompressionStats& _stats);
+// ==================== //
+
+// ===== Checks ===== //
+// - CheckTextureCompression
+// --- SIMD kernels against their scalar versions, every format and preset on solid, gradient, alpha tested and noisy
+// --- blocks, and a small mipmapped texture through CompressDDS on one and many threads; logs every check that fails,
+// --- returns false if any did
+bool CheckTextureCompression();
+
+// - BenchmarkTextureCompression
+// --- Compresses each of _paths to its automatic format and to BC7 at every preset, on one thread and on every core,
+// --- and logs the time, throughput, size and PSNR of each; returns false if the threads wrote a different file than one
+bool BenchmarkTextureCompression(const char* const* _paths, unsigned int _pathCount);
+// ================== //
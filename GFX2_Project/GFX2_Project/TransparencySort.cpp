@@ -0,0 +1,256 @@
+#include "TransparencySort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "Profiling.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define TRANSPARENCY_SSE
+#include <emmintrin.h>
+#endif
+
+// ===== Local Helpers ===== //
+// === Frames to skip the insertion sort after it gave up
+static const unsigned int INSERTION_BACKOFF = 8;
+
+// - DistanceKey
+// --- Non-negative floats order like their bits, inverting them puts the furthest first
+static inline unsigned int DistanceKey(float _distanceSquared)
+{
+	unsigned int bits;
+	memcpy(&bits, &_distanceSquared, sizeof(bits));
+	return ~bits;
+}
+// ========================= //
+
+// ===== Constructor ===== //
+TransparencySorter::TransparencySorter()
+{
+	m_iInsertionSorts = 0;
+	m_iRadixSorts = 0;
+	m_iSkipInsertion = 0;
+}
+// ======================= //
+
+// ===== Interface ===== //
+void TransparencySorter::Sort(const Vec3& _camera, const Vec3* _positions, const unsigned int* _items, size_t _count, vector<unsigned int>* _sorted)
+{
+	_sorted->resize(_count);
+	if (_count == 0) {
+		Reset();
+		return;
+	}
+	if (m_Keys.size() < _count) {
+		m_Keys.resize(_count);
+		m_Order.resize(_count);
+		m_SortedKeys.resize(_count);
+		m_ScratchKeys.resize(_count);
+		m_ScratchOrder.resize(_count);
+	}
+	ComputeKeys(_camera, _positions, _count);
+
+	// === Same objects as last frame? Then start from last frame's order
+	bool sameItems = m_PreviousItems.size() == _count && memcmp(&m_PreviousItems[0], _items, _count * sizeof(unsigned int)) == 0;
+	bool sorted = false;
+	if (sameItems && m_iSkipInsertion == 0) {
+		for (size_t i = 0; i < _count; i++) {
+			m_Order[i] = m_PreviousOrder[i];
+			m_SortedKeys[i] = m_Keys[m_Order[i]];
+		}
+		sorted = InsertionSort(_count);
+		// === Too far out of order, the camera is probably still moving fast: go straight to the radix sort for a while
+		if (!sorted)
+			m_iSkipInsertion = INSERTION_BACKOFF;
+	}
+	else if (m_iSkipInsertion > 0) {
+		m_iSkipInsertion--;
+	}
+	if (sorted) {
+		m_iInsertionSorts++;
+	}
+	else {
+		RadixSort(_count);
+		m_iRadixSorts++;
+	}
+
+	// === Remember this frame, then hand out the items
+	m_PreviousItems.assign(_items, _items + _count);
+	m_PreviousOrder.assign(m_Order.begin(), m_Order.begin() + _count);
+	for (size_t i = 0; i < _count; i++)
+		(*_sorted)[i] = _items[m_Order[i]];
+}
+
+void TransparencySorter::Reset()
+{
+	m_PreviousItems.clear();
+	m_PreviousOrder.clear();
+	m_iSkipInsertion = 0;
+}
+// ===================== //
+
+// ===== Private Interface ===== //
+// - ComputeKeys
+// --- One pass over the positions, squared distances to the camera as sortable keys
+void TransparencySorter::ComputeKeys(const Vec3& _camera, const Vec3* _positions, size_t _count)
+{
+	size_t i = 0;
+#if defined(TRANSPARENCY_SSE)
+	const __m128 cameraX = _mm_set1_ps(_camera.x);
+	const __m128 cameraY = _mm_set1_ps(_camera.y);
+	const __m128 cameraZ = _mm_set1_ps(_camera.z);
+	const __m128i invert = _mm_set1_epi32(-1);
+	for (; i + 4 <= _count; i += 4) {
+		const Vec3* p = &_positions[i];
+		__m128 dx = _mm_sub_ps(_mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x), cameraX);
+		__m128 dy = _mm_sub_ps(_mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y), cameraY);
+		__m128 dz = _mm_sub_ps(_mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z), cameraZ);
+		__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		_mm_storeu_si128((__m128i*)&m_Keys[i], _mm_xor_si128(_mm_castps_si128(distanceSquared), invert));
+	}
+#endif
+	for (; i < _count; i++) {
+		float dx = _positions[i].x - _camera.x, dy = _positions[i].y - _camera.y, dz = _positions[i].z - _camera.z;
+		m_Keys[i] = DistanceKey(dx * dx + dy * dy + dz * dz);
+	}
+}
+
+// - InsertionSort
+// --- Sorts m_SortedKeys / m_Order in place, gives up once it has moved about twice as many elements as there are,
+// --- at which point the radix sort is cheaper; returns false if it gave up
+bool TransparencySorter::InsertionSort(size_t _count)
+{
+	size_t budget = _count * 2 + 16;
+	for (size_t i = 1; i < _count; i++) {
+		unsigned int key = m_SortedKeys[i];
+		if (m_SortedKeys[i - 1] <= key)
+			continue;
+		unsigned int order = m_Order[i];
+		size_t j = i;
+		while (j > 0 && m_SortedKeys[j - 1] > key) {
+			m_SortedKeys[j] = m_SortedKeys[j - 1];
+			m_Order[j] = m_Order[j - 1];
+			j--;
+			if (--budget == 0)
+				return false;
+		}
+		m_SortedKeys[j] = key;
+		m_Order[j] = order;
+	}
+	return true;
+}
+
+// - RadixSort
+// --- LSD radix sort of m_Keys, 4 stable passes of 8 bits; passes where every key has the same byte are skipped
+void TransparencySorter::RadixSort(size_t _count)
+{
+	// === All four histograms in one pass
+	unsigned int histograms[4][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < _count; i++) {
+		unsigned int key = m_Keys[i];
+		histograms[0][key & 0xFF]++;
+		histograms[1][(key >> 8) & 0xFF]++;
+		histograms[2][(key >> 16) & 0xFF]++;
+		histograms[3][key >> 24]++;
+	}
+
+	unsigned int* keys = &m_SortedKeys[0];
+	unsigned int* order = &m_Order[0];
+	unsigned int* scratchKeys = &m_ScratchKeys[0];
+	unsigned int* scratchOrder = &m_ScratchOrder[0];
+	for (size_t i = 0; i < _count; i++) {
+		keys[i] = m_Keys[i];
+		order[i] = (unsigned int)i;
+	}
+	for (unsigned int pass = 0; pass < 4; pass++) {
+		unsigned int shift = pass * 8;
+		if (histograms[pass][(keys[0] >> shift) & 0xFF] == _count)
+			continue;
+		unsigned int offsets[256];
+		unsigned int offset = 0;
+		for (unsigned int bucket = 0; bucket < 256; bucket++) {
+			offsets[bucket] = offset;
+			offset += histograms[pass][bucket];
+		}
+		for (size_t i = 0; i < _count; i++) {
+			unsigned int destination = offsets[(keys[i] >> shift) & 0xFF]++;
+			scratchKeys[destination] = keys[i];
+			scratchOrder[destination] = order[i];
+		}
+		std::swap(keys, scratchKeys);
+		std::swap(order, scratchOrder);
+	}
+
+	// === An odd number of passes leaves the result in the scratch arrays
+	if (order != &m_Order[0]) {
+		memcpy(&m_Order[0], order, _count * sizeof(unsigned int));
+		memcpy(&m_SortedKeys[0], keys, _count * sizeof(unsigned int));
+	}
+}
+// ============================= //
+
+// ===== Benchmark ===== //
+bool BenchmarkTransparencySort(unsigned int _frames)
+{
+	const size_t counts[3] = { 1000, 10000, 100000 };
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	bool correct = true;
+	unsigned int frames = _frames > 0 ? _frames : 1;
+
+	for (unsigned int c = 0; c < 3; c++) {
+		size_t count = counts[c];
+		vector<Vec3> positions(count);
+		vector<unsigned int> items(count);
+		for (size_t i = 0; i < count; i++) {
+			positions[i] = MakeVec3(position(random), position(random) * 0.1f, position(random));
+			items[i] = (unsigned int)i;
+		}
+
+		for (unsigned int moving = 0; moving < 2; moving++) {
+			// === The moving camera circles the scene, about a third of a degree a frame
+			TransparencySorter sorter;
+			vector<unsigned int> sorted;
+			double sortTime = 0;
+			Stopwatch stopwatch;
+			for (unsigned int frame = 0; frame < frames; frame++) {
+				float angle = moving ? (float)frame * 0.005f : 0.0f;
+				Vec3 camera = MakeVec3(150.0f * std::cos(angle), 20.0f, 150.0f * std::sin(angle));
+				stopwatch.Restart();
+				sorter.Sort(camera, &positions[0], &items[0], count, &sorted);
+				sortTime += stopwatch.ElapsedMilliseconds();
+
+				for (size_t i = 1; i < count && correct; i++) {
+					Vec3 a = Subtract(positions[sorted[i - 1]], camera), b = Subtract(positions[sorted[i]], camera);
+					correct = Dot(a, a) >= Dot(b, b);
+				}
+			}
+
+			// === The old way: distances with a square root, then std::sort
+			struct Distance { float distance; unsigned int item; };
+			vector<Distance> distances(count);
+			stopwatch.Restart();
+			for (unsigned int frame = 0; frame < frames; frame++) {
+				float angle = moving ? (float)frame * 0.005f : 0.0f;
+				Vec3 camera = MakeVec3(150.0f * std::cos(angle), 20.0f, 150.0f * std::sin(angle));
+				for (size_t i = 0; i < count; i++) {
+					distances[i].distance = Length(Subtract(positions[i], camera));
+					distances[i].item = items[i];
+				}
+				std::sort(distances.begin(), distances.end(), [](const Distance& _a, const Distance& _b) { return _a.distance > _b.distance; });
+			}
+			double stdSortTime = stopwatch.ElapsedMilliseconds();
+
+			double perObject = 1000000.0 / ((double)frames * (double)count);
+			LogMessage("TransparencySort: %6u objects, %s camera, %.2f ns per object (%u insertion, %u radix), std::sort %.2f ns per object",
+				(unsigned int)count, moving ? "moving" : "static", sortTime * perObject, sorter.GetInsertionSortCount(), sorter.GetRadixSortCount(),
+				stdSortTime * perObject);
+		}
+	}
+	if (!correct)
+		LogMessage("TransparencySort: WRONG ORDER");
+	return correct;
+}
+// ===================== //
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Math.h"
+
+using std::vector;
+
+// - TransparencySorter
+// --- Orders transparent objects back to front by their squared distance from the camera (no square roots),
+// --- with the keys computed 4 at a time
+// --- Keeps last frame's order: when the same objects come back and are still nearly in order an insertion
+// --- sort finishes them in about one pass, anything else goes through an LSD radix sort on the float bits
+class TransparencySorter
+{
+private:
+	// === Last frame, to spot when the same objects come back
+	vector<unsigned int>	m_PreviousItems;
+	vector<unsigned int>	m_PreviousOrder;
+	// === Scratch, kept between frames so sorting doesn't allocate
+	vector<unsigned int>	m_Keys;
+	vector<unsigned int>	m_Order;
+	vector<unsigned int>	m_SortedKeys;
+	vector<unsigned int>	m_ScratchKeys;
+	vector<unsigned int>	m_ScratchOrder;
+	unsigned int			m_iInsertionSorts;
+	unsigned int			m_iRadixSorts;
+	unsigned int			m_iSkipInsertion;
+
+	void ComputeKeys(const Vec3& _camera, const Vec3* _positions, size_t _count);
+	bool InsertionSort(size_t _count);
+	void RadixSort(size_t _count);
+
+public:
+	// ===== Constructor
+	TransparencySorter();
+
+	// ===== Interface
+	// - Sort
+	// --- _positions[i] is where _items[i] is, _sorted gets the items furthest to closest
+	// --- Equal distances keep the order they had last frame, or the input order
+	void Sort(const Vec3& _camera, const Vec3* _positions, const unsigned int* _items, size_t _count, vector<unsigned int>* _sorted);
+	// - Reset
+	// --- Forgets last frame's order
+	void Reset();
+
+	// ===== Accessors
+	unsigned int GetInsertionSortCount() const { return m_iInsertionSorts; }
+	unsigned int GetRadixSortCount() const { return m_iRadixSorts; }
+};
+
+// - BenchmarkTransparencySort
+// --- Sorts 1k, 10k and 100k random objects _frames times each, with a static and with a moving camera,
+// --- against std::sort on distances; logs ns per object and returns false if any order was wrong
+bool BenchmarkTransparencySort(unsigned int _frames);
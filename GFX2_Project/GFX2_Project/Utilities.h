@@ -1,8 +0,0 @@
-#pragma once
-
-#include "Object.h"
-
-bool SortByDistance(Object* _a, Object* _b)
-{
-	return _a->DistanceFromCamera > _b->DistanceFromCamera;
-}
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "VertexPacking.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Profiling.h"
+
+using std::vector;
+
+// ===== Local Helpers ===== //
+static const float SNORM16_MAX = 32767.0f;
+
+// === Worst angular error of the octahedral SNORM16 encoding, measured over a dense sphere sweep with margin
+static const float OCTAHEDRAL_ERROR_RADIANS = 0.00005f;
+
+static inline short FloatToSnorm16(float _value)
+{
+	if (_value > 1) _value = 1;
+	if (_value < -1) _value = -1;
+	return (short)std::floor(_value * SNORM16_MAX + 0.5f);
+}
+
+static inline float Snorm16ToFloat(short _value)
+{
+	float value = _value / SNORM16_MAX;
+	return value < -1 ? -1 : value;
+}
+
+static inline float SignNotZero(float _value)
+{
+	return _value >= 0 ? 1.0f : -1.0f;
+}
+
+static float AngleBetween(const float _a[3], const float _b[3])
+{
+	float cross[3] = { _a[1] * _b[2] - _a[2] * _b[1], _a[2] * _b[0] - _a[0] * _b[2], _a[0] * _b[1] - _a[1] * _b[0] };
+	float sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+	float cosine = _a[0] * _b[0] + _a[1] * _b[1] + _a[2] * _b[2];
+	return std::atan2(sine, cosine);
+}
+// ========================= //
+
+// ===== Scalar Encoding ===== //
+unsigned short FloatToHalf(float _value)
+{
+	unsigned int bits;
+	memcpy(&bits, &_value, sizeof(bits));
+	unsigned short sign = (unsigned short)((bits >> 16) & 0x8000);
+	bits &= 0x7FFFFFFF;
+
+	// === NaN stays NaN, infinity and everything from 65520 up becomes infinity
+	if (bits > 0x7F800000)
+		return sign | 0x7E00;
+	if (bits >= 0x477FF000)
+		return sign | 0x7C00;
+
+	// === Below 2^-14 the half is subnormal, a multiple of 2^-24
+	if (bits < 0x38800000) {
+		float magnitude;
+		memcpy(&magnitude, &bits, sizeof(magnitude));
+		float scaled = magnitude * 16777216.0f;
+		float rounded = std::floor(scaled);
+		float remainder = scaled - rounded;
+		if (remainder > 0.5f || (remainder == 0.5f && std::fmod(rounded, 2.0f) != 0))
+			rounded += 1;
+		return sign | (unsigned short)rounded;
+	}
+
+	// === Normal range, rebias the exponent and round the mantissa to nearest even (a carry correctly bumps the exponent)
+	unsigned int half = ((((bits >> 23) - 127 + 15) << 10) | ((bits & 0x7FFFFF) >> 13));
+	unsigned int remainder = bits & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		++half;
+	return sign | (unsigned short)half;
+}
+
+float HalfToFloat(unsigned short _half)
+{
+	unsigned int sign = (unsigned int)(_half & 0x8000) << 16;
+	unsigned int exponent = (_half >> 10) & 0x1F;
+	unsigned int mantissa = _half & 0x3FF;
+	unsigned int bits;
+	if (exponent == 0) {
+		// == Zero and subnormals
+		float value = mantissa / 16777216.0f;
+		memcpy(&bits, &value, sizeof(bits));
+		bits |= sign;
+	}
+	else if (exponent == 31) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+void EncodeOctahedral(const float _normal[3], short _encoded[2])
+{
+	float length = std::fabs(_normal[0]) + std::fabs(_normal[1]) + std::fabs(_normal[2]);
+	if (length <= 0) {
+		_encoded[0] = _encoded[1] = 0;
+		return;
+	}
+
+	// === Project onto the octahedron, fold the lower half over the upper one
+	float x = _normal[0] / length, y = _normal[1] / length;
+	if (_normal[2] < 0) {
+		float foldedX = (1 - std::fabs(y)) * SignNotZero(x);
+		float foldedY = (1 - std::fabs(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	// === Rounding each axis on its own is not always closest, try the floor / ceil combinations
+	float reference[3] = { _normal[0], _normal[1], _normal[2] };
+	float floorX = std::floor(x * SNORM16_MAX), floorY = std::floor(y * SNORM16_MAX);
+	float bestAngle = FLT_MAX;
+	for (int i = 0; i < 4; i++) {
+		float candidateX = floorX + (i & 1), candidateY = floorY + (i >> 1);
+		if (candidateX > SNORM16_MAX || candidateY > SNORM16_MAX || candidateX < -SNORM16_MAX || candidateY < -SNORM16_MAX)
+			continue;
+		short candidate[2] = { (short)candidateX, (short)candidateY };
+		float decoded[3];
+		DecodeOctahedral(candidate, decoded);
+		float angle = AngleBetween(reference, decoded);
+		if (angle < bestAngle) {
+			bestAngle = angle;
+			_encoded[0] = candidate[0];
+			_encoded[1] = candidate[1];
+		}
+	}
+}
+
+void DecodeOctahedral(const short _encoded[2], float _normal[3])
+{
+	float x = Snorm16ToFloat(_encoded[0]), y = Snorm16ToFloat(_encoded[1]);
+	float z = 1 - std::fabs(x) - std::fabs(y);
+	if (z < 0) {
+		float unfoldedX = (1 - std::fabs(y)) * SignNotZero(x);
+		float unfoldedY = (1 - std::fabs(x)) * SignNotZero(y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+	float length = std::sqrt(x * x + y * y + z * z);
+	_normal[0] = x / length;
+	_normal[1] = y / length;
+	_normal[2] = z / length;
+}
+// =========================== //
+
+// ===== Vertex Packing ===== //
+VertexQuantization ComputeVertexQuantization(const float _boundsMin[3], const float _boundsMax[3])
+{
+	VertexQuantization quantization;
+	for (int axis = 0; axis < 3; axis++) {
+		float halfExtent = (_boundsMax[axis] - _boundsMin[axis]) * 0.5f;
+		quantization.scale[axis] = halfExtent > 0 ? halfExtent : 1.0f;
+		quantization.offset[axis] = (_boundsMax[axis] + _boundsMin[axis]) * 0.5f;
+	}
+	return quantization;
+}
+
+void PackVertex(const Vertex& _vertex, const VertexQuantization& _quantization, Vertex_Packed* _packed)
+{
+	const float position[3] = { _vertex.x, _vertex.y, _vertex.z };
+	for (int axis = 0; axis < 3; axis++)
+		_packed->position[axis] = FloatToSnorm16((position[axis] - _quantization.offset[axis]) / _quantization.scale[axis]);
+	_packed->position[3] = (short)SNORM16_MAX;
+	EncodeOctahedral(_vertex.normals, _packed->normal);
+	_packed->uv[0] = FloatToHalf(_vertex.u);
+	_packed->uv[1] = FloatToHalf(_vertex.v);
+}
+
+Vertex UnpackVertex(const Vertex_Packed& _packed, const VertexQuantization& _quantization)
+{
+	float position[3], normal[3];
+	for (int axis = 0; axis < 3; axis++)
+		position[axis] = Snorm16ToFloat(_packed.position[axis]) * _quantization.scale[axis] + _quantization.offset[axis];
+	DecodeOctahedral(_packed.normal, normal);
+	return Vertex(position[0], position[1], position[2], 1, HalfToFloat(_packed.uv[0]), HalfToFloat(_packed.uv[1]), 0, normal);
+}
+
+void PackVertices(const Vertex* _vertices, size_t _count, const VertexQuantization& _quantization, Vertex_Packed* _packed)
+{
+	for (size_t i = 0; i < _count; i++)
+		PackVertex(_vertices[i], _quantization, &_packed[i]);
+}
+
+VertexPackingError GetPackingErrorBounds(const VertexQuantization& _quantization)
+{
+	VertexPackingError bounds;
+	for (int axis = 0; axis < 3; axis++) {
+		// == Half a quantization step, plus the float rounding of the decode
+		float magnitude = std::fabs(_quantization.offset[axis]) + _quantization.scale[axis];
+		bounds.position[axis] = 0.5f * _quantization.scale[axis] / SNORM16_MAX + 2 * FLT_EPSILON * magnitude;
+	}
+	bounds.normalRadians = OCTAHEDRAL_ERROR_RADIANS;
+	bounds.uv = 1.0f / 4096.0f;
+	return bounds;
+}
+
+VertexPackingError MeasurePackingError(const Vertex* _vertices, size_t _count, const VertexQuantization& _quantization)
+{
+	VertexPackingError error;
+	memset(&error, 0, sizeof(error));
+	for (size_t i = 0; i < _count; i++) {
+		Vertex_Packed packed;
+		PackVertex(_vertices[i], _quantization, &packed);
+		Vertex unpacked = UnpackVertex(packed, _quantization);
+
+		const float original[3] = { _vertices[i].x, _vertices[i].y, _vertices[i].z };
+		const float decoded[3] = { unpacked.x, unpacked.y, unpacked.z };
+		for (int axis = 0; axis < 3; axis++) {
+			float difference = std::fabs(original[axis] - decoded[axis]);
+			if (difference > error.position[axis])
+				error.position[axis] = difference;
+		}
+
+		// == Normals are compared by direction, the encoding does not keep their length
+		float length = std::sqrt(_vertices[i].normals[0] * _vertices[i].normals[0] + _vertices[i].normals[1] * _vertices[i].normals[1] + _vertices[i].normals[2] * _vertices[i].normals[2]);
+		if (length > 0) {
+			float angle = AngleBetween(_vertices[i].normals, unpacked.normals);
+			if (angle > error.normalRadians)
+				error.normalRadians = angle;
+		}
+
+		float uvError = std::fabs(_vertices[i].u - unpacked.u) > std::fabs(_vertices[i].v - unpacked.v) ? std::fabs(_vertices[i].u - unpacked.u) : std::fabs(_vertices[i].v - unpacked.v);
+		if (uvError > error.uv)
+			error.uv = uvError;
+	}
+	return error;
+}
+// ========================== //
+
+// ===== Checks ===== //
+bool CheckVertexPacking()
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	bool passed = true;
+
+	// === Every finite half, including the subnormals and both zeros, has to come back with the same bits
+	unsigned int halfMismatches = 0;
+	for (unsigned int half = 0; half < 0x10000; half++) {
+		if ((half & 0x7C00) == 0x7C00 && (half & 0x3FF) != 0)
+			continue;
+		if (FloatToHalf(HalfToFloat((unsigned short)half)) != half)
+			++halfMismatches;
+	}
+	if (halfMismatches > 0) {
+		LogMessage("VertexPacking: %u half floats changed on a round trip", halfMismatches);
+		passed = false;
+	}
+
+	// === Small, large, far away and flat meshes
+	const float boundsList[][6] = {
+		{ -1, -1, -1, 1, 1, 1 },
+		{ -0.01f, 0, -0.02f, 0.01f, 0.05f, 0.02f },
+		{ -500, -20, -800, 700, 300, 900 },
+		{ 10000, 5000, -20000, 10050, 5010, -19900 },
+		{ -5, 2, -5, 5, 2, 5 },
+	};
+	const unsigned int VERTEX_COUNT = 20000;
+	vector<Vertex> vertices(VERTEX_COUNT);
+	for (size_t b = 0; b < sizeof(boundsList) / sizeof(boundsList[0]); b++) {
+		const float* boundsMin = boundsList[b];
+		const float* boundsMax = boundsList[b] + 3;
+		for (unsigned int i = 0; i < VERTEX_COUNT; i++) {
+			float position[3], normal[3];
+			for (int axis = 0; axis < 3; axis++) {
+				float t = unit(random) * 0.5f + 0.5f;
+				// == The first few sit exactly on the corners of the bounds
+				if (i < 8)
+					t = (float)((i >> axis) & 1);
+				position[axis] = boundsMin[axis] + (boundsMax[axis] - boundsMin[axis]) * t;
+				normal[axis] = unit(random);
+			}
+			// == Along the axes, and close to z = 0 where the octahedron folds
+			if (i % 16 == 1) {
+				normal[0] = normal[1] = normal[2] = 0;
+				normal[(i / 16) % 3] = (i / 48) % 2 ? 1.0f : -1.0f;
+			}
+			else if (i % 16 == 2) {
+				normal[2] = unit(random) * 1e-4f;
+			}
+			float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			if (length < 1e-6f) {
+				normal[0] = 0; normal[1] = 1; normal[2] = 0;
+				length = 1;
+			}
+			vertices[i] = Vertex(position[0], position[1], position[2], 1, unit(random), unit(random), 0, normal[0] / length, normal[1] / length, normal[2] / length);
+		}
+
+		VertexQuantization quantization = ComputeVertexQuantization(boundsMin, boundsMax);
+		VertexPackingError bounds = GetPackingErrorBounds(quantization);
+		VertexPackingError error = MeasurePackingError(vertices.data(), vertices.size(), quantization);
+		bool within = error.normalRadians <= bounds.normalRadians && error.uv <= bounds.uv;
+		for (int axis = 0; axis < 3; axis++)
+			within = within && error.position[axis] <= bounds.position[axis];
+		if (!within) {
+			LogMessage("VertexPacking: bounds %u, position error %g %g %g of %g %g %g, normal %g of %g rad, uv %g of %g, FAILED", (unsigned int)b,
+				error.position[0], error.position[1], error.position[2], bounds.position[0], bounds.position[1], bounds.position[2],
+				error.normalRadians, bounds.normalRadians, error.uv, bounds.uv);
+			passed = false;
+		}
+		else if (b == 0 || b + 1 == sizeof(boundsList) / sizeof(boundsList[0])) {
+			LogMessage("VertexPacking: bounds %u, position error %g of %g, normal %g of %g rad, uv %g of %g", (unsigned int)b,
+				error.position[0], bounds.position[0], error.normalRadians, bounds.normalRadians, error.uv, bounds.uv);
+		}
+	}
+
+	LogMessage("VertexPacking: %s", passed ? "checks passed" : "checks FAILED");
+	return passed;
+}
+// ================== //
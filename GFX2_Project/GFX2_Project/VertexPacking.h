@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Vertex_Types.h"
+
+// - VertexQuantization
+// --- Maps SNORM16 positions back into the mesh: position = snorm * scale + offset
+// --- The shader gets scale and offset through the object constant buffer
+struct VertexQuantization
+{
+	float scale[3];
+	float offset[3];
+};
+
+// - VertexPackingError
+// --- Largest error of a packed attribute: per axis for positions, radians for normals,
+// --- absolute for UVs (a half float keeps 11 significant bits)
+struct VertexPackingError
+{
+	float position[3];
+	float normalRadians;
+	float uv;
+};
+
+// ===== Scalar Encoding ===== //
+// - FloatToHalf / HalfToFloat
+// --- IEEE binary16, rounded to nearest even, out of range values become infinity
+unsigned short FloatToHalf(float _value);
+float HalfToFloat(unsigned short _half);
+
+// - EncodeOctahedral / DecodeOctahedral
+// --- Unit normal <-> two SNORM16 values, the encoder picks the closest of the neighbouring codes
+void EncodeOctahedral(const float _normal[3], short _encoded[2]);
+void DecodeOctahedral(const short _encoded[2], float _normal[3]);
+// =========================== //
+
+// ===== Vertex Packing ===== //
+// - ComputeVertexQuantization
+// --- Spreads the 16-bit range over the mesh bounds, a flat axis keeps a scale of 1
+VertexQuantization ComputeVertexQuantization(const float _boundsMin[3], const float _boundsMax[3]);
+
+// - PackVertex / UnpackVertex
+// --- w always comes back as 1 and n as 0, neither is stored
+void PackVertex(const Vertex& _vertex, const VertexQuantization& _quantization, Vertex_Packed* _packed);
+Vertex UnpackVertex(const Vertex_Packed& _packed, const VertexQuantization& _quantization);
+
+// - PackVertices
+void PackVertices(const Vertex* _vertices, size_t _count, const VertexQuantization& _quantization, Vertex_Packed* _packed);
+
+// - GetPackingErrorBounds
+// --- Guaranteed worst case error of packing any vertex inside the bounds, for UVs in [-1, 1]
+VertexPackingError GetPackingErrorBounds(const VertexQuantization& _quantization);
+
+// - MeasurePackingError
+// --- Largest error actually produced by packing _vertices, UVs measured as absolute error
+VertexPackingError MeasurePackingError(const Vertex* _vertices, size_t _count, const VertexQuantization& _quantization);
+// ========================== //
+
+// ===== Checks ===== //
+// - CheckVertexPacking
+// --- Packs and unpacks random vertices inside bounds near and far from the origin, with a flat axis, on the bounds
+// --- themselves, along the axes and across the octahedral fold, and checks every position, normal and UV error
+// --- against GetPackingErrorBounds; also that every half float survives FloatToHalf(HalfToFloat). Logs the worst
+// --- errors next to their bounds, returns false if any was over
+bool CheckVertexPacking();
+// ================== //
@@ -0,0 +1,70 @@
+#pragma once
+
+// ===== Vertex Structures ===== //
+struct Vertex_PositionColor
+{
+	float x, y, z, w;
+	float color[4];
+	Vertex_PositionColor() {
+		x = y = z = 0; w = 1;
+		color[0] = 1; color[1] = 1; color[2] = 1; color[3] = 1;
+	}
+	Vertex_PositionColor(float _x, float _y, float _z, float _w) {
+		x = _x; y = _y; z = _z; w = _w;
+		color[0] = 1; color[1] = 0; color[2] = 0; color[3] = 1;
+	}
+	Vertex_PositionColor(float _x, float _y, float _z, float _w, float* _color) {
+		x = _x; y = _y; z = _z; w = _w;
+		color[0] = _color[0]; color[1] = _color[1]; color[2] = _color[2]; color[3] = _color[3];
+	}
+	Vertex_PositionColor(float _x, float _y, float _z, float _w, float _cR, float _cG, float _cB, float _cA) {
+		x = _x; y = _y; z = _z; w = _w;
+		color[0] = _cR; color[1] = _cG; color[2] = _cB; color[3] = _cA;
+	}
+};
+
+struct Vertex
+{
+	float x, y, z, w;
+	float u, v, n;
+	float normals[3];
+
+	Vertex() {
+		x = y = z = 0; w = 1;
+		u = z = 0;
+	}
+	Vertex(float _x, float _y, float _z, float _w = 1, float _u = 0, float _v = 0, float _n = 0) {
+		x = _x; y = _y; z = _z; w = _w;
+		u = _u; v = _v; n = _n;
+		normals[0] = 0; normals[1] = 0; normals[2] = 0;
+	}
+	Vertex(float _x, float _y, float _z, float _w, float _u, float _v, float _n, float* _normals) {
+		x = _x; y = _y; z = _z; w = _w;
+		u = _u; v = _v; n = _n;
+		normals[0] = _normals[0]; normals[1] = _normals[1]; normals[2] = _normals[2];
+	}
+	Vertex(float _x, float _y, float _z, float _w, float _u, float _v, float _n, float _nx, float _ny, float _nz) {
+		x = _x; y = _y; z = _z; w = _w;
+		u = _u; v = _v; n = _n;
+		normals[0] = _nx; normals[1] = _ny; normals[2] = _nz;
+	}
+};
+
+// - Vertex_Packed
+// --- 16 byte alternative to Vertex, see VertexPacking.h for the encoding
+// --- position: SNORM16 against the mesh bounds (w unused), normal: octahedral SNORM16, uv: half floats
+struct Vertex_Packed
+{
+	short position[4];
+	short normal[2];
+	unsigned short uv[2];
+};
+
+// - VertexFormat
+// --- Which vertex struct an Object's vertex buffer holds
+enum VertexFormat
+{
+	VERTEX_FORMAT_FULL,
+	VERTEX_FORMAT_PACKED
+};
+// ============================= //
@@ -0,0 +1,10 @@
+// - OITWeight
+// --- Must match OITWeight in WeightedBlendedOIT.cpp, the CPU reference the math is checked against
+float OITWeight(float _alpha, float _depth)
+{
+	float z = abs(_depth);
+	float nearTerm = z / 5.0;
+	float farTerm = z / 200.0;
+	float falloff = 10.0 / (1e-5 + nearTerm * nearTerm + farTerm * farTerm * farTerm * farTerm * farTerm * farTerm);
+	return _alpha * clamp(falloff, 1e-2, 3e3);
+}
@@ -0,0 +1,157 @@
+#include "WeightedBlendedOIT.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Profiling.h"
+
+// ===== Weighted Blended ===== //
+float OITWeight(float _alpha, float _depth)
+{
+	// === Equation 7 of the paper, tuned for depths of 0.1 - 500
+	float z = std::fabs(_depth);
+	float nearTerm = z / 5.0f, farTerm = z / 200.0f;
+	float falloff = 10.0f / (1e-5f + nearTerm * nearTerm + farTerm * farTerm * farTerm * farTerm * farTerm * farTerm);
+	return _alpha * std::min(std::max(falloff, 1e-2f), 3e3f);
+}
+
+void OITClear(OITPixel* _pixel)
+{
+	_pixel->accumulation[0] = 0;
+	_pixel->accumulation[1] = 0;
+	_pixel->accumulation[2] = 0;
+	_pixel->accumulation[3] = 1;
+	_pixel->weight = 0;
+}
+
+void OITAccumulate(OITPixel* _pixel, const float _color[4], float _depth)
+{
+	// === Blend ONE / ONE on rgb, ZERO / INV_SRC_ALPHA on alpha
+	float alpha = _color[3];
+	float weight = OITWeight(alpha, _depth);
+	_pixel->accumulation[0] += _color[0] * alpha * weight;
+	_pixel->accumulation[1] += _color[1] * alpha * weight;
+	_pixel->accumulation[2] += _color[2] * alpha * weight;
+	_pixel->accumulation[3] *= 1.0f - alpha;
+	_pixel->weight += alpha * weight;
+}
+
+void OITComposite(const OITPixel& _pixel, const float _background[3], float _out[3])
+{
+	// === Blend SRC_ALPHA / INV_SRC_ALPHA, the shader outputs (average, 1 - revealage)
+	float coverage = 1.0f - _pixel.accumulation[3];
+	float inverseWeight = 1.0f / std::max(_pixel.weight, 1e-5f);
+	for (int i = 0; i < 3; i++)
+		_out[i] = _pixel.accumulation[i] * inverseWeight * coverage + _background[i] * (1.0f - coverage);
+}
+// ============================ //
+
+// ===== Reference ===== //
+void CompositeSorted(OITFragment* _fragments, size_t _count, const float _background[3], float _out[3])
+{
+	std::sort(_fragments, _fragments + _count, [](const OITFragment& _a, const OITFragment& _b) { return _a.depth > _b.depth; });
+	_out[0] = _background[0];
+	_out[1] = _background[1];
+	_out[2] = _background[2];
+	for (size_t f = 0; f < _count; f++) {
+		float alpha = _fragments[f].color[3];
+		for (int i = 0; i < 3; i++)
+			_out[i] = _fragments[f].color[i] * alpha + _out[i] * (1.0f - alpha);
+	}
+}
+// ===================== //
+
+// ===== Check ===== //
+// - AccumulateUniform
+// --- OITAccumulate with every weight 1, the baseline OITWeight has to beat
+static void AccumulateUniform(OITPixel* _pixel, const float _color[4])
+{
+	float alpha = _color[3];
+	_pixel->accumulation[0] += _color[0] * alpha;
+	_pixel->accumulation[1] += _color[1] * alpha;
+	_pixel->accumulation[2] += _color[2] * alpha;
+	_pixel->accumulation[3] *= 1.0f - alpha;
+	_pixel->weight += alpha;
+}
+
+bool CheckWeightedBlendedOIT(size_t _pixelCount)
+{
+	std::mt19937 random(17);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> alpha(0.1f, 0.9f);
+	std::uniform_real_distribution<float> depth(0.5f, 100.0f);
+	std::uniform_int_distribution<int> layers(1, 8);
+
+	double exactError = 0, mixedError = 0, mixedMaxError = 0, uniformError = 0;
+	size_t mixedChannels = 0, overBound = 0;
+	std::vector<float> mixedErrors;
+	mixedErrors.reserve(_pixelCount);
+	OITFragment fragments[8];
+	for (size_t p = 0; p < _pixelCount; p++) {
+		// === Every third pixel is a single fragment or one color throughout, the rest mix colors
+		int kind = (int)(p % 3);
+		int count = kind == 0 ? 1 : layers(random);
+		float background[3] = { unit(random), unit(random), unit(random) };
+		float shared[3] = { unit(random), unit(random), unit(random) };
+		OITPixel pixel, uniformPixel;
+		OITClear(&pixel);
+		OITClear(&uniformPixel);
+		for (int f = 0; f < count; f++) {
+			for (int i = 0; i < 3; i++)
+				fragments[f].color[i] = kind == 2 ? unit(random) : shared[i];
+			fragments[f].color[3] = alpha(random);
+			fragments[f].depth = depth(random);
+			OITAccumulate(&pixel, fragments[f].color, fragments[f].depth);
+			AccumulateUniform(&uniformPixel, fragments[f].color);
+		}
+
+		// === Both blend the fragment colors with weights summing to the coverage, so a composite that is right at all
+		// === can only be off by how far apart the colors are; any weighting passes this, it says nothing of quality
+		float coverage = 1.0f - pixel.accumulation[3];
+		float low[3] = { 1, 1, 1 }, high[3] = { 0, 0, 0 };
+		for (int f = 0; f < count; f++) {
+			for (int i = 0; i < 3; i++) {
+				low[i] = std::min(low[i], fragments[f].color[i]);
+				high[i] = std::max(high[i], fragments[f].color[i]);
+			}
+		}
+
+		float weighted[3], uniform[3], sorted[3];
+		OITComposite(pixel, background, weighted);
+		OITComposite(uniformPixel, background, uniform);
+		CompositeSorted(fragments, count, background, sorted);
+		for (int i = 0; i < 3; i++) {
+			double error = std::fabs((double)weighted[i] - (double)sorted[i]);
+			if (kind == 2) {
+				mixedErrors.push_back((float)error);
+				uniformError += std::fabs((double)uniform[i] - (double)sorted[i]);
+				mixedError += error;
+				mixedMaxError = std::max(mixedMaxError, error);
+				mixedChannels++;
+				if (error > (double)coverage * (double)(high[i] - low[i]) + 1e-4)
+					overBound++;
+			}
+			else {
+				exactError = std::max(exactError, error);
+			}
+		}
+	}
+
+	// === The quality checks: the depth weighting has to beat plain alpha weighting on the same stacks, on average and
+	// === in the tail
+	double meanError = mixedChannels > 0 ? mixedError / (double)mixedChannels : 0;
+	double uniformMeanError = mixedChannels > 0 ? uniformError / (double)mixedChannels : 0;
+	double p99Error = 0;
+	if (!mixedErrors.empty()) {
+		std::vector<float>::iterator p99 = mixedErrors.begin() + mixedErrors.size() * 99 / 100;
+		std::nth_element(mixedErrors.begin(), p99, mixedErrors.end());
+		p99Error = *p99;
+	}
+	bool passed = exactError < 1e-4 && overBound == 0 && meanError < 0.075 && meanError < uniformMeanError && p99Error < 0.32;
+	LogMessage("WeightedBlendedOIT: %u pixels, single / one color stacks max error %.6f, mixed stacks mean error %.4f (uniform weights %.4f) p99 %.4f max %.4f, %u channels over the bound%s",
+		(unsigned int)_pixelCount, exactError, meanError, uniformMeanError, p99Error, mixedMaxError, (unsigned int)overBound, passed ? "" : ", FAILED");
+	return passed;
+}
+// ================= //
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+
+// - WeightedBlendedOIT
+// --- CPU reference of the weighted blended order-independent transparency in ModelOIT_PS.hlsl / OITComposite_PS.hlsl
+// --- (McGuire and Bavoil 2013), the same math one pixel at a time, so it can be checked without a GPU
+// --- Two targets, both with a single blend state (feature level 10.0 has no independent blending):
+// --- target 0 rgb adds color * alpha * weight, its alpha multiplies by (1 - alpha) and ends as the revealage;
+// --- target 1 red adds alpha * weight
+
+// - OITFragment
+// --- One transparent surface covering a pixel: straight (not premultiplied) color and view space depth
+struct OITFragment
+{
+	float color[4];
+	float depth;
+};
+
+// - OITPixel
+// --- What the two targets hold for one pixel
+struct OITPixel
+{
+	float accumulation[4];
+	float weight;
+};
+
+// ===== Weighted Blended ===== //
+// - OITWeight
+// --- Weight of a fragment, larger for nearer and more opaque ones; depth is in view space units (0.1 - 1000)
+float OITWeight(float _alpha, float _depth);
+
+// - OITClear
+// --- Target 0 clears to (0, 0, 0, 1), target 1 to 0
+void OITClear(OITPixel* _pixel);
+void OITAccumulate(OITPixel* _pixel, const float _color[4], float _depth);
+
+// - OITComposite
+// --- The full screen pass: the weighted average color, over _background by the coverage 1 - revealage
+void OITComposite(const OITPixel& _pixel, const float _background[3], float _out[3]);
+// ============================ //
+
+// ===== Reference ===== //
+// - CompositeSorted
+// --- Brute force: sorts the fragments furthest to closest and blends them one over the other,
+// --- what the sorted path draws; _fragments is reordered
+void CompositeSorted(OITFragment* _fragments, size_t _count, const float _background[3], float _out[3]);
+// ===================== //
+
+// - CheckWeightedBlendedOIT
+// --- Composites _pixelCount random stacks of 1 - 8 fragments both ways and logs the difference
+// --- Single fragments and stacks of one color must match the sorted result exactly (up to rounding)
+// --- Mixed stacks are an approximation with no tighter worst case than the coverage times the spread of the fragment
+// --- colors; every channel is checked against that, but any convex weighting stays within it, so it only catches a
+// --- broken composite. The quality of OITWeight is checked against the same stacks weighted by alpha alone: its mean
+// --- error has to be lower (random stacks land near 0.053 against 0.082) and under 0.075, and its 99th percentile
+// --- under 0.32 (near 0.30 against 0.33); a single pixel can still be off by more than half, near 0.70 at most
+// --- Returns false if any of these does not hold
+bool CheckWeightedBlendedOIT(size_t _pixelCount);
@@ -1,23 +1,49 @@
 #include <algorithm>
+#include <cstring>
 #include <ctime>
 #include <d3d11.h>
 #include <DirectXMath.h>
 #include <iostream>
+#include <shellapi.h>
+#include <string>
 #include <thread>
 
+#include "AssetRegistry.h"
+#include "Bounds.h"
 #include "Camera.h"
+#include "ConstantRing.h"
+#include "D3D11RenderContext.h"
+#include "DDSHeader.h"
 #include "DDSTextureLoader.h"
+#include "Frustum.h"
+#include "InstanceBatcher.h"
 #include "Light.h"
+#include "Math.h"
 #include "MoveComponent.h"
 #include "Object.h"
 #include "ObjLoader.h"
-#include "Utilities.h"
+#include "ObjParser.h"
+#include "ObjStream.h"
+#include "Profiling.h"
+#include "RenderContext.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "StaticBatcher.h"
+#include "TextureCompression.h"
+#include "TransparencySort.h"
+#include "WeightedBlendedOIT.h"
 #include "Vertex_Inputs.h"
+#include "VertexPacking.h"
 #include "XTime.h"
 
 // === Include Compiled Shaders
+#include "FullScreen_VS.h"
 #include "Model_PS.h"
 #include "Model_VS.h"
+#include "ModelInstanced_VS.h"
+#include "ModelOIT_PS.h"
+#include "ModelPacked_VS.h"
+#include "OITComposite_PS.h"
 #include "Skybox_PS.h"
 #include "Skybox_VS.h"
 #include "Transparency_PS.h"
@@ -32,10 +58,37 @@ using namespace std;
 
 #define BACKBUFFER_WIDTH	1024
 #define BACKBUFFER_HEIGHT	780
+// === Per draw constants of a frame, 16384 draws before the ring wraps
+#define CONSTANT_RING_SIZE	(4 * 1024 * 1024)
+// === Instances the Instance Buffer starts with, it grows when a View needs more
+#define INSTANCE_BUFFER_SIZE	4096
+// === Edge of the world grid cells static geometry is baked in
+#define STATIC_CELL_SIZE	16.0f
 
 // === Macros
 #define SAFE_RELEASE(p) { if(p) { p->Release(); p = nullptr; } }
-#define Float4x4ToXMMAtrix(float4x4) { XMMATRIX(float4x4._11, float4x4._12, float4x4._13, float4x4._14, float4x4._21, float4x4._22, float4x4._23, float4x4._24, float4x4._31, float4x4._32, float4x4._33, float4x4._34, float4x4._41, float4x4._42, float4x4._43, float4x4._44) }
+
+// === Views the Scene is drawn into every frame, each gets its own visible list
+enum SceneView { VIEW_RENDER_TEXTURE, VIEW_MAIN, VIEW_MINIMAP, VIEW_COUNT };
+
+// === Tint of everything that is not a Scene entity
+static const Vec4 NO_TINT = { 1, 1, 1, 1 };
+
+// - ToMat4 / ToXMFLOAT4X4
+// --- Both are row-major with the translation in the last row, only the type differs
+static Mat4 ToMat4(const XMFLOAT4X4& _matrix)
+{
+	Mat4 matrix;
+	memcpy(&matrix, &_matrix, sizeof(matrix));
+	return matrix;
+}
+
+static XMFLOAT4X4 ToXMFLOAT4X4(const Mat4& _matrix)
+{
+	XMFLOAT4X4 matrix;
+	memcpy(&matrix, &_matrix, sizeof(matrix));
+	return matrix;
+}
 
 // === Window Class
 class ApplicationWindow
@@ -44,6 +97,9 @@ class ApplicationWindow
 	struct SEND_TO_VRAM_OBJECT
 	{
 		XMFLOAT4X4 worldMatrix;
+		XMFLOAT4 tint;
+		XMFLOAT4 positionScale;
+		XMFLOAT4 positionOffset;
 	};
 	struct SEND_TO_VRAM_SCENE
 	{
@@ -61,20 +117,48 @@ class ApplicationWindow
 	IDXGISwapChain*					pSwapChain;
 	ID3D11Device*					pDevice;
 	ID3D11DeviceContext*			pDeviceContext;
+	// === State changes and draws go through m_RenderContext, which drops the ones that change nothing
+	D3D11RenderContext				m_D3DContext;
+	StateFilteringContext			m_RenderContext;
+	unsigned int					m_iFrameCount;
 	ID3D11RenderTargetView*			pRenderTargetView;
-	D3D11_VIEWPORT					viewPorts[2];
+	RenderViewport					viewPorts[2];
 	ID3D11Texture2D*				pDepthStencil;
 	ID3D11DepthStencilView*			pDepthView;
 	ID3D11BlendState*				pBlendState;
 	ID3D11RasterizerState*			pRS_CullBack;
 	ID3D11RasterizerState*			pRS_CullFront;
+	ID3D11RasterizerState*			pRS_CullNone;
+	// === Weighted Blended OIT, accumulation (rgb) + revealage (a) and the weights
+	ID3D11Texture2D*				pOITTextures[2];
+	ID3D11RenderTargetView*			pOITTargetViews[2];
+	ID3D11ShaderResourceView*		pOITResourceViews[2];
+	ID3D11BlendState*				pOITBlendState;
+	ID3D11DepthStencilState*		pDSS_NoDepthWrite;
+	bool							m_bOITEnabled;
+	bool							OITKeyBuffer;
 	// === Constant Buffers
 	ID3D11Buffer*					pObjectConstantBuffer;
 	ID3D11Buffer*					pSceneConstantBuffer;
 	ID3D11Buffer*					pLightConstantBuffer;
+	// === Object and Scene constants sliced out of one buffer and bound by offset, when the runtime can (D3D11.1)
+	ID3D11Buffer*					pConstantRingBuffer;
+	ConstantRing					m_ConstantRing;
+	vector<ConstantSlice>			m_DrawSlices;
+	bool							m_bConstantOffsets;
+	// === Per instance world matrices and tints of the instanced draws, appended View after View
+	ID3D11Buffer*					pInstanceBuffer;
+	unsigned int					m_iInstanceCapacity;
+	unsigned int					m_iInstanceHead;
+	unsigned int					m_iInstanceBase;
 	// === Shaders
 	ID3D11VertexShader*				pModel_VS;
+	ID3D11VertexShader*				pModelPacked_VS;
+	ID3D11VertexShader*				pModelInstanced_VS;
 	ID3D11PixelShader*				pModel_PS;
+	ID3D11PixelShader*				pModelOIT_PS;
+	ID3D11VertexShader*				pFullScreen_VS;
+	ID3D11PixelShader*				pOITComposite_PS;
 	ID3D11VertexShader*				pSkybox_VS;
 	ID3D11PixelShader*				pSkybox_PS;
 	ID3D11VertexShader*				pVertexColor_VS;
@@ -90,16 +174,39 @@ class ApplicationWindow
 	ID3D11RenderTargetView*			pMMRenderTargetView;
 	ID3D11Texture2D*				pMMDepthStencil;
 	ID3D11DepthStencilView*			pMMDepthView;
-	// === Scene Objects
+	// === Models, their textures and meshes loaded once through the registry
+	AssetRegistry					m_Assets;
 	Object							Star;
 	Object							Ground;
 	Object							Bamboo;
 	Object							Skybox;
 	Object							Barrel;
 	Object							RTObject;
-	Object							PatrolPointLight;
 	Object							CherryTree;
-	vector<Object*>					TransparentObjects;
+	Object							TransparentCube;
+	// === Scene, entities that are not drawn by DrawScene are kept around
+	Scene							m_Scene;
+	EntityID						RTObjectEntity;
+	EntityID						PatrolPointLight;
+	// === Culling, dense Scene indexes
+	vector<unsigned int>			VisibleObjects[VIEW_COUNT];
+	Frustum							ViewFrustums[VIEW_COUNT];
+	vector<unsigned int>			VisibleTransparentObjects;
+	// === Transparent ordering, one sorter per View so each keeps its own last frame
+	TransparencySorter				TransparentSorters[VIEW_COUNT];
+	vector<Vec3>					TransparentPositions;
+	vector<unsigned int>			SortedTransparentObjects;
+	// === Draws of the View being rendered, payloads are dense Scene indexes
+	RenderQueue						m_RenderQueue;
+	// === Runs of the queue with the same mesh and material, drawn instanced when the model can be
+	InstanceBatcher					m_Batcher;
+	bool							m_bInstancing;
+	bool							InstancingKeyBuffer;
+	// === Static geometry baked at load time, one model per batch; the batches must not move once built
+	vector<StaticBatch>				m_StaticBatches;
+	vector<Object*>					m_StaticBatchModels;
+	// === Pieces of each batch in the View being rendered, the Objects keep their own index ranges
+	vector< vector<IndexRange> >	m_StaticBatchRanges;
 	// === Lights
 	Lights							mLights;
 	DirectionalLight				mDirectionalLight;
@@ -144,21 +251,40 @@ private:
 	void InitializeRasterizerStates();
 	void InitializeShaders();
 	void InitializeConstantBuffers();
+	void InitializeInstanceBuffer(unsigned int _capacity);
 	void InitializeSamplerState();
 	void InitializeRenderTexture();
+	void InitializeDepthStencilStates();
+	void InitializeOITTargets(int _width, int _height);
+	void ReleaseOITTargets();
 	// ===== Priavte Interface
 	void CreateLights();
 	XMFLOAT4X4 CreateProjectionMatrix(float _fov, float _width, float _height);
 	void CreateSkybox();
 	void CreateCube(Object* _object, float _radius);
-	void DrawSkybox(Camera _camera);
+	void DrawSkybox(const Camera& _camera);
 	void DrawRTObject();
-	void DrawObject(Object* _object);
-	void DrawTransparentObjects();
-	void DrawScene();
-	thread* LoadObjectModel(const char* _path, Object& _object);
+	void DrawObject(Object* _object, const Mat4& _worldMatrix, const Vec4& _tint = NO_TINT, ID3D11PixelShader* _pixelShader = nullptr);
+	void DrawMesh(Object* _object, const Mat4& _worldMatrix, const Vec4& _tint);
+	void DrawMesh(Object* _object, const ConstantSlice& _constants);
+	void DrawIndexRanges(Object* _object);
+	const vector<IndexRange>& GetIndexRanges(Object* _object) const;
+	void DrawInstances(Object* _object, unsigned int _firstInstance, unsigned int _count);
+	void SetObjectConstants(Object* _object, const Mat4& _worldMatrix, const Vec4& _tint);
+	void AllocateConstants(const void* _data, unsigned int _size, ConstantSlice* _slice);
+	unsigned int AllocateQueueConstants(unsigned int _batch, unsigned int _first);
+	void UploadInstances();
+	void WrapConstantRing();
+	void GetViewTargets(SceneView _view, ID3D11RenderTargetView** _target, ID3D11DepthStencilView** _depth);
+	void QueueTransparentObjects(SceneView _view, const Camera& _camera, const vector<unsigned int>& _visible);
+	void DrawTransparentObjectsOIT(SceneView _view, const vector<unsigned int>& _visible);
+	void SubmitRenderQueue();
+	void DrawScene(SceneView _view, const Camera& _camera);
+	void CullScene(SceneView _view, const Camera& _camera, const XMFLOAT4X4& _projMatrix);
 	void LoadObjects();
-	void UpdateSceneBuffer(Camera _camera, XMFLOAT4X4 _projMatrix);
+	void BuildStaticBatches();
+	void AssignRenderIDs();
+	void UpdateSceneBuffer(const Camera& _camera, const XMFLOAT4X4& _projMatrix);
 	void UpdateLighting();
 	void UpdateObjects();
 };
@@ -207,6 +333,13 @@ ApplicationWindow::ApplicationWindow(HINSTANCE hinst, WNDPROC proc)
 
 	// === DirectX Initialization
 	InitializeDeviceAndSwapChain();
+	m_Assets.SetDevice(pDevice);
+	// === Textures load exactly as stored; -blockcompress trades their quality for memory, BC1 when opaque and BC3 when
+	// === not, redone on every launch. -compress writes the .dds back offline instead
+	if (wcsstr(GetCommandLineW(), L"-blockcompress")) {
+		CompressionOptions compression = { DDS_FORMAT_UNKNOWN, COMPRESSION_FAST, 0 };
+		m_Assets.SetTextureCompression(compression);
+	}
 	InitializeRenderTarget();
 	SetupViewports();
 	InitializeDepthView(width, height);
@@ -215,13 +348,23 @@ ApplicationWindow::ApplicationWindow(HINSTANCE hinst, WNDPROC proc)
 	InitializeRasterizerStates();
 	InitializeShaders();
 	InitializeConstantBuffers();
+	InitializeInstanceBuffer(INSTANCE_BUFFER_SIZE);
 	InitializeRenderTexture();
+	InitializeDepthStencilStates();
+	InitializeOITTargets(width, height);
+	m_bOITEnabled = false;
+	OITKeyBuffer = false;
+	m_bInstancing = true;
+	InstancingKeyBuffer = false;
 	// ===
 
 	// === Other Initializations
 	CreateLights();
 	CreateSkybox();
 	LoadObjects();
+	BuildStaticBatches();
+	AssignRenderIDs();
+	m_Assets.LogStats();
 	// ===
 
 	// === Create the Projection Matrix
@@ -231,19 +374,18 @@ ApplicationWindow::ApplicationWindow(HINSTANCE hinst, WNDPROC proc)
 	// ===
 
 	// === Setup the Secondary Camera
-	XMFLOAT4X4 secondaryView = RTObject.WorldMatrix;
-	XMStoreFloat4x4(&secondaryView, XMMatrixMultiply(XMMatrixRotationY(XMConvertToRadians(180)), Float4x4ToXMMAtrix(secondaryView)));
-	m_SecondaryCamera.SetViewMatrix(secondaryView);
+	XMFLOAT4X4 secondaryView = ToXMFLOAT4X4(m_Scene.GetWorldMatrix(RTObjectEntity));
+	XMStoreFloat4x4(&secondaryView, XMMatrixMultiply(XMMatrixRotationY(XMConvertToRadians(180)), XMLoadFloat4x4(&secondaryView)));
+	m_SecondaryCamera.SetWorldMatrix(secondaryView);
 	// ===
 
 	// === Setup the MiniMap Camera
-	XMMATRIX miniMapView = XMMatrixIdentity();
-	XMVECTOR position = XMLoadFloat3(&m_Camera.GetPosition());
-	miniMapView = XMMatrixMultiply(XMMatrixTranslation(m_Camera.GetPosition().x, m_Camera.GetPosition().y + 2, m_Camera.GetPosition().z), miniMapView);
-	miniMapView = XMMatrixMultiply(XMMatrixRotationX(XMConvertToRadians(90)), miniMapView);
-	XMFLOAT4X4 view;
-	XMStoreFloat4x4(&view, miniMapView);
-	m_MiniMapCamera.SetViewMatrix(view);
+	XMFLOAT3 miniMapPosition = m_Camera.GetPosition();
+	miniMapPosition.y += 2;
+	XMFLOAT4 miniMapOrientation;
+	XMStoreFloat4(&miniMapOrientation, XMQuaternionRotationRollPitchYaw(XMConvertToRadians(90), 0, 0));
+	m_MiniMapCamera.SetPosition(miniMapPosition);
+	m_MiniMapCamera.SetOrientation(miniMapOrientation);
 	// === 
 }
 // ======================= //
@@ -252,12 +394,16 @@ ApplicationWindow::ApplicationWindow(HINSTANCE hinst, WNDPROC proc)
 bool ApplicationWindow::ShutDown()
 {
 	// === Clean up all memory
-	for (unsigned int i = 0; i < TransparentObjects.size(); i++)
-		delete TransparentObjects[i];
+	m_Scene.Clear();
+	for (unsigned int i = 0; i < m_StaticBatchModels.size(); i++)
+		delete m_StaticBatchModels[i];
+	m_StaticBatchModels.clear();
+	m_Assets.Clear();
 
 	// === Release all DirectX Pointer Objects
 	SAFE_RELEASE(pSwapChain);
 	SAFE_RELEASE(pDevice);
+	m_D3DContext.SetDeviceContext(nullptr);
 	SAFE_RELEASE(pDeviceContext);
 	SAFE_RELEASE(pRenderTargetView);
 	SAFE_RELEASE(pDepthStencil);
@@ -265,11 +411,22 @@ bool ApplicationWindow::ShutDown()
 	SAFE_RELEASE(pBlendState);
 	SAFE_RELEASE(pRS_CullBack);
 	SAFE_RELEASE(pRS_CullFront);
+	SAFE_RELEASE(pRS_CullNone);
+	ReleaseOITTargets();
+	SAFE_RELEASE(pOITBlendState);
+	SAFE_RELEASE(pDSS_NoDepthWrite);
 	SAFE_RELEASE(pObjectConstantBuffer);
 	SAFE_RELEASE(pSceneConstantBuffer);
 	SAFE_RELEASE(pLightConstantBuffer);
+	SAFE_RELEASE(pConstantRingBuffer);
+	SAFE_RELEASE(pInstanceBuffer);
 	SAFE_RELEASE(pModel_PS);
 	SAFE_RELEASE(pModel_VS);
+	SAFE_RELEASE(pModelPacked_VS);
+	SAFE_RELEASE(pModelInstanced_VS);
+	SAFE_RELEASE(pModelOIT_PS);
+	SAFE_RELEASE(pFullScreen_VS);
+	SAFE_RELEASE(pOITComposite_PS);
 	SAFE_RELEASE(pSkybox_PS);
 	SAFE_RELEASE(pSkybox_VS);
 	SAFE_RELEASE(pVertexColor_PS);
@@ -292,6 +449,8 @@ bool ApplicationWindow::Run()
 {
 	// === Update Time
 	Time.Signal();
+	m_ConstantRing.BeginFrame();
+	m_iInstanceHead = 0;
 
 	// === Update Camera
 	m_Camera.HandleInput(Time.Delta());
@@ -302,10 +461,16 @@ bool ApplicationWindow::Run()
 	// === Update the Lighting
 	UpdateLighting();
 
+	// === Cull the Scene for every View
+	m_Scene.UpdateBounds();
+	CullScene(VIEW_RENDER_TEXTURE, m_SecondaryCamera, SecondaryProjectionMatrix);
+	CullScene(VIEW_MAIN, m_Camera, ProjectionMatrix);
+	CullScene(VIEW_MINIMAP, m_MiniMapCamera, MiniMapProjectionMatrix);
+
 	// === Render to Texture
-	pDeviceContext->RSSetViewports(1, &viewPorts[0]);
-	pDeviceContext->OMSetRenderTargets(1, &pRenderTextureTargetView, pRTDepthView);
-	pDeviceContext->OMSetBlendState(pBlendState, NULL, 0xffffffff);
+	m_RenderContext.RSSetViewports(1, &viewPorts[0]);
+	m_RenderContext.OMSetRenderTargets(1, &pRenderTextureTargetView, pRTDepthView);
+	m_RenderContext.OMSetBlendState(pBlendState, NULL, 0xffffffff);
 	pDeviceContext->ClearRenderTargetView(pRenderTextureTargetView, RED);
 	pDeviceContext->ClearDepthStencilView(pRTDepthView, D3D11_CLEAR_DEPTH, 1, NULL);
 
@@ -313,11 +478,11 @@ bool ApplicationWindow::Run()
 
 	DrawSkybox(m_SecondaryCamera);
 
-	DrawScene();
+	DrawScene(VIEW_RENDER_TEXTURE, m_SecondaryCamera);
 
 	// === Normal Render
-	pDeviceContext->OMSetRenderTargets(1, &pRenderTargetView, pDepthView);
-	pDeviceContext->OMSetBlendState(pBlendState, NULL, 0xffffffff);
+	m_RenderContext.OMSetRenderTargets(1, &pRenderTargetView, pDepthView);
+	m_RenderContext.OMSetBlendState(pBlendState, NULL, 0xffffffff);
 	pDeviceContext->ClearRenderTargetView(pRenderTargetView, BLUE);
 	pDeviceContext->ClearDepthStencilView(pDepthView, D3D11_CLEAR_DEPTH, 1, NULL);
 
@@ -327,12 +492,12 @@ bool ApplicationWindow::Run()
 
 	DrawRTObject();
 
-	DrawScene();
+	DrawScene(VIEW_MAIN, m_Camera);
 
 	// === MiniMap Render
-	pDeviceContext->RSSetViewports(1, &viewPorts[1]);
-	pDeviceContext->OMSetRenderTargets(1, &pRenderTargetView, pDepthView);
-	pDeviceContext->OMSetBlendState(pBlendState, NULL, 0xffffffff);
+	m_RenderContext.RSSetViewports(1, &viewPorts[1]);
+	m_RenderContext.OMSetRenderTargets(1, &pRenderTargetView, pDepthView);
+	m_RenderContext.OMSetBlendState(pBlendState, NULL, 0xffffffff);
 //	pDeviceContext->ClearRenderTargetView(pRenderTargetView, BLUE);
 	pDeviceContext->ClearDepthStencilView(pDepthView, D3D11_CLEAR_DEPTH, 1, NULL);
 
@@ -340,11 +505,19 @@ bool ApplicationWindow::Run()
 
 	DrawSkybox(m_MiniMapCamera);
 
-	DrawScene();
+	DrawScene(VIEW_MINIMAP, m_MiniMapCamera);
 
 	// === Update all the Objects
 	UpdateObjects();
 
+	// === State calls and buffer writes of this frame, and how many never reached the device
+	m_RenderContext.EndFrame();
+	if (++m_iFrameCount % 600 == 0) {
+		const RenderContextStats& stats = m_RenderContext.GetFrameStats();
+		LogMessage("RenderContext: %u draws of %u instances (instancing %s), %u state calls, %u filtered, %u buffer writes",
+			stats.draws, stats.instances, m_bInstancing ? "on" : "off", stats.submitted, stats.filtered, stats.bufferWrites);
+	}
+
 	pSwapChain->Present(0, 0);
 	return true; 
 }
@@ -357,7 +530,7 @@ void ApplicationWindow::ResizeWindow(int _width, int _height)
 		height = _height;
 
 
-		pDeviceContext->OMSetRenderTargets(0, 0, 0);
+		m_RenderContext.OMSetRenderTargets(0, 0, 0);
 
 		// === Release the Render Target view
 		pRenderTargetView->Release();
@@ -383,7 +556,7 @@ void ApplicationWindow::ResizeWindow(int _width, int _height)
 		//width = desc.BufferDesc.Width;
 		//height = desc.BufferDesc.Height;
 
-		pDeviceContext->OMSetRenderTargets(1, &pRenderTargetView, NULL);
+		m_RenderContext.OMSetRenderTargets(1, &pRenderTargetView, NULL);
 
 		// === Set up the viewport.
 		SetupViewports();
@@ -396,6 +569,13 @@ void ApplicationWindow::ResizeWindow(int _width, int _height)
 		SAFE_RELEASE(pDepthStencil);
 		SAFE_RELEASE(pDepthView);
 		InitializeDepthView(width, height);
+
+		// === Recreate the OIT Targets
+		ReleaseOITTargets();
+		InitializeOITTargets(width, height);
+
+		// === The new views may have the addresses of the released ones, forget what is bound
+		m_RenderContext.Invalidate();
 	}
 }
 // ============================ //
@@ -426,6 +606,9 @@ void ApplicationWindow::InitializeDeviceAndSwapChain()
 	D3D_FEATURE_LEVEL featureLevel;
 
 	D3D11CreateDeviceAndSwapChain(NULL, D3D_DRIVER_TYPE::D3D_DRIVER_TYPE_HARDWARE, NULL, flag, featureLevels, 4, D3D11_SDK_VERSION, &swapDesc, &pSwapChain, &pDevice, &featureLevel, &pDeviceContext);
+	m_D3DContext.SetDeviceContext(pDeviceContext);
+	m_RenderContext.SetTarget(&m_D3DContext);
+	m_iFrameCount = 0;
 }
 
 void ApplicationWindow::InitializeRenderTarget()
@@ -442,23 +625,23 @@ void ApplicationWindow::SetupViewports()
 	DXGI_SWAP_CHAIN_DESC swapDesc;
 	ZeroMemory(&swapDesc, sizeof(swapDesc));
 //	pSwapChain->GetDesc(&swapDesc);
-	viewPorts[0].Height = height;
-	viewPorts[0].Width = width;
-	viewPorts[0].MinDepth = 0;
-	viewPorts[0].MaxDepth = 1;
-	viewPorts[0].TopLeftX = 0;
-	viewPorts[0].TopLeftY = 0;
+	viewPorts[0].height = height;
+	viewPorts[0].width = width;
+	viewPorts[0].minDepth = 0;
+	viewPorts[0].maxDepth = 1;
+	viewPorts[0].topLeftX = 0;
+	viewPorts[0].topLeftY = 0;
 
 	// === MiniMap
 	float mHeight = height * 0.2f;
 	float mWidth = width * 0.2f;
 	ZeroMemory(&swapDesc, sizeof(swapDesc));
-	viewPorts[1].Height = mHeight;
-	viewPorts[1].Width = mWidth;
-	viewPorts[1].MinDepth = 0;
-	viewPorts[1].MaxDepth = 1;
-	viewPorts[1].TopLeftX = width * 0.75f;
-	viewPorts[1].TopLeftY = height * 0.05f;
+	viewPorts[1].height = mHeight;
+	viewPorts[1].width = mWidth;
+	viewPorts[1].minDepth = 0;
+	viewPorts[1].maxDepth = 1;
+	viewPorts[1].topLeftX = width * 0.75f;
+	viewPorts[1].topLeftY = height * 0.05f;
 	// == ProjectionMatrix
 	MiniMapProjectionMatrix = CreateProjectionMatrix(65, mWidth, mHeight);
 }
@@ -535,6 +718,14 @@ void ApplicationWindow::InitializeBlendState()
 	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
 	pDevice->CreateBlendState(&blendDesc, &pBlendState);
+
+	// === OIT Accumulation, one state for both targets: rgb adds up, alpha multiplies by (1 - alpha)
+	blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ZERO;
+	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+
+	pDevice->CreateBlendState(&blendDesc, &pOITBlendState);
 }
 
 void ApplicationWindow::InitializeRasterizerStates()
@@ -559,13 +750,24 @@ void ApplicationWindow::InitializeRasterizerStates()
 
 	// === Create RS with Cull Front Mode
 	pDevice->CreateRasterizerState(&rasterDesc, &pRS_CullFront);
+
+	rasterDesc.CullMode = D3D11_CULL_NONE;
+
+	// === Create RS without Culling
+	pDevice->CreateRasterizerState(&rasterDesc, &pRS_CullNone);
 }
 
 void ApplicationWindow::InitializeShaders()
 {
 	// === Model Shaders
 	pDevice->CreateVertexShader(&Model_VS, sizeof(Model_VS), NULL, &pModel_VS);
+	pDevice->CreateVertexShader(&ModelPacked_VS, sizeof(ModelPacked_VS), NULL, &pModelPacked_VS);
+	pDevice->CreateVertexShader(&ModelInstanced_VS, sizeof(ModelInstanced_VS), NULL, &pModelInstanced_VS);
 	pDevice->CreatePixelShader(&Model_PS, sizeof(Model_PS), NULL, &pModel_PS);
+	pDevice->CreatePixelShader(&ModelOIT_PS, sizeof(ModelOIT_PS), NULL, &pModelOIT_PS);
+	// === OIT Composite Shaders
+	pDevice->CreateVertexShader(&FullScreen_VS, sizeof(FullScreen_VS), NULL, &pFullScreen_VS);
+	pDevice->CreatePixelShader(&OITComposite_PS, sizeof(OITComposite_PS), NULL, &pOITComposite_PS);
 	// === Skybox Shaders
 	pDevice->CreateVertexShader(&Skybox_VS, sizeof(Skybox_VS), NULL, &pSkybox_VS);
 	pDevice->CreatePixelShader(&Skybox_PS, sizeof(Skybox_PS), NULL, &pSkybox_PS);
@@ -606,6 +808,41 @@ void ApplicationWindow::InitializeConstantBuffers()
 	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
 
 	pDevice->CreateBuffer(&bufferDesc, NULL, &pLightConstantBuffer);
+
+	// == Constant Ring, without offset binding every draw goes through the Object Buffer
+	pConstantRingBuffer = nullptr;
+	m_bConstantOffsets = m_D3DContext.SupportsConstantOffsets(pDevice);
+	if (m_bConstantOffsets) {
+		ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+		bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		bufferDesc.ByteWidth = CONSTANT_RING_SIZE;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_FLAG::D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0;
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+		m_bConstantOffsets = SUCCEEDED(pDevice->CreateBuffer(&bufferDesc, NULL, &pConstantRingBuffer));
+	}
+	m_ConstantRing.Initialize(m_bConstantOffsets ? CONSTANT_RING_SIZE : 0);
+	m_DrawSlices.reserve(CONSTANT_RING_SIZE / CONSTANT_RING_ALIGNMENT);
+}
+
+// - InitializeInstanceBuffer
+// --- Also grows it, once the old buffer is released
+void ApplicationWindow::InitializeInstanceBuffer(unsigned int _capacity)
+{
+	D3D11_BUFFER_DESC bufferDesc;
+	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bufferDesc.ByteWidth = _capacity * sizeof(InstanceData);
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_FLAG::D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags = 0;
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+	pInstanceBuffer = nullptr;
+	pDevice->CreateBuffer(&bufferDesc, NULL, &pInstanceBuffer);
+	m_iInstanceCapacity = pInstanceBuffer != nullptr ? _capacity : 0;
+	m_iInstanceHead = 0;
+	m_iInstanceBase = 0;
 }
 
 void ApplicationWindow::InitializeRenderTexture()
@@ -628,6 +865,53 @@ void ApplicationWindow::InitializeRenderTexture()
 
 	pDevice->CreateRenderTargetView(pRenderTexture, NULL, &pRenderTextureTargetView);
 }
+
+void ApplicationWindow::InitializeDepthStencilStates()
+{
+	// === Depth Test without Depth Writes, for the OIT accumulation
+	D3D11_DEPTH_STENCIL_DESC depthDesc;
+	ZeroMemory(&depthDesc, sizeof(depthDesc));
+	depthDesc.DepthEnable = true;
+	depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthDesc.DepthFunc = D3D11_COMPARISON_LESS;
+	depthDesc.StencilEnable = false;
+
+	pDevice->CreateDepthStencilState(&depthDesc, &pDSS_NoDepthWrite);
+}
+
+void ApplicationWindow::InitializeOITTargets(int _width, int _height)
+{
+	// === Accumulation + Revealage, then the Weights
+	const DXGI_FORMAT formats[2] = { DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R16_FLOAT };
+	for (int i = 0; i < 2; i++) {
+		D3D11_TEXTURE2D_DESC desc;
+		ZeroMemory(&desc, sizeof(desc));
+		desc.Width = _width;
+		desc.Height = _height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = formats[i];
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+
+		pDevice->CreateTexture2D(&desc, NULL, &pOITTextures[i]);
+		pDevice->CreateRenderTargetView(pOITTextures[i], NULL, &pOITTargetViews[i]);
+		pDevice->CreateShaderResourceView(pOITTextures[i], NULL, &pOITResourceViews[i]);
+	}
+}
+
+void ApplicationWindow::ReleaseOITTargets()
+{
+	for (int i = 0; i < 2; i++) {
+		SAFE_RELEASE(pOITResourceViews[i]);
+		SAFE_RELEASE(pOITTargetViews[i]);
+		SAFE_RELEASE(pOITTextures[i]);
+	}
+}
 // ========================================== //
 
 // ===== Private Interface ===== //
@@ -669,9 +953,6 @@ XMFLOAT4X4 ApplicationWindow::CreateProjectionMatrix(float _fov, float _width, f
 
 void ApplicationWindow::CreateSkybox()
 {
-	// === Setup the World Matrix
-	XMStoreFloat4x4(&Skybox.WorldMatrix, XMMatrixIdentity());
-
 	// === Set up the Vertex Buffer and Index Buffer
 	Vertex vertices[24];
 	// == Front Face
@@ -722,22 +1003,11 @@ void ApplicationWindow::CreateSkybox()
 
 	pDevice->CreateBuffer(&bufferDesc, &initData, &Skybox.pVertexBuffer);
 	// == Index Buffer
-	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	bufferDesc.ByteWidth = sizeof(indexes);
-	bufferDesc.CPUAccessFlags = NULL;
-	bufferDesc.MiscFlags = 0;
-	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	initData.pSysMem = indexes;
-	initData.SysMemPitch = 0;
-	initData.SysMemSlicePitch = 0;
-
-	pDevice->CreateBuffer(&bufferDesc, &initData, &Skybox.pIndexBuffer);
+	CreateIndexBuffer(pDevice, &Skybox, indexes, sizeof(indexes) / sizeof(unsigned int), sizeof(vertices) / sizeof(Vertex));
+	// == Local Bounds
+	Skybox.SetLocalBounds(ComputeBounds(vertices, sizeof(vertices) / sizeof(Vertex), sizeof(Vertex)));
 	// == Vertex Size
 	Skybox.VertexSize = sizeof(Vertex);
-	// == Number of Indexes
-	Skybox.NumIndexes = sizeof(indexes) / sizeof(unsigned int);
 
 	// === Create the InputLayout
 	pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Skybox_VS, sizeof(Skybox_VS), &Skybox.pInputLayout);
@@ -747,7 +1017,7 @@ void ApplicationWindow::CreateSkybox()
 	Skybox.pVertexShader = pSkybox_VS;
 
 	// == Create the ShaderResourceView
-	CreateDDSTextureFromFile(pDevice, L"NebulaSkybox.dds", NULL, &Skybox.pShaderResourceView);
+	m_Assets.AcquireTexture("NebulaSkybox.dds", &Skybox.pShaderResourceView);
 
 	// === Setup the Sampler State
 	D3D11_SAMPLER_DESC samplerDesc;
@@ -800,114 +1070,25 @@ void ApplicationWindow::CreateCube(Object* _object, float _radius)
 	vertices[23] = Vertex(_radius, -_radius, -_radius, 1, 1, 0, 0, 0, -1, 0);
 	// == Triangles (Indexes)
 	unsigned int indexes[] = { 0, 2, 3, 0, 3, 1, 4, 6, 7, 4, 7, 5, 8, 10, 11, 8, 11, 9, 12, 14, 15, 12, 15, 13, 16, 18, 19, 16, 19, 17, 20, 22, 23, 20, 23, 21 };
-	// == Setup Vertex Buffer
-	D3D11_BUFFER_DESC bufferDesc;
-	D3D11_SUBRESOURCE_DATA initData;
-	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bufferDesc.ByteWidth = sizeof(vertices);
-	bufferDesc.CPUAccessFlags = NULL;
-	bufferDesc.MiscFlags = 0;
-	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-
-	initData.pSysMem = vertices;
-	initData.SysMemPitch = 0;
-	initData.SysMemSlicePitch = 0;
-
-	pDevice->CreateBuffer(&bufferDesc, &initData, &_object->pVertexBuffer);
-	// == Index Buffer
-	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	bufferDesc.ByteWidth = sizeof(indexes);
-	bufferDesc.CPUAccessFlags = NULL;
-	bufferDesc.MiscFlags = 0;
-	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-	initData.pSysMem = indexes;
-	initData.SysMemPitch = 0;
-	initData.SysMemSlicePitch = 0;
-
-	pDevice->CreateBuffer(&bufferDesc, &initData, &_object->pIndexBuffer);
-	// == Vertex Size
-	_object->VertexSize = sizeof(Vertex);
-	// == Number of Indexes
-	_object->NumIndexes = sizeof(indexes) / sizeof(unsigned int);
+	// == Buffers, shared with every cube of the same size
+	m_Assets.AcquireMesh("Cube", vertices, sizeof(vertices) / sizeof(Vertex), indexes, sizeof(indexes) / sizeof(unsigned int), _object, [&](Object* _created) {
+		CreateMeshBuffers(pDevice, _created, vertices, sizeof(vertices) / sizeof(Vertex), indexes, sizeof(indexes) / sizeof(unsigned int), "Cube");
+	});
 }
 
-void ApplicationWindow::DrawSkybox(Camera _camera)
+void ApplicationWindow::DrawSkybox(const Camera& _camera)
 {
 	// === Move the Skybox to the Camera's position
-	XMFLOAT3 cameraPos = _camera.GetPosition();
-	Skybox.WorldMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, cameraPos.x, cameraPos.y, cameraPos.z, 1);
+	const XMFLOAT3& cameraPos = _camera.GetPosition();
 
 	// === Draw the Skybox
-	pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	DrawObject(&Skybox);
+	m_RenderContext.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	DrawObject(&Skybox, Mat4Translation(cameraPos.x, cameraPos.y, cameraPos.z));
 
 	// === Clear the Depth Buffer
 	pDeviceContext->ClearDepthStencilView(pDepthView, D3D11_CLEAR_DEPTH, 1, NULL);
 }
 
-// - LoadObjectModel
-// --- Loads in the data from an obj file
-// --- Sets up the Vertex Buffer, Index Buffer, Vertex Size, and Number of Indexes
-thread* ApplicationWindow::LoadObjectModel(const char* _path, Object& _object)
-{
-//	vector<Vector3> positions, uvs, normals;
-//	vector<Vertex> vertices;
-//	vector<unsigned int> indexes;
-	ObjectData modelData;
-	modelData.path = _path;
-	// === Load the Data from the filepath
-	thread* objThread = new thread(LoadObjFile, &modelData);
-//	thread thread = thread(LoadObjFile, _path, &positions, &uvs, &normals);
-//	LoadObjFile(_path, positions, uvs, normals);
-	// === Cycle through the data, setting up the actaul object
-//	Vertex vert;
-	Vertex* objectVertices = new Vertex[modelData.vertices.size()];
-	unsigned int* objectIndexes = new unsigned int[modelData.vertices.size()];
-	for (unsigned int i = 0; i < modelData.vertices.size(); i++) {
-		objectVertices[i] = Vertex(modelData.vertices[i].x, modelData.vertices[i].y, modelData.vertices[i].z, 1, modelData.uvs[i].x, modelData.uvs[i].y, modelData.uvs[i].z, modelData.normals[i].x, modelData.normals[i].y, modelData.normals[i].z);
-		objectIndexes[i] = i;
-	}
-	// === Setup the Object
-	// == Vertex Buffer
-	D3D11_BUFFER_DESC bufferDesc;
-	D3D11_SUBRESOURCE_DATA initData;
-	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bufferDesc.ByteWidth = sizeof(Vertex) * modelData.vertices.size();
-	bufferDesc.CPUAccessFlags = NULL;
-	bufferDesc.MiscFlags = 0;
-	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-
-	initData.pSysMem = objectVertices;
-	initData.SysMemPitch = 0;
-	initData.SysMemSlicePitch = 0;
-
-	pDevice->CreateBuffer(&bufferDesc, &initData, &_object.pVertexBuffer);
-	// == Index Buffer
-	ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	bufferDesc.ByteWidth = sizeof(unsigned int) * modelData.vertices.size();
-	bufferDesc.CPUAccessFlags = NULL;
-	bufferDesc.MiscFlags = 0;
-	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-//	memcpy(&initData.pSysMem, &objectIndexes, sizeof(unsigned int) * positions.size());
-	initData.pSysMem = objectIndexes;
-	initData.SysMemPitch = 0;
-	initData.SysMemSlicePitch = 0;
-
-	pDevice->CreateBuffer(&bufferDesc, &initData, &_object.pIndexBuffer);
-	// == Set the VertexSize
-	_object.VertexSize = sizeof(Vertex);
-	// == Set the Number of Vertices
-	_object.NumIndexes = modelData.vertices.size();
-
-	return objThread;
-}
-
 void ApplicationWindow::LoadObjects()
 {
 	D3D11_BUFFER_DESC bufferDesc;
@@ -929,76 +1110,70 @@ void ApplicationWindow::LoadObjects()
 	ModelData modelData[3];
 	// === Load the Bamboo
 	{
-		// == Set the WorldMatrix
-		Bamboo.WorldMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -3, 0.2, 3, 1);
 		// == Start a thread to Load the Object
 		modelData[0].path = "SingleBamboo.obj";
 		modelData[0].object = &Bamboo;
 		modelData[0].device = pDevice;
+		modelData[0].format = VERTEX_FORMAT_FULL;
+		Bamboo.KeepMeshData = true;
 		loadingThreads[0] = thread(LoadObjFile_Thread, &modelData[0]);
 		// == Set the Shaders
 		Bamboo.pVertexShader = pModel_VS;
 		Bamboo.pPixelShader = pModel_PS;
 		// == Set the Texture and ShaderResourceView
-		CreateDDSTextureFromFile(pDevice, L"BambooT.dds", NULL, &Bamboo.pShaderResourceView);
+		m_Assets.AcquireTexture("BambooT.dds", &Bamboo.pShaderResourceView);
 		// == Set the Sampler State
 		pDevice->CreateSamplerState(&samplerDesc, &Bamboo.pSamplerState);
 		// == Set the InputLayout
 		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &Bamboo.pInputLayout);
+		// == Set the Instanced Shader and InputLayout
+		Bamboo.pInstancedVertexShader = pModelInstanced_VS;
+		pDevice->CreateInputLayout(Layout_Vertex_Instanced, sizeof(Layout_Vertex_Instanced) / sizeof(D3D11_INPUT_ELEMENT_DESC), ModelInstanced_VS, sizeof(ModelInstanced_VS), &Bamboo.pInstancedInputLayout);
 	}
 
 	// === Load the Barrel
 	{
-		// == Set the WorldMatrix
-		XMStoreFloat4x4(&Barrel.WorldMatrix, XMMatrixMultiply(XMMATRIX(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 2, 0, 2, 1), XMMatrixScaling(0.5f, 0.5f, 0.5f)));
 		// == Start a thread to Load the Object
 		modelData[1].path = "Barrel.obj";
 		modelData[1].object = &Barrel;
 		modelData[1].device = pDevice;
+		modelData[1].format = VERTEX_FORMAT_PACKED;
 		loadingThreads[1] = thread(LoadObjFile_Thread, &modelData[1]);
 		// == Set the Shaders
-		Barrel.pVertexShader = pModel_VS;
+		Barrel.pVertexShader = pModelPacked_VS;
 		Barrel.pPixelShader = pModel_PS;
 		// == Set the Texture and ShaderResourceView
-		CreateDDSTextureFromFile(pDevice, L"barrel_diffuse.dds", NULL, &Barrel.pShaderResourceView);
+		m_Assets.AcquireTexture("barrel_diffuse.dds", &Barrel.pShaderResourceView);
 		// == Set the Sampler State
 		pDevice->CreateSamplerState(&samplerDesc, &Barrel.pSamplerState);
 		// == Set the InputLayout
-		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &Barrel.pInputLayout);
-		// == Setup the MoveComponent
-		Barrel.pMoveComponent = new MoveComponent(&Barrel);
-		XMFLOAT3* Waypoints = new XMFLOAT3[2];
-		Waypoints[0] = XMFLOAT3(-3, 0, 2); Waypoints[1] = XMFLOAT3(3, 0, 2);
-		Barrel.pMoveComponent->SetWaypoints(Waypoints, 2);
-		Barrel.pMoveComponent->Patrol(0);
+		pDevice->CreateInputLayout(Layout_Vertex_Packed, sizeof(Layout_Vertex_Packed) / sizeof(D3D11_INPUT_ELEMENT_DESC), ModelPacked_VS, sizeof(ModelPacked_VS), &Barrel.pInputLayout);
 	}
 
 	// === Load the CherryTree
 	{
-		// == Set the WorldMatrix
-		XMStoreFloat4x4(&CherryTree.WorldMatrix, XMMatrixMultiply(XMMATRIX(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 7, 0, 7, 1), XMMatrixScaling(0.75f, 0.75f, 0.75f)));
 		// == Start a thread to Load the Object
 		modelData[2].path = "CherryTree.obj";
 		modelData[2].object = &CherryTree;
 		modelData[2].device = pDevice;
+		modelData[2].format = VERTEX_FORMAT_PACKED;
+		CherryTree.KeepMeshData = true;
 		loadingThreads[2] = thread(LoadObjFile_Thread, &modelData[2]);
 		// == Set the Shaders
-		CherryTree.pVertexShader = pModel_VS;
+		CherryTree.pVertexShader = pModelPacked_VS;
 		CherryTree.pPixelShader = pModel_PS;
 		// == Set the Texture and ShaderResourceView
-		CreateDDSTextureFromFile(pDevice, L"cherryblossomtree.dds", NULL, &CherryTree.pShaderResourceView);
+		m_Assets.AcquireTexture("cherryblossomtree.dds", &CherryTree.pShaderResourceView);
 		// == Set the Sampler State
 		pDevice->CreateSamplerState(&samplerDesc, &CherryTree.pSamplerState);
 		// == Set the InputLayout
-		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &CherryTree.pInputLayout);
+		pDevice->CreateInputLayout(Layout_Vertex_Packed, sizeof(Layout_Vertex_Packed) / sizeof(D3D11_INPUT_ELEMENT_DESC), ModelPacked_VS, sizeof(ModelPacked_VS), &CherryTree.pInputLayout);
 	}
 
 	// === Load Custom Objects
 
 	// === Load the Star Object
 	{
-		// == Set the WorldMatrix
-		Star.WorldMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 2, 1);
 		// == Set the Vertex Buffer
 		Vertex_PositionColor vertices[17];
 		vertices[0] = Vertex_PositionColor(0.0f, 0.0f, -0.15f, 1, WHITE);
@@ -1026,18 +1201,9 @@ void ApplicationWindow::LoadObjects()
 		pDevice->CreateBuffer(&bufferDesc, &initData, &Star.pVertexBuffer);
 		// == Set the Index Buffer
 		unsigned int indexes[] = { 1, 0, 11, 1, 8, 0, 13, 0, 8, 13, 5, 0, 10, 0, 5, 10, 2, 0, 7, 0, 2, 7, 14, 0, 4, 0, 14, 4, 11, 0, 1, 12, 16, 1, 16, 9, 13, 9, 16, 13, 16, 6, 10, 6, 16, 10, 16, 3, 7, 3, 16, 7, 16, 15, 4, 15, 16, 4, 16, 12, 1, 9, 8, 13, 8, 9, 13, 6, 5, 10, 5, 6, 10, 3, 2, 7, 2, 3, 7, 15, 14, 4, 14, 15, 4, 12, 11, 1, 11, 12 };
-		ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		bufferDesc.ByteWidth = sizeof(indexes);
-		bufferDesc.CPUAccessFlags = NULL;
-		bufferDesc.MiscFlags = 0;
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-		initData.pSysMem = indexes;
-		initData.SysMemPitch = 0;
-		initData.SysMemSlicePitch = 0;
-
-		pDevice->CreateBuffer(&bufferDesc, &initData, &Star.pIndexBuffer);
+		CreateIndexBuffer(pDevice, &Star, indexes, sizeof(indexes) / sizeof(unsigned int), sizeof(vertices) / sizeof(Vertex_PositionColor));
+		// == Local Bounds
+		Star.SetLocalBounds(ComputeBounds(vertices, sizeof(vertices) / sizeof(Vertex_PositionColor), sizeof(Vertex_PositionColor)));
 		// == Set the Shaders
 		Star.pVertexShader = pVertexColor_VS;
 		Star.pPixelShader = pVertexColor_PS;
@@ -1045,14 +1211,10 @@ void ApplicationWindow::LoadObjects()
 		pDevice->CreateInputLayout(Layout_Vertex_PositionColor, 2, VertexColor_VS, sizeof(VertexColor_VS), &Star.pInputLayout);
 		// == Set the VertexSize
 		Star.VertexSize = sizeof(Vertex_PositionColor);
-		// == Set the Number of Vertices
-		Star.NumIndexes = sizeof(indexes) / sizeof(unsigned int);
 	}
 
 	// === Load the Ground
 	{
-		// == Set the WorldMatrix
-		XMStoreFloat4x4(&Ground.WorldMatrix, XMMatrixIdentity());
 		// == Set the Vertex Buffer
 		Vertex groundVerts[4];
 		float radius = 8.0f;
@@ -1074,37 +1236,30 @@ void ApplicationWindow::LoadObjects()
 		pDevice->CreateBuffer(&bufferDesc, &initData, &Ground.pVertexBuffer);
 		// == Set the Index Buffer
 		unsigned int indexes[] = { 0, 3, 1, 0, 2, 3 };
-		ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		bufferDesc.ByteWidth = sizeof(indexes);
-		bufferDesc.CPUAccessFlags = NULL;
-		bufferDesc.MiscFlags = 0;
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-		initData.pSysMem = indexes;
-		initData.SysMemPitch = 0;
-		initData.SysMemSlicePitch = 0;
-
-		pDevice->CreateBuffer(&bufferDesc, &initData, &Ground.pIndexBuffer);
+		CreateIndexBuffer(pDevice, &Ground, indexes, sizeof(indexes) / sizeof(unsigned int), sizeof(groundVerts) / sizeof(Vertex));
+		// == Local Bounds
+		Ground.SetLocalBounds(ComputeBounds(groundVerts, sizeof(groundVerts) / sizeof(Vertex), sizeof(Vertex)));
+		// == Keep the Mesh for Static Batching
+		Ground.MeshVertices.assign(groundVerts, groundVerts + sizeof(groundVerts) / sizeof(Vertex));
+		Ground.MeshIndexes.assign(indexes, indexes + sizeof(indexes) / sizeof(unsigned int));
 		// == Set the Shaders
 		Ground.pVertexShader = pModel_VS;
 		Ground.pPixelShader = pModel_PS;
 		// == Set the Texture and ShaderResourceView
-		CreateDDSTextureFromFile(pDevice, L"SMGrass_Seamless.dds", NULL, &Ground.pShaderResourceView);
+		m_Assets.AcquireTexture("SMGrass_Seamless.dds", &Ground.pShaderResourceView);
 		// == Set the Sampler State
 		pDevice->CreateSamplerState(&samplerDesc, &Ground.pSamplerState);
 		// == Set the InputLayout
 		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &Ground.pInputLayout);
+		// == Set the Instanced Shader and InputLayout
+		Ground.pInstancedVertexShader = pModelInstanced_VS;
+		pDevice->CreateInputLayout(Layout_Vertex_Instanced, sizeof(Layout_Vertex_Instanced) / sizeof(D3D11_INPUT_ELEMENT_DESC), ModelInstanced_VS, sizeof(ModelInstanced_VS), &Ground.pInstancedInputLayout);
 		// == Set the VertexSize
 		Ground.VertexSize = sizeof(Vertex);
-		// == Set the Number of Vertices
-		Ground.NumIndexes = sizeof(indexes) / sizeof(unsigned int);
 	}
 
 	// === Load the RTObject
 	{
-		// == Set the WorldMatrix
-		RTObject.WorldMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 4, 1);
 		// == Setup the Verts Buffer
 		Vertex verts[4];
 		verts[0] = Vertex(-0.5f, -1, 0, 1, 1, 1, 0, 0, 0, -1);
@@ -1125,18 +1280,9 @@ void ApplicationWindow::LoadObjects()
 		pDevice->CreateBuffer(&bufferDesc, &initData, &RTObject.pVertexBuffer);
 		// == Setup the Index Buffer
 		unsigned int indexes[] = { 0, 1, 3, 1, 2, 3 };
-		ZeroMemory(&bufferDesc, sizeof(bufferDesc));
-		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		bufferDesc.ByteWidth = sizeof(indexes);
-		bufferDesc.CPUAccessFlags = NULL;
-		bufferDesc.MiscFlags = 0;
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-
-		initData.pSysMem = indexes;
-		initData.SysMemPitch = 0;
-		initData.SysMemSlicePitch = 0;
-
-		pDevice->CreateBuffer(&bufferDesc, &initData, &RTObject.pIndexBuffer);
+		CreateIndexBuffer(pDevice, &RTObject, indexes, sizeof(indexes) / sizeof(unsigned int), sizeof(verts) / sizeof(Vertex));
+		// == Local Bounds
+		RTObject.SetLocalBounds(ComputeBounds(verts, sizeof(verts) / sizeof(Vertex), sizeof(Vertex)));
 		// == Set the Shaders
 		RTObject.pVertexShader = pModel_VS;
 		RTObject.pPixelShader = pModel_PS;
@@ -1148,171 +1294,594 @@ void ApplicationWindow::LoadObjects()
 		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &RTObject.pInputLayout);
 		// == Set the VertexSize
 		RTObject.VertexSize = sizeof(Vertex);
-		// == Set the Number of Vertices
-		RTObject.NumIndexes = sizeof(indexes) / sizeof(unsigned int);
-	}
-
-	// === Load the PatrolPointLight
-	{
-		// == Set the WorldMatrix
-		PatrolPointLight.WorldMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 5, 1, -4, 1);
-		// == Setup the MoveComponent
-		PatrolPointLight.pMoveComponent = new MoveComponent(&PatrolPointLight);
-		XMFLOAT3* Waypoints = new XMFLOAT3[2];
-		Waypoints[0] = XMFLOAT3(5, 1, -4); Waypoints[1] = XMFLOAT3(1, 1, -4);
-		PatrolPointLight.pMoveComponent->SetWaypoints(Waypoints, 2);
-		PatrolPointLight.pMoveComponent->Patrol(0);
 	}
 
-	// === Load the Transparent Cubes
+	// === Load the Transparent Cube, shared by all the transparent entities
 	{
-		// === Cube 1
-		Object* cube = new Object();
-		// == Set the WorldMatrix
-		cube->WorldMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 1, 0.515f, -4, 1);
 		// == Create a Cube Model
-		CreateCube(cube, 0.5f);
+		CreateCube(&TransparentCube, 0.5f);
 		// == Set the InputLayout
-		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &cube->pInputLayout);
+		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &TransparentCube.pInputLayout);
+		// == Set the Instanced Shader and InputLayout
+		TransparentCube.pInstancedVertexShader = pModelInstanced_VS;
+		pDevice->CreateInputLayout(Layout_Vertex_Instanced, sizeof(Layout_Vertex_Instanced) / sizeof(D3D11_INPUT_ELEMENT_DESC), ModelInstanced_VS, sizeof(ModelInstanced_VS), &TransparentCube.pInstancedInputLayout);
 		// == Set the Shaders
-		cube->pVertexShader = pModel_VS;
-		cube->pPixelShader = pModel_PS;
+		TransparentCube.pVertexShader = pModel_VS;
+		TransparentCube.pPixelShader = pModel_PS;
 		// == Set the Texture and ShaderResourceView
-		CreateDDSTextureFromFile(pDevice, L"WindowedBox.dds", NULL, &cube->pShaderResourceView);
+		m_Assets.AcquireTexture("WindowedBox.dds", &TransparentCube.pShaderResourceView);
 		// == Set the Sampler State
-		pDevice->CreateSamplerState(&samplerDesc, &cube->pSamplerState);
-		TransparentObjects.push_back(cube);
-
-		// === Cube 2
-		cube = new Object();
-		// == Set the WorldMatrix
-		cube->WorldMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 3, 0.55f, -4, 1);
-		// == Create a Cube Model
-		CreateCube(cube, 0.5f);
-		// == Set the InputLayout
-		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &cube->pInputLayout);
-		// == Set the Shaders
-		cube->pVertexShader = pModel_VS;
-		cube->pPixelShader = pModel_PS;
-		// == Set the Texture and ShaderResourceView
-		CreateDDSTextureFromFile(pDevice, L"WindowedBox.dds", NULL, &cube->pShaderResourceView);
-		// == Set the Sampler State
-		pDevice->CreateSamplerState(&samplerDesc, &cube->pSamplerState);
-		TransparentObjects.push_back(cube);
-
-		// === Cube 3
-		cube = new Object();
-		// == Set the WorldMatrix
-		cube->WorldMatrix = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 5, 0.55f, -4, 1);
-		// == Create a Cube Model
-		CreateCube(cube, 0.5f);
-		// == Set the InputLayout
-		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &cube->pInputLayout);
-		// == Set the Shaders
-		cube->pVertexShader = pModel_VS;
-		cube->pPixelShader = pModel_PS;
-		// == Set the Texture and ShaderResourceView
-		CreateDDSTextureFromFile(pDevice, L"WindowedBox.dds", NULL, &cube->pShaderResourceView);
-		// == Set the Sampler State
-		pDevice->CreateSamplerState(&samplerDesc, &cube->pSamplerState);
-		TransparentObjects.push_back(cube);
+		pDevice->CreateSamplerState(&samplerDesc, &TransparentCube.pSamplerState);
 	}
 
 	// === Wait for all the Loading Threads to finish
 	for (int i = 0; i < 3; i++) {
 		loadingThreads[i].join();
 	}
+
+	// === Place everything in the Scene, now that every model knows its bounds
+	{
+		XMFLOAT4X4 world;
+		// == Cherry Tree, needs both faces
+		XMStoreFloat4x4(&world, XMMatrixMultiply(XMMATRIX(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 7, 0, 7, 1), XMMatrixScaling(0.75f, 0.75f, 0.75f)));
+		m_Scene.CreateEntity(ToMat4(world), CherryTree.GetLocalBounds(), &CherryTree, ENTITY_DRAW | ENTITY_TWO_SIDED | ENTITY_STATIC);
+		// == Ground
+		m_Scene.CreateEntity(Mat4Identity(), Ground.GetLocalBounds(), &Ground, ENTITY_DRAW | ENTITY_STATIC);
+		// == Star
+		m_Scene.CreateEntity(Mat4Translation(0, 1, 2), Star.GetLocalBounds(), &Star, ENTITY_DRAW);
+		// == Bamboo
+		m_Scene.CreateEntity(Mat4Translation(-3, 0.2f, 3), Bamboo.GetLocalBounds(), &Bamboo, ENTITY_DRAW | ENTITY_STATIC);
+		// == Barrel, patrols between two Waypoints at half speed
+		XMStoreFloat4x4(&world, XMMatrixMultiply(XMMATRIX(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 2, 0, 2, 1), XMMatrixScaling(0.5f, 0.5f, 0.5f)));
+		EntityID barrel = m_Scene.CreateEntity(ToMat4(world), Barrel.GetLocalBounds(), &Barrel, ENTITY_DRAW);
+		MoveComponent* mover = new MoveComponent(&m_Scene, barrel);
+		Vec3 Waypoints[2] = { MakeVec3(-3, 0, 2), MakeVec3(3, 0, 2) };
+		mover->SetWaypoints(Waypoints, 2);
+		mover->SetSpeed(0.5f);
+		mover->Patrol(0);
+		m_Scene.SetMover(barrel, mover);
+		// == Transparent Cubes
+		m_Scene.CreateEntity(Mat4Translation(1, 0.515f, -4), TransparentCube.GetLocalBounds(), &TransparentCube, ENTITY_DRAW | ENTITY_TRANSPARENT);
+		m_Scene.CreateEntity(Mat4Translation(3, 0.55f, -4), TransparentCube.GetLocalBounds(), &TransparentCube, ENTITY_DRAW | ENTITY_TRANSPARENT);
+		m_Scene.CreateEntity(Mat4Translation(5, 0.55f, -4), TransparentCube.GetLocalBounds(), &TransparentCube, ENTITY_DRAW | ENTITY_TRANSPARENT);
+		// == RTObject, only drawn in the main view by DrawRTObject
+		RTObjectEntity = m_Scene.CreateEntity(Mat4Translation(0, 1, 4), RTObject.GetLocalBounds(), &RTObject, 0);
+		// == PatrolPointLight, a transform the Point Light follows
+		Bounds noBounds = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 }, 0 };
+		PatrolPointLight = m_Scene.CreateEntity(Mat4Translation(5, 1, -4), noBounds, nullptr, 0);
+		mover = new MoveComponent(&m_Scene, PatrolPointLight);
+		Waypoints[0] = MakeVec3(5, 1, -4); Waypoints[1] = MakeVec3(1, 1, -4);
+		mover->SetWaypoints(Waypoints, 2);
+		mover->Patrol(0);
+		m_Scene.SetMover(PatrolPointLight, mover);
+	}
+}
+
+// - BuildStaticBatches
+// --- Bakes the static entities whose model kept its mesh: the ones sharing pixel shader, texture, sampler and
+// --- sidedness are merged per cell into a model of their own, in world space, and are no longer drawn themselves
+// --- Cells with a single entity are left as they are; every model drops its copy of the mesh afterwards
+void ApplicationWindow::BuildStaticBatches()
+{
+	StaticBatcher batcher;
+	batcher.SetCellSize(STATIC_CELL_SIZE);
+	vector<Object*> meshes;
+	// === Dense index of the first entity of every material
+	vector<size_t> materials;
+	unsigned int staticCount = 0;
+	for (size_t i = 0; i < m_Scene.Size(); i++) {
+		unsigned int flags = m_Scene.GetFlagsAt(i);
+		Object* model = m_Scene.GetModelAt(i);
+		if ((flags & (ENTITY_DRAW | ENTITY_STATIC | ENTITY_TRANSPARENT)) != (ENTITY_DRAW | ENTITY_STATIC) || model == nullptr || model->MeshVertices.empty())
+			continue;
+		// == One mesh per model
+		unsigned int mesh = (unsigned int)(find(meshes.begin(), meshes.end(), model) - meshes.begin());
+		if (mesh == meshes.size()) {
+			meshes.push_back(model);
+			batcher.AddMesh(model->MeshVertices.data(), (unsigned int)model->MeshVertices.size(), model->MeshIndexes.data(), (unsigned int)model->MeshIndexes.size());
+		}
+		// == The baked vertices all go through Model_VS, so the vertex shader is not part of the material
+		unsigned int material = 0;
+		for (; material < materials.size(); material++) {
+			Object* other = m_Scene.GetModelAt(materials[material]);
+			if (other->pPixelShader == model->pPixelShader && other->pShaderResourceView == model->pShaderResourceView
+				&& other->pSamplerState == model->pSamplerState && (m_Scene.GetFlagsAt(materials[material]) & ENTITY_TWO_SIDED) == (flags & ENTITY_TWO_SIDED))
+				break;
+		}
+		if (material == materials.size())
+			materials.push_back(i);
+		batcher.AddInstance(mesh, material, m_Scene.GetWorldMatrixAt(i), (unsigned int)i);
+		staticCount++;
+	}
+	batcher.Build(&m_StaticBatches);
+	m_StaticBatchRanges.assign(m_StaticBatches.size(), vector<IndexRange>());
+
+	// === A model and an entity per batch; creating entities leaves the dense indexes of the pieces as they are
+	D3D11_BUFFER_DESC bufferDesc;
+	D3D11_SUBRESOURCE_DATA initData;
+	unsigned int bakedCount = 0;
+	for (unsigned int b = 0; b < m_StaticBatches.size(); b++) {
+		const StaticBatch& batch = m_StaticBatches[b];
+		Object* source = m_Scene.GetModelAt(materials[batch.material]);
+		unsigned int sourceFlags = m_Scene.GetFlagsAt(materials[batch.material]);
+		Object* model = new Object();
+		// == Vertex Buffer
+		ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bufferDesc.ByteWidth = (UINT)(batch.vertices.size() * sizeof(Vertex));
+		bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		initData.pSysMem = batch.vertices.data();
+		initData.SysMemPitch = 0;
+		initData.SysMemSlicePitch = 0;
+		pDevice->CreateBuffer(&bufferDesc, &initData, &model->pVertexBuffer);
+		// == Index Buffer, 32 bit so the ranges of the pieces stay where the batch put them
+		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		bufferDesc.ByteWidth = (UINT)(batch.indexes.size() * sizeof(unsigned int));
+		initData.pSysMem = batch.indexes.data();
+		pDevice->CreateBuffer(&bufferDesc, &initData, &model->pIndexBuffer);
+		model->IndexFormat = DXGI_FORMAT_R32_UINT;
+		model->NumIndexes = (unsigned int)batch.indexes.size();
+		model->VertexSize = sizeof(Vertex);
+		model->SetLocalBounds(batch.bounds);
+		// == Shaders and InputLayout
+		model->pVertexShader = pModel_VS;
+		model->pPixelShader = source->pPixelShader;
+		pDevice->CreateInputLayout(Layout_Vertex, sizeof(Layout_Vertex) / sizeof(D3D11_INPUT_ELEMENT_DESC), Model_VS, sizeof(Model_VS), &model->pInputLayout);
+		// == Texture and Sampler, shared with the source model
+		model->pShaderResourceView = source->pShaderResourceView;
+		model->pSamplerState = source->pSamplerState;
+		if (model->pShaderResourceView)
+			model->pShaderResourceView->AddRef();
+		if (model->pSamplerState)
+			model->pSamplerState->AddRef();
+		model->pStaticBatch = &batch;
+		m_StaticBatchModels.push_back(model);
+		m_Scene.CreateEntity(Mat4Identity(), batch.bounds, model, ENTITY_DRAW | ENTITY_STATIC | (sourceFlags & ENTITY_TWO_SIDED));
+
+		// == The pieces are drawn by the batch from now on
+		for (unsigned int p = 0; p < batch.pieces.size(); p++) {
+			EntityID piece = m_Scene.GetEntityAt(batch.pieces[p].source);
+			m_Scene.SetFlags(piece, m_Scene.GetFlags(piece) & ~ENTITY_DRAW);
+		}
+		bakedCount += (unsigned int)batch.pieces.size();
+	}
+
+	// === The meshes are in the batches or on the GPU now
+	for (size_t i = 0; i < m_Scene.Size(); i++) {
+		Object* model = m_Scene.GetModelAt(i);
+		if (model == nullptr)
+			continue;
+		vector<Vertex>().swap(model->MeshVertices);
+		vector<unsigned int>().swap(model->MeshIndexes);
+	}
+	LogMessage("StaticBatcher: %u static objects, %u baked into %u batches (cell size %.1f), %u left as they are",
+		staticCount, bakedCount, (unsigned int)m_StaticBatches.size(), STATIC_CELL_SIZE, staticCount - bakedCount);
+}
+
+// - AssignRenderIDs
+// --- Models sharing shaders or a texture and sampler get the same id, so the Render Queue groups them
+// --- The Instance Batcher learns which meshes have an instanced shader
+void ApplicationWindow::AssignRenderIDs()
+{
+	Object* fixedModels[] = { &Star, &Ground, &Bamboo, &Barrel, &RTObject, &CherryTree, &TransparentCube };
+	vector<Object*> models(fixedModels, fixedModels + sizeof(fixedModels) / sizeof(fixedModels[0]));
+	models.insert(models.end(), m_StaticBatchModels.begin(), m_StaticBatchModels.end());
+	const unsigned int modelCount = (unsigned int)models.size();
+	for (unsigned int i = 0; i < modelCount; i++) {
+		models[i]->MeshID = i;
+		models[i]->ShaderID = i;
+		models[i]->MaterialID = i;
+		for (unsigned int j = 0; j < i; j++) {
+			if (models[j]->pVertexShader == models[i]->pVertexShader && models[j]->pPixelShader == models[i]->pPixelShader)
+				models[i]->ShaderID = models[j]->ShaderID;
+			if (models[j]->pShaderResourceView == models[i]->pShaderResourceView && models[j]->pSamplerState == models[i]->pSamplerState)
+				models[i]->MaterialID = models[j]->MaterialID;
+		}
+		m_Batcher.SetInstanced(models[i]->MeshID, models[i]->pInstancedVertexShader != nullptr && models[i]->pInstancedInputLayout != nullptr);
+	}
 }
 
 void ApplicationWindow::DrawRTObject()
 {
 	// == Set the Texture and ShaderResourceView
 //	pDevice->CreateShaderResourceView(pRenderTexture, NULL, &RTObject.pShaderResourceView);
-	DrawObject(&RTObject);
+	DrawObject(&RTObject, m_Scene.GetWorldMatrix(RTObjectEntity));
 }
 
-void ApplicationWindow::DrawObject(Object* _object)
+// - DrawObject
+// --- _pixelShader replaces the Object's own one when given
+void ApplicationWindow::DrawObject(Object* _object, const Mat4& _worldMatrix, const Vec4& _tint, ID3D11PixelShader* _pixelShader)
 {
-	// === Update the ObjectConstantBuffer
-	toShaderObject.worldMatrix = _object->WorldMatrix;
-	D3D11_MAPPED_SUBRESOURCE objectSubResource;
-	pDeviceContext->Map(pObjectConstantBuffer, 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, NULL, &objectSubResource);
-	memcpy(objectSubResource.pData, &toShaderObject, sizeof(toShaderObject));
-	pDeviceContext->Unmap(pObjectConstantBuffer, 0);
-	pDeviceContext->VSSetConstantBuffers(0, 1, &pObjectConstantBuffer);
-
 	// === Set the VertexBuffer
 	UINT strides[] = { _object->VertexSize };
 	UINT offsets[] = { 0 };
-	pDeviceContext->IASetVertexBuffers(0, 1, &_object->pVertexBuffer, strides, offsets);
+	m_RenderContext.IASetVertexBuffers(0, 1, &_object->pVertexBuffer, strides, offsets);
 
 	// === Set the IndexBuffer
-	pDeviceContext->IASetIndexBuffer(_object->pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	m_RenderContext.IASetIndexBuffer(_object->pIndexBuffer, _object->IndexFormat, 0);
 
 	// === Set the Shaders
-	pDeviceContext->VSSetShader(_object->pVertexShader, NULL, 0);
-	pDeviceContext->PSSetShader(_object->pPixelShader, NULL, 0);
+	m_RenderContext.VSSetShader(_object->pVertexShader);
+	m_RenderContext.PSSetShader(_pixelShader != nullptr ? _pixelShader : _object->pPixelShader);
 
 	// === Set the Layout
-	pDeviceContext->IASetInputLayout(_object->pInputLayout);
+	m_RenderContext.IASetInputLayout(_object->pInputLayout);
 
 	// === Is there a Texture to take into account?
-	pDeviceContext->PSSetShaderResources(0, 1, &_object->pShaderResourceView);
-	pDeviceContext->PSSetSamplers(0, 1, &_object->pSamplerState);
+	m_RenderContext.PSSetShaderResources(0, 1, &_object->pShaderResourceView);
+	m_RenderContext.PSSetSamplers(0, 1, &_object->pSamplerState);
+
+	DrawMesh(_object, _worldMatrix, _tint);
+}
+
+// - DrawMesh
+// --- Only uploads the Object constants and draws, everything else must already be bound
+// --- A single draw: one slice of the Constant Ring, or a discard of the ObjectConstantBuffer without offsets
+void ApplicationWindow::DrawMesh(Object* _object, const Mat4& _worldMatrix, const Vec4& _tint)
+{
+	SetObjectConstants(_object, _worldMatrix, _tint);
+	if (m_bConstantOffsets) {
+		ConstantSlice slice;
+		AllocateConstants(&toShaderObject, sizeof(toShaderObject), &slice);
+		m_ConstantRing.Upload(&m_RenderContext, pConstantRingBuffer);
+		DrawMesh(_object, slice);
+		return;
+	}
+	m_RenderContext.WriteBuffer(pObjectConstantBuffer, 0, &toShaderObject, sizeof(toShaderObject), true);
+	m_RenderContext.VSSetConstantBuffers(0, 1, &pObjectConstantBuffer);
+	DrawIndexRanges(_object);
+}
+
+// - DrawMesh
+// --- Draws with Object constants already uploaded to the Constant Ring
+void ApplicationWindow::DrawMesh(Object* _object, const ConstantSlice& _constants)
+{
+	unsigned int firstConstant = _constants.FirstConstant(), constantCount = _constants.ConstantCount();
+	m_RenderContext.VSSetConstantBuffers1(0, 1, &pConstantRingBuffer, &firstConstant, &constantCount);
+	DrawIndexRanges(_object);
+}
+
+// - DrawIndexRanges
+// --- Once per index range if the mesh had to be split for 16-bit indexes, or per run of pieces of a static batch in view
+void ApplicationWindow::DrawIndexRanges(Object* _object)
+{
+	const vector<IndexRange>& ranges = GetIndexRanges(_object);
+	if (ranges.empty()) {
+		m_RenderContext.DrawIndexed(_object->NumIndexes, 0, 0);
+	}
+	else {
+		for (unsigned int i = 0; i < ranges.size(); i++)
+			m_RenderContext.DrawIndexed(ranges[i].indexCount, ranges[i].firstIndex, ranges[i].baseVertex);
+	}
+}
 
-	// === Draw 
-	pDeviceContext->DrawIndexed(_object->NumIndexes, 0, 0);
+// - GetIndexRanges
+// --- Static batches draw what DrawScene culled them to for the current View, every other Object its own ranges
+const vector<IndexRange>& ApplicationWindow::GetIndexRanges(Object* _object) const
+{
+	if (_object->pStaticBatch != nullptr)
+		return m_StaticBatchRanges[_object->pStaticBatch - &m_StaticBatches[0]];
+	return _object->IndexRanges;
 }
 
-void ApplicationWindow::DrawTransparentObjects()
+// - DrawInstances
+// --- _count instances of the Instance Buffer from _firstInstance on, with the instanced shader, layout and buffers bound
+void ApplicationWindow::DrawInstances(Object* _object, unsigned int _firstInstance, unsigned int _count)
 {
-	// === Determine the Distances
-	for (unsigned int i = 0; i < TransparentObjects.size(); i++) {
-		XMFLOAT3 distance;
-		XMStoreFloat3(&distance, XMVector3Length(XMVectorSubtract(XMLoadFloat3(&TransparentObjects[i]->GetPosition()), XMLoadFloat3(&m_Camera.GetPosition()))));
-		TransparentObjects[i]->DistanceFromCamera = distance.x;
+	const vector<IndexRange>& ranges = GetIndexRanges(_object);
+	if (ranges.empty()) {
+		m_RenderContext.DrawIndexedInstanced(_object->NumIndexes, _count, 0, 0, _firstInstance);
+	}
+	else {
+		for (unsigned int i = 0; i < ranges.size(); i++)
+			m_RenderContext.DrawIndexedInstanced(ranges[i].indexCount, _count, ranges[i].firstIndex, ranges[i].baseVertex, _firstInstance);
 	}
+}
+
+void ApplicationWindow::SetObjectConstants(Object* _object, const Mat4& _worldMatrix, const Vec4& _tint)
+{
+	toShaderObject.worldMatrix = ToXMFLOAT4X4(_worldMatrix);
+	toShaderObject.tint = XMFLOAT4(_tint.x, _tint.y, _tint.z, _tint.w);
+	toShaderObject.positionScale = _object->PositionScale;
+	toShaderObject.positionOffset = _object->PositionOffset;
+}
+
+// - AllocateConstants
+// --- A slice for constants used right away, wrapping the Constant Ring when it is full
+void ApplicationWindow::AllocateConstants(const void* _data, unsigned int _size, ConstantSlice* _slice)
+{
+	if (m_ConstantRing.Allocate(_data, _size, _slice))
+		return;
+	WrapConstantRing();
+	m_ConstantRing.Allocate(_data, _size, _slice);
+}
+
+// - AllocateQueueConstants
+// --- Object constants of the queued draws from _first on (in the Instance Batch _batch), as many as fit, in one upload
+// --- Instanced draws take theirs from the Instance Buffer and are skipped; returns the queued draw where the Constant Ring ran out
+unsigned int ApplicationWindow::AllocateQueueConstants(unsigned int _batch, unsigned int _first)
+{
+	m_DrawSlices.clear();
+	const vector<InstanceBatch>& batches = m_Batcher.GetBatches();
+	ConstantSlice slice;
+	for (; _batch < batches.size(); _batch++) {
+		const InstanceBatch& batch = batches[_batch];
+		if (batch.instanced)
+			continue;
+		for (unsigned int i = max(_first, batch.first); i < batch.first + batch.count; i++) {
+			unsigned int index = m_RenderQueue[i].payload;
+			SetObjectConstants(m_Scene.GetModelAt(index), m_Scene.GetWorldMatrixAt(index), m_Scene.GetTintAt(index));
+			if (!m_ConstantRing.Allocate(&toShaderObject, sizeof(toShaderObject), &slice)) {
+				m_ConstantRing.Upload(&m_RenderContext, pConstantRingBuffer);
+				return i;
+			}
+			m_DrawSlices.push_back(slice);
+		}
+	}
+	m_ConstantRing.Upload(&m_RenderContext, pConstantRingBuffer);
+	return (unsigned int)m_RenderQueue.Size();
+}
+
+// - UploadInstances
+// --- Appends the instance data of the View being drawn to the Instance Buffer, which starts over with a discard
+// --- every frame and whenever it is full; a View with more instances than fit gets a bigger buffer
+void ApplicationWindow::UploadInstances()
+{
+	const vector<InstanceData>& instances = m_Batcher.GetInstances();
+	unsigned int count = (unsigned int)instances.size();
+	if (count == 0)
+		return;
+	if (count > m_iInstanceCapacity) {
+		SAFE_RELEASE(pInstanceBuffer);
+		InitializeInstanceBuffer(max(count, m_iInstanceCapacity * 2));
+		// == The new buffer may have the address of the released one
+		m_RenderContext.Invalidate();
+	}
+	bool discard = m_iInstanceHead == 0 || m_iInstanceHead + count > m_iInstanceCapacity;
+	if (discard)
+		m_iInstanceHead = 0;
+	m_RenderContext.WriteBuffer(pInstanceBuffer, m_iInstanceHead * sizeof(InstanceData), &instances[0], count * sizeof(InstanceData), discard);
+	m_iInstanceBase = m_iInstanceHead;
+	m_iInstanceHead += count;
+}
+
+// - WrapConstantRing
+// --- Starts the Constant Ring over with a discard, which also drops the Scene constants of the View being drawn:
+// --- they are uploaded and bound again at the front
+void ApplicationWindow::WrapConstantRing()
+{
+	m_ConstantRing.Upload(&m_RenderContext, pConstantRingBuffer);
+	m_ConstantRing.Wrap();
+	ConstantSlice slice;
+	m_ConstantRing.Allocate(&toShaderScene, sizeof(toShaderScene), &slice);
+	m_ConstantRing.Upload(&m_RenderContext, pConstantRingBuffer);
+	unsigned int firstConstant = slice.FirstConstant(), constantCount = slice.ConstantCount();
+	m_RenderContext.VSSetConstantBuffers1(1, 1, &pConstantRingBuffer, &firstConstant, &constantCount);
+}
+
+void ApplicationWindow::GetViewTargets(SceneView _view, ID3D11RenderTargetView** _target, ID3D11DepthStencilView** _depth)
+{
+	if (_view == VIEW_RENDER_TEXTURE) {
+		*_target = pRenderTextureTargetView;
+		*_depth = pRTDepthView;
+	}
+	else {
+		*_target = pRenderTargetView;
+		*_depth = pDepthView;
+	}
+}
+
+// - QueueTransparentObjects
+// --- Sorted furthest to closest, the rank goes in the depth field so the queue keeps that order
+void ApplicationWindow::QueueTransparentObjects(SceneView _view, const Camera& _camera, const vector<unsigned int>& _visible)
+{
+	if (_visible.empty())
+		return;
+
 	// === Sort the Objects furthest to closest
-	sort(TransparentObjects.begin(), TransparentObjects.end(), SortByDistance);
-
-	// === Draw the Objects
-	for (unsigned int i = 0; i < TransparentObjects.size(); i++) {
-		pDeviceContext->RSSetState(pRS_CullFront);
-		DrawObject(TransparentObjects[i]);
-		pDeviceContext->RSSetState(pRS_CullBack);
-		DrawObject(TransparentObjects[i]);
+	TransparentPositions.resize(_visible.size());
+	for (unsigned int i = 0; i < _visible.size(); i++) {
+		const Mat4& world = m_Scene.GetWorldMatrixAt(_visible[i]);
+		TransparentPositions[i] = MakeVec3(world.m[3][0], world.m[3][1], world.m[3][2]);
 	}
+	const XMFLOAT3& cameraPosition = _camera.GetPosition();
+	TransparentSorters[_view].Sort(MakeVec3(cameraPosition.x, cameraPosition.y, cameraPosition.z), &TransparentPositions[0], &_visible[0], _visible.size(), &SortedTransparentObjects);
+
+	// === Queue the Objects, inside faces first
+	for (unsigned int i = 0; i < SortedTransparentObjects.size(); i++) {
+		unsigned int index = SortedTransparentObjects[i];
+		Object* model = m_Scene.GetModelAt(index);
+		SortKeyFields fields = { (unsigned int)_view, PASS_TRANSPARENT, BLEND_ALPHA, CULL_FRONT, model->ShaderID, model->MaterialID, model->MeshID, i };
+		m_RenderQueue.Push(fields, index);
+		fields.cull = CULL_BACK;
+		m_RenderQueue.Push(fields, index);
+	}
+}
+
+// - DrawTransparentObjectsOIT
+// --- Weighted blended OIT: every object once, in any order, into the accumulation targets, then one composite pass
+void ApplicationWindow::DrawTransparentObjectsOIT(SceneView _view, const vector<unsigned int>& _visible)
+{
+	ID3D11RenderTargetView* target;
+	ID3D11DepthStencilView* depth;
+	GetViewTargets(_view, &target, &depth);
+
+	// === Accumulate, tested against the opaque depth but without writing it
+	const float clearAccumulation[4] = { 0, 0, 0, 1 };
+	const float clearWeight[4] = { 0, 0, 0, 0 };
+	pDeviceContext->ClearRenderTargetView(pOITTargetViews[0], clearAccumulation);
+	pDeviceContext->ClearRenderTargetView(pOITTargetViews[1], clearWeight);
+	m_RenderContext.OMSetRenderTargets(2, pOITTargetViews, depth);
+	m_RenderContext.OMSetBlendState(pOITBlendState, NULL, 0xffffffff);
+	m_RenderContext.OMSetDepthStencilState(pDSS_NoDepthWrite, 0);
+	m_RenderContext.RSSetState(pRS_CullNone);
+	for (unsigned int i = 0; i < _visible.size(); i++)
+		DrawObject(m_Scene.GetModelAt(_visible[i]), m_Scene.GetWorldMatrixAt(_visible[i]), m_Scene.GetTintAt(_visible[i]), pModelOIT_PS);
+
+	// === Composite over the View
+	m_RenderContext.OMSetRenderTargets(1, &target, NULL);
+	m_RenderContext.OMSetBlendState(pBlendState, NULL, 0xffffffff);
+	m_RenderContext.OMSetDepthStencilState(NULL, 0);
+	m_RenderContext.IASetInputLayout(NULL);
+	m_RenderContext.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_RenderContext.VSSetShader(pFullScreen_VS);
+	m_RenderContext.PSSetShader(pOITComposite_PS);
+	m_RenderContext.PSSetShaderResources(0, 2, pOITResourceViews);
+	m_RenderContext.Draw(3, 0);
+
+	// === Unbind the targets from the PS before they are rendered to again, and restore the View
+	ID3D11ShaderResourceView* nullViews[2] = { NULL, NULL };
+	m_RenderContext.PSSetShaderResources(0, 2, nullViews);
+	m_RenderContext.OMSetRenderTargets(1, &target, depth);
+	m_RenderContext.RSSetState(pRS_CullBack);
 }
 
-void ApplicationWindow::DrawScene()
+void ApplicationWindow::DrawScene(SceneView _view, const Camera& _camera)
 {
-	// === Draw the Objects
-	pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	// == Objects with Front Culling
-	pDeviceContext->RSSetState(pRS_CullFront);
-	DrawObject(&CherryTree);
-	// == Objects with Back Culling
-	pDeviceContext->RSSetState(pRS_CullBack);
-	DrawObject(&Ground);
-	DrawObject(&Star);
-	DrawObject(&Bamboo);
-	DrawObject(&Barrel);
-	DrawObject(&CherryTree);
-	// == Transparent Objects
-	DrawTransparentObjects();
+	const vector<unsigned int>& visible = VisibleObjects[_view];
+	const XMFLOAT3& cameraPosition = _camera.GetPosition();
+	Vec3 camera = MakeVec3(cameraPosition.x, cameraPosition.y, cameraPosition.z);
+
+	// === Queue the opaque Objects, nearest first within the same state
+	m_RenderQueue.Clear();
+	VisibleTransparentObjects.clear();
+	for (unsigned int i = 0; i < visible.size(); i++) {
+		unsigned int flags = m_Scene.GetFlagsAt(visible[i]);
+		if (!(flags & ENTITY_DRAW))
+			continue;
+		if (flags & ENTITY_TRANSPARENT) {
+			VisibleTransparentObjects.push_back(visible[i]);
+			continue;
+		}
+		const Mat4& world = m_Scene.GetWorldMatrixAt(visible[i]);
+		Vec3 offset = Subtract(MakeVec3(world.m[3][0], world.m[3][1], world.m[3][2]), camera);
+		Object* model = m_Scene.GetModelAt(visible[i]);
+		// == Static batches only draw their pieces in view, the queue is submitted before the next View culls them again
+		if (model->pStaticBatch != nullptr) {
+			vector<IndexRange>& ranges = m_StaticBatchRanges[model->pStaticBatch - &m_StaticBatches[0]];
+			CullStaticBatch(*model->pStaticBatch, ViewFrustums[_view], &ranges);
+			if (ranges.empty())
+				continue;
+		}
+		SortKeyFields fields = { (unsigned int)_view, PASS_OPAQUE, BLEND_OPAQUE, CULL_BACK, model->ShaderID, model->MaterialID, model->MeshID, DepthToKey(Dot(offset, offset), false) };
+		// == Two sided Objects get their inside drawn too
+		if (flags & ENTITY_TWO_SIDED) {
+			fields.cull = CULL_FRONT;
+			m_RenderQueue.Push(fields, visible[i]);
+			fields.cull = CULL_BACK;
+		}
+		m_RenderQueue.Push(fields, visible[i]);
+	}
+
+	// === Transparent Objects go through the queue unless OIT draws them
+	if (!m_bOITEnabled)
+		QueueTransparentObjects(_view, _camera, VisibleTransparentObjects);
+
+	m_RenderQueue.Sort();
+	SubmitRenderQueue();
+
+	if (m_bOITEnabled && !VisibleTransparentObjects.empty())
+		DrawTransparentObjectsOIT(_view, VisibleTransparentObjects);
 }
 
-void ApplicationWindow::UpdateSceneBuffer(Camera _camera, XMFLOAT4X4 _projMatrix)
+// - SubmitRenderQueue
+// --- Draws the queue in order, only binding the state whose key field differs from the previous draw
+// --- The blend state is the same for every pass, so the blend field only orders the draws
+// --- Runs of the same mesh and material whose model has an instanced shader become one instanced draw
+void ApplicationWindow::SubmitRenderQueue()
+{
+	m_RenderContext.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY::D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// === Batch the queue and upload the instances of this View at once
+	m_Batcher.SetMinInstances(m_bInstancing ? 2 : 0xFFFFFFFF);
+	m_Batcher.Build(m_RenderQueue, m_Scene);
+	UploadInstances();
+
+	// === With offsets, the Object constants of the other draws are uploaded together; an upload ends where the Constant Ring is full
+	const vector<InstanceBatch>& batches = m_Batcher.GetBatches();
+	SortKeyFields bound = { 0, 0, 0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0 };
+	bool boundInstanced = false;
+	unsigned int drawSlice = 0;
+	unsigned int uploadEnd = m_bConstantOffsets ? AllocateQueueConstants(0, 0) : m_RenderQueue.Size();
+	for (unsigned int b = 0; b < batches.size(); b++) {
+		const InstanceBatch& batch = batches[b];
+		SortKeyFields fields = DecodeSortKey(m_RenderQueue[batch.first].key);
+		Object* model = m_Scene.GetModelAt(m_RenderQueue[batch.first].payload);
+		// == Instanced draws use their own shader, layout and a second vertex buffer
+		bool rebind = batch.instanced != boundInstanced;
+
+		// == Rasterizer State
+		if (fields.cull != bound.cull)
+			m_RenderContext.RSSetState(fields.cull == CULL_FRONT ? pRS_CullFront : pRS_CullBack);
+		// == Shaders
+		if (fields.shader != bound.shader || rebind) {
+			m_RenderContext.VSSetShader(batch.instanced ? model->pInstancedVertexShader : model->pVertexShader);
+			m_RenderContext.PSSetShader(model->pPixelShader);
+		}
+		// == Texture and Sampler
+		if (fields.material != bound.material) {
+			m_RenderContext.PSSetShaderResources(0, 1, &model->pShaderResourceView);
+			m_RenderContext.PSSetSamplers(0, 1, &model->pSamplerState);
+		}
+		// == Buffers and Layout
+		if (fields.mesh != bound.mesh || rebind) {
+			ID3D11Buffer* buffers[] = { model->pVertexBuffer, pInstanceBuffer };
+			UINT strides[] = { model->VertexSize, sizeof(InstanceData) };
+			UINT offsets[] = { 0, 0 };
+			m_RenderContext.IASetVertexBuffers(0, batch.instanced ? 2 : 1, buffers, strides, offsets);
+			m_RenderContext.IASetIndexBuffer(model->pIndexBuffer, model->IndexFormat, 0);
+			m_RenderContext.IASetInputLayout(batch.instanced ? model->pInstancedInputLayout : model->pInputLayout);
+		}
+		bound = fields;
+		boundInstanced = batch.instanced;
+
+		if (batch.instanced) {
+			DrawInstances(model, m_iInstanceBase + batch.firstInstance, batch.count);
+			continue;
+		}
+		for (unsigned int i = batch.first; i < batch.first + batch.count; i++) {
+			unsigned int index = m_RenderQueue[i].payload;
+			if (!m_bConstantOffsets) {
+				DrawMesh(model, m_Scene.GetWorldMatrixAt(index), m_Scene.GetTintAt(index));
+				continue;
+			}
+			if (i == uploadEnd) {
+				WrapConstantRing();
+				drawSlice = 0;
+				uploadEnd = AllocateQueueConstants(b, i);
+			}
+			DrawMesh(model, m_DrawSlices[drawSlice++]);
+		}
+	}
+	m_RenderContext.RSSetState(pRS_CullBack);
+}
+
+// - CullScene
+// --- Fills the visible list of _view and keeps its frustum, for culling inside the static batches
+void ApplicationWindow::CullScene(SceneView _view, const Camera& _camera, const XMFLOAT4X4& _projMatrix)
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(_camera.GetViewXMMatrix(), XMLoadFloat4x4(&_projMatrix)));
+	ViewFrustums[_view] = ExtractFrustum(&viewProjection._11);
+	m_Scene.Cull(ViewFrustums[_view], &VisibleObjects[_view]);
+}
+
+void ApplicationWindow::UpdateSceneBuffer(const Camera& _camera, const XMFLOAT4X4& _projMatrix)
 {
 	toShaderScene.viewMatrix = _camera.GetViewMatrix();
 	toShaderScene.projectionMatrix = _projMatrix;
 
-	D3D11_MAPPED_SUBRESOURCE sceneSubResource;
-	pDeviceContext->Map(pSceneConstantBuffer, 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, NULL, &sceneSubResource);
-	memcpy(sceneSubResource.pData, &toShaderScene, sizeof(toShaderScene));
-	pDeviceContext->Unmap(pSceneConstantBuffer, 0);
-
-	pDeviceContext->VSSetConstantBuffers(1, 1, &pSceneConstantBuffer);
+	// === A slice of the Constant Ring per View, or a discard of the SceneConstantBuffer
+	if (m_bConstantOffsets) {
+		ConstantSlice slice;
+		AllocateConstants(&toShaderScene, sizeof(toShaderScene), &slice);
+		m_ConstantRing.Upload(&m_RenderContext, pConstantRingBuffer);
+		unsigned int firstConstant = slice.FirstConstant(), constantCount = slice.ConstantCount();
+		m_RenderContext.VSSetConstantBuffers1(1, 1, &pConstantRingBuffer, &firstConstant, &constantCount);
+		return;
+	}
+	m_RenderContext.WriteBuffer(pSceneConstantBuffer, 0, &toShaderScene, sizeof(toShaderScene), true);
+	m_RenderContext.VSSetConstantBuffers(1, 1, &pSceneConstantBuffer);
 }
 
 void ApplicationWindow::UpdateLighting()
@@ -1341,7 +1910,8 @@ void ApplicationWindow::UpdateLighting()
 	mLights.mSpotLight.HandleInput(Time.Delta());
 
 	// === PointLight Position
-	mLights.mPointLight.Position = XMFLOAT4(PatrolPointLight.GetPosition().x, PatrolPointLight.GetPosition().y, PatrolPointLight.GetPosition().z, 1);
+	Vec3 patrolPosition = m_Scene.GetPosition(PatrolPointLight);
+	mLights.mPointLight.Position = XMFLOAT4(patrolPosition.x, patrolPosition.y, patrolPosition.z, 1);
 
 	// === Rotate Directional Lighting
 	XMFLOAT3 lightDir;
@@ -1349,27 +1919,123 @@ void ApplicationWindow::UpdateLighting()
 	mLights.mDirectionalLight.LightDirection = XMFLOAT4(lightDir.x, lightDir.y, lightDir.z, 1);
 
 	// === Update the Constant Buffera
-	D3D11_MAPPED_SUBRESOURCE sceneSubResource;
-	pDeviceContext->Map(pLightConstantBuffer, 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, NULL, &sceneSubResource);
-	memcpy(sceneSubResource.pData, &mLights, sizeof(Lights));
-	pDeviceContext->Unmap(pLightConstantBuffer, 0);
+	m_RenderContext.WriteBuffer(pLightConstantBuffer, 0, &mLights, sizeof(Lights), true);
 
-	pDeviceContext->PSSetConstantBuffers(0, 1, &pLightConstantBuffer);
+	m_RenderContext.PSSetConstantBuffers(0, 1, &pLightConstantBuffer);
 }
 
 void ApplicationWindow::UpdateObjects()
 {
 	// === Update any Objects that need to be
-	Barrel.Update(Time.Delta());
-	PatrolPointLight.Update(Time.Delta());
+	m_Scene.UpdateMovers(Time.Delta());
+
+	// === Toggle instanced drawing, to compare the draw counts
+	if (GetAsyncKeyState('I') && !InstancingKeyBuffer) {
+		InstancingKeyBuffer = true;
+		m_bInstancing = !m_bInstancing;
+	}
+	else if (!GetAsyncKeyState('I')) {
+		InstancingKeyBuffer = false;
+	}
+
+	// === Toggle between sorted and order-independent Transparency
+	if (GetAsyncKeyState('T') && !OITKeyBuffer) {
+		OITKeyBuffer = true;
+		m_bOITEnabled = !m_bOITEnabled;
+	}
+	else if (!GetAsyncKeyState('T')) {
+		OITKeyBuffer = false;
+	}
 }
 // ============================= //
 
 // ===== Windows Related ===== //	
+// - CompressTextureFromCommandLine
+// --- -compress <source.dds> <destination.dds> [bc1 | bc3 | bc7 | auto] [fast | normal | high], auto and high by default
+static bool CompressTextureFromCommandLine()
+{
+	int count = 0;
+	LPWSTR* arguments = CommandLineToArgvW(GetCommandLineW(), &count);
+	if (arguments == nullptr)
+		return false;
+	vector<string> words;
+	for (int i = 0; i < count; i++) {
+		char word[MAX_PATH];
+		if (WideCharToMultiByte(CP_ACP, 0, arguments[i], -1, word, MAX_PATH, nullptr, nullptr) == 0)
+			word[0] = '\0';
+		words.push_back(word);
+	}
+	LocalFree(arguments);
+
+	size_t first = find(words.begin(), words.end(), "-compress") - words.begin() + 1;
+	CompressionOptions options = { DDS_FORMAT_UNKNOWN, COMPRESSION_HIGH, 0 };
+	bool valid = first + 2 <= words.size();
+	for (size_t i = first + 2; valid && i < words.size(); i++)
+		valid = ParseCompressionArgument(words[i].c_str(), &options);
+	if (!valid) {
+		LogMessage("Usage: -compress <source.dds> <destination.dds> [bc1 | bc3 | bc7 | auto] [fast | normal | high]");
+		return false;
+	}
+	return CompressDDSFile(words[first].c_str(), words[first + 1].c_str(), options);
+}
+
+// - RecordCheck
+// --- One result of -benchmark: logs _name if it failed and counts it in _failures
+static void RecordCheck(const char* _name, bool _passed, unsigned int* _failures)
+{
+	if (_passed)
+		return;
+	LogMessage("Benchmark: %s FAILED", _name);
+	(*_failures)++;
+}
+
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPTSTR lpCmdLine,	int nCmdShow );						   
 LRESULT CALLBACK WndProc(HWND hWnd,	UINT message, WPARAM wparam, LPARAM lparam );		
-int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE, LPTSTR, int )
+int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE, LPTSTR lpCmdLine, int )
 {
+	// === Headless benchmarks, no window or device
+	if (lpCmdLine && wcsstr(lpCmdLine, L"-benchmark")) {
+		unsigned int failures = 0;
+		BenchmarkFrustumCulling(100000, 100);
+		RecordCheck("BenchmarkCamera", BenchmarkCamera(100000), &failures);
+		RecordCheck("BenchmarkMath", BenchmarkMath(1000000), &failures);
+		BenchmarkScene(1000000, 10);
+		RecordCheck("BenchmarkMovement", BenchmarkMovement(100000, 600), &failures);
+		RecordCheck("BenchmarkTransparencySort", BenchmarkTransparencySort(100), &failures);
+		RecordCheck("CheckWeightedBlendedOIT", CheckWeightedBlendedOIT(100000), &failures);
+		BenchmarkRenderQueue(10000);
+		RecordCheck("BenchmarkRenderContext", BenchmarkRenderContext(10000), &failures);
+		RecordCheck("CheckConstantRing", CheckConstantRing(), &failures);
+		RecordCheck("BenchmarkConstantRing", BenchmarkConstantRing(10000), &failures);
+		RecordCheck("BenchmarkInstancing", BenchmarkInstancing(10000), &failures);
+		RecordCheck("CheckStaticBatcher", CheckStaticBatcher(), &failures);
+		RecordCheck("CheckAssetTable", CheckAssetTable(), &failures);
+		RecordCheck("CheckDDSHeader", CheckDDSHeader(), &failures);
+		const char* textures[] = { "BambooT.dds", "barrel_diffuse.dds", "cherryblossomtree.dds", "NebulaSkybox.dds", "SMGrass_Seamless.dds", "WindowedBox.dds" };
+		BenchmarkDDSLoading(textures, sizeof(textures) / sizeof(textures[0]), 20);
+		RecordCheck("CheckTextureCompression", CheckTextureCompression(), &failures);
+		RecordCheck("BenchmarkTextureCompression", BenchmarkTextureCompression(textures, sizeof(textures) / sizeof(textures[0])), &failures);
+		const char* models[] = { "Barrel.obj", "CherryTree.obj", "SingleBamboo.obj" };
+		BenchmarkObjParser(models, sizeof(models) / sizeof(models[0]), 100);
+		RecordCheck("CheckObjParserThreads", CheckObjParserThreads(), &failures);
+		BenchmarkObjParserThreads(100);
+		RecordCheck("CheckObjStream", CheckObjStream(), &failures);
+		// === Writes and streams a 5 GB temporary file, so only on request
+		if (wcsstr(lpCmdLine, L"-largeobj"))
+			RecordCheck("CheckLargeObjStream", CheckLargeObjStream(5), &failures);
+		RecordCheck("CheckVertexPacking", CheckVertexPacking(), &failures);
+		// === Non-zero exit code on any failure, so scripts can gate on it
+		if (failures > 0) {
+			LogMessage("Benchmark: %u checks FAILED", failures);
+			return 1;
+		}
+		LogMessage("Benchmark: every check passed");
+		return 0;
+	}
+	// === Offline texture compression, no window or device
+	if (lpCmdLine && wcsstr(lpCmdLine, L"-compress"))
+		return CompressTextureFromCommandLine() ? 0 : 1;
+
 	srand(unsigned int(time(0)));
 	pApplication = new ApplicationWindow(hInstance, (WNDPROC)WndProc);
     MSG msg; ZeroMemory( &msg, sizeof( msg ) );